@@ -1,11 +1,42 @@
 #ifndef ASYNCSERIALDEVICE_H
 #define ASYNCSERIALDEVICE_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QQueue>
 #include <QTimer>
 #include <QSerialPort>
 
+#include <functional>
+
+// A command for an AsyncSerialDevice and how to tell its reply is complete.
+// The reply ends at the first of these that's set:
+//   - replySize, for replies whose length is only known from the reply
+//   - replyLength, a fixed number of bytes
+//   - terminator, e.g. "\r"
+// and is everything read so far if none are.
+struct SerialCommand
+{
+    QByteArray data;
+
+    // the length of the reply at the front of what's been read, 0 until it's complete
+    std::function<qsizetype(const QByteArray &read)> replySize;
+    qsizetype replyLength {0};
+    QByteArray terminator;
+
+    // a command with the same key that hasn't been sent yet is replaced by
+    // this one, e.g. for set points where only the latest value matters
+    QString coalesceKey;
+
+    int timeout_ms {3000}; // from when the command is sent
+    // called with the reply and how long it took to come back
+    std::function<void(const QByteArray &reply, double latency_ms)> done;
+};
+
+// Sends commands in the order they're written and matches each reply to the
+// oldest unanswered command. Up to pipeline_depth() commands are sent before
+// their replies come back, for devices that buffer commands; the default of
+// one waits for every reply before sending the next command.
 class AsyncSerialDevice : public QObject
 {
     Q_OBJECT
@@ -13,29 +44,54 @@ public:
     explicit AsyncSerialDevice(const QString& portName, QObject *parent = nullptr);
     bool is_connected() const; // returns whether the device is connected or not
     void set_port_name(const QString &portName); // sets the port number for the device
+    bool has_pending_writes() const { return !writeQueue.isEmpty() || !inFlight.isEmpty(); } // commands not answered yet
+
+    int pipeline_depth() const { return pipelineDepth; }
+
+    struct Latency
+    {
+        int count {};
+        double last_ms {};
+        double mean_ms {};
+        double max_ms {};
+    };
+    const Latency &latency() const { return commandLatency; } // of the replies since connecting
+    QString latency_summary() const; // e.g. "JetDrive: 120 replies, mean 2.1 ms, max 8.0 ms"
 
 signals:
     void response(const QString &s); // emit info to be printed to console window
     void error(const QString &s); // error messages
     void timeout(const QString &s); // timeout errors
+    void writes_complete(); // every queued command has been answered
 
 protected:
-    void write(const QByteArray &data); // add command to queue for writing
-    void write_next(); // send next command in queue
-    void clear_command_queue(); // clear the queue
+    void write(const SerialCommand &command); // add command to queue for writing, or coalesce it
+    void clear_command_queue(); // clear the queue and the commands waiting for replies
+    void set_pipeline_depth(int depth); // commands sent before their replies come back
 
 protected:
-    QByteArray prevWrite; // stores the last command sent
+    QByteArray prevWrite; // stores the oldest command waiting for a reply
     QSerialPort *serialPort {nullptr}; // handle for the serial port
-    QTimer *timer {nullptr}; // timer for managing timeout
-    QByteArray readData; // data of response from device
+    QTimer *timer {nullptr}; // times out the oldest command waiting for a reply
+    QByteArray readData; // data read from the device that isn't part of a reply yet
     QString name {"Serial Device"}; // name of the device
 
 private:
-    QQueue<QByteArray> writeQueue; // queue of commands to write to the serial device
-    bool isWriteReady {true}; // keeps track of if the device is ready to receive another command
-    const int readTimeout_ms {3000}; // timeout time in milliseconds
+    struct SentCommand
+    {
+        SerialCommand command;
+        QElapsedTimer sent;
+    };
+
+    void write_next(); // send queued commands until the pipeline is full
+    void handle_ready_read();
+    qsizetype reply_size(const SerialCommand &command) const;
+    void restart_timer();
 
+    QQueue<SerialCommand> writeQueue; // commands waiting to be sent
+    QQueue<SentCommand> inFlight; // commands sent and waiting for replies, oldest first
+    int pipelineDepth {1};
+    Latency commandLatency;
 };
 
 #endif // ASYNCSERIALDEVICE_H
@@ -0,0 +1,124 @@
+#ifndef BUILDORCHESTRATOR_H
+#define BUILDORCHESTRATOR_H
+
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+#include <map>
+#include <string>
+#include <future>
+
+#include "printer.h"
+#include "layerfile.h"
+#include "rasterprint.h"
+
+class PrintThread;
+
+// Runs a whole build unattended: every layer of a layer file is recoated,
+// raster printed, misted and cured by one stream of commands that is sent a
+// layer at a time. Work that doesn't need the same axis or device overlaps:
+//  - the commands for the next layer (reading it from the file, planning its
+//    passes and formatting its rows) are made on another thread while the
+//    current layer runs and added to the stream before it runs out
+//  - the x-axis moves to the first pass of the layer during the recoat,
+//    which only moves the y and z axes
+//  - the heat lamp is switched on with the mister so it has warmed up by the
+//    time the bed gets to it, and the bed goes straight from the mister to
+//    the lamp without coming back up in between
+// Raster_Print.dmc stays on the controller for the whole build, so misting
+// and curing run as the #LMIST and #LCURE routines of Library.dmc in another
+// thread, the same routines PowderSetupWidget uses.
+//
+// Each phase starts with a PhaseMark line, which is how the time spent in
+// each phase is measured.
+
+struct BuildSettings
+{
+    RecoatSettings recoat;
+    int jettingFrequency_Hz {1000};
+    int acceleration_mm_per_s2 {2000};
+    double travelSpeed_mm_per_s {50};
+
+    bool mist {true};
+    double mistSpeed_mm_s {10};
+    int mistDwell_ms {1000};
+
+    bool cure {true};
+    double cureSpeed_mm_s {10};
+
+    int firstLayer {0}; // to carry on with a build that was stopped
+};
+
+struct BuildReport
+{
+    int layersDone {};
+    int numLayers {};
+    double elapsed_s {};
+    double waiting_s {}; // the stream ran out before the next layer was ready
+    std::map<std::string, double> phase_s; // total time in each phase
+
+    double layers_per_hour() const
+    { return elapsed_s > 0 ? layersDone * 3600.0 / elapsed_s : 0; }
+    // e.g. "Layer 3 of 40, 52.1 layers/hour (per layer: recoat 28.1 s, ...)"
+    std::string summary() const;
+};
+
+class BuildOrchestrator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BuildOrchestrator(Printer *printer, QObject *parent = nullptr);
+    ~BuildOrchestrator();
+
+    bool open_layer_file(const std::string &fileName);
+    const LayerFileHeader &layer_file_header() const { return reader_.header(); }
+    int number_of_layers() const { return reader_.number_of_layers(); }
+
+    // false (see error()) if no layer file is open or the raster print
+    // program can't be downloaded
+    bool start(const BuildSettings &settings);
+    void stop();
+    bool is_running() const { return running_; }
+
+    const BuildReport &report() const { return report_; }
+    const std::string &error() const { return error_; }
+
+    // commands for one layer, from its recoat to its cure. Uses the settings
+    // of the last start()
+    std::string layer_commands(int layer);
+
+signals:
+    void progress(QString text);
+    void finished(bool completed);
+
+private:
+    void prepare_layer(int layer);
+    void layer_prepared(int layer, const std::string &commands);
+    void phase_started(const QString &phase, int layer);
+    void stream_ended();
+    void end_build(bool completed);
+
+    Printer *printer_ {nullptr};
+    PrintThread *printThread_ {nullptr};
+    QString rasterProgram_;
+
+    LayerFileReader reader_;
+    RasterPrintCommandGenerator generator_;
+    BuildSettings settings_;
+    std::future<void> preparing_;
+
+    bool running_ {false};
+    int generation_ {0}; // layers prepared for an earlier build are ignored
+    int layersSent_ {0};
+    bool waitingForLayer_ {false};
+    double waitingSince_s_ {};
+
+    BuildReport report_;
+    QElapsedTimer timer_;
+    std::string currentPhase_;
+    double phaseStart_s_ {};
+    std::string error_;
+};
+
+#endif // BUILDORCHESTRATOR_H
@@ -0,0 +1,60 @@
+#ifndef CONTOURPRINT_H
+#define CONTOURPRINT_H
+
+#include <string>
+#include <vector>
+#include <istream>
+
+#include <QString>
+
+#include "printer.h"
+
+// Coordinated (vector) printing of 2D polylines. Each polyline is printed in
+// one continuous move using linear interpolation mode (LM/LI) on the
+// controller. The jetting axis is part of the interpolated vector so drops
+// are spaced by distance along the path, even through speed changes at corners.
+
+struct ContourPoint
+{
+    double x_mm {};
+    double y_mm {};
+};
+
+using Polyline = std::vector<ContourPoint>;
+
+// Text format: one "x,y" (or "x y") point per line in mm. A blank line starts
+// a new polyline and lines starting with '#' are ignored.
+std::vector<Polyline> load_polylines_from_text(std::istream &input);
+
+// Reads <line>, <polyline>, <polygon> and <path> (M, L, H, V, Z commands,
+// absolute or relative) elements from an SVG file. Units are taken as mm.
+std::vector<Polyline> load_polylines_from_svg(const QString &fileName);
+
+// picks the loader from the file extension
+std::vector<Polyline> load_polylines(const QString &fileName);
+
+class ContourPrintCommandGenerator
+{
+public:
+    std::string generate_commands_for_printing(const std::vector<Polyline> &polylines) const;
+
+    int dropletSpacing_um {};
+    int jettingFrequency_Hz {};
+    int acceleration_mm_per_s2 {};
+    double travelSpeed_mm_per_s {50};
+    // how far a corner can deviate from the path, sets the corner speed
+    double cornerDeviation_mm {0.01};
+
+    // bed position of the polyline origin
+    double originX_mm {};
+    double originY_mm {};
+
+    // number of segments to load before starting motion
+    int prefillSegments {32};
+
+private:
+    double print_speed_mm_per_s() const
+    { return (dropletSpacing_um * jettingFrequency_Hz) / 1000.0; }
+};
+
+#endif // CONTOURPRINT_H
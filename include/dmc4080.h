@@ -2,9 +2,12 @@
 #define DMC4080_H
 
 #include <QObject>
+#include <string>
 #include <string_view>
 #include "gmessagepoller.h"
 #include "gmessagehandler.h"
+#include "jogchannel.h"
+#include "homingplanner.h"
 
 class PrintThread;
 class GInterruptHandler;
@@ -17,9 +20,20 @@ public:
     explicit DMC4080(std::string_view address_, QObject *parent = nullptr);
     ~DMC4080();
 
-    void connect_to_motion_controller(bool homeZAxis);
+    // Only sends the settings (and burns them with BN) if they are different
+    // from the ones the controller was last set up with, and only homes if
+    // the axes aren't still homed from last time or homeIfHomed is true. So
+    // reconnecting after restarting this program takes a few seconds.
+    void connect_to_motion_controller(bool homeZAxis, bool homeIfHomed = false);
     void disconnect_controller();
 
+    // Library.dmc stays on the controller so its subroutines can be started
+    // with one XQ (see CMD::call_library). It is downloaded on connecting and
+    // every other program has to be downloaded with download_program(),
+    // which puts the library after it.
+    bool download_library();
+    bool download_program(const char *program, const char *preprocessorOptions = "--max 4");
+
 public:
     // the computer ethernet port needs to be set to 192.168.42.10
     const char *address; // IP address of motion controller
@@ -27,11 +41,27 @@ public:
     //GInterruptHandler *interruptHandler {nullptr};
 
     GMessagePoller *messagePoller {nullptr};
+    JogChannel *jogChannel {nullptr};
 
     GCon g {0}; // Handle for connection to Galil Motion Controller
 
+    // makes the #LHOME routine of the library, changes are downloaded the
+    // next time the library is
+    HomingPlanner homing;
+
 private:
+    void finish_connecting();
+    // value of a variable on the controller, or -1 if it doesn't exist
+    int read_variable(const char *name);
+
+    // Library.dmc without the comments, and #LHOME
+    std::string library() const;
+
+    std::string libraryRoutines; // Library.dmc without the comments
 
+    bool isConnecting {false};
+    bool homeZAxisOnConnect {true};
+    bool homeIfHomedOnConnect {false};
 };
 
 #endif // DMC4080_H
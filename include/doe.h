@@ -0,0 +1,90 @@
+#ifndef DOE_H
+#define DOE_H
+
+#include <string>
+#include <vector>
+
+#include "lineprintdata.h"
+#include "printer.h"
+
+// Design of experiments for line printing. Makes the line sets for a
+// parameter study from ranges of LineSet columns instead of entering every
+// combination in the table, and packs them onto the bed.
+namespace DOE
+{
+
+enum class Method
+{
+    FullFactorial, // every combination of the levels of every factor
+    LatinHypercube // `runs` sets spread evenly over the range of each factor
+};
+
+// most sets a design can make, more than this don't fit on the bed anyway
+constexpr int MAX_RUNS {500};
+
+// a LineSet column varied from low to high (inclusive) in steps of step
+struct Factor
+{
+    int column {}; // index into LineSet
+    float low {};
+    float high {};
+    float step {};
+
+    std::vector<float> levels() const;
+};
+
+struct Design
+{
+    LineSet base; // values of the columns that aren't varied
+    std::vector<Factor> factors;
+    Method method {Method::FullFactorial};
+    int runs {10}; // latin hypercube only
+    unsigned seed {1};
+};
+
+// problems with the design (out of the table limits etc.), empty if it is fine
+std::vector<std::string> validate(const Design &design);
+
+// The print velocity of each set is its droplet spacing times its jetting
+// frequency like in the line printing table, so it can't be a factor. Sets
+// whose print velocity ends up out of range are left out and counted in
+// `skipped`.
+std::vector<LineSet> generate(const Design &design, int *skipped = nullptr);
+
+// part of the bed the sets are packed in (mm)
+struct Area
+{
+    double x_mm {};
+    double y_mm {};
+    double width_mm {PRINT_X_SIZE_MM};
+    double height_mm {PRINT_Y_SIZE_MM};
+};
+
+struct Packing
+{
+    std::vector<LineSet> placed; // with their origins, in printing order
+    std::vector<LineSet> unplaced; // didn't fit in the area
+    double usedWidth_mm {};
+    double usedHeight_mm {};
+    double printTime_s {};
+};
+
+// Packs the sets into the area with shelf packing (first fit decreasing
+// height). The footprint of a set includes the distance the x-axis needs to
+// get up to speed before its lines and to stop after them, and footprints
+// are at least gap_mm apart. Several shelf widths are tried and the one that
+// places the most sets in the smallest bounding box is kept, with the
+// estimated print time deciding between packings of about the same area.
+// Shelves are printed from the bottom up and sets left to right so the
+// moves between sets are short.
+Packing pack(const std::vector<LineSet> &sets, const Area &area, double gap_mm);
+
+// Rough time to print sets that have origins: the print move of every line,
+// the x-axis returning to the start of the next line and the moves between
+// sets at the travel speeds.
+double estimated_print_time_s(const std::vector<LineSet> &sets,
+                              double xTravelSpeed_mm_s = 80, double yTravelSpeed_mm_s = 60);
+
+}
+
+#endif // DOE_H
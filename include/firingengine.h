@@ -0,0 +1,117 @@
+#ifndef FIRINGENGINE_H
+#define FIRINGENGINE_H
+
+#include <string>
+#include <vector>
+
+#include "printer.h"
+
+// Fires droplets at encoder positions of the print axis instead of at times.
+//
+// EncoderGearing: the jetting axis (H) is geared to the print axis encoder and
+// the gearing ratio is switched on and off with position trippoints (AP) at
+// the ends of the window. One H step is one droplet.
+//
+// OutputCompare: the print axis output compare (OC) fires a pulse each time
+// the encoder crosses start + n * spacing. This is done in hardware so it is
+// exact to an encoder count, but the printhead trigger has to be wired to the
+// output compare pin of the print axis.
+//
+// The window is started and ended by position trippoints (AP), which only
+// work in programs that are downloaded to the controller, so that part is
+// made as a thread of the downloaded program by firing_thread().
+namespace Firing
+{
+
+enum class Mode
+{
+    EncoderGearing,
+    OutputCompare
+};
+
+// droplets are placed from start_mm towards end_mm
+struct Window
+{
+    Axis printAxis {Axis::X};
+    double start_mm {};
+    double end_mm {};
+    int dropletSpacing_um {};
+};
+
+// names of the controller arrays used to record firing telemetry
+constexpr const char *PRINT_POSITION_ARRAY {"firePos"};
+constexpr const char *JET_POSITION_ARRAY   {"fireJet"};
+constexpr int MAX_RECORD_LENGTH {4000};
+
+class Engine
+{
+public:
+    explicit Engine(Mode mode = Mode::EncoderGearing) : mode(mode) {}
+
+    // run before the print move starts
+    std::string arm(const Window &window) const;
+    // "#<label>" to "EN" for the downloaded program, started with XQ once the
+    // print move is running: fires the droplets of the window as the print
+    // axis passes it
+    std::string firing_thread(const Window &window, const std::string &label) const;
+    // stops firing right away
+    std::string disarm(const Window &window) const;
+
+    // records the print axis position and the jetting axis position every
+    // few samples for duration_s so verify() can check the droplet positions
+    std::string start_recording(const Window &window, double duration_s) const;
+
+    // positions the droplets are commanded to land at
+    std::vector<double> commanded_positions_mm(const Window &window) const;
+    // droplet spacing after rounding to whole encoder counts (output compare
+    // can only step in whole counts)
+    double actual_spacing_um(const Window &window) const;
+    int number_of_droplets(const Window &window) const;
+
+    Mode mode;
+
+private:
+    // waits for the print axis to reach the window, then starts firing
+    std::string arm_at_start(const Window &window) const;
+    // waits for the print axis to pass the end of the window, then stops firing
+    std::string disarm_at_end(const Window &window) const;
+};
+
+struct Telemetry
+{
+    std::vector<double> printAxis_cnts;
+    std::vector<double> jetAxis_cnts;
+};
+
+struct Verification
+{
+    int commandedDroplets {};
+    int firedDroplets {};
+    int missedDroplets {}; // commanded positions no droplet was fired near
+    int extraDroplets {};  // droplets that aren't near a commanded position
+    // false in OutputCompare mode, which can't be measured
+    bool placementMeasured {true};
+    // of the matched droplets, signed along the direction of travel,
+    // positive is late
+    double meanError_um {};
+    double rmsError_um {};
+    double maxError_um {};
+
+    std::string summary() const;
+};
+
+// Reads the recorded arrays back from the controller
+bool upload_telemetry(GCon g, Telemetry &telemetry);
+
+// Compares where droplets were commanded with where they were fired.
+// In EncoderGearing mode each jetting axis count is a droplet, so the fire
+// positions are found by interpolating the print axis position where the
+// jetting axis crossed each count, and each one is compared with the nearest
+// commanded position. Output compare pulses aren't recorded by the
+// controller, so in that mode the placement isn't measured and the check is
+// only that the print axis crossed every compare position.
+Verification verify(const Engine &engine, const Window &window, const Telemetry &telemetry);
+
+}
+
+#endif // FIRINGENGINE_H
@@ -15,5 +15,9 @@ signals:
     void capture_microscope_image(const QString& pos);
 
 protected:
+    // sets jsAck on the controller once the JetDrive has the segment's settings
+    void acknowledge_jet_schedule(int segment);
+
     Printer *printer_ {nullptr};
+    QMetaObject::Connection jetScheduleAck_;
 };
@@ -0,0 +1,43 @@
+#ifndef HALFTONE_H
+#define HALFTONE_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "rasterprint.h"
+
+class QImage;
+
+// Turns a grayscale binder saturation map into a droplet pattern so parts
+// can have graded saturation instead of only on/off. The fraction of
+// droplets printed in an area follows the saturation of that area.
+namespace Halftone
+{
+
+enum class Method
+{
+    Threshold,      // droplet where saturation is over half (no grading)
+    FloydSteinberg, // error diffusion, best detail
+    BlueNoise       // ordered with a blue noise mask, no worms and no seams
+};
+
+// saturation is row major with `stride` bytes per row, 0 is no binder and
+// 255 is a droplet at every site. numThreads 0 uses all hardware threads.
+//
+// Floyd-Steinberg gives the same result as dithering on one thread: rows
+// run on different threads in a wavefront, each row only waits for the row
+// above to be a couple of pixels ahead of it. The threshold and blue noise
+// methods have no dependence between pixels so the image is split into
+// bands of rows.
+Bitmap dither(const uint8_t *saturation, int width, int height, size_t stride,
+              Method method, int numThreads = 0);
+
+// grayscale image where darker is more binder (same as the printhead images)
+Bitmap dither(const QImage &image, Method method, int numThreads = 0);
+
+// side length of the blue noise threshold mask
+constexpr int BLUE_NOISE_SIZE {64};
+
+}
+
+#endif // HALFTONE_H
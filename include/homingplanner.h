@@ -0,0 +1,64 @@
+#ifndef HOMINGPLANNER_H
+#define HOMINGPLANNER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "printer.h"
+
+// Makes the #LHOME routine of the controller's subroutine library (see
+// Library.dmc). Each axis homes in its own thread on the controller as a list
+// of steps (e.g. jog to the limit, then find the index), so the axes don't
+// wait on each other unless a dependency says a step of one axis can't start
+// until a step of another has finished, e.g. the bed can't be raised until
+// the y-axis has taken it away from the roller.
+//
+// A thread sets lHS<axis> to the number of its steps that are done, which is
+// what the other threads wait on.
+
+struct HomingStep
+{
+    std::string name;
+    std::vector<std::string> commands; // DMC, in counts of lXCnt, lYCnt, lZCnt
+};
+
+class HomingPlanner
+{
+public:
+    // the same moves as the printer has always homed with, with the z-axis
+    // raised once the y-axis is at its front limit
+    HomingPlanner();
+
+    void set_steps(Axis axis, const std::vector<HomingStep> &steps);
+    const std::vector<HomingStep> &steps(Axis axis) const;
+
+    // afterStep of afterAxis waits for beforeStep of beforeAxis. False (see
+    // error()) if either step doesn't exist or the homing could never finish
+    bool add_dependency(Axis beforeAxis, const std::string &beforeStep,
+                        Axis afterAxis, const std::string &afterStep);
+    void clear_dependencies();
+    const std::string &error() const { return error_; }
+
+    // #LHOME and a routine per axis. Without comments, it is downloaded with
+    // and without the preprocessor
+    std::string generate_program() const;
+
+private:
+    struct Dependency
+    {
+        Axis beforeAxis;
+        int beforeStep;
+        Axis afterAxis;
+        int afterStep;
+    };
+
+    int step_index(Axis axis, const std::string &name) const;
+    bool can_finish(const std::vector<Dependency> &dependencies) const;
+
+    std::map<Axis, std::vector<HomingStep>> steps_;
+    std::vector<Dependency> dependencies_;
+    std::string error_;
+};
+
+#endif // HOMINGPLANNER_H
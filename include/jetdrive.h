@@ -33,12 +33,8 @@ public:
 
     void set_waveform(const Waveform &waveform);
 
-    // Before sending the next command,
-    // the response packet must have been received.
-    // TODO: Implement a queue for commands that get popped off and sent when
-    // the appropriate response has been received
-    // use response_size(CMD) to get the appropriate of bytes to wait for
-    // from the response
+    // Commands are answered in order with response_size(CMD) bytes, so once
+    // initialized several of them are sent without waiting for the replies
     void set_continuous_jetting();
     void set_single_jetting();
 
@@ -56,10 +52,9 @@ public:
     void set_strobe_delay(short strobeDelay_microseconds);
 
 private:
-    // consider making these virtual functions in the asyncserialdevice ??
-    void handle_ready_read();
     void handle_timeout();
     void initialize_jet_drive();
+    void send(CMD command, const QString &coalesceKey = {}); // builds the command from jetParams
 
     void clear_members();
     void handle_serial_error(QSerialPort::SerialPortError serialPortError);
@@ -72,8 +67,7 @@ private:
     // Members to help with initialization
     InitState initState {NOT_INITIALIZED};
     const QByteArray xCmd {"X2000"};
-    short iX200 = {0};
-    int expectedResponseSize {4};
+    static constexpr int jetDrivePipelineDepth {4}; // commands sent before their replies come back
 };
 
 }
@@ -0,0 +1,77 @@
+#ifndef JETSCHEDULE_H
+#define JETSCHEDULE_H
+
+#include <string>
+#include <vector>
+
+#include "printer.h"
+
+class LinePrintData;
+
+// Line printing where the JetDrive makes the droplets. The controller gives
+// the JetDrive one trigger pulse at the start of each segment and the JetDrive
+// jets the segment's number of droplets at its frequency, so every segment can
+// have its own frequency, droplet count and droplet spacing (print speed is
+// spacing times frequency).
+//
+// The whole schedule is worked out here and downloaded to the Sched[] array
+// before Line_Print_Schedule.dmc starts, so the program never has to ask for
+// the next segment. The JetDrive is on a serial port of this computer, so its
+// settings still go through here: once a segment has printed the program sends
+// "CMD JET_SCHED <segment> <frequency> <drops>" for the next one and moves to
+// it while GMessageHandler programs the JetDrive, then sets jsAck on the
+// controller. The program only waits on jsAck before the trigger pulse, which
+// is normally already set by the time the move is done.
+
+// must match Line_Print_Schedule.dmc
+constexpr const char *JET_SCHEDULE_ARRAY {"Sched"};
+constexpr int JET_SCHEDULE_FIELDS {8};
+constexpr int JET_SCHEDULE_MAX_SEGMENTS {1500}; // keeps Sched[] to half the array memory
+constexpr int JET_MAX_DROPS_PER_TRIGGER {999}; // most the JetDrive jets from one pulse
+
+struct JetSegment
+{
+    double startX_mm {}; // position of the first droplet (controller coordinates)
+    double y_mm {};
+    int numDroplets {};
+    int dropletSpacing_um {};
+    int frequency_Hz {};
+    double acceleration_mm_per_s2 {};
+
+    double length_mm() const { return numDroplets * dropletSpacing_um / 1000.0; }
+    double print_speed_mm_per_s() const { return (dropletSpacing_um * frequency_Hz) / 1000.0; }
+};
+
+class JetSchedule
+{
+public:
+    // false if the JetDrive or the controller can't print the segment, it is
+    // left out and error() says why
+    bool add_segment(const JetSegment &segment);
+
+    const std::vector<JetSegment>& segments() const { return segments_; }
+    bool empty() const { return segments_.empty(); }
+    void clear();
+    const std::string &error() const { return error_; }
+
+    // Every line of every set in the table with the set's jetting frequency and
+    // droplet spacing. The offset is added to the set origins (nozzle to
+    // controller coordinates).
+    static JetSchedule from_line_print_data(LinePrintData &table, double offsetX_mm, double offsetY_mm);
+
+    // values of Sched[], JET_SCHEDULE_FIELDS per segment in counts
+    std::vector<long> controller_array() const;
+
+    // Line_Print_Schedule.dmc has to be downloaded to the controller first
+    std::string generate_commands_for_printing() const;
+
+    double travelSpeedX_mm_per_s {80};
+    double travelSpeedY_mm_per_s {60};
+    int settleTime_ms {100}; // after moving to the start of a segment
+
+private:
+    std::vector<JetSegment> segments_;
+    std::string error_;
+};
+
+#endif // JETSCHEDULE_H
@@ -0,0 +1,148 @@
+#ifndef JOBFILE_H
+#define JOBFILE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+#include <QString>
+#include <nlohmann/json.hpp>
+
+#include "printer.h"
+#include "trajectory.h"
+
+class LayerMap;
+class LinePrintData;
+struct Bitmap;
+
+// Print job file (.bjob). The settings of a job are a JSON document and the
+// large data (line tables, droplet maps, PVT lists) go in binary blocks
+// after it, so a job can be saved, opened again later and re-run without
+// the widgets that made it.
+//
+// Layout, all values little endian:
+//   header:  "BJOB", version (uint32), json size (uint64),
+//            payload offset (uint64), payload size (uint64)
+//   json:    {"type": ..., "settings": {...}, "blocks": {name: {offset, size, element, count}}}
+//   padding: zeros up to the payload offset
+//   payload: the blocks, each starting on a JOB_PAYLOAD_ALIGNMENT boundary
+//            (block offsets are from the start of the payload)
+//
+// Loading maps the payload into memory instead of reading it, so opening a
+// job with a big droplet map doesn't copy it and pages are only read from
+// disk when a block is used. Blocks of a loaded job point into the mapping,
+// which stays until the JobFile and every BlockView of it are gone.
+
+// increase when the layout or the meaning of a setting changes
+constexpr uint32_t JOB_FILE_VERSION {1};
+constexpr size_t JOB_PAYLOAD_ALIGNMENT {64};
+
+// read-only view of the values in a block
+template <typename T>
+struct BlockView
+{
+    const T *data {nullptr};
+    size_t size {};
+    // keeps the data alive, so a view can be kept after the JobFile is gone
+    std::shared_ptr<const void> owner;
+
+    const T *begin() const { return data; }
+    const T *end() const { return data + size; }
+    const T &operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+class JobFile
+{
+public:
+    JobFile();
+    JobFile(JobFile &&other) = default;
+    JobFile &operator=(JobFile &&other) = default;
+    JobFile(const JobFile &) = delete;
+    JobFile &operator=(const JobFile &) = delete;
+
+    // what kind of job this is (e.g. "line print"), picks what runs it
+    std::string type;
+    nlohmann::json settings;
+
+    // values are copied into the job
+    template <typename T>
+    void add_block(const std::string &name, const T *values, size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "blocks hold plain values");
+        add_block(name, element_name<T>(), sizeof(T), values, count);
+    }
+    template <typename T>
+    void add_block(const std::string &name, const std::vector<T> &values)
+    { add_block(name, values.data(), values.size()); }
+
+    bool has_block(const std::string &name) const { return blocks_.count(name) != 0; }
+    // empty if there is no block with the name or it holds a different type
+    template <typename T>
+    BlockView<T> block(const std::string &name) const
+    {
+        auto it = blocks_.find(name);
+        if (it == blocks_.end() || it->second.element != element_name<T>()
+                || it->second.bytes != it->second.count * sizeof(T)) return {};
+        return {reinterpret_cast<const T*>(it->second.data.get()), it->second.count, it->second.data};
+    }
+
+    bool save(const QString &fileName);
+    bool load(const QString &fileName);
+    // why the last save or load failed
+    const std::string &error() const { return error_; }
+
+private:
+    struct Block
+    {
+        std::string element;
+        size_t count {};
+        size_t bytes {};
+        size_t offset {}; // in the payload
+        // into a copy of the values or the payload, which it keeps alive
+        std::shared_ptr<const uint8_t> data;
+    };
+    struct Payload;
+
+    template <typename T> static const char *element_name();
+    void add_block(const std::string &name, const char *element, size_t elementSize,
+                   const void *values, size_t count);
+    bool fail(const std::string &message);
+
+    std::map<std::string, Block> blocks_;
+    std::string error_;
+};
+
+template <> inline const char *JobFile::element_name<uint8_t>() { return "u8"; }
+template <> inline const char *JobFile::element_name<int32_t>() { return "i32"; }
+template <> inline const char *JobFile::element_name<uint32_t>() { return "u32"; }
+template <> inline const char *JobFile::element_name<float>() { return "f32"; }
+template <> inline const char *JobFile::element_name<double>() { return "f64"; }
+
+// settings stored in the json of a job
+void to_json(nlohmann::json &j, const RecoatSettings &settings);
+void from_json(const nlohmann::json &j, RecoatSettings &settings);
+
+// large data stored in blocks. The read functions return false (and leave
+// the output alone) if the job doesn't have the data or it is malformed.
+namespace Job
+{
+void write_line_print_data(JobFile &job, const LinePrintData &table);
+bool read_line_print_data(const JobFile &job, LinePrintData &table);
+
+void write_bitmap(JobFile &job, const std::string &name, const Bitmap &bitmap);
+// the bitmap points into the job file instead of copying it
+bool read_bitmap(const JobFile &job, const std::string &name, Bitmap &bitmap);
+
+// spans of each row, for full-bed droplet maps
+void write_layer_map(JobFile &job, const std::string &name, const LayerMap &layer);
+bool read_layer_map(const JobFile &job, const std::string &name, LayerMap &layer);
+
+void write_pvt_points(JobFile &job, const std::string &name, const std::vector<Trajectory::PVTPoint> &points);
+bool read_pvt_points(const JobFile &job, const std::string &name, std::vector<Trajectory::PVTPoint> &points);
+}
+
+#endif // JOBFILE_H
@@ -0,0 +1,102 @@
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+#include "jobfile.h"
+
+class PrinterWidget;
+class PrintThread;
+
+// A job waiting in, running from or done in a JobQueue
+struct QueuedJob
+{
+    enum class State { Waiting, Running, Completed, Failed, Skipped };
+
+    int id {};
+    QString name;
+    std::shared_ptr<const JobFile> job;
+    int priority {};             // higher runs first
+    std::vector<int> dependsOn;  // jobs that have to complete before this one
+
+    State state {State::Waiting};
+    QDateTime started;
+    double elapsed_s {};
+    QString result;
+};
+
+QString state_name(QueuedJob::State state);
+
+// Runs saved jobs (see jobfile.h) back to back without anyone at the
+// machine, e.g. line prints, recoats, bed scans and droplet videos overnight.
+//
+// A job is run by the first widget whose run_job() takes it, which emits
+// job_finished when it is done. The next job is the waiting one with the
+// highest priority whose dependencies have all completed, the one queued
+// first if there is a tie. A job can only depend on jobs queued before it,
+// and is skipped if one of them fails or is skipped. Stopping the print
+// thread fails the running job and pauses the queue.
+class JobQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit JobQueue(PrintThread *printThread, QObject *parent = nullptr);
+
+    void add_runner(PrinterWidget *widget);
+
+    // the id of the job, or -1 if it depends on a job that wasn't queued
+    // before it
+    int add(const QString &name, JobFile &&job, int priority = 0, const std::vector<int> &dependsOn = {});
+    // false for the running job
+    bool remove(int id);
+    void clear_finished();
+    bool set_priority(int id, int priority);
+    bool set_dependencies(int id, const std::vector<int> &dependsOn);
+
+    const std::vector<QueuedJob> &jobs() const { return jobs_; }
+    const QueuedJob *find(int id) const;
+
+    void start();
+    // the running job finishes, the next one doesn't start
+    void pause();
+    bool is_running() const { return running_; }
+
+    // e.g. "3 completed, 1 failed, 2 waiting in 1 h 12 min"
+    QString summary() const;
+
+signals:
+    void changed(); // a job was added, removed or edited, or its state changed
+    void started();
+    void paused();
+    void finished(); // no waiting job can run
+    void print_to_output_window(QString s);
+
+private:
+    QueuedJob *find(int id);
+    bool dependencies_valid(int id, const std::vector<int> &dependsOn) const;
+    void skip_blocked_jobs();
+    QueuedJob *next_job();
+    void run_next();
+    void when_job_finished(PrinterWidget *widget, bool completed, const QString &result);
+    void when_stream_stopped();
+    void end_running_job(QueuedJob::State state, const QString &result);
+
+    std::vector<PrinterWidget*> runners_;
+    std::vector<QueuedJob> jobs_;
+    int nextId_ {1};
+
+    bool running_ {false};
+    int runningId_ {-1};
+    PrinterWidget *runningWidget_ {nullptr};
+    QElapsedTimer jobTimer_;
+    QElapsedTimer queueTimer_;
+};
+
+#endif // JOBQUEUE_H
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <map>
+#include <string_view>
+
+#include "gclib.h"
+#include "gclibo.h"
+
+#include "printer.h"
+
+// Jogs the x and y-axes on a connection of its own, so jogging never waits
+// behind the commands queued in PrintThread (and they don't wait for it).
+//
+// The velocity can be changed at any time, e.g. from a joystick or while a
+// jog button is held, and is sent to the controller at a fixed rate. If the
+// velocity isn't set (or keep_alive() called) for a while the axes are
+// stopped, and #LJOGWD in the subroutine library stops them on the
+// controller if this computer stops talking to it altogether.
+class JogChannel : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit JogChannel(QObject *parent = nullptr);
+    ~JogChannel();
+
+    void connect_to_controller(std::string_view IPAddress);
+    void stop();
+
+    // signed, in mm/s, 0 to stop. An axis that is moving for any other
+    // reason is stopped first. A jog that can't start or is stopped by
+    // something else emits error() and has to be set again.
+    void set_velocity(Axis axis, double velocity_mm_s);
+    void stop_jogging();
+    // call more often than the watchdog time while jogging
+    void keep_alive();
+
+protected:
+    void run() override;
+
+signals:
+    void error(QString message);
+    void watchdog_stopped();
+
+private:
+    struct AxisJog
+    {
+        double acceleration_mm_s2 {};
+        double target_mm_s {};
+        double sent_mm_s {};
+        bool jogging {false};
+    };
+
+    bool command(const std::string &command);
+    bool is_moving(Axis axis);
+    void update_axis(Axis axis, AxisJog &jog);
+
+    GCon g_ {nullptr};
+    QMutex mutex_;
+    QWaitCondition waitCondition_;
+    bool quit_ {false};
+
+    std::map<Axis, AxisJog> axes_;
+    QElapsedTimer sinceKeepAlive_;
+    bool watchdogRunning_ {false}; // #LJOGWD on the controller
+};
@@ -0,0 +1,99 @@
+#ifndef LAYERFILE_H
+#define LAYERFILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+
+#include "rasterprint.h"
+
+// One layer of a part as a bit-packed droplet map, 1 bit per droplet. Rows
+// are padded to whole bytes. Row 0 is the top (largest y) like Bitmap.
+class DropletLayer
+{
+public:
+    DropletLayer(int width = 0, int height = 0);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int row_bytes() const { return rowBytes_; }
+
+    bool at(int x, int y) const
+    { return (bits_[(size_t)y * rowBytes_ + (x >> 3)] >> (x & 7)) & 1; }
+    void set(int x, int y)
+    { bits_[(size_t)y * rowBytes_ + (x >> 3)] |= (uint8_t)(1 << (x & 7)); }
+    // sets columns first to last (inclusive) of a row
+    void set_span(int y, int first, int last);
+
+    const uint8_t *row(int y) const { return bits_.data() + (size_t)y * rowBytes_; }
+    uint8_t *row(int y) { return bits_.data() + (size_t)y * rowBytes_; }
+    bool row_is_empty(int y) const;
+
+    // number of droplets in the layer
+    size_t count() const;
+
+    // one byte per droplet, for raster printing
+    Bitmap to_bitmap() const;
+
+private:
+    int width_ {};
+    int height_ {};
+    int rowBytes_ {};
+    std::vector<uint8_t> bits_;
+};
+
+// Layer file (.bjl) layout, all values little endian:
+//   header: "BJL1", version, width, height, layerCount, dropletSpacing_um,
+//           lineSpacing_um, layerHeight_um, originX_mm, originY_mm
+//   each layer: firstRow, rowCount, rowCount * rowBytes bytes
+//               (only the rows between the first and last non-empty row)
+//   index: file offset of each layer
+//   footer: offset of the index, "BJLE"
+// Layers are written one at a time as they are sliced, so the whole build
+// never has to be held in memory, and the index at the end lets a reader go
+// straight to any layer.
+struct LayerFileHeader
+{
+    uint32_t width {};
+    uint32_t height {};
+    uint32_t layerCount {};
+    uint32_t dropletSpacing_um {};
+    uint32_t lineSpacing_um {};
+    uint32_t layerHeight_um {};
+    // bed position of the bottom left droplet
+    double originX_mm {};
+    double originY_mm {};
+};
+
+class LayerFileWriter
+{
+public:
+    bool open(const std::string &fileName, const LayerFileHeader &header);
+    // layers have to be written in order
+    bool write_layer(const DropletLayer &layer);
+    // writes the index, false if fewer layers were written than in the header
+    bool close();
+
+private:
+    std::ofstream file_;
+    LayerFileHeader header_;
+    std::vector<uint64_t> offsets_;
+};
+
+class LayerFileReader
+{
+public:
+    bool open(const std::string &fileName);
+    const LayerFileHeader &header() const { return header_; }
+    int number_of_layers() const { return (int)offsets_.size(); }
+    // returns an empty (0x0) layer if it can't be read
+    DropletLayer read_layer(int layer);
+
+private:
+    std::ifstream file_;
+    LayerFileHeader header_;
+    std::vector<uint64_t> offsets_;
+};
+
+#endif // LAYERFILE_H
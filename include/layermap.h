@@ -0,0 +1,96 @@
+#ifndef LAYERMAP_H
+#define LAYERMAP_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+
+#include "layerfile.h"
+
+// Droplet map of a layer stored as runs of droplets in each row, so the
+// memory used depends on how many edges the pattern has rather than on the
+// bed area. A full 100 x 100 mm layer at 15 um spacing is ~44 million
+// droplet sites but a solid square in it is one span per row.
+//
+// Row 0 is the top (largest y) like Bitmap and DropletLayer.
+//
+// at() is for random lookups (previews, checks). It unpacks the tile it
+// is in to a bit-packed cache, and keeps the most recently used tiles so
+// nearby lookups don't have to search the rows again. The cache makes at()
+// not safe to call from more than one thread at a time.
+class LayerMap
+{
+public:
+    // droplets begin to end - 1 of a row
+    struct Span
+    {
+        int32_t begin {};
+        int32_t end {};
+    };
+    using Row = std::vector<Span>;
+
+    LayerMap(int width = 0, int height = 0);
+    explicit LayerMap(const DropletLayer &layer);
+    explicit LayerMap(const Bitmap &bitmap);
+
+    // copies don't share the tile cache
+    LayerMap(const LayerMap &other);
+    LayerMap &operator=(const LayerMap &other);
+    LayerMap(LayerMap &&other) = default;
+    LayerMap &operator=(LayerMap &&other) = default;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // spans are sorted, don't overlap and don't touch
+    const Row &row(int y) const { return rows_[y]; }
+    bool row_is_empty(int y) const { return rows_[y].empty(); }
+
+    void set_span(int y, int begin, int end);
+    void clear_span(int y, int begin, int end);
+    bool at(int x, int y) const;
+
+    // number of droplets, for binder volume
+    size_t count() const;
+    size_t number_of_spans() const;
+
+    // this | other, this & ~other and this & other. Maps have to be the same size
+    LayerMap &unite(const LayerMap &other);
+    LayerMap &subtract(const LayerMap &other);
+    LayerMap &intersect(const LayerMap &other);
+
+    // keeps the droplets that have every droplet within `droplets` of them
+    // (a square) set, so layer minus eroded(n) is a shell n droplets thick
+    LayerMap eroded(int droplets) const;
+
+    DropletLayer to_droplet_layer() const;
+    Bitmap to_bitmap() const;
+
+    // approximate memory used by the spans and the tile cache
+    size_t memory_bytes() const;
+
+    static constexpr int TILE_SIZE {256}; // droplets along each side
+    static constexpr size_t MAX_CACHED_TILES {64};
+
+private:
+    using TileKey = uint64_t;
+    struct Tile
+    {
+        std::vector<uint8_t> bits; // TILE_SIZE rows of TILE_SIZE / 8 bytes
+        std::list<TileKey>::iterator lruPosition;
+    };
+
+    static Row merge(const Row &a, const Row &b, bool keepA, bool keepB, bool keepBoth);
+    const Tile &tile(int tileX, int tileY) const;
+    void invalidate_cache() const;
+
+    int width_ {};
+    int height_ {};
+    std::vector<Row> rows_;
+
+    mutable std::unordered_map<TileKey, Tile> tiles_;
+    mutable std::list<TileKey> lru_; // most recently used first
+};
+
+#endif // LAYERMAP_H
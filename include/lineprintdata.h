@@ -34,6 +34,7 @@
 #include <QString>
 #include <QLineF> // used in LinePrintData method
 #include <stdexcept>
+#include <cmath>
 
 enum class type {int_type, float_type}; // Type specifier for TableData class.
 // Add types here for additional functionality down the road
@@ -98,6 +99,12 @@ public:
     int size = 7; // Number of columns in dataset (make sure this is the same as the number of objects above)
     // also, make sure to add them to the switch statement below
 
+    // Bed position of the start of the first line (mm), set when sets are
+    // packed onto the bed. NaN means the set goes after the one before it.
+    float originX = NAN;
+    float originY = NAN;
+    bool has_origin() const {return !std::isnan(originX) && !std::isnan(originY);}
+
     TableData& operator[](int i)
     {
         switch(i)
@@ -136,9 +143,36 @@ public:
     int get_column_index_for(const TableData &column);
     int numRows(){return (int)(data.size());}
 
+    // bed position of the start of the first line of each set
+    std::vector<QPointF> set_origins();
+
     std::vector<QLineF> qLines();
     std::vector<QLineF> qAccelerationLines();
 
+    // The preview lines are cached per set. Call invalidate_set after changing
+    // the values of a set in 'data'. Changes to startX, startY, setSpacing and
+    // line lengths are picked up on their own since they move the sets after them.
+    void invalidate_set(int set);
+    void invalidate_geometry();
+
+    // indices of the sets whose lines changed since the last call
+    std::vector<int> changed_sets();
+    const std::vector<QLineF>& set_lines(int set) const {return geometry[set].lines;}
+    const std::vector<QLineF>& set_acceleration_lines(int set) const {return geometry[set].accelerationLines;}
+
+private:
+    struct SetGeometry
+    {
+        bool valid{false};
+        bool changed{false};
+        QPointF origin; // position the lines were generated at
+        std::vector<QLineF> lines;
+        std::vector<QLineF> accelerationLines;
+    };
+    std::vector<SetGeometry> geometry;
+
+    void update_geometry();
+    void generate_set_geometry(int set, QPointF origin);
 };
 
 #endif // LINEPRINTDATA_H
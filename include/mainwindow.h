@@ -11,8 +11,14 @@ class LinePrintWidget;
 class OutputWindow;
 class PowderSetupWidget;
 class QMessageBox;
+class QTimer;
 class BedMicroscopeWidget;
 class MJPrintheadWidget;
+class ContourPrintWidget;
+class RasterPrintWidget;
+class BuildWidget;
+class ServoTuningWidget;
+class JobQueueWidget;
 
 class JettingWidget;
 class HighSpeedLineWidget;
@@ -40,6 +46,7 @@ private slots:
     void x_left_button_pressed();
 
     void jog_released(); // executed when any jogging buttons above are released
+    void update_jog_velocity(); // sends the jog velocity to the jog channel
 
     void on_xHome_clicked();
     void on_yHome_clicked();
@@ -58,6 +65,9 @@ private slots:
     void on_removeBuildBox_clicked();
     void on_actionShow_Hide_Console_triggered();
     void show_hide_droplet_analyzer_window();
+    void open_job();
+    void save_job();
+    void add_job_to_queue();
     void generate_printing_message_box(const std::string &message);
 
     void tab_was_changed(int index);
@@ -91,6 +101,16 @@ private:
     DropletObservationWidget *dropletObservationWidget {nullptr};
     BedMicroscopeWidget *bedMicroscopeWidget {nullptr};
     MJPrintheadWidget *mjPrintheadWidget {nullptr};
+    ContourPrintWidget *contourPrintWidget {nullptr};
+    RasterPrintWidget *rasterPrintWidget {nullptr};
+    BuildWidget *buildWidget {nullptr};
+    ServoTuningWidget *servoTuningWidget {nullptr};
+    JobQueueWidget *jobQueueWidget {nullptr};
+
+    // -1, 0 or 1 while a jog button is held
+    int xJogDirection {0};
+    int yJogDirection {0};
+    QTimer *jogKeepAliveTimer {nullptr};
 
     QMessageBox *messageBox {nullptr};
     // TODO: should this go somewhere else?
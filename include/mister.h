@@ -36,7 +36,7 @@ public:
     int connect_to_misters();
     void disconnect_serial();
 
-    void send_command(CMD command);
+    void send_command(CMD cmd);
     void turn_on_misters();
     void turn_off_misters();
     void turn_on_left_mister();
@@ -46,9 +46,10 @@ private:
     void initialize_misters();
 
 
-    // consider making these virtual functions in the asyncserialdevice ??
-    void handle_ready_read();
     void handle_timeout();
+    // every reply ends with a carriage return
+    static SerialCommand command(char cmd);
+    void check_init_reply(const QByteArray &reply);
 
     void clear_members();
     void handle_serial_error(QSerialPort::SerialPortError serialPortError);
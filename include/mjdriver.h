@@ -3,6 +3,7 @@
 
 #include <QMutex>
 #include "asyncserialdevice.h"
+#include "halftone.h"
 
 namespace Added_Scientific
 {
@@ -51,8 +52,11 @@ public:
     void soft_reset_board();
     void report_current_position();
     void report_head_temps();
-    QByteArray convert_image(int headIdx, const QImage &image, int whiteSpace);
-    void send_image_data(int headIdx, const QImage &image, int whiteSpace);
+    // gray levels in the image are the binder saturation (darker is more)
+    QByteArray convert_image(int headIdx, const QImage &image, int whiteSpace,
+                             Halftone::Method halftone = Halftone::Method::Threshold);
+    void send_image_data(int headIdx, const QImage &image, int whiteSpace,
+                         Halftone::Method halftone = Halftone::Method::Threshold);
     void reconstructed_bitmap(const QByteArray &imageData, int width, int height);
 
     void create_bitmap_lines(int numLines, int width);
@@ -72,8 +76,8 @@ public:
 
 protected:
 
-    // consider making these virtual functions in the asyncserialdevice ??
-    void handle_ready_read();
+    SerialCommand command(const QByteArray &data); // replied to with a line or a JSON object
+    void handle_reply(const QByteArray &reply);
     void handle_timeout();
 
     void clear_members();
@@ -42,9 +42,10 @@ public:
 private:
     void initialize_pressure_controller();
 
-    // consider making these virtual functions in the asyncserialdevice ??
-    void handle_ready_read();
     void handle_timeout();
+    // every reply ends with a carriage return
+    static SerialCommand command(char cmd);
+    void check_init_reply(const QByteArray &reply);
 
     void clear_members();
     void handle_serial_error(QSerialPort::SerialPortError serialPortError);
@@ -72,6 +72,8 @@
 #include <string_view>
 #include <functional>
 #include <map>
+#include <vector>
+#include <utility>
 #include <QObject>
 
 class PrintThread;
@@ -103,6 +105,20 @@ class BedMicroscope;
 
 #define HEAT_LAMP_BIT 24 // pin 3
 
+// y-axis positions of the stations the bed passes under (mm)
+constexpr double MIST_START_Y_MM {-350};
+constexpr double MIST_END_Y_MM {-150};
+constexpr double HEAT_LAMP_START_Y_MM {-310};
+constexpr double HEAT_LAMP_END_Y_MM {-460};
+// how far the bed drops to pass under the roller, mister and lamp
+constexpr double Z_OFFSET_UNDER_ROLLER_MM {0.5};
+// Clearance between the roller and the bed: the bed is only under the roller
+// while it is in front of this y position, so behind it the z-axis can move
+// without the roller touching the powder. The roller traverse of a recoat
+// starts 120 mm in front of the back of the stage (-380 mm), this leaves a
+// 10 mm margin.
+constexpr double ROLLER_CLEAR_Y_MM {-390};
+
 #define HS_TTL_BIT 17 // pin 16
 //#define MISTER_BIT 21 // pin 2
 
@@ -170,7 +186,7 @@ public:
     explicit Printer(QObject *parent = nullptr);
     ~Printer();
 
-    void connect(bool homeZAxis);
+    void connect(bool homeZAxis, bool homeIfHomed = false);
     void disconnect_printer();
 
     static float motor_type_value(MotorType motorType);
@@ -226,6 +242,7 @@ namespace detail
 {
 string axis_string(Axis axis);
 constexpr int mm2cnts(double mm, Axis axis);
+double counts_per_mm(Axis axis);
 string create_gcmd(std::string_view command, Axis axis, int quantity);
 
 inline string to_ASCII_code(char charToConvert)
@@ -241,29 +258,69 @@ inline string GMotionComplete() { return "GMotionComplete,"; }
 inline string JetDrive() { return "JetDrive,"; }
 inline string GSleep() { return "GSleep,"; }
 inline string Message() { return "Message,"; }
+inline string LinearSegment() { return "LinearSegment,"; }
+inline string ArrayDownload() { return "ArrayDownload,"; }
+inline string PhaseMark() { return "PhaseMark,"; }
+inline string GPositionWait() { return "GPositionWait,"; }
+inline string LibraryDownload() { return "LibraryDownload"; }
 inline string GOpen() { return "GOpen"; }
 }
 
 string set_default_controller_settings();
+// FNV-1a hash of the settings, kept to 31 bits so it fits in a variable
+// on the controller
+int configuration_fingerprint(std::string_view settings);
 string cmd_buf_to_dmc(const std::stringstream &s);
-string homing_sequence(bool homeZAxis);
 string move_xy_axes_to_default_position();
 string add_pvt_data_to_buffer(Axis axis,
                               double relativePosition_mm,
                               double velocity_mm,
                               int time_counts);
+string add_pvt_counts_to_buffer(Axis axis,
+                                int relativePosition_cnts,
+                                int velocity_cnts_s,
+                                int time_counts);
 string exit_pvt_mode(Axis axis);
 string begin_pvt_motion(Axis axis);
 string set_hopper_mode_and_intensity(int mode, int intensity);
 string set_jetting_gearing_ratio_from_droplet_spacing(Axis masterAxis,
                                                       int dropletSpacing);
-string mist_layer(double traverseSpeed_mm_per_s, int sleepTime_ms);
 string spread_layer(const RecoatSettings &settings);
 
 // Establish connection with motion controller
 inline string open_connection_to_controller()
 { return detail::GOpen() + "\n"; }
 
+// (re)downloads Library.dmc when the stream gets here, see
+// DMC4080::download_library()
+inline string download_library()
+{ return detail::LibraryDownload() + "\n"; }
+
+// Sets the variables a subroutine of Library.dmc takes and runs it in the
+// given thread, then waits for it to finish. The assignments are packed onto
+// as few command lines as fit, so most calls are one round trip to the
+// controller.
+string call_library(std::string_view label,
+                    const std::vector<std::pair<string, double>> &arguments,
+                    int thread = 0);
+
+// The routines of Library.dmc
+namespace library
+{
+string home_axes(bool homeZAxis);
+// same clearance model as CMD::spread_layer
+string spread_layer(const RecoatSettings &settings);
+// with thenCure the heat lamp warms up while misting and the bed stays down
+// for cure_layer(..., bedDown = true)
+string mist_layer(double traverseSpeed_mm_per_s, int sleepTime_ms,
+                  bool thenCure = false, int thread = 0);
+string cure_layer(double heatingTraverseSpeed_mm_s, bool bedDown = false, int thread = 0);
+string move_to_jetting_window();
+// images the bed at every x position of every y position
+string image_bed(const std::vector<double> &xPositions_mm,
+                 const std::vector<double> &yPositions_mm);
+}
+
 // The Acceleration command (AC) sets the linear acceleration
 // of the motors for independent moves, such as PR, PA, and JG moves.
 // The parameters will be rounded down to the nearest factor of 1024
@@ -326,6 +383,20 @@ inline string begin_motion(Axis axis)
 inline string motion_complete(Axis axis)
 { return detail::GMotionComplete() + detail::axis_string(axis) + "\n"; }
 
+// waits for the coordinated (LM/VM) move on the S vector to finish
+inline string motion_complete_vector()
+{ return detail::GMotionComplete() + "S" + "\n"; }
+
+// waits until the axis has moved past the position, for starting a move on
+// another axis partway through this one. Going backward (toward -) if
+// backward is true
+inline string wait_for_position(Axis axis, double position_mm, bool backward)
+{
+    return detail::GPositionWait() + detail::axis_string(axis) + ","
+            + std::to_string(detail::mm2cnts(position_mm, axis)) + ","
+            + (backward ? "-1" : "1") + "\n";
+}
+
 inline string sleep(int milliseconds)
 { return detail::GSleep() + std::to_string(milliseconds) + "\n";}
 
@@ -385,6 +456,10 @@ inline string message(const std::string& text)
 inline string display_message(const std::string &message)
 { return detail::Message() + message + "\n"; }
 
+// tells whoever is watching the stream that a phase of a layer started
+inline string phase_mark(const std::string &phase, int layer)
+{ return detail::PhaseMark() + phase + "," + std::to_string(layer) + "\n"; }
+
 inline string enable_gearing_for(Axis slaveAxis, Axis masterAxis)
 {
     return detail::GCmd()
@@ -33,19 +33,29 @@ public:
     ~PrintThread();
     void setup(DMC4080 *printer);
     void execute_command(std::stringstream &ss);
+    // adds to the end of the queue even while it is running, for jobs that
+    // are sent a piece at a time
+    void append_command(std::stringstream &ss);
     void stop();
     void print_gcmds(bool print);
 
 private:
     void run() override;
     void clear_queue();
+    bool next_command(std::string &command);
+    void send_linear_segment(const std::string &segment);
+    void send_raster_row(const std::string &row);
+    void wait_for_position(const std::string &args);
     GReturn e(GReturn rc);
 
 signals:
     void response(QString s);
     void error(const std::string &text);
     void ended();
+    void stopped(); // the queue was cleared by stop()
     void connected_to_controller();
+    // the stream reached a "PhaseMark,<phase>,<layer>" line
+    void phase_started(QString phase, int layer);
 
 private:
     DMC4080 *mPrinter {nullptr};
@@ -56,6 +66,10 @@ private:
     bool running {true};
 
     bool mPrintGCmds {false};
+
+    // state of the controller's linear interpolation (LM) segment buffer
+    int mLinearBufferSpace {0};
+    int mLinearSegmentsSent {0};
 };
 
 #endif // PRINTHREAD_H
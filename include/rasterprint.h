@@ -0,0 +1,105 @@
+#ifndef RASTERPRINT_H
+#define RASTERPRINT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "printer.h"
+
+// Raster printing of a 1-bit image where each pixel is one droplet. Every
+// image row is turned into runs of consecutive droplets and printed in one
+// pass of the x-axis, alternating direction each pass (serpentine). The
+// jetting axis is geared to the x-axis and the gearing is switched on and off
+// at the ends of each run with position trippoints.
+//
+// Rows are streamed to Raster_Print.dmc while it runs. The job settings go in
+// the Data[] array like the line printing programs, and the rows go into two
+// slots of the Rows[] array so the next row downloads while the current one
+// prints.
+
+// must match Raster_Print.dmc
+constexpr int RASTER_MAX_RUNS_PER_ROW {200};
+constexpr int RASTER_ROW_HEADER_SIZE {4};
+constexpr int RASTER_ROW_SLOT_SIZE {RASTER_ROW_HEADER_SIZE + 2 * RASTER_MAX_RUNS_PER_ROW};
+
+class LayerMap;
+
+struct Bitmap
+{
+    int width {};
+    int height {};
+    // row major, 1 where a droplet is printed. Row 0 is the top of the image
+    std::vector<uint8_t> pixels;
+    // the pixels are somewhere else instead (e.g. a block of an open job
+    // file), kept alive by owner
+    const uint8_t *external {nullptr};
+    std::shared_ptr<const void> owner;
+
+    const uint8_t *data() const { return external ? external : pixels.data(); }
+    bool at(int x, int y) const { return data()[(size_t)y * width + x] != 0; }
+    bool empty() const { return width == 0 || height == 0; }
+};
+
+// consecutive printed pixels in a row, first and last are inclusive columns
+struct RasterRun
+{
+    int first {};
+    int last {};
+};
+
+std::vector<RasterRun> runs_in_row(const Bitmap &bitmap, int row);
+
+// one move across the bed
+struct RasterPass
+{
+    int row {};
+    int direction {1}; // 1 is +x
+    std::vector<RasterRun> runs; // in the order they are printed
+};
+
+class RasterPrintCommandGenerator
+{
+public:
+    // rows with more runs than fit in a row slot are split over several passes
+    std::vector<RasterPass> plan_passes(const Bitmap &bitmap) const;
+    std::vector<RasterPass> plan_passes(const LayerMap &layer) const;
+
+    // Raster_Print.dmc has to be downloaded to the controller first
+    std::string generate_commands_for_printing(const Bitmap &bitmap) const;
+    std::string generate_commands_for_printing(const LayerMap &layer) const;
+
+    int dropletSpacing_um {};
+    int lineSpacing_um {};
+    int jettingFrequency_Hz {};
+    int acceleration_mm_per_s2 {};
+    double travelSpeed_mm_per_s {50};
+
+    // bed position of the bottom left pixel
+    double originX_mm {};
+    double originY_mm {};
+
+    double print_speed_mm_per_s() const
+    { return (dropletSpacing_um * jettingFrequency_Hz) / 1000.0; }
+
+    // distance to get up to speed plus a little to settle before the first droplet
+    double run_up_mm() const;
+    // where the x-axis starts a pass, before the run up to its first droplet
+    double pass_start_x_mm(const RasterPass &pass) const;
+
+    double pixel_x_mm(int column) const
+    { return originX_mm + column * dropletSpacing_um / 1000.0; }
+    double pixel_y_mm(int height, int row) const
+    { return originY_mm + (height - 1 - row) * lineSpacing_um / 1000.0; }
+    double pixel_y_mm(const Bitmap &bitmap, int row) const
+    { return pixel_y_mm(bitmap.height, row); }
+
+private:
+    std::vector<RasterPass> plan_passes(int height, const std::function<std::vector<RasterRun>(int row)> &runs) const;
+    std::string generate_commands_for_printing(int height, const std::vector<RasterPass> &passes) const;
+    std::string row_slot_command(int height, const RasterPass &pass, int slot) const;
+};
+
+#endif // RASTERPRINT_H
@@ -0,0 +1,122 @@
+#ifndef SERVOTUNER_H
+#define SERVOTUNER_H
+
+#include <string>
+#include <vector>
+
+#include "printer.h"
+
+// Tunes the PID gains of an axis from measurements instead of by hand.
+//
+// An experiment (a position step or a sine sweep of the motor command)
+// records the axis position and the motor command every few servo samples
+// into controller arrays (RA/RD/RC). The recording is fit to the plant
+//     acceleration = gain * command - damping * velocity
+// (counts/s^2, volts and counts/s), which the gains are then picked for by
+// simulating the digital filter of the controller on the fitted plant. The
+// proposed gains give the shortest settling time that keeps the overshoot of
+// a step under the limit.
+//
+// The gains are only valid for the servo update rate (TM) they were tuned at.
+namespace Tuning
+{
+
+// names of the controller arrays the experiments record into
+constexpr const char *POSITION_ARRAY {"tnPos"};
+constexpr const char *COMMAND_ARRAY  {"tnCmd"};
+constexpr int MAX_RECORD_LENGTH {4000};
+
+constexpr double SERVO_PERIOD_S {1.0 / 2048}; // TM 500 (see Trajectory::SAMPLES_PER_SECOND)
+
+struct Gains
+{
+    double KP {};
+    double KD {};
+    double KI {};
+};
+
+struct Record
+{
+    std::vector<double> position_cnts;
+    std::vector<double> command_V;
+    double samplePeriod_s {};
+};
+
+struct PlantModel
+{
+    double gain_cnts_per_s2_per_V {};
+    double damping_per_s {};
+    double fit_R2 {}; // of the acceleration, 1 is a perfect fit
+    bool valid() const { return gain_cnts_per_s2_per_V > 0 && damping_per_s >= 0; }
+};
+
+struct StepMetrics
+{
+    double overshoot_percent {};
+    double settlingTime_s {}; // until it stays within the tolerance, -1 if it never does
+    std::string summary() const;
+};
+
+struct Proposal
+{
+    Gains gains;
+    StepMetrics predicted;
+    bool found {false};
+    std::string summary(Axis axis) const;
+};
+
+struct StepTest
+{
+    Axis axis {Axis::X};
+    double step_mm {0.5};
+    double duration_s {0.5};
+};
+
+struct SineSweep
+{
+    Axis axis {Axis::X};
+    double amplitude_V {0.5};
+    double startFrequency_Hz {2};
+    double endFrequency_Hz {50};
+    double duration_s {2};
+};
+
+// time between the recorded samples of an experiment that lasts duration_s
+double sample_period_s(double duration_s);
+
+// Stream commands for a step of step_mm at the fastest acceleration and
+// speed the controller allows, so the motor command saturates like it would
+// for a true step. The axis's AC, DC and SP are put back afterwards.
+std::string step_test_commands(const StepTest &test);
+
+// DMC program (#TUNESW) that adds a sine of rising frequency to the motor
+// command while the axis holds position. Download it with
+// DMC4080::download_program() before the commands.
+std::string sine_sweep_program(const SineSweep &sweep);
+std::string sine_sweep_commands(const SineSweep &sweep);
+
+// the first count values of a recorded controller array, fewer if the
+// upload fails partway and none if it fails
+std::vector<double> upload_array(GCon g, const char *name, int count);
+
+// the recording of the last experiment, which lasted duration_s
+bool upload_record(GCon g, double duration_s, Record &record);
+bool read_gains(GCon g, Axis axis, Gains &gains);
+
+PlantModel fit_plant(const Record &record);
+
+StepMetrics measure_step(const Record &record, double tolerance_cnts);
+
+// the response of the controller's filter with these gains to a step of
+// step_cnts on the plant, with the motor command limited to torqueLimit_V
+StepMetrics simulate_step(const PlantModel &plant, const Gains &gains,
+                          double step_cnts, double tolerance_cnts, double torqueLimit_V);
+
+Proposal propose_gains(const PlantModel &plant, double maxOvershoot_percent,
+                       double step_cnts, double tolerance_cnts, double torqueLimit_V);
+
+std::string set_gains(Axis axis, const Gains &gains);
+
+}
+
+#endif // SERVOTUNER_H
@@ -0,0 +1,96 @@
+#ifndef SETTLEMODEL_H
+#define SETTLEMODEL_H
+
+#include <string>
+#include <vector>
+
+#include "printer.h"
+
+// How long an axis takes to settle, measured instead of guessed.
+//
+// A calibration move records the position error (_TE) and the reference
+// position (_RP) of an axis into controller arrays while it accelerates to a
+// speed, runs at it and stops. From the recording come
+//   - the run-up settle time: from the end of the acceleration until the
+//     error stays within the tolerance, i.e. how long to run at speed before
+//     jetting, on top of the acceleration distance
+//   - the stop settle time: from the end of the deceleration until the error
+//     stays within the tolerance, i.e. how long to wait after a move before
+//     e.g. taking a picture
+// for each speed and acceleration of the calibration. The model answers from
+// the measurement with the closest speed and acceleration at or above the
+// ones asked about, so it never answers with a shorter time than was
+// measured for a gentler move. Without one, callers keep their old margins.
+namespace Settle
+{
+
+// names of the controller arrays the calibration moves record into
+constexpr const char *ERROR_ARRAY     {"stErr"};
+constexpr const char *REFERENCE_ARRAY {"stRef"};
+
+struct CalibrationMove
+{
+    Axis axis {Axis::X};
+    double speed_mm_s {};
+    double acceleration_mm_s2 {};
+    int direction {1}; // +1 or -1, alternate them so the axis stays put
+};
+
+struct Measurement
+{
+    Axis axis {Axis::X};
+    double speed_mm_s {};
+    double acceleration_mm_s2 {};
+    double runUpSettle_ms {};
+    double stopSettle_ms {};
+};
+
+// how long the recording of the move lasts
+double duration_s(const CalibrationMove &move);
+double distance_mm(const CalibrationMove &move);
+
+// Stream commands for the move and its recording
+std::string calibration_move_commands(const CalibrationMove &move);
+
+// the settle times of the last calibration move, false if it couldn't be
+// uploaded or never settled within tolerance_cnts
+bool measure(GCon g, const CalibrationMove &move, double tolerance_cnts, Measurement &measurement);
+
+class Model
+{
+public:
+    void add(const Measurement &measurement);
+    void clear();
+    const std::vector<Measurement> &measurements() const { return measurements_; }
+
+    // -1 if no measurement covers the speed and acceleration
+    double run_up_settle_ms(Axis axis, double speed_mm_s, double acceleration_mm_s2) const;
+    double stop_settle_ms(Axis axis, double speed_mm_s, double acceleration_mm_s2) const;
+
+    bool save(const std::string &fileName) const;
+    bool load(const std::string &fileName);
+
+private:
+    const Measurement *covering(Axis axis, double speed_mm_s, double acceleration_mm_s2) const;
+
+    std::vector<Measurement> measurements_;
+};
+
+// where model() is loaded from and saved to
+std::string default_file();
+
+// the model the command generators use, loaded from default_file()
+Model &model();
+
+// acceleration distance plus the distance run while settling at speed, or
+// plus fallbackMargin_mm for speeds and accelerations that aren't calibrated
+double run_up_distance_mm(Axis axis, double speed_mm_s, double acceleration_mm_s2,
+                          double fallbackMargin_mm = 0);
+
+// the wait after a move before the axis is within tolerance, or fallback_ms
+// for speeds and accelerations that aren't calibrated
+int stop_wait_ms(Axis axis, double speed_mm_s, double acceleration_mm_s2, int fallback_ms);
+
+}
+
+#endif // SETTLEMODEL_H
@@ -0,0 +1,97 @@
+#ifndef SLICER_H
+#define SLICER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include "layerfile.h"
+
+// Slices a triangle mesh into per-layer droplet maps for binder jetting.
+// Each layer is cut at the middle of its height and filled with the even-odd
+// rule, so the mesh doesn't have to be perfectly closed for most rows to
+// come out right. A droplet is printed when its center is inside the part.
+
+struct Vertex
+{
+    float x {};
+    float y {};
+    float z {};
+};
+
+struct Triangle
+{
+    Vertex v[3];
+};
+
+struct Mesh
+{
+    std::vector<Triangle> triangles;
+    Vertex min;
+    Vertex max;
+
+    bool empty() const { return triangles.empty(); }
+};
+
+// Reads a binary STL file in mm. Returns an empty mesh if the file can't be
+// read (ASCII STL files are not supported)
+Mesh load_binary_stl(const std::string &fileName);
+
+struct SliceSettings
+{
+    int dropletSpacing_um {40}; // x
+    int lineSpacing_um {40};    // y
+    int layerHeight_um {35};    // from RecoatSettings::layerHeight_microns
+    int numThreads {0};         // 0 uses all hardware threads
+};
+
+class Slicer
+{
+public:
+    Slicer(const Mesh &mesh, const SliceSettings &settings);
+
+    int number_of_layers() const { return numLayers_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    LayerFileHeader file_header() const;
+
+    // safe to call from several threads at once
+    DropletLayer slice_layer(int layer) const;
+
+    // Slices all of the layers on a pool of threads and writes them to a
+    // layer file in order. Only a few layers more than the number of threads
+    // are held in memory at a time. progress is called from the calling
+    // thread after each layer is written.
+    bool slice_to_file(const std::string &fileName,
+                       const std::function<void(int layersDone, int numLayers)> &progress = {},
+                       const std::atomic<bool> *cancel = nullptr) const;
+
+private:
+    struct Segment
+    {
+        float x0, y0, x1, y1;
+    };
+
+    void build_layer_index();
+    double layer_z(int layer) const;
+    std::vector<Segment> layer_segments(int layer) const;
+
+    const Mesh &mesh_;
+    SliceSettings settings_;
+    double dropletSpacing_mm_ {};
+    double lineSpacing_mm_ {};
+    double layerHeight_mm_ {};
+    int numLayers_ {};
+    int width_ {};
+    int height_ {};
+
+    // triangles that cross each layer, so a layer doesn't have to scan the
+    // whole mesh. The triangles for layer i are
+    // layerTriangles_[layerStart_[i]] to layerTriangles_[layerStart_[i+1]]
+    std::vector<uint32_t> layerStart_;
+    std::vector<uint32_t> layerTriangles_;
+};
+
+#endif // SLICER_H
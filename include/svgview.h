@@ -53,12 +53,15 @@
 
 #include <QGraphicsView>
 #include <QPen>
+#include <map>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 class QGraphicsSvgItem;
 class QSvgRenderer;
 class QWheelEvent;
 class QPaintEvent;
+class QGraphicsPathItem;
 QT_END_NAMESPACE
 
 class SvgView : public QGraphicsView
@@ -80,6 +83,11 @@ public:
 
     qreal zoomFactor() const;
 
+    // Lines in a group are drawn as one item and replaced together, so a
+    // preview only has to redraw the groups that changed
+    void set_line_group(int group, const std::vector<QLineF> &lines, const QPen &pen);
+    void remove_line_groups_from(int group);
+
     qreal mXSize{0};
     qreal mYSize{0};
 
@@ -110,6 +118,7 @@ private:
     QGraphicsSvgItem *m_svgItem;
     QGraphicsRectItem *m_backgroundItem;
     QGraphicsRectItem *m_outlineItem;
+    std::map<int, QGraphicsPathItem*> m_lineGroups;
 
     QPen outlinePen = QPen(Qt::black, 0.001, Qt::DashLine, Qt::RoundCap);
 
@@ -0,0 +1,144 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <string>
+#include <vector>
+
+#include "printer.h"
+
+// Generates PVT (position, velocity, time) motion for a single axis that
+// accelerates up to a constant velocity, holds it over a window
+// (e.g. the line being printed), and then decelerates back to rest.
+//
+// Only single-axis moves are planned: every line the printer prints is along
+// one axis, and the other axes are stationary while it does. A path over
+// several axes would need the limits of each axis projected onto the path
+// and a profile per axis that share their segment times, which isn't here.
+//
+// Every ramp is a jerk-limited S-curve (or a trapezoid if no jerk limit is
+// given). Each phase of an S-curve is a cubic in time, which is exactly
+// what the controller interpolates between PVT points, so the profile that
+// is downloaded is the profile that was planned. Phases are rounded up to
+// whole servo samples and anything longer than the controller's segment
+// limit is split into several segments.
+//
+// A profile can also be input shaped (ZV or ZVD) for the resonance of the
+// axis: the planned profile is convolved with a few impulses spaced half a
+// period of the resonance apart, which cancels the vibration the ramps would
+// otherwise excite. The shaped ramps take a little longer (half a period for
+// ZV, a whole period for ZVD) but can use a much higher acceleration.
+namespace Trajectory
+{
+
+// the controller only accepts PVT segments of up to 2048 samples
+constexpr int MAX_PVT_SEGMENT_SAMPLES {2048};
+// number of servo samples per second (TM 500)
+constexpr int SAMPLES_PER_SECOND {2048};
+
+struct InputShaper
+{
+    enum class Type { None, ZV, ZVD };
+
+    Type type {Type::None};
+    double frequency_Hz {};  // measured resonance of the axis
+    double dampingRatio {};  // of the resonance, 0 if not known
+};
+
+// one impulse of a shaper, delays are rounded to whole servo samples so the
+// shaped profile still breaks on samples
+struct ShaperImpulse
+{
+    double amplitude {};
+    int delay_samples {};
+};
+
+// the impulses of the shaper, a single impulse of 1 if it is off
+std::vector<ShaperImpulse> shaper_impulses(const InputShaper &shaper);
+
+struct AxisLimits
+{
+    double acceleration_mm_s2 {};
+    double jerk_mm_s3 {}; // 0 means no jerk limit (trapezoidal ramps)
+    InputShaper shaper {};
+};
+
+struct PVTPoint
+{
+    double relativePosition_mm {}; // distance moved during this segment
+    double velocity_mm_s {};       // velocity at the end of this segment
+    int time_samples {};           // duration of this segment
+};
+
+// One constant-jerk piece of a profile
+struct Phase
+{
+    double startTime_s {};
+    double duration_s {};
+    double startPosition_mm {};
+    double startVelocity_mm_s {};
+    double startAcceleration_mm_s2 {};
+    double jerk_mm_s3 {};
+};
+
+class Profile
+{
+public:
+    const std::vector<PVTPoint>& points() const { return points_; }
+    const std::vector<Phase>& phases() const { return phases_; }
+
+    // window where the axis is at the target velocity,
+    // in seconds from the start of the move
+    double constant_velocity_start_s() const { return constantVelocityStart_s_; }
+    double constant_velocity_end_s() const { return constantVelocityEnd_s_; }
+    double constant_velocity_mid_s() const
+    { return 0.5 * (constantVelocityStart_s_ + constantVelocityEnd_s_); }
+
+    double total_time_s() const;
+    double ramp_time_s() const { return constantVelocityStart_s_; }
+    // unsigned distance covered while ramping up to speed
+    double acceleration_distance_mm() const { return accelerationDistance_mm_; }
+    // unsigned distance covered at constant velocity
+    double constant_velocity_distance_mm() const { return constantVelocityDistance_mm_; }
+    double velocity_mm_s() const { return velocity_mm_s_; }
+
+    // signed position/velocity relative to the start of the move
+    double position_at(double time_s) const;
+    double velocity_at(double time_s) const;
+
+    // Returns the PVT commands for the profile followed by the command to exit
+    // PVT mode. Positions are rounded to encoder counts on the cumulative
+    // position so rounding errors do not build up over many segments
+    std::string commands(Axis axis) const;
+
+private:
+    friend Profile plan_constant_velocity_move(double, double, const AxisLimits&);
+    friend Profile shape(const Profile&, const InputShaper&);
+
+    // appends a phase that starts where the previous one ended
+    void add_phase(double duration_s, double startAcceleration_mm_s2, double jerk_mm_s3);
+    // the PVT points of the phases
+    void make_points();
+
+    std::vector<PVTPoint> points_;
+    std::vector<Phase> phases_;
+    double constantVelocityStart_s_ {};
+    double constantVelocityEnd_s_ {};
+    double accelerationDistance_mm_ {};
+    double constantVelocityDistance_mm_ {};
+    double velocity_mm_s_ {};
+};
+
+// Plans a move that ramps up to velocity_mm_s, travels constantVelocityDistance_mm
+// at that velocity, then ramps back down to a stop. The sign of velocity_mm_s
+// sets the direction of the move. With a shaper in the limits the ramps are
+// shaped and the constant velocity distance is still travelled in full.
+Profile plan_constant_velocity_move(double constantVelocityDistance_mm,
+                                    double velocity_mm_s,
+                                    const AxisLimits &limits);
+
+// the profile convolved with the impulses of the shaper
+Profile shape(const Profile &profile, const InputShaper &shaper);
+
+}
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,45 @@
+#ifndef TRIGGERSCHEDULER_H
+#define TRIGGERSCHEDULER_H
+
+#include <string>
+#include <vector>
+
+#include "trajectory.h"
+
+// Places commands (e.g. the high speed camera trigger) at times relative to
+// the start of a PVT move. While the axis is moving the command is placed
+// with a position trippoint (AP) at the position the profile says the axis
+// will be at that time, so it follows the real motion and resolves to a
+// servo sample instead of a whole millisecond. Before the move starts (or
+// while the axis is stopped) it falls back to AT trippoints in samples.
+//
+// Trippoints only work in programs that are downloaded to the controller.
+class TriggerScheduler
+{
+public:
+    TriggerScheduler(const Trajectory::Profile &profile, Axis axis, double moveStart_mm);
+
+    // time_s is relative to the start of the move and may be negative
+    void add_event(double time_s, const std::string &commands);
+
+    // Returns the commands that start the PVT move (BT) with all of the
+    // events in between, in time order
+    std::string commands() const;
+
+private:
+    struct Event
+    {
+        double time_s {};
+        std::string commands;
+    };
+
+    // true if the axis is moving fast enough at time_s for a position trippoint
+    bool moving_at(double time_s) const;
+
+    const Trajectory::Profile &profile_;
+    Axis axis_;
+    double moveStart_mm_;
+    std::vector<Event> events_;
+};
+
+#endif // TRIGGERSCHEDULER_H
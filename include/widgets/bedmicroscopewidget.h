@@ -19,6 +19,9 @@ public:
     explicit BedMicroscopeWidget(Printer *printer, QWidget *parent = nullptr);
     ~BedMicroscopeWidget();
     void allow_widget_input(bool allowed) override;
+    bool save_job(JobFile &job) override;
+    bool load_job(const JobFile &job) override;
+    bool run_job(const JobFile &job) override;
     void connect_to_camera();
     void update_display(const QImage &image);
     void show_microscope_image();
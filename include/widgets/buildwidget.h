@@ -0,0 +1,38 @@
+#ifndef BUILDWIDGET_H
+#define BUILDWIDGET_H
+
+#include <QWidget>
+
+#include "printerwidget.h"
+#include "buildorchestrator.h"
+
+namespace Ui {
+class BuildWidget;
+}
+
+// Runs a build from a sliced layer file (.bjl) layer after layer without
+// anyone pressing the recoat, print, mist and cure buttons in between, and
+// shows how long each phase takes.
+class BuildWidget : public PrinterWidget
+{
+    Q_OBJECT
+
+public:
+    explicit BuildWidget(Printer *printer, QWidget *parent = nullptr);
+    ~BuildWidget();
+    void allow_widget_input(bool allowed) override;
+
+private slots:
+    void open_layer_file();
+    void start_build();
+    void stop_build();
+    void when_build_finished(bool completed);
+
+private:
+    BuildSettings build_settings() const;
+
+    Ui::BuildWidget *ui;
+    BuildOrchestrator *build {nullptr};
+};
+
+#endif // BUILDWIDGET_H
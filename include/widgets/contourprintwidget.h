@@ -0,0 +1,41 @@
+#ifndef CONTOURPRINTWIDGET_H
+#define CONTOURPRINTWIDGET_H
+
+#include <QWidget>
+#include <QPen>
+
+#include "printerwidget.h"
+#include "contourprint.h"
+
+namespace Ui {
+class ContourPrintWidget;
+}
+
+class ContourPrintWidget : public PrinterWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ContourPrintWidget(Printer *printer, QWidget *parent = nullptr);
+    ~ContourPrintWidget();
+    void allow_widget_input(bool allowed) override;
+
+private slots:
+    void load_file();
+    void update_print_settings();
+    void update_preview();
+    void print_contours();
+    void stop_printing();
+    void when_print_completed();
+
+private:
+    Ui::ContourPrintWidget *ui;
+    ContourPrintCommandGenerator print;
+    std::vector<Polyline> polylines;
+    bool printIsRunning_ {false};
+
+    QPen linePen = QPen(QColor(42, 130, 218), 0.1, Qt::SolidLine, Qt::RoundCap);
+    QPen lineTravelPen = QPen(Qt::red, 0.1, Qt::DashLine, Qt::RoundCap);
+};
+
+#endif // CONTOURPRINTWIDGET_H
@@ -0,0 +1,37 @@
+#ifndef DOEDIALOG_H
+#define DOEDIALOG_H
+
+#include <QDialog>
+
+#include "doe.h"
+
+class QTableWidget;
+class QComboBox;
+class QSpinBox;
+class QDialogButtonBox;
+
+// Asks for the factors of a line printing parameter study. Each LineSet
+// column is a row of the table and the checked rows are varied from low to
+// high; the other columns keep the value of the base set.
+class DOEDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DOEDialog(const LineSet &base, QWidget *parent = nullptr);
+
+    DOE::Design design() const;
+
+private:
+    void initWidgets();
+    void update_run_count();
+
+    LineSet base_;
+    QTableWidget *table {};
+    QComboBox *methodComboBox {};
+    QSpinBox *runsSpinBox {};
+    QSpinBox *seedSpinBox {};
+    QDialogButtonBox *buttonBox {};
+};
+
+#endif // DOEDIALOG_H
@@ -31,6 +31,10 @@ public:
     explicit DropletObservationWidget(Printer *printer, QWidget *parent = nullptr);
     ~DropletObservationWidget();
     void allow_widget_input(bool allowed) override;
+    bool save_job(JobFile &job) override;
+    bool load_job(const JobFile &job) override;
+    // jets, records a strobe sweep video and saves it
+    bool run_job(const JobFile &job) override;
     bool is_droplet_anlyzer_window_visible() const;
 
 public slots:
@@ -65,6 +69,7 @@ private slots:
     void jet_for_three_minutes();
     void end_jet_timer();
     void update_progress_bar();
+    void when_job_video_captured();
 
 private:
     Ui::DropletObservationWidget *ui;
@@ -99,6 +104,9 @@ private:
     bool m_captureVideoWithSweep {false};
 
     QString m_tempFileName{};
+
+    bool m_runningJob {false}; // started by run_job()
+    QString m_jobVideoFolder{};
 };
 
 #endif // DROPLETOBSERVATIONWIDGET_H
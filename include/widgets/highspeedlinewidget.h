@@ -6,6 +6,8 @@
 
 #include "printerwidget.h"
 #include "printer.h"
+#include "trajectory.h"
+#include "firingengine.h"
 #include <sstream>
 
 struct SmallBuildBox
@@ -30,6 +32,9 @@ public:
     int dropletSpacing_um{};
     int jettingFrequency_Hz{};
     int acceleration_mm_per_s2{};
+    int jerk_mm_per_s3{}; // 0 for trapezoidal ramps
+    // shapes the print move when printing with the y-axis
+    Trajectory::InputShaper yShaper{};
 
     //const double print_travel_length{20.0};
     const double xTravelSpeed{50};
@@ -41,9 +46,17 @@ public:
 
     int triggerOffset_ms{};
 
+    // fire droplets by print axis position instead of jogging the jetting axis
+    bool positionSynchronizedFiring{false};
+    Firing::Engine firingEngine{};
+    // droplet window for the line at the center of the build box
+    Firing::Window firing_window() const;
+
 private:
+    // PVT move for the print axis across the line (in the negative direction)
+    Trajectory::Profile line_print_profile() const;
+
     std::stringstream s_;
-    int cntsPerSec{2048};
 };
 
 namespace Ui
@@ -59,6 +72,10 @@ public:
     explicit HighSpeedLineWidget(Printer *printer, QWidget *parent = nullptr);
     ~HighSpeedLineWidget();
     void allow_widget_input(bool allowed) override;
+    bool save_job(JobFile &job) override;
+    bool load_job(const JobFile &job) override;
+    // prints every line one after the other
+    bool run_job(const JobFile &job) override;
     void reset_preview_zoom();
 
 public slots:
@@ -86,6 +103,7 @@ private:
     HighSpeedLineCommandGenerator *print{nullptr};
     int currentLineToPrintIndex{0};
     bool printIsRunning_{false};
+    bool runningJob_{false}; // started by run_job()
 };
 
 #endif // HIGHSPEEDLINEWIDGET_H
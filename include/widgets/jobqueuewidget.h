@@ -0,0 +1,49 @@
+#ifndef JOBQUEUEWIDGET_H
+#define JOBQUEUEWIDGET_H
+
+#include <QWidget>
+
+#include "printerwidget.h"
+#include "jobqueue.h"
+
+namespace Ui {
+class JobQueueWidget;
+}
+
+// Shows the job queue (see jobqueue.h), where saved jobs and the jobs of the
+// other tabs are lined up, ordered by priority and dependencies, and run
+// back to back.
+class JobQueueWidget : public PrinterWidget
+{
+    Q_OBJECT
+
+public:
+    explicit JobQueueWidget(Printer *printer, QWidget *parent = nullptr);
+    ~JobQueueWidget();
+    void allow_widget_input(bool allowed) override;
+
+    // a tab that runs jobs
+    void add_runner(PrinterWidget *widget);
+    void add_job(const QString &name, JobFile &&job);
+    bool is_running() const { return queue->is_running(); }
+
+signals:
+    void queue_finished();
+
+private slots:
+    void add_job_files();
+    void remove_job();
+    void clear_finished();
+    void update_table();
+    void job_cell_changed(int row, int column);
+    void update_buttons();
+
+private:
+    int selected_job() const;
+
+    Ui::JobQueueWidget *ui;
+    JobQueue *queue {nullptr};
+    bool inputAllowed {false};
+};
+
+#endif // JOBQUEUEWIDGET_H
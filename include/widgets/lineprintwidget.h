@@ -35,6 +35,9 @@ public:
     void generate_line_set_commands(int setNum, std::stringstream &s);
 
     void allow_widget_input(bool allowed) override;
+    bool save_job(JobFile &job) override;
+    bool load_job(const JobFile &job) override;
+    bool run_job(const JobFile &job) override;
 
 private slots:
     void on_numSets_valueChanged(int arg1);
@@ -48,6 +51,7 @@ private slots:
     void print_lines_dmc();
     void when_line_print_completed();
     void stop_print_button_pressed();
+    void design_experiment();
     QString read_dmc_code(QString filename);
 
 private:
@@ -55,11 +59,13 @@ private:
 
     void disable_velocity_input();
     void check_x_start();
+    void update_inputs_from_table();
 
-    std::vector<std::array<int, 11>> generate_line_set_arrays_dmc();
+    std::vector<std::array<int, 12>> generate_line_set_arrays_dmc();
     std::string line_set_arrays_dmc();
 
     bool printIsRunning_{false};
+    bool runningJob_{false}; // started by run_job()
 
 
     // TODO: put these somewhere better soon!
@@ -76,7 +82,7 @@ private:
     QPen lineTravelPen = QPen(Qt::red, 0.1, Qt::DashLine, Qt::RoundCap);
 
     QString dmcLinePrintCode;
-    QString dmcLinePrintCode_JetFreq;
+    QString dmcLinePrintCode_Schedule;
 
 };
 
@@ -2,6 +2,7 @@
 #define POWDERSETUPWIDGET_H
 
 #include <QWidget>
+#include <QElapsedTimer>
 #include <sstream>
 
 #include "printerwidget.h"
@@ -19,6 +20,9 @@ public:
     ~PowderSetupWidget();
 
     void allow_widget_input(bool allowed) override;
+    bool save_job(JobFile &job) override;
+    bool load_job(const JobFile &job) override;
+    bool run_job(const JobFile &job) override;
 
 private slots:
     void level_recoat_clicked();
@@ -29,9 +33,16 @@ private slots:
 
     void cure_layer_pressed();
 
+    // how long each spread_layer() takes, from the phase marks around it
+    void time_recoat(const QString &phase, int layer);
+
 private:
+    RecoatSettings recoat_settings(bool levelRecoat) const;
+    std::string recoat_commands(const RecoatSettings &settings, int numLayers) const;
+
     Ui::PowderSetupWidget *ui;
     bool isMisting{false};
+    QElapsedTimer recoatTimer;
 };
 
 #endif // POWDERSETUPWIDGET_H
@@ -8,6 +8,8 @@
 #include "printer.h"
 #include "printhread.h"
 
+class JobFile;
+
 namespace Ui {
 class PrinterWidget;
 }
@@ -20,6 +22,16 @@ public:
     explicit PrinterWidget(Printer *printer_, QWidget *parent = nullptr);
     virtual ~PrinterWidget();
 
+    // Widgets that run a kind of job save their settings into a job file and
+    // set themselves up from one. Both return false if the widget doesn't
+    // handle that kind of job.
+    virtual bool save_job(JobFile &job) { (void)job; return false; }
+    virtual bool load_job(const JobFile &job) { (void)job; return false; }
+    // Widgets that can run a kind of job without anyone at the machine load
+    // it, start it and emit job_finished when it is done (see jobqueue.h).
+    // Returns false if the widget doesn't run that kind of job.
+    virtual bool run_job(const JobFile &job) { (void)job; return false; }
+
 public slots:
     virtual void allow_widget_input(bool allowed) = 0; // =0 makes it so that every child must override this function to compile (don't put in slots in child, just public)
 
@@ -29,13 +41,21 @@ signals:
     void stop_print_and_thread();
     void disable_user_input();
     void print_to_output_window(QString s);
+    void job_finished(bool completed, QString result);
 
     void start_continuous_jetting();
     void stop_continuous_jetting();
 
 protected:
+    // for jobs that are one stream of commands, emits job_finished when the
+    // stream ends
+    void finish_job_when_stream_ends();
+
     PrintThread *mPrintThread{nullptr};
     Printer *mPrinter{nullptr};
+
+private slots:
+    void when_job_stream_ended();
 };
 
 #endif // PRINTERWIDGET_H
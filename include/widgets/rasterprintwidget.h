@@ -0,0 +1,51 @@
+#ifndef RASTERPRINTWIDGET_H
+#define RASTERPRINTWIDGET_H
+
+#include <QWidget>
+#include <QPen>
+#include <QImage>
+
+#include <memory>
+
+#include "printerwidget.h"
+#include "rasterprint.h"
+
+namespace Ui {
+class RasterPrintWidget;
+}
+
+class RasterPrintWidget : public PrinterWidget
+{
+    Q_OBJECT
+
+public:
+    explicit RasterPrintWidget(Printer *printer, QWidget *parent = nullptr);
+    ~RasterPrintWidget();
+    void allow_widget_input(bool allowed) override;
+    bool save_job(JobFile &job) override;
+    bool load_job(const JobFile &job) override;
+    bool run_job(const JobFile &job) override;
+
+private slots:
+    void load_file();
+    void update_bitmap();
+    void update_print_settings();
+    void update_preview();
+    void print_bitmap();
+    void stop_printing();
+    void when_print_completed();
+
+private:
+    Ui::RasterPrintWidget *ui;
+    RasterPrintCommandGenerator print;
+    QImage sourceImage;
+    std::shared_ptr<const void> sourceOwner; // the job file sourceImage points into
+    Bitmap bitmap;
+    QString dmcRasterPrintCode;
+    bool printIsRunning_ {false};
+    bool runningJob_ {false}; // started by run_job()
+
+    QPen linePen = QPen(QColor(42, 130, 218), 0.1, Qt::SolidLine, Qt::RoundCap);
+};
+
+#endif // RASTERPRINTWIDGET_H
@@ -0,0 +1,56 @@
+#ifndef SERVOTUNINGWIDGET_H
+#define SERVOTUNINGWIDGET_H
+
+#include <QStringList>
+#include <QWidget>
+
+#include <deque>
+
+#include "printerwidget.h"
+#include "servotuner.h"
+#include "settlemodel.h"
+
+namespace Ui {
+class ServoTuningWidget;
+}
+
+// Runs a step test or sine sweep on the x or y-axis, fits the recording and
+// proposes PID gains (see servotuner.h) next to how the current ones do.
+// Also measures how long the axis takes to settle after accelerating to and
+// stopping from a grid of speeds and accelerations (see settlemodel.h).
+class ServoTuningWidget : public PrinterWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ServoTuningWidget(Printer *printer, QWidget *parent = nullptr);
+    ~ServoTuningWidget();
+    void allow_widget_input(bool allowed) override;
+
+private slots:
+    void run_step_test();
+    void run_sine_sweep();
+    void when_experiment_finished();
+    void apply_gains();
+    void calibrate_settle_times();
+    void when_settle_move_finished();
+
+private:
+    Axis selected_axis() const;
+    void run_next_settle_move();
+
+    Ui::ServoTuningWidget *ui;
+
+    // the experiment that is running or ran last
+    Axis experimentAxis {Axis::X};
+    double experimentDuration_s {};
+    bool experimentIsStep {false};
+
+    Tuning::Proposal proposal {};
+
+    // settle time calibration moves still to run, the front one is running
+    std::deque<Settle::CalibrationMove> settleMoves;
+    QStringList settleReport;
+};
+
+#endif // SERVOTUNINGWIDGET_H
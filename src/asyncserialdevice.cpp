@@ -1,6 +1,8 @@
 #include "asyncserialdevice.h"
 #include <QDebug>
 
+#include <algorithm>
+
 AsyncSerialDevice::AsyncSerialDevice(const QString& portName, QObject *parent) :
     QObject(parent),
     serialPort (new QSerialPort(this)),
@@ -8,6 +10,7 @@ AsyncSerialDevice::AsyncSerialDevice(const QString& portName, QObject *parent) :
 {
     serialPort->setPortName(portName);
     timer->setSingleShot(true);
+    connect(serialPort, &QSerialPort::readyRead, this, &AsyncSerialDevice::handle_ready_read);
 }
 
 bool AsyncSerialDevice::is_connected() const
@@ -20,41 +23,129 @@ void AsyncSerialDevice::set_port_name(const QString &portName)
     serialPort->setPortName(portName);
 }
 
-void AsyncSerialDevice::write(const QByteArray &data)
+void AsyncSerialDevice::set_pipeline_depth(int depth)
+{
+    pipelineDepth = std::max(depth, 1);
+    write_next();
+}
+
+void AsyncSerialDevice::write(const SerialCommand &command)
 {
     if (!serialPort->isOpen())
     {
         emit error(QString("Can't send command. %1 is not connected").arg(name));
         return;
     }
-    writeQueue.enqueue(data);
-    if (isWriteReady) write_next();
+
+    // last value wins, in the place of the command it replaces
+    if (!command.coalesceKey.isEmpty())
+    {
+        auto queued = std::find_if(writeQueue.begin(), writeQueue.end(), [&command](const SerialCommand &c) {
+            return c.coalesceKey == command.coalesceKey;
+        });
+        if (queued != writeQueue.end())
+        {
+            *queued = command;
+            return;
+        }
+    }
+
+    writeQueue.enqueue(command);
+    write_next();
 }
 
 void AsyncSerialDevice::write_next()
 {
-    if (!writeQueue.isEmpty())
+    if (!serialPort->isOpen()) return;
+
+    while (!writeQueue.isEmpty() && inFlight.size() < pipelineDepth)
     {
-        isWriteReady = false;
-        // dequeue, store, and write the next message
-        prevWrite = writeQueue.dequeue();
-        serialPort->write(prevWrite);
-        // start timeout timer
-        // (expect a response from the device before the timer ends)
-        timer->start(readTimeout_ms);
+        SentCommand sent {writeQueue.dequeue(), {}};
+        serialPort->write(sent.command.data);
+        sent.sent.start();
+        inFlight.enqueue(sent);
     }
+    restart_timer();
+}
 
-    else // writing complete
+void AsyncSerialDevice::restart_timer()
+{
+    if (inFlight.isEmpty())
     {
-        isWriteReady = true;
         timer->stop();
+        prevWrite.clear();
+        return;
+    }
+
+    // only the oldest command can time out, the replies come back in order
+    const SentCommand &oldest = inFlight.head();
+    prevWrite = oldest.command.data;
+    timer->start((int)std::max<qint64>(oldest.command.timeout_ms - oldest.sent.elapsed(), 0));
+}
+
+qsizetype AsyncSerialDevice::reply_size(const SerialCommand &command) const
+{
+    if (command.replySize) return command.replySize(readData);
+    if (command.replyLength > 0) return readData.size() >= command.replyLength ? command.replyLength : 0;
+    if (!command.terminator.isEmpty())
+    {
+        const qsizetype end = readData.indexOf(command.terminator);
+        return end < 0 ? 0 : end + command.terminator.size();
+    }
+    return readData.size();
+}
+
+void AsyncSerialDevice::handle_ready_read()
+{
+    readData.append(serialPort->readAll());
+
+    bool answered {false};
+    while (!inFlight.isEmpty())
+    {
+        const qsizetype size = reply_size(inFlight.head().command);
+        if (size <= 0) break;
+
+        const SentCommand oldest = inFlight.dequeue();
+        answered = true;
+        const QByteArray reply = readData.left(size);
+        readData.remove(0, size);
+
+        const double latency_ms = oldest.sent.nsecsElapsed() / 1e6;
+        commandLatency.count++;
+        commandLatency.last_ms = latency_ms;
+        commandLatency.mean_ms += (latency_ms - commandLatency.mean_ms) / commandLatency.count;
+        commandLatency.max_ms = std::max(commandLatency.max_ms, latency_ms);
+
+        // may write more commands, or disconnect and clear the queues
+        if (oldest.command.done) oldest.command.done(reply, latency_ms);
+        if (!serialPort->isOpen()) return;
     }
+
+    // nothing is waiting for it
+    if (inFlight.isEmpty()) readData.clear();
+
+    write_next();
+    if (answered && !has_pending_writes()) emit writes_complete();
+}
+
+QString AsyncSerialDevice::latency_summary() const
+{
+    return QString("%1: %2 replies, mean %3 ms, max %4 ms")
+            .arg(name)
+            .arg(commandLatency.count)
+            .arg(commandLatency.mean_ms, 0, 'f', 1)
+            .arg(commandLatency.max_ms, 0, 'f', 1);
 }
 
 void AsyncSerialDevice::clear_command_queue()
 {
     writeQueue.clear();
-    isWriteReady = true;
+    inFlight.clear();
+    readData.clear();
+    prevWrite.clear();
+    timer->stop();
+    pipelineDepth = 1;
+    commandLatency = {};
 }
 
 
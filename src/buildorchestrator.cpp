@@ -0,0 +1,319 @@
+#include "buildorchestrator.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <iomanip>
+#include <sstream>
+
+#include "dmc4080.h"
+#include "printhread.h"
+#include "mister.h"
+#include "layermap.h"
+
+namespace
+{
+// Raster_Print.dmc keeps thread 0 for the whole build, so the library
+// routines run next to it
+constexpr int LIBRARY_THREAD {1};
+
+// Mists and cures the layer without bringing the bed back up in between.
+std::string mist_and_cure_commands(const BuildSettings &settings, int layer)
+{
+    using namespace CMD;
+    std::stringstream s;
+
+    if (settings.mist)
+    {
+        s << phase_mark("mist", layer);
+        s << library::mist_layer(settings.mistSpeed_mm_s, settings.mistDwell_ms,
+                                 settings.cure, LIBRARY_THREAD);
+    }
+    if (settings.cure)
+    {
+        s << phase_mark("cure", layer);
+        s << library::cure_layer(settings.cureSpeed_mm_s, settings.mist, LIBRARY_THREAD);
+    }
+    return s.str();
+}
+
+std::string seconds(double value_s)
+{
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(1) << value_s << " s";
+    return s.str();
+}
+}
+
+std::string BuildReport::summary() const
+{
+    std::ostringstream s;
+    s << layersDone << " of " << numLayers << " layers done, "
+      << std::fixed << std::setprecision(1) << layers_per_hour() << " layers/hour";
+
+    if (!phase_s.empty() || waiting_s > 0)
+    {
+        s << " (";
+        bool first {true};
+        for (const auto &[phase, time_s] : phase_s)
+        {
+            if (!first) s << ", ";
+            s << phase << " " << seconds(time_s);
+            first = false;
+        }
+        if (waiting_s > 0) s << (first ? "" : ", ") << "waiting " << seconds(waiting_s);
+        s << ")";
+    }
+    return s.str();
+}
+
+BuildOrchestrator::BuildOrchestrator(Printer *printer, QObject *parent) :
+    QObject(parent),
+    printer_(printer),
+    printThread_(printer->mcu->printerThread)
+{
+    QFile file(":/src/dmc/Raster_Print.dmc");
+    if (file.open(QFile::ReadOnly | QFile::Text))
+    {
+        QTextStream in(&file);
+        rasterProgram_ = in.readAll();
+    }
+    else
+    {
+        qDebug() << " Could not open the raster print program for reading";
+    }
+
+    connect(printThread_, &PrintThread::phase_started, this, &BuildOrchestrator::phase_started);
+    connect(printThread_, &PrintThread::ended, this, &BuildOrchestrator::stream_ended);
+    connect(printThread_, &PrintThread::stopped, this, &BuildOrchestrator::stop);
+}
+
+BuildOrchestrator::~BuildOrchestrator()
+{
+    running_ = false;
+    if (preparing_.valid()) preparing_.wait();
+}
+
+bool BuildOrchestrator::open_layer_file(const std::string &fileName)
+{
+    if (running_)
+    {
+        error_ = "Can't open a layer file while a build is running";
+        return false;
+    }
+    if (preparing_.valid()) preparing_.wait();
+
+    if (!reader_.open(fileName))
+    {
+        error_ = "Could not read the layer file " + fileName;
+        return false;
+    }
+    return true;
+}
+
+bool BuildOrchestrator::start(const BuildSettings &settings)
+{
+    const int numLayers = reader_.number_of_layers();
+    if (running_)
+    {
+        error_ = "A build is already running";
+        return false;
+    }
+    if (numLayers == 0)
+    {
+        error_ = "There is no layer file open";
+        return false;
+    }
+    if (settings.firstLayer < 0 || settings.firstLayer >= numLayers)
+    {
+        error_ = "The first layer has to be between 1 and " + std::to_string(numLayers);
+        return false;
+    }
+
+    // the last build may still be making a layer with the old settings
+    if (preparing_.valid()) preparing_.wait();
+
+    settings_ = settings;
+    const LayerFileHeader &header = reader_.header();
+    settings_.recoat.layerHeight_microns = (int)header.layerHeight_um; // the slicer decided it
+    generator_.dropletSpacing_um = (int)header.dropletSpacing_um;
+    generator_.lineSpacing_um = (int)header.lineSpacing_um;
+    generator_.originX_mm = header.originX_mm;
+    generator_.originY_mm = header.originY_mm;
+    generator_.jettingFrequency_Hz = settings.jettingFrequency_Hz;
+    generator_.acceleration_mm_per_s2 = settings.acceleration_mm_per_s2;
+    generator_.travelSpeed_mm_per_s = settings.travelSpeed_mm_per_s;
+
+    if (printer_->mcu->g)
+    {
+        // stays on the controller for every layer of the build
+        QByteArray ba = rasterProgram_.toLocal8Bit();
+        if (!printer_->mcu->download_program(ba.data(), "--max 4"))
+        {
+            error_ = "Could not download the raster print program";
+            return false;
+        }
+    }
+
+    ++generation_;
+    running_ = true;
+    layersSent_ = settings.firstLayer;
+    report_ = BuildReport{};
+    report_.numLayers = numLayers - settings.firstLayer;
+    currentPhase_.clear();
+    timer_.start();
+    waitingForLayer_ = true;
+    waitingSince_s_ = 0;
+    error_.clear();
+
+    prepare_layer(settings.firstLayer);
+    emit progress(QString("Starting build at layer %1 of %2").arg(settings.firstLayer + 1).arg(numLayers));
+    return true;
+}
+
+void BuildOrchestrator::stop()
+{
+    if (running_) end_build(false);
+}
+
+std::string BuildOrchestrator::layer_commands(int layer)
+{
+    using namespace CMD;
+    std::stringstream s;
+    const int numLayers = reader_.number_of_layers();
+
+    const DropletLayer droplets = reader_.read_layer(layer);
+    const LayerMap map(droplets);
+    const std::vector<RasterPass> passes = generator_.plan_passes(map);
+
+    s << display_message("Layer " + std::to_string(layer + 1) + " of " + std::to_string(numLayers));
+    if (droplets.width() == 0)
+        s << display_message("Layer " + std::to_string(layer + 1) + " could not be read so it is not printed");
+
+    s << phase_mark("recoat", layer);
+    if (!passes.empty())
+    {
+        // the recoat only moves y and z, so x gets to the first pass meanwhile
+        s << set_accleration(Axis::X, generator_.acceleration_mm_per_s2)
+          << set_deceleration(Axis::X, generator_.acceleration_mm_per_s2)
+          << set_speed(Axis::X, generator_.travelSpeed_mm_per_s)
+          << position_absolute(Axis::X, generator_.pass_start_x_mm(passes.front()))
+          << begin_motion(Axis::X);
+    }
+    s << spread_layer(settings_.recoat);
+
+    if (!passes.empty())
+    {
+        s << motion_complete(Axis::X);
+        s << phase_mark("print", layer);
+        s << generator_.generate_commands_for_printing(map);
+    }
+
+    s << mist_and_cure_commands(settings_, layer);
+    return s.str();
+}
+
+void BuildOrchestrator::prepare_layer(int layer)
+{
+    const int generation = generation_;
+    const bool lastLayer = (layer == reader_.number_of_layers() - 1);
+
+    preparing_ = std::async(std::launch::async, [this, layer, generation, lastLayer]()
+    {
+        std::string commands = layer_commands(layer);
+        if (lastLayer)
+        {
+            commands += CMD::move_xy_axes_to_default_position();
+            commands += CMD::display_message("Build complete");
+            commands += CMD::phase_mark("done", layer);
+        }
+
+        // hand the layer back to the thread the orchestrator lives in
+        QMetaObject::invokeMethod(this, [this, layer, generation, commands]()
+        {
+            if (generation == generation_) layer_prepared(layer, commands);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void BuildOrchestrator::layer_prepared(int layer, const std::string &commands)
+{
+    if (!running_) return;
+
+    std::stringstream s(commands);
+    printThread_->append_command(s);
+    layersSent_ = layer + 1;
+
+    if (waitingForLayer_)
+    {
+        report_.waiting_s += timer_.elapsed() / 1000.0 - waitingSince_s_;
+        waitingForLayer_ = false;
+    }
+}
+
+void BuildOrchestrator::phase_started(const QString &phase, int layer)
+{
+    if (!running_) return;
+
+    const double now_s = timer_.elapsed() / 1000.0;
+    if (!currentPhase_.empty()) report_.phase_s[currentPhase_] += now_s - phaseStart_s_;
+    currentPhase_ = phase.toStdString();
+    phaseStart_s_ = now_s;
+    report_.elapsed_s = now_s;
+
+    if (phase == "done")
+    {
+        currentPhase_.clear();
+        report_.layersDone = report_.numLayers;
+        emit progress(QString::fromStdString(report_.summary()));
+        end_build(true);
+        return;
+    }
+
+    if (phase == "recoat")
+    {
+        report_.layersDone = layer - settings_.firstLayer;
+        // the next layer is made while this one runs
+        if (layer + 1 < reader_.number_of_layers()) prepare_layer(layer + 1);
+    }
+
+    emit progress(QString("Layer %1: %2. %3").arg(layer + 1).arg(phase)
+                  .arg(QString::fromStdString(report_.summary())));
+}
+
+void BuildOrchestrator::stream_ended()
+{
+    // the end of the last layer is handled by its "done" mark
+    if (!running_ || layersSent_ >= reader_.number_of_layers()) return;
+
+    // the next layer isn't ready yet, the time until it is isn't part of a phase
+    const double now_s = timer_.elapsed() / 1000.0;
+    if (!currentPhase_.empty()) report_.phase_s[currentPhase_] += now_s - phaseStart_s_;
+    currentPhase_.clear();
+    waitingForLayer_ = true;
+    waitingSince_s_ = now_s;
+    emit progress(QString("Waiting for layer %1 to be ready").arg(layersSent_ + 1));
+}
+
+void BuildOrchestrator::end_build(bool completed)
+{
+    running_ = false;
+    ++generation_;
+
+    if (!completed)
+    {
+        // a stopped build can leave the mister or lamp on
+        printer_->mister->turn_off_misters();
+        if (printer_->mcu->g)
+        {
+            const std::string haltRoutine = "HX" + std::to_string(LIBRARY_THREAD);
+            const std::string lampOff = "CB " + std::to_string(HEAT_LAMP_BIT);
+            GCmd(printer_->mcu->g, haltRoutine.c_str());
+            GCmd(printer_->mcu->g, lampOff.c_str());
+        }
+        emit progress(QString("Build stopped. %1").arg(QString::fromStdString(report_.summary())));
+    }
+    emit finished(completed);
+}
+
+#include "moc_buildorchestrator.cpp"
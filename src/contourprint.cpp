@@ -0,0 +1,350 @@
+#include "contourprint.h"
+
+#include <cmath>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QXmlStreamReader>
+
+std::vector<Polyline> load_polylines_from_text(std::istream &input)
+{
+    std::vector<Polyline> polylines;
+    Polyline current;
+
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if (!line.empty() && line[0] == '#') continue;
+
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::stringstream ss(line);
+        ContourPoint point;
+        if (ss >> point.x_mm >> point.y_mm)
+        {
+            current.push_back(point);
+        }
+        else if (!current.empty()) // blank line ends the polyline
+        {
+            polylines.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.empty()) polylines.push_back(current);
+
+    return polylines;
+}
+
+namespace
+{
+std::vector<double> parse_numbers(const QString &text)
+{
+    std::vector<double> numbers;
+    QString cleaned = text;
+    cleaned.replace(',', ' ');
+    const auto tokens = cleaned.split(' ', Qt::SkipEmptyParts);
+    for (const auto &token : tokens)
+    {
+        bool ok;
+        double value = token.toDouble(&ok);
+        if (ok) numbers.push_back(value);
+    }
+    return numbers;
+}
+
+// Only straight segments are supported (M, L, H, V, Z). Curves end the
+// current polyline since they can't be printed with LI segments as is.
+std::vector<Polyline> parse_svg_path(const QString &d)
+{
+    std::vector<Polyline> polylines;
+    Polyline current;
+    ContourPoint position;
+    ContourPoint subpathStart;
+
+    // split into command letters and numbers
+    QString spaced;
+    for (const auto c : d)
+    {
+        if (c.isLetter() && c != 'e' && c != 'E') spaced += QString(" %1 ").arg(c);
+        else if (c == '-' && !spaced.isEmpty() && !spaced.endsWith('e') && !spaced.endsWith('E'))
+            spaced += " -";
+        else spaced += c;
+    }
+    spaced.replace(',', ' ');
+    const auto tokens = spaced.split(' ', Qt::SkipEmptyParts);
+
+    auto finish_polyline = [&]()
+    {
+        if (current.size() > 1) polylines.push_back(current);
+        current.clear();
+    };
+
+    QChar command;
+    int i {0};
+    auto next_number = [&](double &value) -> bool
+    {
+        if (i >= tokens.size()) return false;
+        bool ok;
+        value = tokens[i].toDouble(&ok);
+        if (ok) ++i;
+        return ok;
+    };
+
+    while (i < tokens.size())
+    {
+        if (tokens[i].size() == 1 && tokens[i][0].isLetter())
+        {
+            command = tokens[i][0];
+            ++i;
+        }
+        const bool relative = command.isLower();
+        double a, b;
+
+        switch (command.toUpper().toLatin1())
+        {
+        case 'M':
+            if (!next_number(a) || !next_number(b)) { ++i; break; }
+            finish_polyline();
+            position = relative ? ContourPoint{position.x_mm + a, position.y_mm + b} : ContourPoint{a, b};
+            subpathStart = position;
+            current.push_back(position);
+            // extra coordinate pairs after a move are line segments
+            command = relative ? 'l' : 'L';
+            break;
+        case 'L':
+            if (!next_number(a) || !next_number(b)) { ++i; break; }
+            position = relative ? ContourPoint{position.x_mm + a, position.y_mm + b} : ContourPoint{a, b};
+            current.push_back(position);
+            break;
+        case 'H':
+            if (!next_number(a)) { ++i; break; }
+            position.x_mm = relative ? position.x_mm + a : a;
+            current.push_back(position);
+            break;
+        case 'V':
+            if (!next_number(a)) { ++i; break; }
+            position.y_mm = relative ? position.y_mm + a : a;
+            current.push_back(position);
+            break;
+        case 'Z':
+            if (!current.empty()) current.push_back(subpathStart);
+            position = subpathStart;
+            finish_polyline();
+            break;
+        default: // unsupported command, skip its arguments
+            finish_polyline();
+            while (i < tokens.size() && !(tokens[i].size() == 1 && tokens[i][0].isLetter())) ++i;
+            break;
+        }
+    }
+    finish_polyline();
+
+    return polylines;
+}
+}
+
+std::vector<Polyline> load_polylines_from_svg(const QString &fileName)
+{
+    std::vector<Polyline> polylines;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return polylines;
+
+    QXmlStreamReader xml(&file);
+    while (!xml.atEnd())
+    {
+        if (xml.readNext() != QXmlStreamReader::StartElement) continue;
+
+        const auto name = xml.name();
+        const auto attributes = xml.attributes();
+        if (name == QLatin1String("line"))
+        {
+            polylines.push_back({{attributes.value("x1").toDouble(), attributes.value("y1").toDouble()},
+                                 {attributes.value("x2").toDouble(), attributes.value("y2").toDouble()}});
+        }
+        else if (name == QLatin1String("polyline") || name == QLatin1String("polygon"))
+        {
+            const auto numbers = parse_numbers(attributes.value("points").toString());
+            Polyline polyline;
+            for (size_t n{0}; n + 1 < numbers.size(); n += 2)
+                polyline.push_back({numbers[n], numbers[n+1]});
+            if (name == QLatin1String("polygon") && !polyline.empty())
+                polyline.push_back(polyline.front()); // close the shape
+            if (polyline.size() > 1) polylines.push_back(polyline);
+        }
+        else if (name == QLatin1String("path"))
+        {
+            const auto paths = parse_svg_path(attributes.value("d").toString());
+            polylines.insert(polylines.end(), paths.begin(), paths.end());
+        }
+    }
+
+    // SVG has y pointing down, the printer has y pointing up
+    for (auto &polyline : polylines)
+        for (auto &point : polyline)
+            point.y_mm = -point.y_mm;
+
+    return polylines;
+}
+
+std::vector<Polyline> load_polylines(const QString &fileName)
+{
+    if (QFileInfo(fileName).suffix().compare("svg", Qt::CaseInsensitive) == 0)
+        return load_polylines_from_svg(fileName);
+
+    std::ifstream file(fileName.toStdString());
+    return load_polylines_from_text(file);
+}
+
+namespace
+{
+struct ContourSegment
+{
+    ContourPoint end;     // absolute end position (mm)
+    double length_mm {};
+    double ux {};         // unit direction
+    double uy {};
+    double speed_mm_s {};
+    double endSpeed_mm_s {};
+    bool jetting {false};
+};
+
+// maximum speed through a corner so the path stays within the deviation
+double corner_speed(const ContourSegment &in, const ContourSegment &out,
+                    double acceleration_mm_s2, double deviation_mm)
+{
+    const double cosTheta = -(in.ux * out.ux + in.uy * out.uy);
+    if (cosTheta > 0.999999) return 0; // reversal
+    const double sinHalfTheta = std::sqrt(0.5 * (1.0 - cosTheta));
+    if (sinHalfTheta > 0.999999) return std::numeric_limits<double>::max(); // straight
+    return std::sqrt(acceleration_mm_s2 * deviation_mm * sinHalfTheta / (1.0 - sinHalfTheta));
+}
+}
+
+std::string ContourPrintCommandGenerator::generate_commands_for_printing(const std::vector<Polyline> &polylines) const
+{
+    std::stringstream s;
+    using CMD::detail::GCmd;
+
+    // flatten into travel and print segments
+    std::vector<ContourSegment> segments;
+    ContourPoint start {};
+    ContourPoint position {};
+    bool havePosition {false};
+    for (const auto &polyline : polylines)
+    {
+        if (polyline.size() < 2) continue;
+        for (size_t i{0}; i < polyline.size(); ++i)
+        {
+            const ContourPoint target {originX_mm + polyline[i].x_mm, originY_mm + polyline[i].y_mm};
+            if (!havePosition)
+            {
+                start = position = target;
+                havePosition = true;
+                continue;
+            }
+
+            ContourSegment segment;
+            segment.end = target;
+            const double dx = target.x_mm - position.x_mm;
+            const double dy = target.y_mm - position.y_mm;
+            segment.length_mm = std::hypot(dx, dy);
+            if (segment.length_mm < 1e-6) continue;
+            segment.ux = dx / segment.length_mm;
+            segment.uy = dy / segment.length_mm;
+            segment.jetting = (i != 0); // the move to the start of a polyline is travel
+            segment.speed_mm_s = segment.jetting ? print_speed_mm_per_s() : travelSpeed_mm_per_s;
+            segments.push_back(segment);
+            position = target;
+        }
+    }
+
+    if (segments.empty())
+    {
+        s << CMD::display_message("Nothing to print");
+        return s.str();
+    }
+
+    // end of segment speeds: limited by the corners and by being able to
+    // slow down in time for the following corners
+    segments.back().endSpeed_mm_s = 0;
+    for (int i = (int)segments.size() - 2; i >= 0; --i)
+    {
+        const auto &next = segments[i+1];
+        double endSpeed = std::min(segments[i].speed_mm_s, next.speed_mm_s);
+        endSpeed = std::min(endSpeed, corner_speed(segments[i], next, acceleration_mm_per_s2, cornerDeviation_mm));
+        endSpeed = std::min(endSpeed, std::sqrt(std::pow(next.endSpeed_mm_s, 2) + 2.0 * acceleration_mm_per_s2 * next.length_mm));
+        segments[i].endSpeed_mm_s = endSpeed;
+    }
+
+    // convert to LI segments. Positions are rounded on the cumulative position
+    // so rounding errors don't build up over the path
+    std::vector<std::string> linearSegments;
+    double minCntsPerMM {std::numeric_limits<double>::max()};
+    double droplets {0};
+    long long prevX = std::llround(start.x_mm * X_CNTS_PER_MM);
+    long long prevY = std::llround(start.y_mm * Y_CNTS_PER_MM);
+    long long prevH {0};
+    for (const auto &segment : segments)
+    {
+        const long long x = std::llround(segment.end.x_mm * X_CNTS_PER_MM);
+        const long long y = std::llround(segment.end.y_mm * Y_CNTS_PER_MM);
+        if (segment.jetting) droplets += segment.length_mm * 1000.0 / dropletSpacing_um;
+        const long long h = std::llround(droplets); // one jetting axis count per droplet
+
+        const long long dx = x - prevX, dy = y - prevY, dh = h - prevH;
+        prevX = x; prevY = y; prevH = h;
+        if (dx == 0 && dy == 0 && dh == 0) continue;
+
+        // vector speed is in counts of all the LM axes, so scale it so the
+        // speed along the path in mm/s is right for this segment
+        const double cntsPerMM = std::sqrt(double(dx*dx + dy*dy + dh*dh)) / segment.length_mm;
+        minCntsPerMM = std::min(minCntsPerMM, cntsPerMM);
+
+        std::stringstream li;
+        li << CMD::detail::LinearSegment() << "LI " << dx << "," << dy << "," << dh
+           << " <" << std::lround(segment.speed_mm_s * cntsPerMM)
+           << " >" << std::lround(segment.endSpeed_mm_s * cntsPerMM) << "\n";
+        linearSegments.push_back(li.str());
+    }
+
+    s << CMD::display_message("Printing " + std::to_string(polylines.size()) + " contours");
+
+    // setup jetting axis
+    s << CMD::stop_motion(Axis::Jet);
+    s << CMD::servo_here(Axis::Jet);
+
+    // move to the start of the path
+    s << CMD::set_speed(Axis::X, travelSpeed_mm_per_s);
+    s << CMD::set_speed(Axis::Y, travelSpeed_mm_per_s);
+    s << CMD::position_absolute(Axis::X, start.x_mm);
+    s << CMD::position_absolute(Axis::Y, start.y_mm);
+    s << CMD::begin_motion(Axis::X);
+    s << CMD::begin_motion(Axis::Y);
+    s << CMD::motion_complete(Axis::X);
+    s << CMD::motion_complete(Axis::Y);
+
+    // linear interpolation with the jetting axis geared in through the vector
+    const int vectorAcceleration = std::lround(acceleration_mm_per_s2 * minCntsPerMM);
+    s << GCmd("LM XYH");
+    s << GCmd("VA " + std::to_string(vectorAcceleration));
+    s << GCmd("VD " + std::to_string(vectorAcceleration));
+
+    // load some segments before starting so the buffer doesn't run empty
+    // at the start, then keep it topped up while moving
+    const size_t prefill = std::min(linearSegments.size(), (size_t)std::max(prefillSegments, 1));
+    for (size_t i{0}; i < linearSegments.size(); ++i)
+    {
+        s << linearSegments[i];
+        if (i + 1 == prefill) s << GCmd("BGS");
+    }
+    s << GCmd("LE");
+    s << CMD::motion_complete_vector();
+
+    s << CMD::display_message("Contours printed");
+
+    return s.str();
+}
@@ -11,15 +11,48 @@
 #include "printer.h"
 
 #include <QDebug>
+#include <QFile>
+#include <QTextStream>
 
 DMC4080::DMC4080(std::string_view address_, QObject *parent) :
     QObject(parent),
     address ( address_.data() ),
     printerThread ( new PrintThread(this) ),
     //interruptHandler ( new GInterruptHandler(this) ),
-    messagePoller ( new GMessagePoller(this) )
+    messagePoller ( new GMessagePoller(this) ),
+    jogChannel ( new JogChannel(this) )
 {
     printerThread->setup(this);
+    connect(printerThread, &PrintThread::connected_to_controller, this, &DMC4080::finish_connecting);
+
+    QFile file(":/src/dmc/Library.dmc");
+    if (file.open(QFile::ReadOnly | QFile::Text))
+    {
+        // the library is also put after programs that are downloaded without
+        // the preprocessor, so take out what only the preprocessor understands
+        QTextStream in(&file);
+        while (!in.atEnd())
+        {
+            QString line = in.readLine();
+            bool inString {false};
+            for (int i{0}; i < line.size() - 1; ++i)
+            {
+                if (line[i] == '"') inString = !inString;
+                else if (!inString && line[i] == '/' && line[i + 1] == '/')
+                {
+                    line.truncate(i);
+                    break;
+                }
+            }
+            line = line.trimmed();
+            if (line.isEmpty() || line.startsWith("REM")) continue;
+            libraryRoutines += line.toStdString() + "\n";
+        }
+    }
+    else
+    {
+        qDebug() << " Could not open the DMC subroutine library for reading";
+    }
 }
 
 DMC4080::~DMC4080()
@@ -27,18 +60,92 @@ DMC4080::~DMC4080()
     disconnect_controller();
 }
 
-void DMC4080::connect_to_motion_controller(bool homeZAxis)
+void DMC4080::connect_to_motion_controller(bool homeZAxis, bool homeIfHomed)
 {
     std::stringstream s;
 
+    // the rest depends on the state of the controller, see finish_connecting()
     s << CMD::open_connection_to_controller();
-    s << CMD::set_default_controller_settings();
-    s << CMD::homing_sequence(homeZAxis);
+    isConnecting = true;
+    homeZAxisOnConnect = homeZAxis;
+    homeIfHomedOnConnect = homeIfHomed;
 
     printerThread->execute_command(s);
 
     // subscribe to messages
     messagePoller->connect_to_controller(address);
+    jogChannel->connect_to_controller(address);
+}
+
+void DMC4080::finish_connecting()
+{
+    if (!isConnecting || !g) return;
+    isConnecting = false;
+
+    using CMD::detail::GCmd;
+    std::stringstream s;
+
+    // cfgHash is a fingerprint of the settings the controller was set up
+    // with. It is gone after a reset, so then they are always sent again
+    const std::string settings = CMD::set_default_controller_settings();
+    const int fingerprint = CMD::configuration_fingerprint(settings);
+    const bool isConfigured = (read_variable("cfgHash") == fingerprint);
+    if (isConfigured)
+    {
+        s << CMD::display_message("Controller settings are unchanged, not sending them again");
+        // disconnecting turns the motors off
+        s << GCmd("SH XYZ") << GCmd("SH H");
+    }
+    else
+    {
+        s << settings;
+        s << GCmd("cfgHash=" + std::to_string(fingerprint));
+    }
+
+    s << CMD::download_library();
+
+    const bool isHomed = isConfigured && (read_variable("lHomed") == 1);
+    if (isHomed && !homeIfHomedOnConnect)
+        s << CMD::display_message("Axes are still homed, not homing again");
+    else
+        s << CMD::library::home_axes(homeZAxisOnConnect);
+
+    printerThread->execute_command(s);
+}
+
+int DMC4080::read_variable(const char *name)
+{
+    const std::string command = std::string("MG ") + name;
+    int value{};
+    if (!g || GCmdI(g, command.c_str(), &value) != G_NO_ERROR) return -1;
+    return value;
+}
+
+std::string DMC4080::library() const
+{
+    return libraryRoutines + homing.generate_program();
+}
+
+bool DMC4080::download_library()
+{
+    if (!g || libraryRoutines.empty()) return false;
+    return GProgramDownload(g, library().c_str(), "") == G_NO_ERROR;
+}
+
+bool DMC4080::download_program(const char *program, const char *preprocessorOptions)
+{
+    if (!g) return false;
+
+    std::string withLibrary {program};
+    withLibrary += "\n";
+    withLibrary += library();
+    if (GProgramDownload(g, withLibrary.c_str(), preprocessorOptions) != G_NO_ERROR)
+    {
+        // at least leave the library there
+        download_library();
+        return false;
+    }
+    return true;
 }
 
 void DMC4080::disconnect_controller()
@@ -46,6 +153,8 @@ void DMC4080::disconnect_controller()
     qDebug() << "disconnecting";
     //interruptHandler->stop();
     messagePoller->stop();
+    jogChannel->stop();
+    jogChannel->wait();
     // this needs to go first
     printerThread->stop();
 
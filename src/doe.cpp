@@ -0,0 +1,329 @@
+#include "doe.h"
+
+#include <cmath>
+#include <random>
+#include <numeric>
+#include <sstream>
+#include <algorithm>
+
+#include "printer.h"
+#include "settlemodel.h"
+
+namespace DOE
+{
+
+namespace
+{
+const int VELOCITY_COLUMN {LinePrintData().get_column_index_for(LineSet().printVelocity)};
+
+std::string column_name(int column)
+{
+    LineSet set;
+    std::string name = set[column].typeName;
+    std::replace(name.begin(), name.end(), '\n', ' ');
+    return name;
+}
+
+std::string number(double value)
+{
+    std::ostringstream s;
+    s << value;
+    return s.str();
+}
+
+// snaps a value onto the steps of a factor and rounds integer columns
+float snapped(const Factor &factor, float value, type dataType)
+{
+    if (factor.step > 0) value = factor.low + std::round((value - factor.low) / factor.step) * factor.step;
+    value = std::clamp(value, factor.low, factor.high);
+    if (dataType == type::int_type) value = std::round(value);
+    return value;
+}
+
+// footprint of a set on the bed, including the acceleration overrun
+struct Footprint
+{
+    int set {};
+    double overrun_mm {};
+    double width_mm {};
+    double height_mm {};
+};
+
+Footprint footprint_of(int index, LineSet &set)
+{
+    Footprint f;
+    f.set = index;
+    f.overrun_mm = Settle::run_up_distance_mm(Axis::X, set.printVelocity.value, set.printAcceleration.value);
+    f.width_mm = set.lineLength.value + 2.0 * f.overrun_mm;
+    f.height_mm = std::max(0.0f, set.numLines.value - 1) * set.lineSpacing.value;
+    return f;
+}
+
+// first fit decreasing height into shelves no wider than shelfWidth_mm
+Packing shelf_pack(const std::vector<LineSet> &sets, const std::vector<Footprint> &byHeight,
+                   const Area &area, double shelfWidth_mm, double gap_mm)
+{
+    struct Shelf
+    {
+        double y_mm {};
+        double height_mm {};
+        double used_mm {};
+        std::vector<std::pair<int, double>> sets; // set and x of its footprint
+    };
+    std::vector<Shelf> shelves;
+
+    Packing packing;
+    for (const auto &f : byHeight)
+    {
+        if (f.width_mm > shelfWidth_mm || f.height_mm > area.height_mm)
+        {
+            packing.unplaced.push_back(sets[f.set]);
+            continue;
+        }
+
+        auto shelf = std::find_if(shelves.begin(), shelves.end(), [&](const Shelf &s)
+        { return s.used_mm + gap_mm + f.width_mm <= shelfWidth_mm && f.height_mm <= s.height_mm; });
+
+        if (shelf == shelves.end())
+        {
+            // sets are sorted by height, so the first set on a shelf is the tallest
+            const double y = shelves.empty() ? 0 : shelves.back().y_mm + shelves.back().height_mm + gap_mm;
+            if (y + f.height_mm > area.height_mm)
+            {
+                packing.unplaced.push_back(sets[f.set]);
+                continue;
+            }
+            shelves.push_back({y, f.height_mm, -gap_mm, {}});
+            shelf = shelves.end() - 1;
+        }
+
+        shelf->used_mm += gap_mm;
+        shelf->sets.push_back({f.set, shelf->used_mm});
+        shelf->used_mm += f.width_mm;
+        packing.usedWidth_mm = std::max(packing.usedWidth_mm, shelf->used_mm);
+        packing.usedHeight_mm = std::max(packing.usedHeight_mm, shelf->y_mm + shelf->height_mm);
+    }
+
+    // print from the bottom shelf up, left to right along each shelf
+    for (const auto &shelf : shelves)
+    {
+        for (const auto &[index, x] : shelf.sets)
+        {
+            LineSet set = sets[index];
+            const double overrun_mm = footprint_of(index, set).overrun_mm;
+            set.originX = (float)(area.x_mm + x + overrun_mm);
+            set.originY = (float)(area.y_mm + shelf.y_mm);
+            packing.placed.push_back(set);
+        }
+    }
+    packing.printTime_s = estimated_print_time_s(packing.placed);
+    return packing;
+}
+}
+
+std::vector<float> Factor::levels() const
+{
+    std::vector<float> values;
+    if (step <= 0 || high <= low) return {low};
+    const int count = (int)std::floor((high - low) / step + 1e-4) + 1;
+    values.reserve(count);
+    for (int i{0}; i < count; ++i) values.push_back(low + i * step);
+    return values;
+}
+
+std::vector<std::string> validate(const Design &design)
+{
+    std::vector<std::string> errors;
+    LineSet base = design.base;
+
+    for (int c{0}; c < base.size; ++c)
+    {
+        if (std::isnan(base[c].value)) errors.push_back(column_name(c) + " has no value");
+    }
+
+    std::vector<bool> used(base.size, false);
+    size_t runs {1};
+    for (const auto &factor : design.factors)
+    {
+        if (factor.column < 0 || factor.column >= base.size)
+        {
+            errors.push_back("Factor column " + std::to_string(factor.column) + " does not exist");
+            continue;
+        }
+        const std::string name = column_name(factor.column);
+        const TableData &column = base[factor.column];
+
+        if (factor.column == VELOCITY_COLUMN)
+            errors.push_back(name + " is set by the droplet spacing and jetting frequency");
+        if (used[factor.column]) errors.push_back(name + " is varied more than once");
+        used[factor.column] = true;
+
+        if (factor.low > factor.high) errors.push_back(name + " low is greater than high");
+        if (factor.low < column.min) errors.push_back(name + " low is below the minimum of " + number(column.min));
+        if (factor.high > column.max) errors.push_back(name + " high is above the maximum of " + number(column.max));
+        if (factor.high > factor.low && factor.step <= 0) errors.push_back(name + " needs a step greater than 0");
+        if (column.dataType == type::int_type && factor.step != std::round(factor.step))
+            errors.push_back(name + " is a whole number so the step has to be too");
+
+        runs *= factor.levels().size();
+    }
+
+    if (design.method == Method::FullFactorial && runs > (size_t)MAX_RUNS)
+        errors.push_back("The design has " + std::to_string(runs) + " sets, the most is " + std::to_string(MAX_RUNS));
+    if (design.method == Method::LatinHypercube && (design.runs < 1 || design.runs > MAX_RUNS))
+        errors.push_back("The number of runs has to be between 1 and " + std::to_string(MAX_RUNS));
+
+    return errors;
+}
+
+std::vector<LineSet> generate(const Design &design, int *skipped)
+{
+    std::vector<LineSet> sets;
+    if (!validate(design).empty()) return sets;
+
+    if (design.method == Method::FullFactorial)
+    {
+        std::vector<std::vector<float>> levels;
+        size_t runs {1};
+        for (const auto &factor : design.factors)
+        {
+            levels.push_back(factor.levels());
+            runs *= levels.back().size();
+        }
+
+        sets.reserve(runs);
+        for (size_t run{0}; run < runs; ++run)
+        {
+            // the last factor changes fastest
+            LineSet set = design.base;
+            size_t remainder = run;
+            for (size_t f = design.factors.size(); f-- > 0;)
+            {
+                set[design.factors[f].column].value = levels[f][remainder % levels[f].size()];
+                remainder /= levels[f].size();
+            }
+            sets.push_back(set);
+        }
+    }
+    else
+    {
+        // each factor's range is cut into `runs` strata and every stratum is
+        // used once, in a random order for each factor
+        std::mt19937 rng(design.seed);
+        std::uniform_real_distribution<float> within(0.0f, 1.0f);
+        sets.assign(design.runs, design.base);
+        for (const auto &factor : design.factors)
+        {
+            std::vector<int> strata(design.runs);
+            std::iota(strata.begin(), strata.end(), 0);
+            std::shuffle(strata.begin(), strata.end(), rng);
+
+            const type dataType = LineSet()[factor.column].dataType;
+            for (int run{0}; run < design.runs; ++run)
+            {
+                const float fraction = (strata[run] + within(rng)) / design.runs;
+                const float value = factor.low + fraction * (factor.high - factor.low);
+                sets[run][factor.column].value = snapped(factor, value, dataType);
+            }
+        }
+    }
+
+    // print velocity follows the droplet spacing and jetting frequency
+    int outOfRange {0};
+    std::vector<LineSet> valid;
+    valid.reserve(sets.size());
+    for (auto &set : sets)
+    {
+        const float velocity = (set.dropletSpacing.value * set.jettingFreq.value) / 1000.0f;
+        if (set.printVelocity.checkinRange(velocity) != errorType::errorNone)
+        {
+            ++outOfRange;
+            continue;
+        }
+        set.printVelocity.value = velocity;
+        valid.push_back(set);
+    }
+
+    if (skipped) *skipped = outOfRange;
+    return valid;
+}
+
+Packing pack(const std::vector<LineSet> &sets, const Area &area, double gap_mm)
+{
+    std::vector<Footprint> byHeight;
+    byHeight.reserve(sets.size());
+    double widest_mm {0};
+    for (size_t i{0}; i < sets.size(); ++i)
+    {
+        LineSet set = sets[i];
+        byHeight.push_back(footprint_of((int)i, set));
+        widest_mm = std::max(widest_mm, byHeight.back().width_mm);
+    }
+    std::stable_sort(byHeight.begin(), byHeight.end(), [](const Footprint &a, const Footprint &b)
+    {
+        if (a.height_mm != b.height_mm) return a.height_mm > b.height_mm;
+        return a.width_mm > b.width_mm;
+    });
+
+    // narrower shelves stack more sets up the bed, which can make the
+    // bounding box smaller than filling the full width first
+    constexpr int shelfWidthSteps {20};
+    const double narrowest_mm = std::min(widest_mm, area.width_mm);
+
+    Packing best;
+    bool haveBest {false};
+    for (int i{0}; i <= shelfWidthSteps; ++i)
+    {
+        const double shelfWidth_mm = area.width_mm - (area.width_mm - narrowest_mm) * i / shelfWidthSteps;
+        Packing packing = shelf_pack(sets, byHeight, area, shelfWidth_mm, gap_mm);
+
+        const double area_mm2 = packing.usedWidth_mm * packing.usedHeight_mm;
+        const double bestArea_mm2 = best.usedWidth_mm * best.usedHeight_mm;
+        bool better {!haveBest};
+        if (haveBest && packing.placed.size() != best.placed.size())
+            better = packing.placed.size() > best.placed.size();
+        else if (haveBest && std::abs(area_mm2 - bestArea_mm2) > 0.02 * bestArea_mm2)
+            better = area_mm2 < bestArea_mm2;
+        else if (haveBest)
+            better = packing.printTime_s < best.printTime_s;
+
+        if (better)
+        {
+            best = std::move(packing);
+            haveBest = true;
+        }
+    }
+    return best;
+}
+
+double estimated_print_time_s(const std::vector<LineSet> &sets, double xTravelSpeed_mm_s, double yTravelSpeed_mm_s)
+{
+    auto travel_s = [&](double dx, double dy)
+    { return std::max(std::abs(dx) / xTravelSpeed_mm_s, std::abs(dy) / yTravelSpeed_mm_s); };
+
+    double time_s {0};
+    double x {0};
+    double y {0};
+    for (LineSet set : sets)
+    {
+        const double v = set.printVelocity.value;
+        const double a = set.printAcceleration.value;
+        const double overrun = Settle::run_up_distance_mm(Axis::X, v, a);
+        const double length = set.lineLength.value;
+        const int numLines = (int)set.numLines.value;
+
+        // to the start of the first line
+        time_s += travel_s(set.originX - overrun - x, set.originY - y);
+
+        // each line ramps up, prints and ramps down, then the x-axis goes
+        // back to the start of the next line
+        time_s += numLines * (length / v + 2.0 * v / a);
+        time_s += (numLines - 1) * travel_s(length + 2.0 * overrun, set.lineSpacing.value);
+
+        x = set.originX + length + overrun;
+        y = set.originY + (numLines - 1) * set.lineSpacing.value;
+    }
+    return time_s;
+}
+
+}
@@ -0,0 +1,285 @@
+#include "firingengine.h"
+
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+namespace Firing
+{
+
+namespace
+{
+double direction(const Window &window)
+{
+    return (window.end_mm < window.start_mm) ? -1.0 : 1.0;
+}
+
+// droplet spacing in print axis encoder counts
+double spacing_counts(const Window &window)
+{
+    return window.dropletSpacing_um / 1000.0 * CMD::detail::counts_per_mm(window.printAxis);
+}
+
+// output compare can only step in whole counts (up to 65535)
+int output_compare_increment(const Window &window)
+{
+    return std::clamp((int)std::lround(spacing_counts(window)), 1, 65535);
+}
+
+std::string position_counts(const Window &window, double position_mm)
+{
+    return std::to_string(std::lround(position_mm * CMD::detail::counts_per_mm(window.printAxis)));
+}
+}
+
+double Engine::actual_spacing_um(const Window &window) const
+{
+    if (mode == Mode::OutputCompare)
+        return output_compare_increment(window) * 1000.0 / CMD::detail::counts_per_mm(window.printAxis);
+    return window.dropletSpacing_um;
+}
+
+int Engine::number_of_droplets(const Window &window) const
+{
+    const double length_um = std::abs(window.end_mm - window.start_mm) * 1000.0;
+    return (int)std::floor(length_um / actual_spacing_um(window) + 1e-9) + 1;
+}
+
+std::vector<double> Engine::commanded_positions_mm(const Window &window) const
+{
+    std::vector<double> positions;
+    const int numDroplets = number_of_droplets(window);
+    const double step_mm = direction(window) * actual_spacing_um(window) / 1000.0;
+    positions.reserve(numDroplets);
+    for (int i{0}; i < numDroplets; ++i)
+        positions.push_back(window.start_mm + i * step_mm);
+    return positions;
+}
+
+std::string Engine::arm(const Window &window) const
+{
+    std::stringstream s;
+    using CMD::detail::GCmd;
+    const std::string axis = CMD::detail::axis_string(window.printAxis);
+
+    if (mode == Mode::EncoderGearing)
+    {
+        // gear to the encoder but don't move until the window starts
+        s << CMD::stop_motion(Axis::Jet);
+        s << CMD::servo_here(Axis::Jet);
+        s << CMD::set_accleration(Axis::Jet, 20000000); // set super high acceleration for jetting axis
+        s << CMD::enable_gearing_for(Axis::Jet, window.printAxis);
+        s << CMD::disable_gearing_for(Axis::Jet);
+    }
+    else
+    {
+        // pulses at start, start +- increment, ... as the encoder crosses them
+        const int increment = (int)direction(window) * output_compare_increment(window);
+        s << GCmd("OC" + axis + "=" + position_counts(window, window.start_mm) + "," + std::to_string(increment));
+    }
+
+    return s.str();
+}
+
+std::string Engine::arm_at_start(const Window &window) const
+{
+    // output compare starts by itself once the encoder crosses the start
+    if (mode != Mode::EncoderGearing) return {};
+
+    // Gearing starts counting from wherever it is turned on, so turn it on
+    // one droplet before the window. Position trippoints are checked every
+    // sample so the first droplet can be up to one sample of travel late
+    std::stringstream s;
+    const double step_mm = direction(window) * actual_spacing_um(window) / 1000.0;
+    s << CMD::after_absolute_position(window.printAxis, window.start_mm - step_mm);
+    s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(window.printAxis, window.dropletSpacing_um);
+    return s.str();
+}
+
+std::string Engine::disarm_at_end(const Window &window) const
+{
+    std::stringstream s;
+    const double step_mm = direction(window) * actual_spacing_um(window) / 1000.0;
+
+    // stop halfway to where the next droplet would be so a late trippoint
+    // doesn't add an extra droplet
+    s << CMD::after_absolute_position(window.printAxis, commanded_positions_mm(window).back() + 0.5 * step_mm);
+    s << disarm(window);
+    return s.str();
+}
+
+std::string Engine::firing_thread(const Window &window, const std::string &label) const
+{
+    std::stringstream s;
+    s << arm_at_start(window);
+    s << disarm_at_end(window);
+    return "#" + label + "\n" + CMD::cmd_buf_to_dmc(s) + "EN\n";
+}
+
+std::string Engine::disarm(const Window &window) const
+{
+    if (mode == Mode::EncoderGearing)
+        return CMD::disable_gearing_for(Axis::Jet);
+
+    return CMD::detail::GCmd("OC" + CMD::detail::axis_string(window.printAxis) + "=0,0");
+}
+
+std::string Engine::start_recording(const Window &window, double duration_s) const
+{
+    std::stringstream s;
+    using CMD::detail::GCmd;
+
+    // smallest power of 2 sample period that fits the whole move in the
+    // arrays, from 1 since RC 0 stops recording
+    const double samples = duration_s * 2048.0;
+    int period {1};
+    while ((samples / std::pow(2, period)) > MAX_RECORD_LENGTH && period < 8) period++;
+
+    const std::string size = std::to_string(MAX_RECORD_LENGTH);
+    const std::string posArray = PRINT_POSITION_ARRAY;
+    const std::string jetArray = JET_POSITION_ARRAY;
+    // every line records again, so free the arrays of the last line first.
+    // Only these two, the rest of the program's arrays are still in use
+    s << GCmd("DA " + posArray + "[]," + jetArray + "[]");
+    s << GCmd("DM " + posArray + "[" + size + "]," + jetArray + "[" + size + "]");
+    s << GCmd("RA " + posArray + "[]," + jetArray + "[]");
+    s << GCmd("RD _TP" + CMD::detail::axis_string(window.printAxis) + ",_RPH");
+    s << GCmd("RC " + std::to_string(period));
+
+    return s.str();
+}
+
+namespace
+{
+std::vector<double> upload_array(GCon g, const char *name)
+{
+    std::vector<double> values;
+    std::vector<char> buf(MAX_RECORD_LENGTH * 16, '\0');
+    if (GArrayUpload(g, name, G_BOUNDS, G_BOUNDS, G_COMMA, buf.data(), buf.size()) != G_NO_ERROR)
+        return values;
+
+    std::stringstream ss(std::string(buf.data()));
+    std::string value;
+    while (std::getline(ss, value, ','))
+    {
+        try { values.push_back(std::stod(value)); }
+        catch (const std::exception &) { break; }
+    }
+    return values;
+}
+}
+
+bool upload_telemetry(GCon g, Telemetry &telemetry)
+{
+    if (!g) return false;
+
+    telemetry.printAxis_cnts = upload_array(g, PRINT_POSITION_ARRAY);
+    telemetry.jetAxis_cnts = upload_array(g, JET_POSITION_ARRAY);
+
+    const size_t size = std::min(telemetry.printAxis_cnts.size(), telemetry.jetAxis_cnts.size());
+    telemetry.printAxis_cnts.resize(size);
+    telemetry.jetAxis_cnts.resize(size);
+    return size > 0;
+}
+
+Verification verify(const Engine &engine, const Window &window, const Telemetry &telemetry)
+{
+    Verification result;
+    const auto commanded = engine.commanded_positions_mm(window);
+    result.commandedDroplets = (int)commanded.size();
+
+    const double cntsPerMM = CMD::detail::counts_per_mm(window.printAxis);
+    const double dir = direction(window);
+    const auto &pos = telemetry.printAxis_cnts;
+    const auto &jet = telemetry.jetAxis_cnts;
+
+    if (engine.mode == Mode::OutputCompare)
+    {
+        // The pulses are fired in hardware and not recorded, so only check
+        // that the encoder crossed every compare position
+        result.placementMeasured = false;
+        for (const double target : commanded)
+        {
+            const double target_cnts = target * cntsPerMM;
+            for (size_t i{1}; i < pos.size(); ++i)
+            {
+                if ((pos[i-1] - target_cnts) * dir <= 0 && (pos[i] - target_cnts) * dir >= 0)
+                {
+                    result.firedDroplets++;
+                    break;
+                }
+            }
+        }
+        result.missedDroplets = result.commandedDroplets - result.firedDroplets;
+        return result;
+    }
+
+    // every jetting axis count crossed is a droplet
+    std::vector<double> fired_mm;
+    for (size_t i{1}; i < std::min(pos.size(), jet.size()); ++i)
+    {
+        const double j0 = jet[i-1], j1 = jet[i];
+        if (j0 == j1) continue;
+        // counts reached during this sample (not the one it started on)
+        const double first = (j1 > j0) ? std::floor(j0) + 1 : std::ceil(j0) - 1;
+        const double step = (j1 > j0) ? 1.0 : -1.0;
+        for (double k = first; (k - j1) * step <= 0; k += step)
+        {
+            const double f = (k - j0) / (j1 - j0);
+            fired_mm.push_back((pos[i-1] + f * (pos[i] - pos[i-1])) / cntsPerMM);
+        }
+    }
+    result.firedDroplets = (int)fired_mm.size();
+
+    // Each droplet is matched to the nearest commanded position within half
+    // a spacing, so a missed or extra droplet doesn't shift the ones after it
+    const double step_mm = dir * engine.actual_spacing_um(window) / 1000.0;
+    std::vector<bool> matched(commanded.size(), false);
+    int n {0};
+    double sum {0}, sumSq {0};
+    for (const double fired : fired_mm)
+    {
+        const long nearest = std::lround((fired - window.start_mm) / step_mm);
+        if (nearest < 0 || nearest >= (long)commanded.size() || matched[nearest])
+        {
+            result.extraDroplets++;
+            continue;
+        }
+        matched[nearest] = true;
+
+        const double error_um = (fired - commanded[nearest]) * dir * 1000.0;
+        n++;
+        sum += error_um;
+        sumSq += error_um * error_um;
+        result.maxError_um = std::max(result.maxError_um, std::abs(error_um));
+    }
+    result.missedDroplets = (int)std::count(matched.begin(), matched.end(), false);
+    if (n > 0)
+    {
+        result.meanError_um = sum / n;
+        result.rmsError_um = std::sqrt(sumSq / n);
+    }
+
+    return result;
+}
+
+std::string Verification::summary() const
+{
+    std::stringstream s;
+    s << "Droplets commanded: " << commandedDroplets;
+    if (!placementMeasured)
+    {
+        s << ", compare positions crossed: " << firedDroplets
+          << " (output compare pulses aren't recorded, so placement can't be measured)";
+        return s.str();
+    }
+    s << ", fired: " << firedDroplets
+      << ", missed: " << missedDroplets
+      << ", extra: " << extraDroplets
+      << ", placement error mean " << meanError_um
+      << " um, rms " << rmsError_um
+      << " um, max " << maxError_um << " um";
+    return s.str();
+}
+
+}
@@ -2,6 +2,7 @@
 
 #include "mister.h"
 #include "jetdrive.h"
+#include "dmc4080.h"
 #include <QDebug>
 #include <QRegularExpression>
 
@@ -23,6 +24,25 @@ void GMessageHandler::handle_message(QString message)
     {
         printer_->mister->turn_off_misters();
     }
+    else if (message.contains("CMD JET_SCHED"))
+    {
+        // "CMD JET_SCHED <segment> <frequency> <drops>" from Line_Print_Schedule.dmc
+        int startIndex = message.indexOf("CMD JET_SCHED") + strlen("CMD JET_SCHED");
+        QList<int> values;
+        auto matches = QRegularExpression("-?\\d+").globalMatch(message.mid(startIndex));
+        while (matches.hasNext()) values.append(matches.next().captured().toInt());
+
+        if (values.size() == 3)
+        {
+            printer_->jetDrive->set_continuous_mode_frequency(values[1]);
+            printer_->jetDrive->set_num_drops_per_trigger(values[2]);
+            acknowledge_jet_schedule(values[0]);
+        }
+        else
+        {
+            qDebug() << "Unable to extract values from received string. CMD JET_SCHED";
+        }
+    }
     else if (message.contains("CMD JET_FREQ"))
     {
         int startIndex = message.indexOf("CMD JET_FREQ") + strlen("CMD JET_FREQ") + 1; // +1 to skip the space
@@ -68,4 +88,27 @@ void GMessageHandler::handle_message(QString message)
     // or maybe I just respond back through the main g handle?
 }
 
+void GMessageHandler::acknowledge_jet_schedule(int segment)
+{
+    // the program triggers the segment once jsAck reaches it, so only set it
+    // after the JetDrive has answered the commands for the segment
+    auto send_ack = [this, segment]()
+    {
+        if (!printer_->mcu->g) return;
+        const std::string command = "jsAck=" + std::to_string(segment);
+        GCmd(printer_->mcu->g, command.c_str());
+    };
+
+    QObject::disconnect(jetScheduleAck_);
+    if (printer_->jetDrive->has_pending_writes())
+    {
+        jetScheduleAck_ = connect(printer_->jetDrive, &JetDrive::Controller::writes_complete, this, [this, send_ack]()
+        {
+            QObject::disconnect(jetScheduleAck_);
+            send_ack();
+        });
+    }
+    else send_ack();
+}
+
 #include "moc_gmessagehandler.cpp"
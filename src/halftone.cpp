@@ -0,0 +1,280 @@
+#include "halftone.h"
+
+#include <cmath>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <QImage>
+
+namespace Halftone
+{
+
+namespace
+{
+constexpr int MASK_AREA {BLUE_NOISE_SIZE * BLUE_NOISE_SIZE};
+
+int thread_count(int numThreads, int height)
+{
+    if (numThreads <= 0) numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    return std::max(1, std::min(numThreads, height));
+}
+
+// runs fn(firstRow, endRow) on bands of rows on separate threads
+template <typename Fn>
+void run_in_bands(int height, int numThreads, Fn fn)
+{
+    std::vector<std::thread> threads;
+    const int bandHeight = (height + numThreads - 1) / numThreads;
+    for (int first{0}; first < height; first += bandHeight)
+    {
+        threads.emplace_back(fn, first, std::min(height, first + bandHeight));
+    }
+    for (auto &thread : threads) thread.join();
+}
+
+// Blue noise threshold mask made with the void and cluster method
+// (Ulichney 1993). Each site gets a rank from 0 to MASK_AREA-1 in the
+// order it would be turned on, and the ranks are scaled to 0-254 so that
+// a saturation of s turns on about s/255 of the sites.
+std::array<uint8_t, MASK_AREA> make_blue_noise_mask()
+{
+    constexpr int N {BLUE_NOISE_SIZE};
+    constexpr double sigma {1.5};
+
+    // gaussian of the wrapped distance between two sites
+    std::vector<float> kernel(MASK_AREA);
+    for (int dy{0}; dy < N; ++dy)
+    {
+        for (int dx{0}; dx < N; ++dx)
+        {
+            const int wx = std::min(dx, N - dx);
+            const int wy = std::min(dy, N - dy);
+            kernel[dy * N + dx] = (float)std::exp(-(wx * wx + wy * wy) / (2.0 * sigma * sigma));
+        }
+    }
+
+    std::vector<uint8_t> pattern(MASK_AREA, 0);
+    std::vector<float> energy(MASK_AREA, 0.0f);
+    auto toggle = [&](int site, bool on)
+    {
+        pattern[site] = on;
+        const float sign = on ? 1.0f : -1.0f;
+        const int sx = site % N, sy = site / N;
+        for (int y{0}; y < N; ++y)
+        {
+            const int dy = (y - sy + N) % N;
+            for (int x{0}; x < N; ++x)
+                energy[y * N + x] += sign * kernel[dy * N + (x - sx + N) % N];
+        }
+    };
+    auto tightest_cluster = [&]()
+    {
+        int best {-1};
+        for (int i{0}; i < MASK_AREA; ++i)
+            if (pattern[i] && (best < 0 || energy[i] > energy[best])) best = i;
+        return best;
+    };
+    auto largest_void = [&]()
+    {
+        int best {-1};
+        for (int i{0}; i < MASK_AREA; ++i)
+            if (!pattern[i] && (best < 0 || energy[i] < energy[best])) best = i;
+        return best;
+    };
+
+    // random starting pattern with 10% of the sites on, then move points from
+    // the tightest cluster to the largest void until it stops changing
+    std::mt19937 rng(1);
+    const int initialOnes = MASK_AREA / 10;
+    for (int placed{0}; placed < initialOnes;)
+    {
+        const int site = (int)(rng() % MASK_AREA);
+        if (!pattern[site]) { toggle(site, true); ++placed; }
+    }
+    while (true)
+    {
+        const int cluster = tightest_cluster();
+        toggle(cluster, false);
+        const int gap = largest_void();
+        toggle(gap, true);
+        if (gap == cluster) break;
+    }
+    const std::vector<uint8_t> initialPattern = pattern;
+    const std::vector<float> initialEnergy = energy;
+
+    std::vector<int> rank(MASK_AREA);
+
+    // rank the starting points by taking away the tightest clusters
+    for (int ones{initialOnes}; ones > 0; --ones)
+    {
+        const int cluster = tightest_cluster();
+        toggle(cluster, false);
+        rank[cluster] = ones - 1;
+    }
+
+    // then rank the rest by filling the largest voids
+    pattern = initialPattern;
+    energy = initialEnergy;
+    for (int ones{initialOnes}; ones < MASK_AREA; ++ones)
+    {
+        const int gap = largest_void();
+        toggle(gap, true);
+        rank[gap] = ones;
+    }
+
+    std::array<uint8_t, MASK_AREA> mask;
+    for (int i{0}; i < MASK_AREA; ++i)
+        mask[i] = (uint8_t)((rank[i] * 255) / MASK_AREA);
+    return mask;
+}
+
+const std::array<uint8_t, MASK_AREA> &blue_noise_mask()
+{
+    static const std::array<uint8_t, MASK_AREA> mask = make_blue_noise_mask();
+    return mask;
+}
+
+// saturation of a pixel, optionally from a grayscale value (dark = binder)
+inline uint8_t level(uint8_t value, bool invert)
+{
+    return invert ? (uint8_t)(255 - value) : value;
+}
+
+void threshold(const uint8_t *data, size_t stride, bool invert, Bitmap &out, int numThreads)
+{
+    run_in_bands(out.height, numThreads, [&](int first, int end)
+    {
+        for (int y{first}; y < end; ++y)
+        {
+            const uint8_t *in = data + y * stride;
+            uint8_t *o = out.pixels.data() + (size_t)y * out.width;
+            for (int x{0}; x < out.width; ++x) o[x] = level(in[x], invert) >= 128;
+        }
+    });
+}
+
+void blue_noise(const uint8_t *data, size_t stride, bool invert, Bitmap &out, int numThreads)
+{
+    const auto &mask = blue_noise_mask();
+    run_in_bands(out.height, numThreads, [&](int first, int end)
+    {
+        for (int y{first}; y < end; ++y)
+        {
+            const uint8_t *in = data + y * stride;
+            const uint8_t *m = mask.data() + (y % BLUE_NOISE_SIZE) * BLUE_NOISE_SIZE;
+            uint8_t *o = out.pixels.data() + (size_t)y * out.width;
+            // a whole mask row at a time so the inner loop has no modulo
+            for (int x0{0}; x0 < out.width; x0 += BLUE_NOISE_SIZE)
+            {
+                const int n = std::min(BLUE_NOISE_SIZE, out.width - x0);
+                for (int i{0}; i < n; ++i) o[x0 + i] = level(in[x0 + i], invert) > m[i];
+            }
+        }
+    });
+}
+
+void floyd_steinberg(const uint8_t *data, size_t stride, bool invert, Bitmap &out, int numThreads)
+{
+    const int width = out.width;
+    const int height = out.height;
+
+    // Values are kept in 1/16ths of a gray level and the error sent to the
+    // row below is kept in 1/256ths, so the 7/16, 3/16, 5/16 and 1/16
+    // weights are whole numbers.
+    // Row r adds its error to errorRows[(r + 1) % numBuffers] while row r + 1
+    // reads it, and a row can't get more than numThreads rows ahead, so
+    // numThreads + 2 buffers are enough for the rows that are in flight.
+    const int numBuffers = numThreads + 2;
+    std::vector<std::vector<int32_t>> errorRows(numBuffers, std::vector<int32_t>(width + 2, 0));
+
+    // how many pixels of each row are done
+    std::vector<std::atomic<int>> progress(height);
+    for (auto &p : progress) p.store(0, std::memory_order_relaxed);
+    constexpr int publishInterval {32};
+
+    auto dither_rows = [&](int thread)
+    {
+        for (int y{thread}; y < height; y += numThreads)
+        {
+            const uint8_t *in = data + y * stride;
+            uint8_t *o = out.pixels.data() + (size_t)y * width;
+            const int32_t *incoming = errorRows[y % numBuffers].data() + 1;
+            int32_t *below = errorRows[(y + 1) % numBuffers].data() + 1;
+            std::fill(below - 1, below + width + 1, 0);
+
+            int aboveDone = (y == 0) ? width : 0;
+            int32_t carry {0};
+            for (int x{0}; x < width; ++x)
+            {
+                // errors from x-1 to x+1 of the row above have to be in
+                while (aboveDone < std::min(width, x + 2))
+                {
+                    aboveDone = progress[y - 1].load(std::memory_order_acquire);
+                    if (aboveDone < std::min(width, x + 2)) std::this_thread::yield();
+                }
+
+                const int32_t value = level(in[x], invert) * 16 + ((incoming[x] + carry) >> 4);
+                const bool on = value >= 128 * 16;
+                o[x] = on;
+                const int32_t error = value - (on ? 255 * 16 : 0);
+                carry = error * 7;
+                below[x - 1] += error * 3;
+                below[x] += error * 5;
+                below[x + 1] += error;
+
+                if ((x + 1) % publishInterval == 0)
+                    progress[y].store(x + 1, std::memory_order_release);
+            }
+            progress[y].store(width, std::memory_order_release);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i{0}; i < numThreads; ++i) threads.emplace_back(dither_rows, i);
+    for (auto &thread : threads) thread.join();
+}
+
+Bitmap dither(const uint8_t *data, int width, int height, size_t stride,
+              bool invert, Method method, int numThreads)
+{
+    Bitmap out;
+    if (!data || width <= 0 || height <= 0) return out;
+    out.width = width;
+    out.height = height;
+    out.pixels.resize((size_t)width * height);
+    numThreads = thread_count(numThreads, height);
+
+    switch (method)
+    {
+    case Method::Threshold:
+        threshold(data, stride, invert, out, numThreads);
+        break;
+    case Method::FloydSteinberg:
+        floyd_steinberg(data, stride, invert, out, numThreads);
+        break;
+    case Method::BlueNoise:
+        blue_noise(data, stride, invert, out, numThreads);
+        break;
+    }
+    return out;
+}
+}
+
+Bitmap dither(const uint8_t *saturation, int width, int height, size_t stride,
+              Method method, int numThreads)
+{
+    return dither(saturation, width, height, stride, false, method, numThreads);
+}
+
+Bitmap dither(const QImage &image, Method method, int numThreads)
+{
+    const QImage gray = image.convertToFormat(QImage::Format_Grayscale8);
+    return dither(gray.constBits(), gray.width(), gray.height(), (size_t)gray.bytesPerLine(),
+                  true, method, numThreads);
+}
+
+}
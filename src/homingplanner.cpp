@@ -0,0 +1,237 @@
+#include "homingplanner.h"
+
+#include <sstream>
+
+namespace
+{
+// most time the threads get to home before #LHOME gives up (10 ms loops)
+constexpr int HOMING_TIMEOUT_LOOPS {12000};
+
+const std::vector<Axis> homingAxes {Axis::X, Axis::Y, Axis::Z};
+}
+
+HomingPlanner::HomingPlanner()
+{
+    // home the x-axis using the central home sensor index pulse
+    set_steps(Axis::X, {
+        {"limit", {"ACX = 800 * lXCnt", "DCX = 800 * lXCnt", "SDX = 800 * lXCnt",
+                   "JGX = 25 * lXCnt", "BGX", "AMX"}},
+        {"index", {"WT 1000", "JGX = -30 * lXCnt", "HVX = 0.5 * lXCnt", "FIX", "BGX", "AMX"}}
+    });
+
+    // move y-axis back a bit off the limit to avoid being right on top of
+    // the index pulse, then home to the nearest index
+    set_steps(Axis::Y, {
+        {"limit", {"ACY = 400 * lYCnt", "DCY = 400 * lYCnt", "SDY = 600 * lYCnt",
+                   "JGY = 25 * lYCnt", "BGY", "AMY"}},
+        {"backoff", {"PRY = -2 * lYCnt", "SPY = 10 * lYCnt", "BGY", "AMY"}},
+        {"index", {"WT 1000", "JGY = -0.5 * lYCnt", "HVY = 0.25 * lYCnt", "FIY", "BGY", "AMY"}}
+    });
+
+    // jog to the bottom (MAX SPEED of 5mm/s!) with the top software limit
+    // off, then back up to the print bed height
+    set_steps(Axis::Z, {
+        {"limit", {"ACZ = 20 * lZCnt", "DCZ = 20 * lZCnt", "SDZ = 40 * lZCnt",
+                   "JGZ = -2 * lZCnt", "FLZ = 2147483647", "BGZ", "AMZ"}},
+        // TUNE THIS BACKING OFF Z LIMIT TO FUTURE PRINT BED HEIGHT!
+        {"raise", {"ACZ = 10 * lZCnt", "SPZ = 2 * lZCnt", "PRZ = 13.5322 * lZCnt", "BGZ", "AMZ"}}
+    });
+
+    // the bed is only clear of the roller once the y-axis is at the front
+    add_dependency(Axis::Y, "limit", Axis::Z, "raise");
+}
+
+void HomingPlanner::set_steps(Axis axis, const std::vector<HomingStep> &steps)
+{
+    steps_[axis] = steps;
+
+    // the dependencies may point at steps that are gone now
+    const std::vector<Dependency> old = dependencies_;
+    dependencies_.clear();
+    for (const auto &dependency : old)
+    {
+        if ((dependency.beforeAxis != axis || dependency.beforeStep < (int)steps.size())
+            && (dependency.afterAxis != axis || dependency.afterStep < (int)steps.size()))
+            dependencies_.push_back(dependency);
+    }
+}
+
+const std::vector<HomingStep> &HomingPlanner::steps(Axis axis) const
+{
+    static const std::vector<HomingStep> none;
+    const auto found = steps_.find(axis);
+    return found == steps_.end() ? none : found->second;
+}
+
+bool HomingPlanner::add_dependency(Axis beforeAxis, const std::string &beforeStep,
+                                   Axis afterAxis, const std::string &afterStep)
+{
+    const int before = step_index(beforeAxis, beforeStep);
+    const int after = step_index(afterAxis, afterStep);
+    if (before < 0 || after < 0)
+    {
+        error_ = "There is no homing step called \"" + (before < 0 ? beforeStep : afterStep) + "\"";
+        return false;
+    }
+    if (beforeAxis == afterAxis)
+    {
+        error_ = "The steps of an axis already run in order";
+        return false;
+    }
+
+    std::vector<Dependency> dependencies = dependencies_;
+    dependencies.push_back({beforeAxis, before, afterAxis, after});
+    if (!can_finish(dependencies))
+    {
+        error_ = "\"" + afterStep + "\" waiting for \"" + beforeStep + "\" would make the axes wait on each other forever";
+        return false;
+    }
+
+    dependencies_ = dependencies;
+    return true;
+}
+
+void HomingPlanner::clear_dependencies()
+{
+    dependencies_.clear();
+}
+
+int HomingPlanner::step_index(Axis axis, const std::string &name) const
+{
+    const std::vector<HomingStep> &axisSteps = steps(axis);
+    for (int i{0}; i < (int)axisSteps.size(); ++i)
+    {
+        if (axisSteps[i].name == name) return i;
+    }
+    return -1;
+}
+
+bool HomingPlanner::can_finish(const std::vector<Dependency> &dependencies) const
+{
+    // run the threads step by step, each one only going on once everything
+    // its next step waits on is done
+    std::map<Axis, int> done;
+    bool progressed {true};
+    while (progressed)
+    {
+        progressed = false;
+        for (const Axis axis : homingAxes)
+        {
+            const int next = done[axis];
+            if (next >= (int)steps(axis).size()) continue;
+
+            bool ready {true};
+            for (const auto &dependency : dependencies)
+            {
+                if (dependency.afterAxis == axis && dependency.afterStep == next
+                    && done[dependency.beforeAxis] <= dependency.beforeStep)
+                    ready = false;
+            }
+            if (ready)
+            {
+                ++done[axis];
+                progressed = true;
+            }
+        }
+    }
+
+    for (const Axis axis : homingAxes)
+    {
+        if (done[axis] < (int)steps(axis).size()) return false;
+    }
+    return true;
+}
+
+std::string HomingPlanner::generate_program() const
+{
+    using CMD::detail::axis_string;
+    std::stringstream s;
+
+    // lHomeZ - 1 to home the z-axis as well
+    // lHomed is set to 1 once the axes are referenced, which DMC4080 checks
+    // to skip homing when it connects again
+    s << "#LHOME\n";
+    s << "lHomed = 0\n";
+    s << "lHWt = 0\n";
+    s << "JS #LCNTS\n";
+    for (const Axis axis : homingAxes)
+        s << "lHS" << axis_string(axis) << " = 0\n";
+
+    int thread {1};
+    for (const Axis axis : homingAxes)
+    {
+        const std::string name = axis_string(axis);
+        if (axis == Axis::Z)
+        {
+            s << "IF (lHomeZ = 1)\n";
+            s << "XQ #LHOME" << name << "," << thread << "\n";
+            s << "ELSE\n";
+            s << "lHS" << name << " = " << steps(axis).size() << "\n"; // its steps count as done
+            s << "ENDIF\n";
+        }
+        else
+        {
+            s << "XQ #LHOME" << name << "," << thread << "\n";
+        }
+        ++thread;
+    }
+
+    // wait for every thread to finish
+    std::string unfinished;
+    for (const Axis axis : homingAxes)
+    {
+        if (!unfinished.empty()) unfinished += " | ";
+        unfinished += "(lHS" + axis_string(axis) + " < " + std::to_string(steps(axis).size()) + ")";
+    }
+    s << "#LHWAIT\n";
+    s << "WT 10\n";
+    s << "lHWt = lHWt + 1\n";
+    s << "JP #LHWAIT, (" << unfinished << ") & (lHWt < " << HOMING_TIMEOUT_LOOPS << ")\n";
+    s << "IF (" << unfinished << ")\n";
+    s << "MG \"Homing did not finish\"\n";
+    s << "HX1\n" << "HX2\n" << "HX3\n";
+    s << "ST\n";
+    s << "EN\n";
+    s << "ENDIF\n";
+
+    s << "DPX = " << X_STAGE_LEN_MM / 2.0 << " * lXCnt\n";
+    s << "DPY = 0\n";
+    s << "DPZ = 0\n";
+    s << "FLZ = 0\n"; // set software limit to current position
+    s << "lHomed = 1\n";
+    s << "EN\n";
+
+    // one routine per axis that runs in its own thread
+    for (const Axis axis : homingAxes)
+    {
+        const std::string name = axis_string(axis);
+        const std::vector<HomingStep> &axisSteps = steps(axis);
+
+        s << "#LHOME" << name << "\n";
+        for (int i{0}; i < (int)axisSteps.size(); ++i)
+        {
+            std::string waitsOn;
+            for (const auto &dependency : dependencies_)
+            {
+                if (dependency.afterAxis != axis || dependency.afterStep != i) continue;
+                if (!waitsOn.empty()) waitsOn += " | ";
+                waitsOn += "(lHS" + axis_string(dependency.beforeAxis) + " < "
+                           + std::to_string(dependency.beforeStep + 1) + ")";
+            }
+            if (!waitsOn.empty())
+            {
+                const std::string label = "#LHW" + name + std::to_string(i);
+                s << label << "\n";
+                s << "WT 10\n";
+                s << "JP " << label << ", " << waitsOn << "\n";
+            }
+
+            for (const auto &command : axisSteps[i].commands)
+                s << command << "\n";
+            s << "lHS" << name << " = " << i + 1 << "\n";
+        }
+        s << "EN\n";
+    }
+
+    return s.str();
+}
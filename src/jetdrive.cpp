@@ -12,9 +12,6 @@ Controller::Controller(const QString &portName, QObject *parent) :
 {
     name = "JetDrive";
     // connect timer for handling timeout errors
-    connect(serialPort, &QSerialPort::readyRead,
-            this, &Controller::handle_ready_read);
-
     connect(timer, &QTimer::timeout,
             this, &Controller::handle_timeout);
 
@@ -27,59 +24,6 @@ Controller::~Controller()
     if (is_connected()) serialPort->close();
 }
 
-void Controller::handle_ready_read()
-{
-    readData.append(serialPort->readAll());
-
-    switch (initState)
-    {
-
-    case INIT_Q:
-        if (readData.contains(">") || readData.contains("MFJET32"))
-        {
-            //emit response("MFJET32");
-            readData.clear();
-            initState = INIT_X2000;
-            write_next();
-        }
-        break;
-
-    case INIT_X2000:
-        if (readData.contains(xCmd.at(iX200)))
-        {
-            //emit response(QString::fromUtf8(&xCmd.constData()[iX200], 1));
-            readData.clear();
-            iX200++;
-
-            // finish once all of the bytes have been written and read
-            if (iX200 >= xCmd.size())
-            {
-                emit response(QString("Connected to %1").arg(name));
-                initState = INITIALIZED;
-                iX200 = 0;
-            }
-            write_next();
-        } else readData.clear();
-        break;
-
-    case INITIALIZED:
-        // the command is in the second byte received
-        if (readData.size() == 2)
-            expectedResponseSize = response_size((CMD)(readData.at(1)));
-        else if (readData.size() >= expectedResponseSize)
-        {
-            // TODO: can do something with the response here (error checking)
-            // qDebug() << readData;
-            readData.clear();
-            write_next();
-        }
-
-        break;
-
-    default: break;
-    }
-}
-
 void Controller::handle_timeout()
 {
     timer->stop();
@@ -94,23 +38,61 @@ void Controller::initialize_jet_drive()
     // Start-up for MicroJet III.
     initState = InitState::INIT_Q;
 
-    write("Q");
-    // write the X2000 command byte by byte
-    for (const auto byte : xCmd)
-        write(QByteArray(1, byte));
+    SerialCommand q;
+    q.data = "Q";
+    q.replySize = [](const QByteArray &read) -> qsizetype {
+        for (const QByteArray &prompt : {QByteArray(">"), QByteArray("MFJET32")})
+        {
+            const qsizetype i = read.indexOf(prompt);
+            if (i >= 0) return i + prompt.size();
+        }
+        return 0;
+    };
+    q.done = [this](const QByteArray &, double) { initState = INIT_X2000; };
+    write(q);
+
+    // write the X2000 command byte by byte, each one is echoed back
+    for (qsizetype i{0}; i < xCmd.size(); ++i)
+    {
+        const char byte = xCmd.at(i);
+        SerialCommand x;
+        x.data = QByteArray(1, byte);
+        x.replySize = [byte](const QByteArray &read) -> qsizetype {
+            const qsizetype echo = read.indexOf(byte);
+            return echo < 0 ? 0 : echo + 1;
+        };
+        if (i == xCmd.size() - 1)
+        {
+            x.done = [this](const QByteArray &, double) {
+                emit response(QString("Connected to %1").arg(name));
+                initState = INITIALIZED;
+                set_pipeline_depth(jetDrivePipelineDepth);
+            };
+        }
+        write(x);
+    }
 
     // initialize jetDrive parameters (order specified in command reference)
-    write(cmdBuilder->build(CMD::RESET, jetParams));        // 1.) Soft Reset
-    write(cmdBuilder->build(CMD::GETVERSION, jetParams));   // 2.) Version
-                                                            // 3.) Get Number of Channels
-    write(cmdBuilder->build(CMD::PULSE, jetParams));        // 4.) Pulse Waveform
-    write(cmdBuilder->build(CMD::CONTMODE, jetParams));     // 5.) Trigger Mode
-    write(cmdBuilder->build(CMD::DROPS, jetParams));        // 6.) Number of Drops per Trigger
-    write(cmdBuilder->build(CMD::FULLFREQ, jetParams));     // 7.) Frequency
-    write(cmdBuilder->build(CMD::STROBEDIV, jetParams));    // 8.) Strobe Divider
-    write(cmdBuilder->build(CMD::STROBEENABLE, jetParams)); // 9.) Strobe Enable
-    write(cmdBuilder->build(CMD::STROBEDELAY, jetParams));  // 10.) Strobe Delay
-    write(cmdBuilder->build(CMD::SOURCE, jetParams));       // 11.) Trigger Source
+    send(CMD::RESET);        // 1.) Soft Reset
+    send(CMD::GETVERSION);   // 2.) Version
+                             // 3.) Get Number of Channels
+    send(CMD::PULSE);        // 4.) Pulse Waveform
+    send(CMD::CONTMODE);     // 5.) Trigger Mode
+    send(CMD::DROPS);        // 6.) Number of Drops per Trigger
+    send(CMD::FULLFREQ);     // 7.) Frequency
+    send(CMD::STROBEDIV);    // 8.) Strobe Divider
+    send(CMD::STROBEENABLE); // 9.) Strobe Enable
+    send(CMD::STROBEDELAY);  // 10.) Strobe Delay
+    send(CMD::SOURCE);       // 11.) Trigger Source
+}
+
+void Controller::send(CMD command, const QString &coalesceKey)
+{
+    SerialCommand c;
+    c.data = cmdBuilder->build(command, jetParams);
+    c.replyLength = response_size(command);
+    c.coalesceKey = coalesceKey;
+    write(c);
 }
 
 int Controller::connect_to_jet_drive()
@@ -139,6 +121,7 @@ int Controller::connect_to_jet_drive()
 
 void Controller::disconnect_serial()
 {
+    if (is_connected() && latency().count > 0) emit response(latency_summary());
     clear_members();
     if (is_connected())
     {
@@ -150,7 +133,6 @@ void Controller::disconnect_serial()
 
 void Controller::clear_members()
 {
-    iX200 = 0;
     initState = InitState::NOT_INITIALIZED;
     clear_command_queue();
 }
@@ -159,7 +141,7 @@ void Controller::set_waveform(const Waveform &waveform)
 {
     QMutexLocker lock(&mutex);
     jetParams.waveform = waveform;
-    write(cmdBuilder->build(CMD::PULSE, jetParams));
+    send(CMD::PULSE);
 }
 
 void Controller::set_continuous_jetting()
@@ -168,7 +150,7 @@ void Controller::set_continuous_jetting()
     if (jetParams.fMode != 1)
     {
         jetParams.fMode = 1;
-        write(cmdBuilder->build(CMD::CONTMODE, jetParams));
+        send(CMD::CONTMODE);
     }
 }
 
@@ -178,7 +160,7 @@ void Controller::set_single_jetting()
     if (jetParams.fMode != 0)
     {
         jetParams.fMode = 0;
-        write(cmdBuilder->build(CMD::CONTMODE, jetParams));
+        send(CMD::CONTMODE);
     }
 }
 
@@ -188,7 +170,7 @@ void Controller::set_continuous_mode_frequency(long frequency_Hz)
     if (jetParams.fFrequency != frequency_Hz)
     {
         jetParams.fFrequency = frequency_Hz;
-        write(cmdBuilder->build(CMD::FULLFREQ, jetParams));
+        send(CMD::FULLFREQ);
     }
 }
 
@@ -198,7 +180,7 @@ void Controller::set_num_drops_per_trigger(short numDrops)
     if (jetParams.fDrops != numDrops)
     {
         jetParams.fDrops = numDrops;
-        write(cmdBuilder->build(CMD::DROPS, jetParams));
+        send(CMD::DROPS);
     }
 }
 
@@ -208,7 +190,7 @@ void Controller::set_external_trigger()
     if (jetParams.fSource != 1)
     {
         jetParams.fSource = 1;
-        write(cmdBuilder->build(CMD::SOURCE, jetParams));
+        send(CMD::SOURCE);
     }
 }
 
@@ -218,7 +200,7 @@ void Controller::set_internal_trigger()
     if (jetParams.fSource != 0)
     {
         jetParams.fSource = 0;
-        write(cmdBuilder->build(CMD::SOURCE, jetParams));
+        send(CMD::SOURCE);
     }
 }
 
@@ -227,7 +209,7 @@ void Controller::start_continuous_jetting()
     set_continuous_jetting();
     set_internal_trigger();
     QMutexLocker lock(&mutex);
-    write(cmdBuilder->build(CMD::SOFTTRIGGER, jetParams));
+    send(CMD::SOFTTRIGGER);
 }
 
 void Controller::stop_continuous_jetting()
@@ -241,7 +223,7 @@ void Controller::enable_strobe()
     if (jetParams.fStrobeEnable != 1)
     {
         jetParams.fStrobeEnable = 1;
-        write(cmdBuilder->build(CMD::STROBEENABLE, jetParams));
+        send(CMD::STROBEENABLE);
     }
 }
 
@@ -251,7 +233,7 @@ void Controller::disable_strobe()
     if (jetParams.fStrobeEnable != 0)
     {
         jetParams.fStrobeEnable = 0;
-        write(cmdBuilder->build(CMD::STROBEENABLE, jetParams));
+        send(CMD::STROBEENABLE);
     }
 }
 
@@ -260,7 +242,8 @@ void Controller::set_strobe_delay(short strobeDelay_microseconds)
     if (jetParams.fStrobeDelay != strobeDelay_microseconds)
     {
         jetParams.fStrobeDelay = strobeDelay_microseconds;
-        write(cmdBuilder->build(CMD::STROBEDELAY, jetParams));
+        // a strobe sweep sets it every frame, only the latest delay matters
+        send(CMD::STROBEDELAY, "strobe delay");
     }
 }
 
@@ -0,0 +1,114 @@
+#include "jetschedule.h"
+#include "lineprintdata.h"
+#include "settlemodel.h"
+
+#include <cmath>
+#include <sstream>
+
+bool JetSchedule::add_segment(const JetSegment &segment)
+{
+    if ((int)segments_.size() >= JET_SCHEDULE_MAX_SEGMENTS)
+        error_ = "The schedule already has the most segments (" + std::to_string(JET_SCHEDULE_MAX_SEGMENTS) + ")";
+    else if (segment.numDroplets < 1 || segment.numDroplets > JET_MAX_DROPS_PER_TRIGGER)
+        error_ = "A segment needs between 1 and " + std::to_string(JET_MAX_DROPS_PER_TRIGGER) + " droplets, not "
+                 + std::to_string(segment.numDroplets);
+    else if (segment.dropletSpacing_um <= 0 || segment.frequency_Hz <= 0)
+        error_ = "A segment needs a droplet spacing and jetting frequency greater than 0";
+    else if (segment.acceleration_mm_per_s2 <= 0)
+        error_ = "A segment needs an acceleration greater than 0";
+    else if (segment.startX_mm - Settle::run_up_distance_mm(Axis::X, segment.print_speed_mm_per_s(), segment.acceleration_mm_per_s2) < 0)
+        error_ = "A segment starts too close to x = 0 to get up to its print speed";
+    else
+    {
+        segments_.push_back(segment);
+        return true;
+    }
+    return false;
+}
+
+void JetSchedule::clear()
+{
+    segments_.clear();
+    error_.clear();
+}
+
+JetSchedule JetSchedule::from_line_print_data(LinePrintData &table, double offsetX_mm, double offsetY_mm)
+{
+    JetSchedule schedule;
+    const std::vector<QPointF> origins = table.set_origins();
+    for (int s{0}; s < table.numRows(); ++s)
+    {
+        const LineSet &set = table.data[s];
+        JetSegment segment;
+        segment.startX_mm = origins[s].x() + offsetX_mm;
+        segment.dropletSpacing_um = (int)set.dropletSpacing.value;
+        segment.frequency_Hz = (int)set.jettingFreq.value;
+        segment.numDroplets = (int)std::lround(set.lineLength.value * 1000.0 / set.dropletSpacing.value);
+        segment.acceleration_mm_per_s2 = set.printAcceleration.value;
+
+        for (int i{0}; i < (int)set.numLines.value; ++i)
+        {
+            segment.y_mm = origins[s].y() + offsetY_mm + i * set.lineSpacing.value;
+            if (!schedule.add_segment(segment)) return schedule;
+        }
+    }
+    return schedule;
+}
+
+std::vector<long> JetSchedule::controller_array() const
+{
+    std::vector<long> values;
+    values.reserve(segments_.size() * JET_SCHEDULE_FIELDS);
+    for (const auto &segment : segments_)
+    {
+        const double speed_mm_s = segment.print_speed_mm_per_s();
+        const double runUp_mm = Settle::run_up_distance_mm(Axis::X, speed_mm_s, segment.acceleration_mm_per_s2);
+
+        values.push_back(std::lround(segment.startX_mm * X_CNTS_PER_MM));
+        values.push_back(std::lround(segment.y_mm * Y_CNTS_PER_MM));
+        values.push_back(std::lround(speed_mm_s * X_CNTS_PER_MM));
+        values.push_back(std::lround(segment.acceleration_mm_per_s2 * X_CNTS_PER_MM));
+        values.push_back(std::lround(runUp_mm * X_CNTS_PER_MM));
+        values.push_back(std::lround(segment.length_mm() * X_CNTS_PER_MM));
+        values.push_back(segment.frequency_Hz);
+        values.push_back(segment.numDroplets);
+    }
+    return values;
+}
+
+std::string JetSchedule::generate_commands_for_printing() const
+{
+    std::stringstream s;
+    if (segments_.empty()) return s.str();
+
+    // longest the JetDrive has taken to be set before the program gives up,
+    // the serial port times out after 3 s
+    constexpr int ackTimeout_ms {5000};
+
+    const std::vector<long> values = controller_array();
+
+    s << CMD::display_message("Printing " + std::to_string(segments_.size()) + " jetting segments");
+    s << CMD::stop_motion(Axis::Jet); // stop jetting if it is currently jetting
+
+    // Sched[] is sized for this schedule, so clear out the arrays of the
+    // last program first (Line_Print_Schedule.dmc makes its own Data[])
+    s << CMD::detail::GCmd() << "DA *[0]" << "\n";
+    s << CMD::detail::GCmd() << "DM " << JET_SCHEDULE_ARRAY << "[" << values.size() << "]" << "\n";
+    s << CMD::detail::ArrayDownload() << JET_SCHEDULE_ARRAY;
+    for (const long value : values) s << "," << value;
+    s << "\n";
+
+    s << CMD::detail::GCmd() << "XQ #BEGIN" << "\n";
+    s << "PrintLineSet,1,"
+      << segments_.size() << ","
+      << std::lround(travelSpeedX_mm_per_s * X_CNTS_PER_MM) << ","
+      << std::lround(travelSpeedY_mm_per_s * Y_CNTS_PER_MM) << ","
+      << settleTime_ms << ","
+      << ackTimeout_ms << "\n";
+
+    // the program ends by itself once the schedule has printed
+    s << "GProgramComplete," << "\n";
+    s << CMD::display_message("Jetting Schedule Complete");
+
+    return s.str();
+}
@@ -0,0 +1,407 @@
+#include "jobfile.h"
+#include "lineprintdata.h"
+#include "rasterprint.h"
+#include "layermap.h"
+
+#include <cstring>
+
+#include <QFile>
+#include <QSaveFile>
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr char JOB_MAGIC[4] {'B', 'J', 'O', 'B'};
+
+struct JobFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t jsonSize;
+    uint64_t payloadOffset;
+    uint64_t payloadSize;
+};
+static_assert(sizeof(JobFileHeader) == 32, "job file header must not be padded");
+
+size_t aligned(size_t offset)
+{
+    return (offset + JOB_PAYLOAD_ALIGNMENT - 1) / JOB_PAYLOAD_ALIGNMENT * JOB_PAYLOAD_ALIGNMENT;
+}
+
+bool write_zeros(QSaveFile &file, size_t count)
+{
+    static const char zeros[JOB_PAYLOAD_ALIGNMENT] {};
+    return count == 0 || file.write(zeros, (qint64)count) == (qint64)count;
+}
+}
+
+// the payload of a loaded job, mapped if the file system supports it
+struct JobFile::Payload
+{
+    explicit Payload(const QString &fileName) : file(fileName) {}
+    ~Payload() { if (mapped) file.unmap(mapped); }
+    const uint8_t *data() const { return mapped ? mapped : read.data(); }
+
+    QFile file; // open while the payload is mapped
+    uint8_t *mapped {nullptr};
+    std::vector<uint8_t> read; // used if the file can't be mapped
+};
+
+JobFile::JobFile() : settings(json::object()) {}
+
+bool JobFile::fail(const std::string &message)
+{
+    error_ = message;
+    return false;
+}
+
+void JobFile::add_block(const std::string &name, const char *element, size_t elementSize,
+                        const void *values, size_t count)
+{
+    Block &block = blocks_[name];
+    block.element = element;
+    block.count = count;
+    block.bytes = count * elementSize;
+    auto owned = std::make_shared<std::vector<uint8_t>>(block.bytes);
+    if (block.bytes) std::memcpy(owned->data(), values, block.bytes);
+    block.data = std::shared_ptr<const uint8_t>(owned, owned->data());
+}
+
+bool JobFile::save(const QString &fileName)
+{
+    // lay out the payload
+    json blockTable = json::object();
+    size_t payloadSize {0};
+    for (auto &[name, block] : blocks_)
+    {
+        payloadSize = aligned(payloadSize);
+        blockTable[name] = {{"offset", payloadSize}, {"size", block.bytes},
+                            {"element", block.element}, {"count", block.count}};
+        payloadSize += block.bytes;
+    }
+
+    const std::string text = json{{"type", type}, {"settings", settings}, {"blocks", blockTable}}.dump();
+
+    JobFileHeader header;
+    std::memcpy(header.magic, JOB_MAGIC, sizeof(JOB_MAGIC));
+    header.version = JOB_FILE_VERSION;
+    header.jsonSize = text.size();
+    header.payloadOffset = aligned(sizeof(header) + text.size());
+    header.payloadSize = payloadSize;
+
+    // written to a temporary file that replaces the old one when it is done
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return fail("Could not open " + fileName.toStdString() + " for writing");
+
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    ok = ok && file.write(text.data(), (qint64)text.size()) == (qint64)text.size();
+    ok = ok && write_zeros(file, header.payloadOffset - sizeof(header) - text.size());
+
+    size_t position {0};
+    for (auto &[name, block] : blocks_)
+    {
+        if (!ok) break;
+        ok = write_zeros(file, aligned(position) - position);
+        position = aligned(position);
+        ok = ok && file.write(reinterpret_cast<const char*>(block.data.get()), (qint64)block.bytes) == (qint64)block.bytes;
+        position += block.bytes;
+    }
+
+    if (!ok || !file.commit()) return fail("Could not write " + fileName.toStdString());
+    error_.clear();
+    return true;
+}
+
+bool JobFile::load(const QString &fileName)
+{
+    blocks_.clear();
+    type.clear();
+    settings = json::object();
+
+    auto payload = std::make_shared<Payload>(fileName);
+    QFile *file = &payload->file;
+    if (!file->open(QIODevice::ReadOnly)) return fail("Could not open " + fileName.toStdString());
+
+    JobFileHeader header;
+    if (file->read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+            || std::memcmp(header.magic, JOB_MAGIC, sizeof(JOB_MAGIC)) != 0)
+    {
+        return fail(fileName.toStdString() + " is not a job file");
+    }
+    if (header.version > JOB_FILE_VERSION)
+    {
+        return fail(fileName.toStdString() + " was made by a newer version (job file version "
+                    + std::to_string(header.version) + ")");
+    }
+    if (header.payloadOffset < sizeof(header) + header.jsonSize
+            || header.payloadOffset + header.payloadSize > (uint64_t)file->size())
+    {
+        return fail(fileName.toStdString() + " is truncated");
+    }
+
+    json j;
+    try
+    {
+        const QByteArray text = file->read((qint64)header.jsonSize);
+        j = json::parse(text.constData(), text.constData() + text.size());
+        type = j.at("type").get<std::string>();
+        settings = j.value("settings", json::object());
+    }
+    catch (const json::exception &e)
+    {
+        return fail(fileName.toStdString() + " has bad job settings: " + e.what());
+    }
+
+    // map the payload, or read it if the file system doesn't support mapping
+    if (header.payloadSize > 0)
+    {
+        payload->mapped = file->map((qint64)header.payloadOffset, (qint64)header.payloadSize);
+        if (!payload->mapped)
+        {
+            payload->read.resize(header.payloadSize);
+            file->seek((qint64)header.payloadOffset);
+            if (file->read(reinterpret_cast<char*>(payload->read.data()), (qint64)header.payloadSize) != (qint64)header.payloadSize)
+                return fail("Could not read " + fileName.toStdString());
+        }
+    }
+
+    try
+    {
+        const json blockTable = j.value("blocks", json::object());
+        for (const auto &[name, entry] : blockTable.items())
+        {
+            Block block;
+            block.element = entry.at("element").get<std::string>();
+            block.count = entry.at("count").get<size_t>();
+            block.bytes = entry.at("size").get<size_t>();
+            block.offset = entry.at("offset").get<size_t>();
+            if (block.offset + block.bytes > header.payloadSize || block.offset % JOB_PAYLOAD_ALIGNMENT != 0)
+            {
+                blocks_.clear();
+                return fail(fileName.toStdString() + " has a block outside of its payload");
+            }
+            block.data = std::shared_ptr<const uint8_t>(payload, payload->data() + block.offset);
+            blocks_[name] = std::move(block);
+        }
+    }
+    catch (const json::exception &e)
+    {
+        blocks_.clear();
+        return fail(fileName.toStdString() + " has a bad block table: " + e.what());
+    }
+
+    error_.clear();
+    return true;
+}
+
+void to_json(json &j, const RecoatSettings &settings)
+{
+    j = json{
+        {"recoatSpeed_mm_s", settings.recoatSpeed_mm_s},
+        {"rollerTraverseSpeed_mm_s", settings.rollerTraverseSpeed_mm_s},
+        {"ultrasonicIntensityLevel", settings.ultrasonicIntensityLevel},
+        {"ultrasonicMode", settings.ultrasonicMode},
+        {"layerHeight_microns", settings.layerHeight_microns},
+        {"isLevelRecoat", settings.isLevelRecoat},
+        {"waitAfterHopperOn_millisecs", settings.waitAfterHopperOn_millisecs},
+        {"yJogSpeedToHopper_mm_s", settings.yJogSpeedToHopper_mm_s},
+        {"recoatYAxisTravel", settings.recoatYAxisTravel},
+        {"rollerYAxisTravel", settings.rollerYAxisTravel},
+        {"xAxisDefaultAcceleration", settings.xAxisDefaultAcceleration},
+        {"yAxisDefaultAcceleration", settings.yAxisDefaultAcceleration},
+        {"zAxisDefaultAcceleration", settings.zAxisDefaultAcceleration}
+    };
+}
+
+// settings missing from the json keep their current values
+void from_json(const json &j, RecoatSettings &settings)
+{
+    settings.recoatSpeed_mm_s = j.value("recoatSpeed_mm_s", settings.recoatSpeed_mm_s);
+    settings.rollerTraverseSpeed_mm_s = j.value("rollerTraverseSpeed_mm_s", settings.rollerTraverseSpeed_mm_s);
+    settings.ultrasonicIntensityLevel = j.value("ultrasonicIntensityLevel", settings.ultrasonicIntensityLevel);
+    settings.ultrasonicMode = j.value("ultrasonicMode", settings.ultrasonicMode);
+    settings.layerHeight_microns = j.value("layerHeight_microns", settings.layerHeight_microns);
+    settings.isLevelRecoat = j.value("isLevelRecoat", settings.isLevelRecoat);
+    settings.waitAfterHopperOn_millisecs = j.value("waitAfterHopperOn_millisecs", settings.waitAfterHopperOn_millisecs);
+    settings.yJogSpeedToHopper_mm_s = j.value("yJogSpeedToHopper_mm_s", settings.yJogSpeedToHopper_mm_s);
+    settings.recoatYAxisTravel = j.value("recoatYAxisTravel", settings.recoatYAxisTravel);
+    settings.rollerYAxisTravel = j.value("rollerYAxisTravel", settings.rollerYAxisTravel);
+    settings.xAxisDefaultAcceleration = j.value("xAxisDefaultAcceleration", settings.xAxisDefaultAcceleration);
+    settings.yAxisDefaultAcceleration = j.value("yAxisDefaultAcceleration", settings.yAxisDefaultAcceleration);
+    settings.zAxisDefaultAcceleration = j.value("zAxisDefaultAcceleration", settings.zAxisDefaultAcceleration);
+}
+
+namespace Job
+{
+
+void write_line_print_data(JobFile &job, const LinePrintData &table)
+{
+    // columns are stored by name so they still line up if columns are added
+    LineSet columns;
+    json names = json::array();
+    for (int c{0}; c < columns.size; ++c) names.push_back(columns[c].typeName);
+
+    std::vector<float> values;
+    std::vector<float> origins; // NaN for sets that follow the one before them
+    values.reserve(table.data.size() * columns.size);
+    origins.reserve(2 * table.data.size());
+    for (auto set : table.data)
+    {
+        for (int c{0}; c < set.size; ++c) values.push_back(set[c].value);
+        origins.push_back(set.originX);
+        origins.push_back(set.originY);
+    }
+
+    job.settings["lineTable"] = {{"startX", table.startX}, {"startY", table.startY},
+                                 {"setSpacing", table.setSpacing}, {"columns", names},
+                                 {"numSets", table.data.size()}};
+    job.add_block("lineTable", values);
+    job.add_block("lineOrigins", origins);
+}
+
+bool read_line_print_data(const JobFile &job, LinePrintData &table)
+{
+    const auto values = job.block<float>("lineTable");
+    if (!job.settings.contains("lineTable")) return false;
+    const json &info = job.settings["lineTable"];
+
+    std::vector<std::string> names;
+    size_t numSets {};
+    try
+    {
+        names = info.at("columns").get<std::vector<std::string>>();
+        numSets = info.at("numSets").get<size_t>();
+    }
+    catch (const json::exception &)
+    {
+        return false;
+    }
+    if (values.size != numSets * names.size()) return false;
+
+    const auto origins = job.block<float>("lineOrigins");
+    const bool hasOrigins = origins.size == 2 * numSets;
+
+    std::vector<LineSet> sets(numSets);
+    for (size_t s{0}; s < numSets; ++s)
+    {
+        if (hasOrigins)
+        {
+            sets[s].originX = origins[2 * s];
+            sets[s].originY = origins[2 * s + 1];
+        }
+        for (size_t n{0}; n < names.size(); ++n)
+        {
+            for (int c{0}; c < sets[s].size; ++c)
+            {
+                if (sets[s][c].typeName == names[n]) sets[s][c].value = values[s * names.size() + n];
+            }
+        }
+    }
+
+    table.data = std::move(sets);
+    table.startX = info.value("startX", table.startX);
+    table.startY = info.value("startY", table.startY);
+    table.setSpacing = info.value("setSpacing", table.setSpacing);
+    table.invalidate_geometry();
+    return true;
+}
+
+void write_bitmap(JobFile &job, const std::string &name, const Bitmap &bitmap)
+{
+    job.settings[name] = {{"width", bitmap.width}, {"height", bitmap.height}};
+    job.add_block(name, bitmap.data(), (size_t)bitmap.width * bitmap.height);
+}
+
+bool read_bitmap(const JobFile &job, const std::string &name, Bitmap &bitmap)
+{
+    if (!job.settings.contains(name)) return false;
+    const int width = job.settings[name].value("width", 0);
+    const int height = job.settings[name].value("height", 0);
+    const auto pixels = job.block<uint8_t>(name);
+    if (width < 0 || height < 0 || pixels.size != (size_t)width * height) return false;
+
+    // the pixels stay in the job file, so opening a big bitmap doesn't read it
+    bitmap.width = width;
+    bitmap.height = height;
+    bitmap.pixels.clear();
+    bitmap.external = pixels.data;
+    bitmap.owner = pixels.owner;
+    return true;
+}
+
+void write_layer_map(JobFile &job, const std::string &name, const LayerMap &layer)
+{
+    std::vector<uint32_t> spansInRow(layer.height());
+    std::vector<int32_t> spans;
+    spans.reserve(2 * layer.number_of_spans());
+    for (int y{0}; y < layer.height(); ++y)
+    {
+        spansInRow[y] = (uint32_t)layer.row(y).size();
+        for (const auto &span : layer.row(y))
+        {
+            spans.push_back(span.begin);
+            spans.push_back(span.end);
+        }
+    }
+
+    job.settings[name] = {{"width", layer.width()}, {"height", layer.height()}};
+    job.add_block(name + ".rows", spansInRow);
+    job.add_block(name + ".spans", spans);
+}
+
+bool read_layer_map(const JobFile &job, const std::string &name, LayerMap &layer)
+{
+    if (!job.settings.contains(name)) return false;
+    const int width = job.settings[name].value("width", 0);
+    const int height = job.settings[name].value("height", 0);
+    const auto spansInRow = job.block<uint32_t>(name + ".rows");
+    const auto spans = job.block<int32_t>(name + ".spans");
+    if (width < 0 || height < 0 || spansInRow.size != (size_t)height) return false;
+
+    size_t total {0};
+    for (auto n : spansInRow) total += n;
+    if (2 * total != spans.size) return false;
+
+    LayerMap loaded(width, height);
+    const int32_t *span = spans.begin();
+    for (int y{0}; y < height; ++y)
+    {
+        for (uint32_t i{0}; i < spansInRow[y]; ++i, span += 2)
+        {
+            loaded.set_span(y, span[0], span[1]);
+        }
+    }
+    layer = std::move(loaded);
+    return true;
+}
+
+void write_pvt_points(JobFile &job, const std::string &name, const std::vector<Trajectory::PVTPoint> &points)
+{
+    // position, velocity and time of each point
+    std::vector<double> values;
+    values.reserve(3 * points.size());
+    for (const auto &point : points)
+    {
+        values.push_back(point.relativePosition_mm);
+        values.push_back(point.velocity_mm_s);
+        values.push_back(point.time_samples);
+    }
+    job.add_block(name, values);
+}
+
+bool read_pvt_points(const JobFile &job, const std::string &name, std::vector<Trajectory::PVTPoint> &points)
+{
+    const auto values = job.block<double>(name);
+    if (!job.has_block(name) || values.size % 3 != 0) return false;
+
+    points.clear();
+    points.reserve(values.size / 3);
+    for (size_t i{0}; i < values.size; i += 3)
+    {
+        points.push_back({values[i], values[i + 1], (int)values[i + 2]});
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,283 @@
+#include "jobqueue.h"
+#include "printerwidget.h"
+#include "printhread.h"
+
+#include <QStringList>
+
+#include <algorithm>
+
+namespace
+{
+bool is_finished(QueuedJob::State state)
+{
+    return state == QueuedJob::State::Completed
+            || state == QueuedJob::State::Failed
+            || state == QueuedJob::State::Skipped;
+}
+
+// e.g. "42.0 s", "12 min 5 s" or "1 h 12 min"
+QString duration_string(double seconds)
+{
+    if (seconds < 60) return QString("%1 s").arg(seconds, 0, 'f', 1);
+    const qint64 s = (qint64)seconds;
+    if (s < 3600) return QString("%1 min %2 s").arg(s / 60).arg(s % 60);
+    return QString("%1 h %2 min").arg(s / 3600).arg((s % 3600) / 60);
+}
+}
+
+QString state_name(QueuedJob::State state)
+{
+    switch (state)
+    {
+    case QueuedJob::State::Waiting:   return "Waiting";
+    case QueuedJob::State::Running:   return "Running";
+    case QueuedJob::State::Completed: return "Completed";
+    case QueuedJob::State::Failed:    return "Failed";
+    case QueuedJob::State::Skipped:   return "Skipped";
+    }
+    return {};
+}
+
+JobQueue::JobQueue(PrintThread *printThread, QObject *parent) :
+    QObject(parent)
+{
+    connect(printThread, &PrintThread::stopped, this, &JobQueue::when_stream_stopped);
+}
+
+void JobQueue::add_runner(PrinterWidget *widget)
+{
+    runners_.push_back(widget);
+    // queued, so a job that finishes (or fails) inside run_job() doesn't
+    // start the next one before run_next() has returned
+    connect(widget, &PrinterWidget::job_finished, this, [this, widget](bool completed, QString result) {
+        when_job_finished(widget, completed, result);
+    }, Qt::QueuedConnection);
+}
+
+int JobQueue::add(const QString &name, JobFile &&job, int priority, const std::vector<int> &dependsOn)
+{
+    const int id = nextId_;
+    if (!dependencies_valid(id, dependsOn)) return -1;
+    nextId_++;
+
+    QueuedJob queued;
+    queued.id = id;
+    queued.name = name;
+    queued.job = std::make_shared<const JobFile>(std::move(job));
+    queued.priority = priority;
+    queued.dependsOn = dependsOn;
+    jobs_.push_back(queued);
+
+    skip_blocked_jobs();
+    emit changed();
+    return id;
+}
+
+bool JobQueue::remove(int id)
+{
+    if (id == runningId_) return false;
+    auto it = std::find_if(jobs_.begin(), jobs_.end(), [id](const QueuedJob &j) { return j.id == id; });
+    if (it == jobs_.end()) return false;
+    jobs_.erase(it);
+
+    // nothing waits for a job that isn't there
+    for (auto &job : jobs_)
+    {
+        job.dependsOn.erase(std::remove(job.dependsOn.begin(), job.dependsOn.end(), id), job.dependsOn.end());
+    }
+    emit changed();
+    return true;
+}
+
+void JobQueue::clear_finished()
+{
+    std::vector<int> finished;
+    for (const auto &job : jobs_)
+    {
+        if (is_finished(job.state)) finished.push_back(job.id);
+    }
+    for (const int id : finished) remove(id);
+}
+
+bool JobQueue::set_priority(int id, int priority)
+{
+    QueuedJob *job = find(id);
+    if (!job || job->state != QueuedJob::State::Waiting) return false;
+    job->priority = priority;
+    emit changed();
+    return true;
+}
+
+bool JobQueue::set_dependencies(int id, const std::vector<int> &dependsOn)
+{
+    QueuedJob *job = find(id);
+    if (!job || job->state != QueuedJob::State::Waiting || !dependencies_valid(id, dependsOn)) return false;
+    job->dependsOn = dependsOn;
+    skip_blocked_jobs();
+    emit changed();
+    return true;
+}
+
+const QueuedJob *JobQueue::find(int id) const
+{
+    auto it = std::find_if(jobs_.begin(), jobs_.end(), [id](const QueuedJob &j) { return j.id == id; });
+    return it == jobs_.end() ? nullptr : &*it;
+}
+
+QueuedJob *JobQueue::find(int id)
+{
+    return const_cast<QueuedJob*>(static_cast<const JobQueue*>(this)->find(id));
+}
+
+bool JobQueue::dependencies_valid(int id, const std::vector<int> &dependsOn) const
+{
+    // only on earlier jobs, so there can't be a cycle
+    return std::all_of(dependsOn.begin(), dependsOn.end(), [this, id](int dependency) {
+        return dependency < id && find(dependency) != nullptr;
+    });
+}
+
+void JobQueue::skip_blocked_jobs()
+{
+    // jobs are in the order they were queued and only depend on earlier
+    // ones, so one pass also catches jobs skipped because of a skipped job
+    for (auto &job : jobs_)
+    {
+        if (job.state != QueuedJob::State::Waiting) continue;
+        for (const int dependency : job.dependsOn)
+        {
+            const QueuedJob *other = find(dependency);
+            if (other && (other->state == QueuedJob::State::Failed || other->state == QueuedJob::State::Skipped))
+            {
+                job.state = QueuedJob::State::Skipped;
+                job.result = QString("Job %1 was %2").arg(dependency).arg(state_name(other->state).toLower());
+                emit print_to_output_window(QString("Skipping job %1 (%2): %3").arg(job.id).arg(job.name, job.result));
+                break;
+            }
+        }
+    }
+}
+
+QueuedJob *JobQueue::next_job()
+{
+    QueuedJob *next {nullptr};
+    for (auto &job : jobs_)
+    {
+        if (job.state != QueuedJob::State::Waiting) continue;
+        const bool ready = std::all_of(job.dependsOn.begin(), job.dependsOn.end(), [this](int dependency) {
+            const QueuedJob *other = find(dependency);
+            return !other || other->state == QueuedJob::State::Completed;
+        });
+        // the earlier job wins a tie
+        if (ready && (!next || job.priority > next->priority)) next = &job;
+    }
+    return next;
+}
+
+void JobQueue::start()
+{
+    if (running_) return;
+
+    running_ = true;
+    queueTimer_.start();
+    emit started();
+    // resumed before the job it was paused during finished
+    if (runningId_ < 0) run_next();
+}
+
+void JobQueue::pause()
+{
+    if (!running_) return;
+    running_ = false;
+    emit print_to_output_window(runningId_ >= 0 ? "The job queue pauses after the running job"
+                                                : "The job queue is paused");
+    emit paused();
+}
+
+void JobQueue::run_next()
+{
+    if (!running_) return;
+
+    QueuedJob *job = next_job();
+    if (!job)
+    {
+        running_ = false;
+        emit print_to_output_window("Job queue finished: " + summary());
+        emit finished();
+        return;
+    }
+
+    job->state = QueuedJob::State::Running;
+    job->started = QDateTime::currentDateTime();
+    runningId_ = job->id;
+    jobTimer_.start();
+    emit print_to_output_window(QString("Starting job %1 (%2)").arg(job->id).arg(job->name));
+    emit changed();
+
+    const std::shared_ptr<const JobFile> file = job->job;
+    for (PrinterWidget *widget : runners_)
+    {
+        if (widget->run_job(*file))
+        {
+            runningWidget_ = widget;
+            return;
+        }
+    }
+    end_running_job(QueuedJob::State::Failed, "No tab runs " + QString::fromStdString(file->type) + " jobs");
+}
+
+void JobQueue::when_job_finished(PrinterWidget *widget, bool completed, const QString &result)
+{
+    // e.g. the widget finishing after the stream was stopped
+    if (runningId_ < 0 || widget != runningWidget_) return;
+    end_running_job(completed ? QueuedJob::State::Completed : QueuedJob::State::Failed, result);
+}
+
+void JobQueue::when_stream_stopped()
+{
+    if (runningId_ < 0) return;
+    running_ = false;
+    end_running_job(QueuedJob::State::Failed, "Stopped");
+    emit print_to_output_window("The job queue is paused");
+    emit paused();
+}
+
+void JobQueue::end_running_job(QueuedJob::State state, const QString &result)
+{
+    QueuedJob *job = find(runningId_);
+    runningId_ = -1;
+    runningWidget_ = nullptr;
+    if (job)
+    {
+        job->state = state;
+        job->elapsed_s = jobTimer_.elapsed() / 1000.0;
+        job->result = result;
+        emit print_to_output_window(QString("Job %1 (%2) %3 in %4%5")
+                                    .arg(job->id).arg(job->name)
+                                    .arg(state_name(state).toLower())
+                                    .arg(duration_string(job->elapsed_s))
+                                    .arg(result.isEmpty() ? QString() : ": " + result));
+    }
+
+    skip_blocked_jobs();
+    emit changed();
+    if (running_) run_next();
+}
+
+QString JobQueue::summary() const
+{
+    QStringList counts;
+    for (const auto state : {QueuedJob::State::Completed, QueuedJob::State::Failed, QueuedJob::State::Skipped,
+                             QueuedJob::State::Running, QueuedJob::State::Waiting})
+    {
+        const auto count = std::count_if(jobs_.begin(), jobs_.end(), [state](const QueuedJob &j) { return j.state == state; });
+        if (count > 0) counts << QString("%1 %2").arg(count).arg(state_name(state).toLower());
+    }
+    if (counts.isEmpty()) return "No jobs";
+
+    QString text = counts.join(", ");
+    if (queueTimer_.isValid()) text += " in " + duration_string(queueTimer_.elapsed() / 1000.0);
+    return text;
+}
+
+#include "moc_jobqueue.cpp"
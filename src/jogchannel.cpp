@@ -0,0 +1,213 @@
+#include "jogchannel.h"
+#include "gclib_errors.h"
+
+#include <QDebug>
+#include <cmath>
+
+namespace
+{
+// how often the velocity is sent to the controller
+constexpr unsigned long UPDATE_PERIOD_MS {20};
+// jogging stops this long after the last update
+constexpr qint64 WATCHDOG_MS {300};
+// thread #LJOGWD runs in on the controller
+constexpr int WATCHDOG_THREAD {7};
+}
+
+JogChannel::JogChannel(QObject *parent) :
+    QThread(parent)
+{
+    // same ramps the jog buttons have always used
+    axes_[Axis::X].acceleration_mm_s2 = 800;
+    axes_[Axis::Y].acceleration_mm_s2 = 300;
+}
+
+JogChannel::~JogChannel()
+{
+    stop();
+    wait();
+}
+
+void JogChannel::connect_to_controller(std::string_view IPAddress)
+{
+    quit_ = false;
+
+    std::string address = IPAddress.data();
+    if (GOpen(address.c_str(), &g_) != G_NO_ERROR)
+    {
+        g_ = nullptr;
+        emit error("Could not open a connection for jogging");
+        return;
+    }
+
+    start();
+}
+
+void JogChannel::stop()
+{
+    const QMutexLocker locker(&mutex_);
+    quit_ = true;
+    waitCondition_.wakeOne();
+}
+
+void JogChannel::set_velocity(Axis axis, double velocity_mm_s)
+{
+    const QMutexLocker locker(&mutex_);
+    auto jog = axes_.find(axis);
+    if (jog == axes_.end()) return;
+
+    jog->second.target_mm_s = velocity_mm_s;
+    sinceKeepAlive_.restart();
+    waitCondition_.wakeOne(); // don't wait for the next update
+}
+
+void JogChannel::stop_jogging()
+{
+    const QMutexLocker locker(&mutex_);
+    for (auto &axis : axes_) axis.second.target_mm_s = 0;
+    waitCondition_.wakeOne();
+}
+
+void JogChannel::keep_alive()
+{
+    const QMutexLocker locker(&mutex_);
+    sinceKeepAlive_.restart();
+}
+
+bool JogChannel::command(const std::string &command)
+{
+    return GCmd(g_, command.c_str()) == G_NO_ERROR;
+}
+
+bool JogChannel::is_moving(Axis axis)
+{
+    const std::string command = "MG _BG" + CMD::detail::axis_string(axis);
+    int moving {};
+    return GCmdI(g_, command.c_str(), &moving) == G_NO_ERROR && moving != 0;
+}
+
+void JogChannel::update_axis(Axis axis, AxisJog &jog)
+{
+    const std::string name = CMD::detail::axis_string(axis);
+    const double cntsPerMM = CMD::detail::counts_per_mm(axis);
+    const std::string velocity = std::to_string(std::lround(jog.target_mm_s * cntsPerMM));
+
+    if (jog.target_mm_s == 0)
+    {
+        if (jog.jogging) command("ST" + name);
+        jog.jogging = false;
+        jog.sent_mm_s = 0;
+        return;
+    }
+
+    if (jog.jogging)
+    {
+        // a jog can change speed and direction while it is running
+        if (is_moving(axis))
+        {
+            if (jog.target_mm_s != jog.sent_mm_s) command("JG" + name + "=" + velocity);
+            jog.sent_mm_s = jog.target_mm_s;
+            return;
+        }
+
+        // stopped by something else (e.g. an ST or a limit switch), which is
+        // a failed jog. Starting it again would undo the stop
+        jog.jogging = false;
+        jog.sent_mm_s = 0;
+        return;
+    }
+
+    // take the axis over from whatever else was moving it
+    if (is_moving(axis))
+    {
+        command("ST" + name);
+        command("AM" + name);
+    }
+
+    const std::string acceleration = std::to_string(std::lround(jog.acceleration_mm_s2 * cntsPerMM));
+    jog.jogging = command("AC" + name + "=" + acceleration)
+            && command("DC" + name + "=" + acceleration)
+            && command("JG" + name + "=" + velocity)
+            && command("BG" + name);
+    jog.sent_mm_s = jog.target_mm_s;
+}
+
+void JogChannel::run()
+{
+    const std::string watchdogThread = std::to_string(WATCHDOG_THREAD);
+
+    while (true)
+    {
+        mutex_.lock();
+        if (!quit_) waitCondition_.wait(&mutex_, UPDATE_PERIOD_MS);
+        if (quit_)
+        {
+            for (auto &axis : axes_) axis.second.target_mm_s = 0;
+        }
+
+        bool watchdogTripped {false};
+        for (auto &axis : axes_)
+        {
+            if (axis.second.target_mm_s != 0 && sinceKeepAlive_.elapsed() > WATCHDOG_MS)
+            {
+                axis.second.target_mm_s = 0;
+                watchdogTripped = true;
+            }
+        }
+        std::map<Axis, AxisJog> axes = axes_;
+        const bool quit = quit_;
+        mutex_.unlock();
+
+        if (watchdogTripped) emit watchdog_stopped();
+
+        bool anyJogging {false};
+        std::map<Axis, double> failed;
+        for (auto &axis : axes)
+        {
+            AxisJog &jog = axis.second;
+            const double target_mm_s = jog.target_mm_s;
+            update_axis(axis.first, jog);
+            if (target_mm_s != 0 && !jog.jogging)
+            {
+                failed[axis.first] = target_mm_s;
+                emit error(QString::fromStdString("Could not jog the " + CMD::detail::axis_string(axis.first) + "-axis"));
+            }
+            anyJogging |= jog.jogging;
+        }
+
+        // keep #LJOGWD from stopping the axes while this is still running
+        if (anyJogging)
+        {
+            command("lJogT=1");
+            if (!watchdogRunning_)
+                watchdogRunning_ = command("XQ #LJOGWD," + watchdogThread);
+        }
+        else if (watchdogRunning_)
+        {
+            command("HX" + watchdogThread);
+            watchdogRunning_ = false;
+        }
+
+        mutex_.lock();
+        for (const auto &axis : axes)
+        {
+            AxisJog &jog = axes_[axis.first];
+            jog.sent_mm_s = axis.second.sent_mm_s;
+            jog.jogging = axis.second.jogging;
+        }
+        // e.g. at a limit switch or after an ST, don't keep trying unless asked again
+        for (const auto &axis : failed)
+        {
+            if (axes_[axis.first].target_mm_s == axis.second) axes_[axis.first].target_mm_s = 0;
+        }
+        mutex_.unlock();
+
+        if (quit) break;
+    }
+
+    GClose(g_);
+    g_ = nullptr;
+    qDebug() << "jog channel closed";
+}
+
+#include "moc_jogchannel.cpp"
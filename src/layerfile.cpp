@@ -0,0 +1,208 @@
+#include "layerfile.h"
+
+#include <cstring>
+#include <bitset>
+
+namespace
+{
+constexpr char FILE_MAGIC[4] {'B', 'J', 'L', '1'};
+constexpr char FOOTER_MAGIC[4] {'B', 'J', 'L', 'E'};
+constexpr uint32_t FILE_VERSION {1};
+
+// the controller PC and anything that would read these files is little
+// endian, so values are written as they are in memory
+template <typename T>
+void write_value(std::ostream &out, const T &value)
+{ out.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+template <typename T>
+bool read_value(std::istream &in, T &value)
+{ return (bool)in.read(reinterpret_cast<char *>(&value), sizeof(T)); }
+}
+
+DropletLayer::DropletLayer(int width, int height) :
+    width_(width),
+    height_(height),
+    rowBytes_((width + 7) / 8),
+    bits_((size_t)rowBytes_ * height, 0)
+{
+
+}
+
+void DropletLayer::set_span(int y, int first, int last)
+{
+    uint8_t *r = row(y);
+    for (int x{first}; x <= last; ++x)
+    {
+        // whole bytes at a time when the span covers them
+        if ((x & 7) == 0 && x + 7 <= last)
+        {
+            r[x >> 3] = 0xFF;
+            x += 7;
+        }
+        else
+        {
+            r[x >> 3] |= (uint8_t)(1 << (x & 7));
+        }
+    }
+}
+
+bool DropletLayer::row_is_empty(int y) const
+{
+    const uint8_t *r = row(y);
+    for (int i{0}; i < rowBytes_; ++i)
+    {
+        if (r[i]) return false;
+    }
+    return true;
+}
+
+size_t DropletLayer::count() const
+{
+    size_t n {0};
+    for (const uint8_t byte : bits_)
+    {
+        n += std::bitset<8>(byte).count();
+    }
+    return n;
+}
+
+Bitmap DropletLayer::to_bitmap() const
+{
+    Bitmap bitmap;
+    bitmap.width = width_;
+    bitmap.height = height_;
+    bitmap.pixels.resize((size_t)width_ * height_);
+    for (int y{0}; y < height_; ++y)
+    {
+        for (int x{0}; x < width_; ++x)
+        {
+            bitmap.pixels[(size_t)y * width_ + x] = at(x, y) ? 1 : 0;
+        }
+    }
+    return bitmap;
+}
+
+bool LayerFileWriter::open(const std::string &fileName, const LayerFileHeader &header)
+{
+    file_.open(fileName, std::ios::binary | std::ios::trunc);
+    if (!file_) return false;
+
+    header_ = header;
+    offsets_.clear();
+    offsets_.reserve(header.layerCount);
+
+    file_.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    write_value(file_, FILE_VERSION);
+    write_value(file_, header.width);
+    write_value(file_, header.height);
+    write_value(file_, header.layerCount);
+    write_value(file_, header.dropletSpacing_um);
+    write_value(file_, header.lineSpacing_um);
+    write_value(file_, header.layerHeight_um);
+    write_value(file_, header.originX_mm);
+    write_value(file_, header.originY_mm);
+    return (bool)file_;
+}
+
+bool LayerFileWriter::write_layer(const DropletLayer &layer)
+{
+    if (!file_ || offsets_.size() >= header_.layerCount) return false;
+    if (layer.width() != (int)header_.width || layer.height() != (int)header_.height) return false;
+
+    // only store the rows that have droplets in them
+    uint32_t firstRow {0};
+    uint32_t endRow {(uint32_t)layer.height()};
+    while (firstRow < endRow && layer.row_is_empty(firstRow)) ++firstRow;
+    while (endRow > firstRow && layer.row_is_empty(endRow - 1)) --endRow;
+    const uint32_t rowCount {endRow - firstRow};
+
+    offsets_.push_back((uint64_t)file_.tellp());
+    write_value(file_, firstRow);
+    write_value(file_, rowCount);
+    if (rowCount > 0)
+    {
+        file_.write(reinterpret_cast<const char *>(layer.row(firstRow)),
+                    (std::streamsize)rowCount * layer.row_bytes());
+    }
+    return (bool)file_;
+}
+
+bool LayerFileWriter::close()
+{
+    if (!file_.is_open()) return false;
+
+    const uint64_t indexOffset = (uint64_t)file_.tellp();
+    for (const uint64_t offset : offsets_)
+    {
+        write_value(file_, offset);
+    }
+    write_value(file_, indexOffset);
+    file_.write(FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+
+    const bool ok = (bool)file_ && offsets_.size() == header_.layerCount;
+    file_.close();
+    return ok;
+}
+
+bool LayerFileReader::open(const std::string &fileName)
+{
+    offsets_.clear();
+    file_.open(fileName, std::ios::binary);
+    if (!file_) return false;
+
+    char magic[4] {};
+    uint32_t version {};
+    file_.read(magic, sizeof(magic));
+    if (!file_ || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0) return false;
+    if (!read_value(file_, version) || version != FILE_VERSION) return false;
+
+    bool ok = read_value(file_, header_.width)
+            && read_value(file_, header_.height)
+            && read_value(file_, header_.layerCount)
+            && read_value(file_, header_.dropletSpacing_um)
+            && read_value(file_, header_.lineSpacing_um)
+            && read_value(file_, header_.layerHeight_um)
+            && read_value(file_, header_.originX_mm)
+            && read_value(file_, header_.originY_mm);
+    if (!ok) return false;
+
+    // footer has the offset of the layer index
+    uint64_t indexOffset {};
+    file_.seekg(-(std::streamoff)(sizeof(uint64_t) + sizeof(FOOTER_MAGIC)), std::ios::end);
+    if (!read_value(file_, indexOffset)) return false;
+    file_.read(magic, sizeof(magic));
+    if (!file_ || std::memcmp(magic, FOOTER_MAGIC, sizeof(magic)) != 0) return false;
+
+    file_.seekg((std::streamoff)indexOffset);
+    offsets_.resize(header_.layerCount);
+    for (auto &offset : offsets_)
+    {
+        if (!read_value(file_, offset))
+        {
+            offsets_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+DropletLayer LayerFileReader::read_layer(int layer)
+{
+    if (layer < 0 || layer >= (int)offsets_.size()) return {};
+
+    file_.clear();
+    file_.seekg((std::streamoff)offsets_[layer]);
+    uint32_t firstRow {}, rowCount {};
+    if (!read_value(file_, firstRow) || !read_value(file_, rowCount)) return {};
+    if (firstRow + rowCount > header_.height) return {};
+
+    DropletLayer result(header_.width, header_.height);
+    if (rowCount > 0)
+    {
+        file_.read(reinterpret_cast<char *>(result.row(firstRow)),
+                   (std::streamsize)rowCount * result.row_bytes());
+        if (!file_) return {};
+    }
+    return result;
+}
@@ -0,0 +1,292 @@
+#include "layermap.h"
+
+#include <algorithm>
+#include <limits>
+
+LayerMap::LayerMap(int width, int height) :
+    width_(width),
+    height_(height),
+    rows_(height)
+{
+
+}
+
+LayerMap::LayerMap(const DropletLayer &layer) :
+    LayerMap(layer.width(), layer.height())
+{
+    for (int y{0}; y < height_; ++y)
+    {
+        const uint8_t *bits = layer.row(y);
+        Row &row = rows_[y];
+        int x {0};
+        while (x < width_)
+        {
+            // skip empty bytes without looking at each bit
+            if ((x & 7) == 0 && bits[x >> 3] == 0) { x += 8; continue; }
+            if (!((bits[x >> 3] >> (x & 7)) & 1)) { ++x; continue; }
+
+            int end = x + 1;
+            while (end < width_)
+            {
+                if ((end & 7) == 0 && bits[end >> 3] == 0xFF) { end += 8; continue; }
+                if (!((bits[end >> 3] >> (end & 7)) & 1)) break;
+                ++end;
+            }
+            end = std::min(end, width_);
+            row.push_back({x, end});
+            x = end;
+        }
+    }
+}
+
+LayerMap::LayerMap(const Bitmap &bitmap) :
+    LayerMap(bitmap.width, bitmap.height)
+{
+    for (int y{0}; y < height_; ++y)
+    {
+        for (const auto &run : runs_in_row(bitmap, y))
+        {
+            rows_[y].push_back({run.first, run.last + 1});
+        }
+    }
+}
+
+LayerMap::LayerMap(const LayerMap &other) :
+    width_(other.width_),
+    height_(other.height_),
+    rows_(other.rows_)
+{
+
+}
+
+LayerMap &LayerMap::operator=(const LayerMap &other)
+{
+    if (this != &other)
+    {
+        width_ = other.width_;
+        height_ = other.height_;
+        rows_ = other.rows_;
+        invalidate_cache();
+    }
+    return *this;
+}
+
+LayerMap::Row LayerMap::merge(const Row &a, const Row &b, bool keepA, bool keepB, bool keepBoth)
+{
+    // walk the span edges of both rows in order, tracking whether each row
+    // is inside a span, and keep the parts where the combination is wanted
+    constexpr int32_t none = std::numeric_limits<int32_t>::max();
+    auto edge = [](const Row &row, size_t i) -> int32_t
+    {
+        if (i >= 2 * row.size()) return none;
+        return (i % 2 == 0) ? row[i / 2].begin : row[i / 2].end;
+    };
+
+    Row result;
+    size_t i {0}, j {0};
+    bool inA {false}, inB {false}, open {false};
+    int32_t start {0};
+    while (true)
+    {
+        const int32_t x = std::min(edge(a, i), edge(b, j));
+        if (x == none) break;
+        while (edge(a, i) == x) { inA = !inA; ++i; }
+        while (edge(b, j) == x) { inB = !inB; ++j; }
+
+        const bool inside = (inA && !inB && keepA) || (!inA && inB && keepB) || (inA && inB && keepBoth);
+        if (inside && !open)
+        {
+            start = x;
+            open = true;
+        }
+        else if (!inside && open)
+        {
+            result.push_back({start, x});
+            open = false;
+        }
+    }
+    return result;
+}
+
+void LayerMap::set_span(int y, int begin, int end)
+{
+    begin = std::max(begin, 0);
+    end = std::min(end, width_);
+    if (y < 0 || y >= height_ || begin >= end) return;
+    rows_[y] = merge(rows_[y], {{begin, end}}, true, true, true);
+    invalidate_cache();
+}
+
+void LayerMap::clear_span(int y, int begin, int end)
+{
+    if (y < 0 || y >= height_ || begin >= end) return;
+    rows_[y] = merge(rows_[y], {{begin, end}}, true, false, false);
+    invalidate_cache();
+}
+
+size_t LayerMap::count() const
+{
+    size_t n {0};
+    for (const Row &row : rows_)
+    {
+        for (const Span &span : row) n += span.end - span.begin;
+    }
+    return n;
+}
+
+size_t LayerMap::number_of_spans() const
+{
+    size_t n {0};
+    for (const Row &row : rows_) n += row.size();
+    return n;
+}
+
+LayerMap &LayerMap::unite(const LayerMap &other)
+{
+    for (int y{0}; y < std::min(height_, other.height_); ++y)
+        rows_[y] = merge(rows_[y], other.rows_[y], true, true, true);
+    invalidate_cache();
+    return *this;
+}
+
+LayerMap &LayerMap::subtract(const LayerMap &other)
+{
+    for (int y{0}; y < std::min(height_, other.height_); ++y)
+        rows_[y] = merge(rows_[y], other.rows_[y], true, false, false);
+    invalidate_cache();
+    return *this;
+}
+
+LayerMap &LayerMap::intersect(const LayerMap &other)
+{
+    for (int y{0}; y < height_; ++y)
+    {
+        if (y < other.height_)
+            rows_[y] = merge(rows_[y], other.rows_[y], false, false, true);
+        else
+            rows_[y].clear();
+    }
+    invalidate_cache();
+    return *this;
+}
+
+LayerMap LayerMap::eroded(int droplets) const
+{
+    if (droplets <= 0) return *this;
+
+    // shrink every span in x first
+    std::vector<Row> shrunk(height_);
+    for (int y{0}; y < height_; ++y)
+    {
+        for (const Span &span : rows_[y])
+        {
+            if (span.end - span.begin > 2 * droplets)
+                shrunk[y].push_back({span.begin + droplets, span.end - droplets});
+        }
+    }
+
+    // then keep what is in all of the rows within reach in y
+    LayerMap result(width_, height_);
+    for (int y{droplets}; y < height_ - droplets; ++y)
+    {
+        Row row = shrunk[y];
+        for (int dy{-droplets}; dy <= droplets && !row.empty(); ++dy)
+        {
+            if (dy != 0) row = merge(row, shrunk[y + dy], false, false, true);
+        }
+        result.rows_[y] = std::move(row);
+    }
+    return result;
+}
+
+DropletLayer LayerMap::to_droplet_layer() const
+{
+    DropletLayer layer(width_, height_);
+    for (int y{0}; y < height_; ++y)
+    {
+        for (const Span &span : rows_[y]) layer.set_span(y, span.begin, span.end - 1);
+    }
+    return layer;
+}
+
+Bitmap LayerMap::to_bitmap() const
+{
+    Bitmap bitmap;
+    bitmap.width = width_;
+    bitmap.height = height_;
+    bitmap.pixels.assign((size_t)width_ * height_, 0);
+    for (int y{0}; y < height_; ++y)
+    {
+        for (const Span &span : rows_[y])
+        {
+            std::fill(bitmap.pixels.begin() + (size_t)y * width_ + span.begin,
+                      bitmap.pixels.begin() + (size_t)y * width_ + span.end, 1);
+        }
+    }
+    return bitmap;
+}
+
+size_t LayerMap::memory_bytes() const
+{
+    size_t bytes = rows_.capacity() * sizeof(Row);
+    for (const Row &row : rows_) bytes += row.capacity() * sizeof(Span);
+    bytes += tiles_.size() * (sizeof(Tile) + TILE_SIZE * TILE_SIZE / 8);
+    return bytes;
+}
+
+bool LayerMap::at(int x, int y) const
+{
+    if (x < 0 || x >= width_ || y < 0 || y >= height_) return false;
+
+    const Tile &t = tile(x / TILE_SIZE, y / TILE_SIZE);
+    const int tx = x % TILE_SIZE;
+    const int ty = y % TILE_SIZE;
+    return (t.bits[(size_t)ty * (TILE_SIZE / 8) + (tx >> 3)] >> (tx & 7)) & 1;
+}
+
+const LayerMap::Tile &LayerMap::tile(int tileX, int tileY) const
+{
+    const TileKey key = ((TileKey)tileY << 32) | (uint32_t)tileX;
+    auto found = tiles_.find(key);
+    if (found != tiles_.end())
+    {
+        // move to the front of the LRU list
+        lru_.splice(lru_.begin(), lru_, found->second.lruPosition);
+        return found->second;
+    }
+
+    if (tiles_.size() >= MAX_CACHED_TILES)
+    {
+        tiles_.erase(lru_.back());
+        lru_.pop_back();
+    }
+
+    // unpack the spans that cross the tile
+    Tile t;
+    t.bits.assign(TILE_SIZE * TILE_SIZE / 8, 0);
+    const int x0 = tileX * TILE_SIZE;
+    const int x1 = x0 + TILE_SIZE;
+    for (int ty{0}; ty < TILE_SIZE && tileY * TILE_SIZE + ty < height_; ++ty)
+    {
+        const Row &row = rows_[tileY * TILE_SIZE + ty];
+        auto span = std::lower_bound(row.begin(), row.end(), x0,
+                                     [](const Span &s, int x) { return s.end <= x; });
+        for (; span != row.end() && span->begin < x1; ++span)
+        {
+            const int first = std::max(span->begin, x0) - x0;
+            const int last = std::min(span->end, x1) - x0;
+            uint8_t *bits = t.bits.data() + (size_t)ty * (TILE_SIZE / 8);
+            for (int x{first}; x < last; ++x) bits[x >> 3] |= (uint8_t)(1 << (x & 7));
+        }
+    }
+
+    lru_.push_front(key);
+    t.lruPosition = lru_.begin();
+    return tiles_.emplace(key, std::move(t)).first->second;
+}
+
+void LayerMap::invalidate_cache() const
+{
+    tiles_.clear();
+    lru_.clear();
+}
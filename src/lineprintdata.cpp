@@ -30,6 +30,7 @@
 
 #include <cmath>
 #include "printer.h"
+#include "settlemodel.h"
 
 /**************************************************************************
  *                        CLASS  Table Data                               *
@@ -161,6 +162,8 @@ void LinePrintData::addRows(int numSets=1)
         for (int i=0; i<numSets; i++)
         {
             data.push_back(data.back());
+            data.back().originX = NAN; // new sets go after the last one
+            data.back().originY = NAN;
         }
     }
 
@@ -181,80 +184,133 @@ int LinePrintData::get_column_index_for(const TableData &column)
     return 0;
 }
 
-std::vector<QLineF> LinePrintData::qLines()
+void LinePrintData::invalidate_set(int set)
 {
+    if (set >= 0 && set < (int)geometry.size()) geometry[set].valid = false;
+}
+
+void LinePrintData::invalidate_geometry()
+{
+    for (auto &set : geometry) set.valid = false;
+}
+
+std::vector<QPointF> LinePrintData::set_origins()
+{
+    std::vector<QPointF> origins;
+    origins.reserve(data.size());
+
     float xpos = startX;
     float ypos = startY;
-    float yheight = PRINT_Y_SIZE_MM; // Height of printer
-    // Note: The coordinate system of vector graphics have the origin in the top left (Quad IV)
-    //       but the printer will have the origin in the bottom left corner (Quad I)
-    //       This will require that the y axis coordinate be subtracted by the height
-    //       to visualize in a vector graphic how coordinates will be represented on the printer.
-
-    std::vector<QLineF> returnVec;
     for (size_t s=0; s < data.size(); s++)
-    { // for each set of lines
-        // Confirm all of the data fields for the set are not empty
-        bool completeSet = true;
-        for (int c=0; c < data[s].size; c++)
-        { // for each value in a set
-            if (std::isnan(data[s][c].value))
-            {
-                completeSet = false; // mark the set as not complete if there is a NaN value
-            }
+    {
+        if (data[s].has_origin())
+        {
+            xpos = data[s].originX;
+            ypos = data[s].originY;
         }
+        origins.push_back(QPointF(xpos, ypos));
+        xpos += setSpacing + data[s].lineLength.value; // Move the X Spacing
+    }
+    return origins;
+}
 
-        if (completeSet) // only if there are no NaNs
+void LinePrintData::update_geometry()
+{
+    geometry.resize(data.size());
+
+    const std::vector<QPointF> origins = set_origins();
+    for (size_t s=0; s < data.size(); s++)
+    { // only sets that were edited or have moved are regenerated
+        SetGeometry &set = geometry[s];
+        if (!set.valid || set.origin != origins[s])
         {
-            for (int i=0; i < (int)data[s].numLines.value; i++) // for each line in the set
-            {
-                // Add a QLine object for the line
-                returnVec.push_back(QLineF(xpos, yheight - ypos, xpos + data[s].lineLength.value, yheight - ypos));
-                ypos += data[s].lineSpacing.value; // Move the Y position by the lineSpacing amount
-            }
+            generate_set_geometry((int)s, origins[s]);
         }
-        ypos = startY; // Reset the Y Spacing
-        xpos += setSpacing + data[s].lineLength.value; // Move the X Spacing
     }
-    return returnVec;
 }
 
-std::vector<QLineF> LinePrintData::qAccelerationLines()
+void LinePrintData::generate_set_geometry(int s, QPointF origin)
 {
-    float xpos = startX;
-    float ypos = startY;
+    const float xpos = origin.x();
+    float ypos = origin.y();
     float yheight = PRINT_Y_SIZE_MM; // Height of printer
     // Note: The coordinate system of vector graphics have the origin in the top left (Quad IV)
     //       but the printer will have the origin in the bottom left corner (Quad I)
     //       This will require that the y axis coordinate be subtracted by the height
     //       to visualize in a vector graphic how coordinates will be represented on the printer.
 
+    SetGeometry &set = geometry[s];
+    set.valid = true;
+    set.changed = true;
+    set.origin = origin;
+    set.lines.clear();
+    set.accelerationLines.clear();
+
+    // Confirm all of the data fields for the set are not empty
+    for (int c=0; c < data[s].size; c++)
+    {
+        if (std::isnan(data[s][c].value)) return; // no lines for a set with a NaN value
+    }
+
+    const int numLines = (int)data[s].numLines.value;
+    const float lineLength = data[s].lineLength.value;
+    // the same run-up the line is printed with
+    const double accelerationDistance = Settle::run_up_distance_mm(Axis::X, data[s].printVelocity.value, data[s].printAcceleration.value);
+    set.lines.reserve(numLines);
+    set.accelerationLines.reserve(2 * numLines);
+
+    for (int i=0; i < numLines; i++) // for each line in the set
+    {
+        const float y = yheight - ypos;
+        set.lines.push_back(QLineF(xpos, y, xpos + lineLength, y));
+        // lines for the accelerations before and after the line
+        set.accelerationLines.push_back(QLineF(xpos - accelerationDistance, y, xpos, y));
+        set.accelerationLines.push_back(QLineF(xpos + lineLength, y, xpos + lineLength + accelerationDistance, y));
+        ypos += data[s].lineSpacing.value; // Move the Y position by the lineSpacing amount
+    }
+}
+
+std::vector<int> LinePrintData::changed_sets()
+{
+    update_geometry();
+
+    std::vector<int> changed;
+    for (size_t s=0; s < geometry.size(); s++)
+    {
+        if (geometry[s].changed) changed.push_back((int)s);
+        geometry[s].changed = false;
+    }
+    return changed;
+}
+
+std::vector<QLineF> LinePrintData::qLines()
+{
+    update_geometry();
+
+    size_t numLines = 0;
+    for (const auto &set : geometry) numLines += set.lines.size();
+
     std::vector<QLineF> returnVec;
-    for (size_t s=0; s < data.size(); s++) // for each set of lines
+    returnVec.reserve(numLines);
+    for (const auto &set : geometry)
     {
-        double accelerationDistance = calculate_acceleration_distance(data[s].printVelocity.value, data[s].printAcceleration.value);
-        // Confirm all of the data fields for the set are not empty
-        bool completeSet = true;
-        for (int c=0; c < data[s].size; c++)
-        { // for each value in a set
-            if (std::isnan(data[s][c].value))
-            {
-                completeSet = false; // mark the set as not complete if there is a NaN value
-            }
-        }
+        returnVec.insert(returnVec.end(), set.lines.begin(), set.lines.end());
+    }
+    return returnVec;
+}
 
-        if (completeSet) // only if there are no NaNs
-        {
-            for (int i=0; i < (int)data[s].numLines.value; i++) // for each line in the set
-            {
-                // Add a QLine object for the accelerations before and after the line
-                returnVec.push_back(QLineF(xpos - accelerationDistance, yheight - ypos, xpos, yheight - ypos));
-                returnVec.push_back(QLineF(xpos + data[s].lineLength.value, yheight - ypos, xpos + data[s].lineLength.value + accelerationDistance, yheight - ypos));
-                ypos += data[s].lineSpacing.value; // Move the Y position by the lineSpacing amount
-            }
-        }
-        ypos = startY; // Reset the Y Spacing
-        xpos += setSpacing + data[s].lineLength.value; // Move the X Spacing
+std::vector<QLineF> LinePrintData::qAccelerationLines()
+{
+    update_geometry();
+
+    size_t numLines = 0;
+    for (const auto &set : geometry) numLines += set.accelerationLines.size();
+
+    std::vector<QLineF> returnVec;
+    returnVec.reserve(numLines);
+    for (const auto &set : geometry)
+    {
+        returnVec.insert(returnVec.end(), set.accelerationLines.begin(), set.accelerationLines.end());
     }
     return returnVec;
 }
@@ -13,7 +13,9 @@
 
 #include <QMessageBox>
 #include <QProgressDialog>
+#include <QFileDialog>
 #include <QDebug>
+#include <QTimer>
 
 #include "gclib.h"
 #include "gclibo.h"
@@ -34,11 +36,17 @@
 #include "dropletobservationwidget.h"
 #include "bedmicroscopewidget.h"
 #include "mjprintheadwidget.h"
+#include "contourprintwidget.h"
+#include "rasterprintwidget.h"
+#include "buildwidget.h"
+#include "servotuningwidget.h"
+#include "jobqueuewidget.h"
 
 #include "pcd.h"
 #include "ginterrupthandler.h"
 #include "dmc4080.h"
 #include "mister.h"
+#include "jobfile.h"
 
 MainWindow::MainWindow(Printer *printer_, QMainWindow *parent) :
     QMainWindow(parent),
@@ -54,14 +62,31 @@ MainWindow::MainWindow(Printer *printer_, QMainWindow *parent) :
     dropletObservationWidget = new DropletObservationWidget(printer);
     bedMicroscopeWidget      = new BedMicroscopeWidget(printer);
     mjPrintheadWidget        = new MJPrintheadWidget(printer);
+    contourPrintWidget       = new ContourPrintWidget(printer);
+    rasterPrintWidget        = new RasterPrintWidget(printer);
+    buildWidget              = new BuildWidget(printer);
+    servoTuningWidget        = new ServoTuningWidget(printer);
+    jobQueueWidget           = new JobQueueWidget(printer);
 
     // add widgets to tabs on the top bar (tab widget now owns)
     ui->tabWidget->addTab(powderSetupWidget, "Powder Setup");
     ui->tabWidget->addTab(linePrintingWidget, "Line Printing");
     ui->tabWidget->addTab(highSpeedLineWidget, "High-Speed Line Printing");
+    ui->tabWidget->addTab(contourPrintWidget, "Contour Printing");
+    ui->tabWidget->addTab(rasterPrintWidget, "Raster Printing");
+    ui->tabWidget->addTab(buildWidget, "Build");
     ui->tabWidget->addTab(dropletObservationWidget, "Jetting");
     ui->tabWidget->addTab(bedMicroscopeWidget, "Bed Imaging");
     ui->tabWidget->addTab(mjPrintheadWidget, "MJ Printhead");
+    ui->tabWidget->addTab(servoTuningWidget, "Servo Tuning");
+    ui->tabWidget->addTab(jobQueueWidget, "Job Queue");
+
+    // queued jobs go to the first tab that runs them, like opened ones
+    for (int i{0}; i < ui->tabWidget->count(); ++i)
+    {
+        auto widget = qobject_cast<PrinterWidget*>(ui->tabWidget->widget(i));
+        if (widget && widget != jobQueueWidget) jobQueueWidget->add_runner(widget);
+    }
 
     // set fill background for all tab widgets
     for (int i{0}; i < ui->tabWidget->count(); ++i)
@@ -130,6 +155,10 @@ void MainWindow::setup()
 
     // connect the output from the printer thread to the output window widget
     connect(printer->mcu->printerThread, &PrintThread::response, outputWindow, &OutputWindow::print_string);
+    qRegisterMetaType<std::string>("std::string"); // queued from the print thread
+    connect(printer->mcu->printerThread, &PrintThread::error, outputWindow, [this](const std::string &text) {
+        outputWindow->print_string(QString::fromStdString(text));
+    });
     connect(printer->mcu->printerThread, &PrintThread::ended, this, &MainWindow::thread_ended);
     connect(printer->mcu->printerThread, &PrintThread::connected_to_controller, this, &MainWindow::connected_to_motion_controller);
 
@@ -159,6 +188,22 @@ void MainWindow::setup()
     connect(ui->yUpButton, &QAbstractButton::released, this, &MainWindow::jog_released);
     connect(ui->yDownButton, &QAbstractButton::released, this, &MainWindow::jog_released);
 
+    connect(ui->xVelocity, qOverload<double>(&QDoubleSpinBox::valueChanged), this, &MainWindow::update_jog_velocity);
+    connect(ui->yVelocity, qOverload<double>(&QDoubleSpinBox::valueChanged), this, &MainWindow::update_jog_velocity);
+
+    // the jog channel stops jogging if it isn't told to keep going
+    jogKeepAliveTimer = new QTimer(this);
+    jogKeepAliveTimer->setInterval(100);
+    connect(jogKeepAliveTimer, &QTimer::timeout, printer->mcu->jogChannel, &JogChannel::keep_alive);
+    connect(printer->mcu->jogChannel, &JogChannel::error, this, &MainWindow::print_to_output_window);
+    connect(printer->mcu->jogChannel, &JogChannel::watchdog_stopped, this, [this]()
+    {
+        xJogDirection = 0;
+        yJogDirection = 0;
+        jogKeepAliveTimer->stop();
+        print_to_output_window("Jogging stopped, the jog buttons stopped responding");
+    });
+
     connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MainWindow::tab_was_changed);
 
     connect(ui->getXAxisPosition, &QAbstractButton::clicked, this, &MainWindow::get_current_x_axis_position);
@@ -181,6 +226,11 @@ void MainWindow::setup()
 
 
     connect(ui->actionShow_Hide_Droplet_Tool, &QAction::triggered, this, &MainWindow::show_hide_droplet_analyzer_window);
+    connect(ui->actionOpen_Job, &QAction::triggered, this, &MainWindow::open_job);
+    connect(ui->actionSave_Job, &QAction::triggered, this, &MainWindow::save_job);
+    connect(ui->actionAdd_Job_to_Queue, &QAction::triggered, this, &MainWindow::add_job_to_queue);
+    // input stays off between the jobs of the queue
+    connect(jobQueueWidget, &JobQueueWidget::queue_finished, this, [this]() {this->allow_user_input(true);});
 
     // connect response from jetDrive to output window
     connect(printer->jetDrive, &JetDrive::Controller::response, this, &MainWindow::print_to_output_window);
@@ -213,8 +263,9 @@ void MainWindow::on_connect_clicked()
     {
         //get connection settings / options from UI
         bool homeZAxis = ui->homeZAxisCheckBox->isChecked();
+        bool homeIfHomed = ui->homeIfHomedCheckBox->isChecked();
         allow_user_input(false);
-        printer->connect(homeZAxis);
+        printer->connect(homeZAxis, homeIfHomed);
     }
     else // if there is already a connection
     {
@@ -224,6 +275,7 @@ void MainWindow::on_connect_clicked()
         // change button label text
         ui->connect->setText("\nConnect and Home Printer\n");
         ui->homeZAxisCheckBox->setEnabled(true);
+        ui->homeIfHomedCheckBox->setEnabled(true);
     }
 }
 
@@ -257,67 +309,45 @@ void MainWindow::allow_user_input(bool allowed)
 
 void MainWindow::y_up_button_pressed()
 {    
-    std::stringstream s;
-
-    s << CMD::set_accleration(Axis::Y, 300);
-    s << CMD::set_deceleration(Axis::Y, 300);
-    s << CMD::set_jog(Axis::Y, -ui->yVelocity->value());
-    s << CMD::begin_motion(Axis::Y);
-
-    printer->mcu->printerThread->execute_command(s);
+    yJogDirection = -1;
+    update_jog_velocity();
 }
 
 void MainWindow::x_right_button_pressed()
 {
-    std::stringstream s;
-    Axis x {Axis::X};
-
-    s << CMD::set_accleration(x, 800);
-    s << CMD::set_deceleration(x, 800);
-    s << CMD::set_jog(x, ui->xVelocity->value());
-    s << CMD::begin_motion(x);
-
-    printer->mcu->printerThread->execute_command(s);
+    xJogDirection = 1;
+    update_jog_velocity();
 }
 
 void MainWindow::jog_released()
 {
-    std::stringstream s;
-    s << CMD::stop_motion(Axis::X);
-    s << CMD::stop_motion(Axis::Y);
-    s << CMD::stop_motion(Axis::Z);
-    s << CMD::motion_complete(Axis::X);
-    s << CMD::motion_complete(Axis::Y);
-    s << CMD::motion_complete(Axis::Z);
-
-    printer->mcu->printerThread->execute_command(s);
+    xJogDirection = 0;
+    yJogDirection = 0;
+    update_jog_velocity();
 }
 
 void MainWindow::y_down_button_pressed()
 {
-    std::stringstream s;
-    Axis y {Axis::Y};
-
-    s << CMD::set_accleration(y, 300);
-    s << CMD::set_deceleration(y, 300);
-    s << CMD::set_jog(y, ui->yVelocity->value());
-    s << CMD::begin_motion(y);
-
-    // send off to thread to send to printer
-    printer->mcu->printerThread->execute_command(s);
+    yJogDirection = 1;
+    update_jog_velocity();
 }
 
 void MainWindow::x_left_button_pressed()
 {
-    std::stringstream s;
-    Axis x {Axis::X};
+    xJogDirection = -1;
+    update_jog_velocity();
+}
 
-    s << CMD::set_accleration(x, 800);
-    s << CMD::set_deceleration(x, 800);
-    s << CMD::set_jog(x, -ui->xVelocity->value());
-    s << CMD::begin_motion(x);
+void MainWindow::update_jog_velocity()
+{
+    // jogs go on their own connection, so they don't wait for the print
+    // thread, and the speed follows the spin boxes while a button is held
+    JogChannel *jog = printer->mcu->jogChannel;
+    jog->set_velocity(Axis::X, xJogDirection * ui->xVelocity->value());
+    jog->set_velocity(Axis::Y, yJogDirection * ui->yVelocity->value());
 
-    printer->mcu->printerThread->execute_command(s);
+    if (xJogDirection != 0 || yJogDirection != 0) jogKeepAliveTimer->start();
+    else jogKeepAliveTimer->stop();
 }
 
 void MainWindow::on_xHome_clicked()
@@ -481,6 +511,61 @@ void MainWindow::show_hide_droplet_analyzer_window()
         dropletObservationWidget->hide_droplet_analyzer_widget();
 }
 
+void MainWindow::open_job()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Open Job", QDir::homePath(), "Print Jobs (*.bjob)");
+    if (fileName.isEmpty()) return;
+
+    JobFile job;
+    if (!job.load(fileName))
+    {
+        print_to_output_window(QString::fromStdString(job.error()));
+        return;
+    }
+
+    // the job goes to the first tab that knows how to run it
+    for (int i{0}; i < ui->tabWidget->count(); ++i)
+    {
+        auto widget = qobject_cast<PrinterWidget*>(ui->tabWidget->widget(i));
+        if (widget && widget->load_job(job))
+        {
+            ui->tabWidget->setCurrentIndex(i);
+            print_to_output_window("Opened " + QString::fromStdString(job.type) + " job " + fileName);
+            return;
+        }
+    }
+    print_to_output_window("No tab can open a " + QString::fromStdString(job.type) + " job");
+}
+
+void MainWindow::save_job()
+{
+    auto widget = qobject_cast<PrinterWidget*>(ui->tabWidget->currentWidget());
+    JobFile job;
+    if (!widget || !widget->save_job(job))
+    {
+        print_to_output_window("The current tab does not have a job to save");
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Job", QDir::homePath(), "Print Jobs (*.bjob)");
+    if (fileName.isEmpty()) return;
+
+    if (job.save(fileName)) print_to_output_window("Saved job to " + fileName);
+    else print_to_output_window(QString::fromStdString(job.error()));
+}
+
+void MainWindow::add_job_to_queue()
+{
+    auto widget = qobject_cast<PrinterWidget*>(ui->tabWidget->currentWidget());
+    JobFile job;
+    if (!widget || !widget->save_job(job))
+    {
+        print_to_output_window("The current tab does not have a job to queue");
+        return;
+    }
+    jobQueueWidget->add_job(ui->tabWidget->tabText(ui->tabWidget->currentIndex()), std::move(job));
+}
+
 void MainWindow::generate_printing_message_box(const std::string &message)
 {
     messageBox->setText(QString::fromStdString(message));
@@ -609,7 +694,7 @@ void MainWindow::connect_motion_controller_button_pressed()
 
 void MainWindow::thread_ended()
 {
-    allow_user_input(true);
+    allow_user_input(!jobQueueWidget->is_running());
 }
 
 // override the resize event of the main window
@@ -632,6 +717,7 @@ void MainWindow::connected_to_motion_controller()
 {
     ui->connect->setText("\nDisconnect Controller\n");
     ui->homeZAxisCheckBox->setEnabled(false);
+    ui->homeIfHomedCheckBox->setEnabled(false);
 }
 
 #include "moc_mainwindow.cpp"
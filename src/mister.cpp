@@ -11,7 +11,6 @@ Controller::Controller(const QString &portName, QObject *parent) :
 {
     name = "Mister";
     // connect timer for handling timeout errors
-    connect(serialPort, &QSerialPort::readyRead, this, &Controller::handle_ready_read);
     connect(timer, &QTimer::timeout, this, &Controller::handle_timeout);
     connect(serialPort, &QSerialPort::errorOccurred, this, &Controller::handle_serial_error);
 
@@ -23,45 +22,6 @@ Controller::~Controller()
     if (is_connected()) serialPort->close();
 }
 
-void Controller::handle_ready_read()
-{
-    auto inData = serialPort->readAll();
-    readData.append(inData);
-    QString responseString = QString(readData).simplified();
-
-    if (!inData.contains("\r")) {return;}
-    switch (initState)
-    {
-    case NOT_INITIALIZED:
-        if (responseString == initString)
-        {
-            readData.clear();
-            initState = INITIALIZED;
-            emit response(QString("Connected to %1").arg(name));
-            write_next();
-        }
-        else
-        {
-            emit error(QString("Unexpected response from device."
-                               " Expected %1 from device but got %2")
-                       .arg(initString)
-                       .arg(responseString));
-            disconnect_serial();
-        }
-        break;
-    case INITIALIZED:
-        // handle response from device here
-        // right now the response does nothing,
-        // just exists so we know the Arduino got the
-        // command and is ready for a new one
-        readData.clear();
-        write_next();
-        break;
-
-    default: break;
-    }
-}
-
 void Controller::handle_timeout()
 {
     timer->stop();
@@ -96,6 +56,7 @@ int Controller::connect_to_misters()
 
 void Controller::disconnect_serial()
 {
+    if (is_connected() && latency().count > 0) emit response(latency_summary());
     clear_members();
     if (is_connected())
     {
@@ -106,14 +67,18 @@ void Controller::disconnect_serial()
     else emit response(QString("%1 is already disconnected").arg(name));
 }
 
-void Controller::send_command(CMD command)
+void Controller::send_command(CMD cmd)
 {
-    write(QString("%1\r").arg((char)command).toUtf8());
+    // the reply does nothing, it just exists so we know
+    // the Arduino got the command and is ready for a new one
+    write(command(cmd));
 }
 
 void Controller::initialize_misters()
 {
-    send_command(INIT);
+    SerialCommand c = command(INIT);
+    c.done = [this](const QByteArray &reply, double) { check_init_reply(reply); };
+    write(c);
 }
 
 void Controller::turn_on_misters()
@@ -136,6 +101,32 @@ void Controller::turn_on_right_mister()
     send_command(RIGHT_ON);
 }
 
+SerialCommand Controller::command(char cmd)
+{
+    SerialCommand c;
+    c.data = QString("%1\r").arg(cmd).toUtf8();
+    c.terminator = "\r";
+    return c;
+}
+
+void Controller::check_init_reply(const QByteArray &reply)
+{
+    const QString responseString = QString(reply).simplified();
+    if (responseString == initString)
+    {
+        initState = INITIALIZED;
+        emit response(QString("Connected to %1").arg(name));
+    }
+    else
+    {
+        emit error(QString("Unexpected response from device."
+                           " Expected %1 from device but got %2")
+                   .arg(initString)
+                   .arg(responseString));
+        disconnect_serial();
+    }
+}
+
 void Controller::clear_members()
 {
     initState = InitState::NOT_INITIALIZED;
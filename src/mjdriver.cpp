@@ -20,16 +20,57 @@ namespace Added_Scientific
 
 using json = nlohmann::json;
 
+namespace
+{
+constexpr int BAUD_RATE {1'000'000};
+
+// a JSON object and the line ending after it, otherwise a line
+qsizetype reply_size(const QByteArray &read)
+{
+    if (read.startsWith('{'))
+    {
+        int depth {0};
+        bool inString {false};
+        for (qsizetype i{0}; i < read.size(); ++i)
+        {
+            const char c = read.at(i);
+            if (inString)
+            {
+                if (c == '\\') ++i;
+                else if (c == '"') inString = false;
+            }
+            else if (c == '"') inString = true;
+            else if (c == '{') ++depth;
+            else if (c == '}' && --depth == 0)
+            {
+                // the line ending is part of the reply, or it would be taken
+                // as the reply to the next command. Wait for it to arrive
+                qsizetype end = i + 1;
+                if (end == read.size()) return 0;
+                if (read.at(end) == '\r')
+                {
+                    if (++end == read.size()) return 0;
+                }
+                if (read.at(end) == '\n') ++end;
+                return end;
+            }
+        }
+        return 0;
+    }
+    const qsizetype end = read.indexOf('\n');
+    return end < 0 ? 0 : end + 1;
+}
+}
+
 Controller::Controller(const QString &portName, QObject *parent) :
     AsyncSerialDevice(portName, parent)
 {
     name = "MJ_Controller";
     // connect timer for handling timeout errors
-    connect(serialPort, &QSerialPort::readyRead, this, &Controller::handle_ready_read);
     connect(timer, &QTimer::timeout, this, &Controller::handle_timeout);
     connect(serialPort, &QSerialPort::errorOccurred, this, &Controller::handle_serial_error);
 
-    serialPort->setBaudRate(1'000'000); // 1 million baud rate.
+    serialPort->setBaudRate(BAUD_RATE); // 1 million baud rate.
 }
 
 Controller::~Controller()
@@ -37,21 +78,24 @@ Controller::~Controller()
     if (is_connected()) serialPort->close();
 }
 
-void Controller::handle_ready_read()
+SerialCommand Controller::command(const QByteArray &data)
 {
-    // look at DataRecievedHandler in "MJ Driver Board/Software/DriverBoardDropwatcher/Form1.cs"
-    while (serialPort->bytesAvailable())
-    {
-        auto inData = serialPort->readAll();
-        readData.append(inData);
-    }
+    SerialCommand c;
+    c.data = data;
+    c.replySize = reply_size;
+    c.done = [this](const QByteArray &reply, double) { handle_reply(reply); };
+    return c;
+}
 
-    if (readData[0] == '{')
+void Controller::handle_reply(const QByteArray &reply)
+{
+    // look at DataRecievedHandler in "MJ Driver Board/Software/DriverBoardDropwatcher/Form1.cs"
+    if (reply.startsWith('{'))
     {
         json j;
         try
         {
-            j = json::parse(readData.toStdString());
+            j = json::parse(reply.toStdString());
             // handle the json here
             emit response( QString::fromStdString(j.dump(4)) ); // this probably doesn't need to be here and clogs the output window
 
@@ -67,11 +111,8 @@ void Controller::handle_ready_read()
 
     else
     {
-        emit response(QString(readData));
+        emit response(QString(reply).trimmed());
     }
-
-    readData.clear();
-    write_next();
 }
 
 void Controller::handle_timeout()
@@ -86,7 +127,7 @@ void Controller::handle_timeout()
 // the controller expects LF after every command
 void Controller::write_line(const QByteArray &data)
 {
-    write(data + "\n");
+    write(command(data + "\n"));
 }
 
 void Controller::connect_board()
@@ -114,6 +155,7 @@ void Controller::connect_board()
 
 void Controller::disconnect_serial()
 {
+    if (is_connected() && latency().count > 0) emit response(latency_summary());
     clear_members();
     if (is_connected())
     {
@@ -170,29 +212,15 @@ void Controller::mode_select(Mode mode)
     write_line(command.toUtf8());
 }
 
-QByteArray Controller::convert_image(int headIdx, const QImage &image, int whiteSpace)
+QByteArray Controller::convert_image(int headIdx, const QImage &image, int whiteSpace, Halftone::Method halftone)
 {
-    // Convert image to grayscale if needed
-    QImage grayimage = image.convertToFormat(QImage::Format_Grayscale8);
+    // Turn the image into droplets (converts to grayscale if needed)
+    const Bitmap droplets = Halftone::dither(image, halftone);
 
     // Get image properties
-    int width = grayimage.width();
-    int height = grayimage.height();
+    int width = droplets.width;
+    int height = droplets.height;
     emit response(QString("Height = %1, Width = %2").arg(height).arg(width)); // for debugging
-    const uchar *pixelData = grayimage.bits();
-
-    // Array to store pixel values
-    std::vector<float> processedPixels(width * height);
-
-    // Normalize pixel values between 0 and 1
-    for (int y = 0; y < height; ++y)
-    {
-        for (int x = 0; x < width; ++x)
-        {
-            int index = y * width + x;
-            processedPixels[index] = (255.0f - pixelData[index]) / 255.0f;
-        }
-    }
 
     // Array to store data
     QByteArray imageData;
@@ -229,7 +257,7 @@ QByteArray Controller::convert_image(int headIdx, const QImage &image, int white
             for (int bit = 0; bit < 8; ++bit)
             {
                 int j = byt*8 + bit;
-                if (j < height && processedPixels[j * width + i] > 0.5f)
+                if (j < height && droplets.at(i, j))
                 {
                     curByte += 1 << (7 - bit);
                 }
@@ -293,10 +321,12 @@ void Controller::reconstructed_bitmap(const QByteArray &imageData, int width, in
     emit response(QString("Bitmap reconstructed and saved"));
 }
 
-void Controller::send_image_data(int headIdx, const QImage &image, int whiteSpace)
+void Controller::send_image_data(int headIdx, const QImage &image, int whiteSpace, Halftone::Method halftone)
 {
-    QByteArray imageData = convert_image(headIdx, image, whiteSpace);
-    write(imageData);
+    SerialCommand c = command(convert_image(headIdx, image, whiteSpace, halftone));
+    // the reply comes after the whole image is through, 10 bits a byte
+    c.timeout_ms += (int)(c.data.size() * 10 * 1000LL / BAUD_RATE);
+    write(c);
 }
 
 void Controller::create_bitmap_lines(int numLines, int width)
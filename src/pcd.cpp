@@ -11,7 +11,6 @@ Controller::Controller(const QString &portName, QObject *parent) :
 {
     name = "Pressure Controller";
     // connect timer for handling timeout errors
-    connect(serialPort, &QSerialPort::readyRead, this, &Controller::handle_ready_read);
     connect(timer, &QTimer::timeout, this, &Controller::handle_timeout);
     connect(serialPort, &QSerialPort::errorOccurred, this, &Controller::handle_serial_error);
 
@@ -23,42 +22,6 @@ Controller::~Controller()
     if (is_connected()) serialPort->close();
 }
 
-void Controller::handle_ready_read()
-{
-    auto inData = serialPort->readAll();
-    readData.append(inData);
-    QString responseString = QString(readData).simplified();
-
-    if (!inData.contains("\r")) {return;}
-    switch (initState)
-    {
-    case NOT_INITIALIZED:
-        if (responseString == initString)
-        {
-            readData.clear();
-            initState = INITIALIZED;
-            emit response(QString("Connected to %1").arg(name));
-            write_next();
-        }
-        else
-        {
-            emit error(QString("Unexpected response from device."
-                               " Expected %1 from device but got %2")
-                       .arg(initString)
-                       .arg(responseString));
-            disconnect_serial();
-        }
-        break;
-    case INITIALIZED:
-        // handle response from PCD here
-        readData.clear();
-        write_next();
-        break;
-
-    default: break;
-    }
-}
-
 void Controller::handle_timeout()
 {
     timer->stop();
@@ -93,6 +56,7 @@ int Controller::connect_to_pressure_controller()
 
 void Controller::disconnect_serial()
 {
+    if (is_connected() && latency().count > 0) emit response(latency_summary());
     clear_members();
     if (is_connected())
     {
@@ -105,23 +69,53 @@ void Controller::disconnect_serial()
 
 void Controller::update_set_point(double setPoint_PSIG)
 {
-    QString command =  QString("%1s%2\r").arg((char)UNIT_ID).arg(setPoint_PSIG);
-    write(command.toUtf8());
+    SerialCommand c = command(UNIT_ID);
+    c.data = QString("%1s%2\r").arg((char)UNIT_ID).arg(setPoint_PSIG).toUtf8();
+    c.coalesceKey = "set point"; // only the latest one matters
+    write(c);
 }
 
 void Controller::purge()
 {
-    write(QString("%1\r").arg((char)PURGE_ON).toUtf8());
+    write(command(PURGE_ON));
 }
 
 void Controller::stop_purge()
 {
-    write(QString("%1\r").arg((char)PURGE_OFF).toUtf8());
+    write(command(PURGE_OFF));
 }
 
 void Controller::initialize_pressure_controller()
 {
-    write(QString("%1\r").arg((char)INIT).toUtf8());
+    SerialCommand c = command(INIT);
+    c.done = [this](const QByteArray &reply, double) { check_init_reply(reply); };
+    write(c);
+}
+
+SerialCommand Controller::command(char cmd)
+{
+    SerialCommand c;
+    c.data = QString("%1\r").arg(cmd).toUtf8();
+    c.terminator = "\r";
+    return c;
+}
+
+void Controller::check_init_reply(const QByteArray &reply)
+{
+    const QString responseString = QString(reply).simplified();
+    if (responseString == initString)
+    {
+        initState = INITIALIZED;
+        emit response(QString("Connected to %1").arg(name));
+    }
+    else
+    {
+        emit error(QString("Unexpected response from device."
+                           " Expected %1 from device but got %2")
+                   .arg(initString)
+                   .arg(responseString));
+        disconnect_serial();
+    }
 }
 
 void Controller::clear_members()
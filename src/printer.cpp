@@ -3,6 +3,8 @@
 #include <sstream>
 #include <cmath>
 #include <stdexcept>
+#include <cstdint>
+#include <algorithm>
 
 #include "pcd.h"
 #include "jetdrive.h"
@@ -10,15 +12,25 @@
 #include "mister.h"
 #include "bedmicroscope.h"
 #include "mjdriver.h"
+#include "settlemodel.h"
+
+namespace
+{
+// e.g. BJ_JETDRIVE_PORT=/tmp/bjsim/jetdrive for tools/serialsim
+QString port_name(const char *variable, const char *defaultPort)
+{
+    return qEnvironmentVariable(variable, defaultPort);
+}
+}
 
 Printer::Printer(QObject *parent) :
     QObject(parent),
     mcu ( new DMC4080("192.168.42.100", this) ),
-    jetDrive ( new JetDrive::Controller("COM8", this) ),
-    pressureController ( new PCD::Controller("COM3", this) ),
-    mister ( new Mister::Controller("COM4", this) ),
+    jetDrive ( new JetDrive::Controller(port_name("BJ_JETDRIVE_PORT", "COM8"), this) ),
+    pressureController ( new PCD::Controller(port_name("BJ_PCD_PORT", "COM3"), this) ),
+    mister ( new Mister::Controller(port_name("BJ_MISTER_PORT", "COM4"), this) ),
     bedMicroscope ( new BedMicroscope(this) ),
-    mjController ( new Added_Scientific::Controller("COM5", this) )
+    mjController ( new Added_Scientific::Controller(port_name("BJ_MJ_PORT", "COM5"), this) )
 {
 //    using Added_Scientific::Controller::HeadIndex;
 //    mjController->set_head_voltage(HeadIndex::HEAD1, 25);
@@ -30,9 +42,9 @@ Printer::~Printer()
     disconnect_printer();
 }
 
-void Printer::connect(bool homeZAxis)
+void Printer::connect(bool homeZAxis, bool homeIfHomed)
 {
-    mcu->connect_to_motion_controller(homeZAxis);
+    mcu->connect_to_motion_controller(homeZAxis, homeIfHomed);
 
     // connect to serial devices
     jetDrive->connect_to_jet_drive();
@@ -79,6 +91,19 @@ constexpr int CMD::detail::mm2cnts(double mm, Axis axis)
     }
 }
 
+double CMD::detail::counts_per_mm(Axis axis)
+{
+    switch (axis)
+    {
+    case Axis::X:   return X_CNTS_PER_MM;
+    case Axis::Y:   return Y_CNTS_PER_MM;
+    case Axis::Z:   return Z_CNTS_PER_MM;
+    case Axis::Jet: return 1;
+
+    default: throw std::invalid_argument("invalid axis");
+    }
+}
+
 float Printer::motor_type_value(MotorType motorType)
 {
     switch (motorType)
@@ -169,15 +194,27 @@ std::string CMD::add_pvt_data_to_buffer(
         double relativePosition_mm,
         double velocity_mm,
         int time_counts)
+{
+    return add_pvt_counts_to_buffer(axis,
+                                    mm2cnts(relativePosition_mm, axis),
+                                    mm2cnts(velocity_mm, axis),
+                                    time_counts);
+}
+
+std::string CMD::add_pvt_counts_to_buffer(
+        Axis axis,
+        int relativePosition_cnts,
+        int velocity_cnts_s,
+        int time_counts)
 {
     std::string result;
     result += GCmd();
     result += "PV";
     result += axis_string(axis);
     result += "=";
-    result += std::to_string(mm2cnts(relativePosition_mm, axis));
+    result += std::to_string(relativePosition_cnts);
     result += ",";
-    result += std::to_string(mm2cnts(velocity_mm, axis));
+    result += std::to_string(velocity_cnts_s);
     result += ",";
     result += std::to_string(time_counts);
     result += "\n";
@@ -252,60 +289,6 @@ std::string CMD::move_xy_axes_to_default_position()
     return s.str();
 }
 
-std::string CMD::mist_layer(double traverseSpeed_mm_per_s, int sleepTime_ms)
-{
-    std::stringstream s;
-
-    const int yAxisTravelSpeed_mm_per_s = 60;
-    const double startPosition_mm = -350;
-    const double endPosition_mm = -150;
-    const double zAxisOffsetUnderRoller{0.5};
-
-    // setup
-    s << message("Misting layer");
-    s << message("CMD MIST_OFF"); // just make sure that the mister is off
-    s << set_accleration(Axis::Y, 600);
-    s << set_deceleration(Axis::Y, 600);
-    s << set_speed(Axis::Y, yAxisTravelSpeed_mm_per_s);
-
-    s << set_accleration(Axis::Z, 10);
-    s << set_deceleration(Axis::Z, 10);
-    s << set_speed(Axis::Z, 2);
-    s << position_relative(Axis::Z, -zAxisOffsetUnderRoller);
-    s << begin_motion(Axis::Z);
-    s << after_motion(Axis::Z);
-
-    // move y-axis to start misting position
-    s << position_absolute(Axis::Y, startPosition_mm);
-    s << begin_motion(Axis::Y);
-    s << after_motion(Axis::Y);
-
-    s << message("CMD MIST_ON");
-    s << wait(sleepTime_ms); // wait
-
-    s << set_speed(Axis::Y, traverseSpeed_mm_per_s); // set traverse speed
-    // travel under mister and specified speed
-    s << position_absolute(Axis::Y, endPosition_mm);
-    s << begin_motion(Axis::Y);
-    s << after_motion(Axis::Y);
-
-    s << message("CMD MIST_OFF");
-
-    // move z-axis back up
-    s << position_relative(Axis::Z, zAxisOffsetUnderRoller);
-    s << begin_motion(Axis::Z);
-
-    // move forward
-    s << set_speed(Axis::Y, yAxisTravelSpeed_mm_per_s);
-    s << position_absolute(Axis::Y, -50);
-    s << begin_motion(Axis::Y);
-    s << after_motion(Axis::Y);
-    s << after_motion(Axis::Z);
-    s << message("Misting complete");
-
-    return s.str();
-}
-
 std::string CMD::set_jetting_gearing_ratio_from_droplet_spacing(
         Axis masterAxis,
         int dropletSpacing_um)
@@ -321,133 +304,52 @@ std::string CMD::set_jetting_gearing_ratio_from_droplet_spacing(
                 + "\n"};
 }
 
-std::string CMD::homing_sequence(bool homeZAxis)
-{
-    std::stringstream s;
-
-    // === Home the X-Axis using the central home sensor index pulse ===
-
-    s << set_accleration(Axis::X, 800);
-    s << set_deceleration(Axis::X, 800);
-    s << set_limit_switch_deceleration(Axis::X, 800);
-    s << set_jog(Axis::X, 25); // jog towards front limit
-
-    s << set_accleration(Axis::Y, 400);
-    s << set_deceleration(Axis::Y, 400);
-    s << set_limit_switch_deceleration(Axis::Y, 600);
-    s << set_jog(Axis::Y, 25); // jog towards front limit
-
-    if (homeZAxis)
-    {
-        s << set_accleration(Axis::Z, 20);
-        s << set_deceleration(Axis::Z, 20);
-        s << set_limit_switch_deceleration(Axis::Z, 40);
-        // jog to bottom (MAX SPEED of 5mm/s!)
-        s << set_jog(Axis::Z, -2);
-        // turn off top software limit
-        s << disable_forward_software_limit(Axis::Z);
-    }
-
-    s << begin_motion(Axis::X);
-    s << begin_motion(Axis::Y);
-    if (homeZAxis)
-        s << begin_motion(Axis::Z);
-
-    s << motion_complete(Axis::X);
-    s << motion_complete(Axis::Y);
-
-    // TODO: This is a temporary solution that depends on alignment
-    // of ballscrew and motor index pulse
-    // find a better way to do this
-    // move y-axis forward a bit to avoid being right on top of the index pulse
-    s << position_relative(Axis::Y, -2);
-    s << set_speed(Axis::Y, 10);
-    s << begin_motion(Axis::Y);
-    s << motion_complete(Axis::Y);
-    // =================================
-
-    // this is put after the short y move because the z axis is slow
-    if (homeZAxis)
-        s << motion_complete(Axis::Z);
-
-    s << sleep(1000);
-
-    // home to center index on x axis
-    s << set_jog(Axis::X, -30);
-    s << set_homing_velocity(Axis::X, 0.5);
-    s << find_index(Axis::X);
-
-    // home y axis to nearest index
-    s << set_jog(Axis::Y, -0.5);
-    s << set_homing_velocity(Axis::Y, 0.25);
-    s << find_index(Axis::Y);
-
-    if (homeZAxis)
-    {
-        // slower acceleration for going back up
-        s << set_accleration(Axis::Z, 10);
-        s << set_speed(Axis::Z, 2);
-        // TUNE THIS BACKING OFF Z LIMIT TO FUTURE PRINT BED HEIGHT!
-        s << position_relative(Axis::Z, 13.5322);
-    }
-
-
-    s << begin_motion(Axis::X);
-    s << begin_motion(Axis::Y);
-    if (homeZAxis)
-        s << begin_motion(Axis::Z);
-
-    s << motion_complete(Axis::X);
-    s << motion_complete(Axis::Y);
-    if (homeZAxis)
-        s << motion_complete(Axis::Z);
-
-    s << define_position(Axis::X, X_STAGE_LEN_MM / 2.0);
-    s << define_position(Axis::Y, 0);
-    s << define_position(Axis::Z, 0);
-    // set software limit to current position
-    s << set_forward_software_limit(Axis::Z, 0);
-
-    return s.str();
-}
-
 std::string CMD::spread_layer(const RecoatSettings &settings)
 {
     std::stringstream s;
     Axis y {Axis::Y};
-    double zAxisOffsetUnderRoller {0.5};
+
+    // Z and Y only wait for each other where the clearance model needs them
+    // to (see ROLLER_CLEAR_Y_MM):
+    //  - the bed ends the last recoat under the roller, so it has to be
+    //    lowered before the y-axis goes back
+    //  - it can come back up as soon as it is behind the roller, while the
+    //    y-axis is still on its way to the hopper
+    //  - it has to be up before the bed gets to the roller again, which is
+    //    after the hopper has put down the powder
+
+    // set hopper settings, the generator is set over serial port 2 so this
+    // doesn't need to wait for anything
+    s << set_hopper_mode_and_intensity(settings.ultrasonicMode,
+                                       settings.ultrasonicIntensityLevel);
 
     // move z-axis down when going back to get more powder
     s << set_accleration(Axis::Z, 10)
       << set_deceleration(Axis::Z, 10)
       << set_speed(Axis::Z, 2)
-      << position_relative(Axis::Z, -zAxisOffsetUnderRoller)
+      << position_relative(Axis::Z, -Z_OFFSET_UNDER_ROLLER_MM)
       << begin_motion(Axis::Z)
+      << set_accleration(y, 400)
+      << set_deceleration(y, 400)
+      << set_jog(y, -50)
       << motion_complete(Axis::Z);
 
     // jog y-axis to back
-    s << set_accleration(y, 400)
-      << set_deceleration(y, 400)
-      << set_jog(y, -50)
-      << begin_motion(y)
-      << motion_complete(y);
+    s << begin_motion(y);
 
     // set z-axis move distance
     if (settings.isLevelRecoat) // move z-axis back up all the way
-        s << position_relative(Axis::Z, zAxisOffsetUnderRoller);
+        s << position_relative(Axis::Z, Z_OFFSET_UNDER_ROLLER_MM);
     else // move up but a layer thickness down from original position
         s << position_relative(Axis::Z,
-                               zAxisOffsetUnderRoller
+                               Z_OFFSET_UNDER_ROLLER_MM
                                - (settings.layerHeight_microns
                                   / 1000.0));
 
-    // set hopper settings
-    s << set_hopper_mode_and_intensity(settings.ultrasonicMode,
-                                       settings.ultrasonicIntensityLevel);
-
-    // move z-axis
+    // move z-axis once the bed is clear of the roller
+    s << wait_for_position(y, ROLLER_CLEAR_Y_MM, true);
     s << begin_motion(Axis::Z);
-    s << motion_complete(Axis::Z);
+    s << motion_complete(y);
 
     // turn on hopper
     s << enable_hopper();
@@ -467,6 +369,9 @@ std::string CMD::spread_layer(const RecoatSettings &settings)
     s << enable_roller1();
     s << enable_roller2();
 
+    // the bed has to be at the new layer height before it gets to the roller
+    s << motion_complete(Axis::Z);
+
     // move y-axis forward under roller
     s << set_speed(y, settings.rollerTraverseSpeed_mm_s);
     s << position_relative(y, 135);
@@ -480,6 +385,118 @@ std::string CMD::spread_layer(const RecoatSettings &settings)
     return s.str();
 }
 
+std::string CMD::call_library(std::string_view label,
+                              const std::vector<std::pair<std::string, double>> &arguments,
+                              int thread)
+{
+    constexpr size_t maxLineLength {80};
+    const std::string start = "XQ #" + std::string(label) + "," + std::to_string(thread);
+
+    std::stringstream s;
+    std::string line;
+    for (const auto &[name, value] : arguments)
+    {
+        std::ostringstream assignment;
+        assignment << name << "=" << value;
+        if (!line.empty() && line.size() + 1 + assignment.str().size() > maxLineLength)
+        {
+            s << GCmd(line);
+            line.clear();
+        }
+        if (!line.empty()) line += ";";
+        line += assignment.str();
+    }
+    if (!line.empty() && line.size() + 1 + start.size() <= maxLineLength)
+        line += ";" + start;
+    else
+    {
+        if (!line.empty()) s << GCmd(line);
+        line = start;
+    }
+    s << GCmd(line);
+    s << "GProgramComplete," << thread << "\n";
+
+    return s.str();
+}
+
+std::string CMD::library::home_axes(bool homeZAxis)
+{
+    return call_library("LHOME", {{"lHomeZ", homeZAxis ? 1 : 0}});
+}
+
+std::string CMD::library::spread_layer(const RecoatSettings &settings)
+{
+    std::stringstream s;
+    // the generator is set over serial port 2, the program doesn't need to
+    s << set_hopper_mode_and_intensity(settings.ultrasonicMode,
+                                       settings.ultrasonicIntensityLevel);
+    s << call_library("LRECOAT",
+                      {{"lLyrHt", settings.isLevelRecoat ? 0 : settings.layerHeight_microns / 1000.0},
+                       {"lRcSpd", settings.recoatSpeed_mm_s},
+                       {"lRlSpd", settings.rollerTraverseSpeed_mm_s},
+                       {"lHopDw", settings.waitAfterHopperOn_millisecs},
+                       {"lZOff", Z_OFFSET_UNDER_ROLLER_MM},
+                       {"lClrY", ROLLER_CLEAR_Y_MM}});
+    return s.str();
+}
+
+std::string CMD::library::mist_layer(double traverseSpeed_mm_per_s, int sleepTime_ms,
+                                     bool thenCure, int thread)
+{
+    return call_library("LMIST",
+                        {{"lMsSpd", traverseSpeed_mm_per_s},
+                         {"lMsDw", sleepTime_ms},
+                         {"lMsY0", MIST_START_Y_MM},
+                         {"lMsY1", MIST_END_Y_MM},
+                         {"lZOff", Z_OFFSET_UNDER_ROLLER_MM},
+                         {"lMsCure", thenCure ? 1 : 0}},
+                        thread);
+}
+
+std::string CMD::library::cure_layer(double heatingTraverseSpeed_mm_s, bool bedDown, int thread)
+{
+    return call_library("LCURE",
+                        {{"lCrSpd", heatingTraverseSpeed_mm_s},
+                         {"lLpY0", HEAT_LAMP_START_Y_MM},
+                         {"lLpY1", HEAT_LAMP_END_Y_MM},
+                         {"lZOff", Z_OFFSET_UNDER_ROLLER_MM},
+                         {"lBackY", -Y_STAGE_LEN_MM},
+                         {"lCrDown", bedDown ? 1 : 0}},
+                        thread);
+}
+
+std::string CMD::library::move_to_jetting_window()
+{
+    return call_library("LJETWIN", {{"lJwX", X_STAGE_LEN_MM}});
+}
+
+std::string CMD::library::image_bed(const std::vector<double> &xPositions_mm,
+                                    const std::vector<double> &yPositions_mm)
+{
+    std::stringstream s;
+    if (xPositions_mm.empty() || yPositions_mm.empty()) return s.str();
+
+    // the arrays are made fresh for each scan, like the old imaging program did
+    s << GCmd("DA *[0]");
+    s << GCmd("DM xPos[" + std::to_string(xPositions_mm.size()) + "]");
+    s << GCmd("DM yPos[" + std::to_string(yPositions_mm.size()) + "]");
+    s << detail::ArrayDownload() << "xPos";
+    for (const double x : xPositions_mm) s << "," << mm2cnts(x, Axis::X);
+    s << "\n";
+    s << detail::ArrayDownload() << "yPos";
+    for (const double y : yPositions_mm) s << "," << mm2cnts(y, Axis::Y);
+    s << "\n";
+
+    // the speeds and accelerations #LIMAGE moves at, 500 ms until calibrated
+    const int settle_ms = std::max(Settle::stop_wait_ms(Axis::X, 50, 5000, 500),
+                                   Settle::stop_wait_ms(Axis::Y, 30, 1000, 500));
+    s << call_library("LIMAGE",
+                      {{"lNx", (double)xPositions_mm.size()},
+                       {"lNy", (double)yPositions_mm.size()},
+                       {"lImWt", (double)settle_ms}});
+    return s.str();
+}
+
 std::string CMD::detail::create_gcmd(
         std::string_view command,
         Axis axis,
@@ -495,6 +512,17 @@ std::string CMD::detail::create_gcmd(
     return result;
 }
 
+int CMD::configuration_fingerprint(std::string_view settings)
+{
+    uint32_t hash {2166136261u};
+    for (const char c : settings)
+    {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return (int)(hash & 0x7FFFFFFF);
+}
+
 std::string CMD::cmd_buf_to_dmc(const std::stringstream &s)
 {
     std::stringstream ss;
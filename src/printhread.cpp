@@ -8,13 +8,21 @@
 
 #include <QDebug>
 
-GReturn GCALL GProgramComplete(GCon g)
+#include <algorithm>
+
+// number of segments the LM buffer holds on the DMC-40x0
+constexpr int LM_BUFFER_SIZE {511};
+
+// double buffered row array used by Raster_Print.dmc
+constexpr const char *RASTER_ROW_ARRAY {"Rows"};
+
+GReturn GCALL GProgramComplete(GCon g, int thread)
 {
-    char pred[] = "_XQ=-1";
+    const std::string pred = "_XQ" + std::to_string(thread) + "=-1";
     GReturn rc;
 
     // poll forever. Change this if a premature exit is desired.
-    rc = GWaitForBool(g, pred, -1);
+    rc = GWaitForBool(g, pred.c_str(), -1);
     if (rc != G_NO_ERROR)
         return rc;
 
@@ -65,6 +73,9 @@ void PrintThread::execute_command(std::stringstream &ss)
 
     // start or wake the thread
 
+    mLinearBufferSpace = 0;
+    mLinearSegmentsSent = 0;
+
     std::string buffer;
     //while(ss >> buffer) // spaces split into different objects
     while (std::getline(ss, buffer)) // Reads whole line (includes spaces)
@@ -75,6 +86,28 @@ void PrintThread::execute_command(std::stringstream &ss)
     { waitCondition.wakeOne(); } // else wake the thread
 }
 
+void PrintThread::append_command(std::stringstream &ss)
+{
+    const QMutexLocker locker(&mutex);
+    const bool wasEmpty = queue.empty();
+
+    std::string buffer;
+    while (std::getline(ss, buffer)) queue.push(buffer);
+
+    if (!isRunning())
+    { start(); }
+    else if (wasEmpty)
+    { waitCondition.wakeOne(); }
+}
+
+bool PrintThread::next_command(std::string &command)
+{
+    const QMutexLocker locker(&mutex);
+    if (queue.empty()) return false;
+    command = queue.front();
+    return true;
+}
+
 void PrintThread::clear_queue()
 {
     mutex.lock();
@@ -87,13 +120,15 @@ void PrintThread::run()
 {
     while (!mQuit)
     {
-        while (queue.size() > 0)
+        std::string commandString;
+        while (next_command(commandString))
         {
             if (!running) // If the queue is externally stopped
             {
                 clear_queue();
                 // Code to run on stop
                 emit response("Stream to Motion Controller Stopped");
+                emit stopped();
                 if (mPrinter->g)
                 {
                     GCmd(mPrinter->g, "ST"); // stop motors
@@ -105,7 +140,6 @@ void PrintThread::run()
                 // === Code to run on each queue item ===
 
                 // split string into command type and command string
-                std::string commandString = queue.front();
                 std::string delimeterChar = ",";
                 size_t pos{0};
                 std::string commandType;
@@ -151,7 +185,8 @@ void PrintThread::run()
                         constexpr int maxLoop{(breakLoopTime_sec * 1000) / sleepTime_ms};
                         int counter{0};
                         do {
-                            GCmdI(mPrinter->g, "Data[0]=?", &val);
+                            // Data[] doesn't exist until the program has dimensioned it
+                            if (GCmdI(mPrinter->g, "Data[0]=?", &val) != G_NO_ERROR) val = 1;
                             GSleep(sleepTime_ms);
                             counter++;
                         }
@@ -202,7 +237,9 @@ void PrintThread::run()
                 {
                     if (mPrinter->g)
                     {
-                        e(GProgramComplete(mPrinter->g));
+                        // "<thread>", thread 0 if it's left out
+                        const int thread = commandString.empty() ? 0 : std::stoi(commandString);
+                        e(GProgramComplete(mPrinter->g, thread));
                     }
                     else
                     {
@@ -223,6 +260,76 @@ void PrintThread::run()
                         emit connected_to_controller();
                     }
                 }
+                else if (commandType == "LibraryDownload")
+                {
+                    if (mPrinter->g)
+                    {
+                        if (!mPrinter->download_library())
+                            emit response("Could not download the DMC subroutine library");
+                    }
+                    else
+                    {
+                        //emit response("ERROR: not connected to controller!");
+                    }
+                }
+                else if (commandType == "LinearSegment")
+                {
+                    if (mPrintGCmds) emit response(QString::fromStdString(commandString));
+                    if (mPrinter->g)
+                    {
+                        send_linear_segment(commandString);
+                    }
+                    else
+                    {
+                        //emit response("ERROR: not connected to controller!");
+                    }
+                }
+                else if (commandType == "ArrayDownload")
+                {
+                    // "<array name>,<values...>", the array has to be dimensioned already
+                    const size_t nameEnd = commandString.find(',');
+                    if (mPrinter->g && nameEnd != std::string::npos)
+                    {
+                        const std::string name = commandString.substr(0, nameEnd);
+                        if (mPrintGCmds) emit response(QString("Downloading array ") + QString::fromStdString(name));
+                        e(GArrayDownload(mPrinter->g, name.c_str(), G_BOUNDS, G_BOUNDS, commandString.c_str() + nameEnd + 1));
+                    }
+                    else
+                    {
+                        //emit response("ERROR: not connected to controller!");
+                    }
+                }
+                else if (commandType == "GPositionWait")
+                {
+                    if (mPrinter->g)
+                    {
+                        wait_for_position(commandString);
+                    }
+                    else
+                    {
+                        //emit response("ERROR: not connected to controller!");
+                    }
+                }
+                else if (commandType == "PhaseMark")
+                {
+                    // "<phase>,<layer>"
+                    const size_t phaseEnd = commandString.find(',');
+                    const std::string phase = commandString.substr(0, phaseEnd);
+                    const int layer = phaseEnd == std::string::npos ? 0 : std::stoi(commandString.substr(phaseEnd + 1));
+                    emit phase_started(QString::fromStdString(phase), layer);
+                }
+                else if (commandType == "RasterRow")
+                {
+                    if (mPrintGCmds) emit response(QString::fromStdString(commandString));
+                    if (mPrinter->g)
+                    {
+                        send_raster_row(commandString);
+                    }
+                    else
+                    {
+                        //emit response("ERROR: not connected to controller!");
+                    }
+                }
                 else if (commandType == "Message")
                 {
                     emit response(QString::fromStdString(commandString));
@@ -236,8 +343,11 @@ void PrintThread::run()
 
 
                 //msleep(150);
+                mutex.lock();
                 queue.pop(); // remove command from the queue
-                if(queue.size() == 0)
+                const bool queueFinished = queue.empty();
+                mutex.unlock();
+                if (queueFinished)
                 {
                     // code to run when the queue completes normally
                     if (mPrintGCmds)
@@ -253,14 +363,118 @@ void PrintThread::run()
 
         emit ended();
         mutex.lock();
-        // wait until thread is woken again by transaction call
-        waitCondition.wait(&mutex);
+        // wait until thread is woken again by transaction call, unless
+        // commands were appended since the queue finished
+        if (queue.empty() && !mQuit) waitCondition.wait(&mutex);
         // Once the thread is woken again
         running = true;
         mutex.unlock();
     }
 }
 
+void PrintThread::wait_for_position(const std::string &args)
+{
+    // "<axis>,<position (counts)>,<direction>", returns once the axis has
+    // gone past the position in the direction of its move (1 forward, -1
+    // backward) or has stopped, so a move that ends early can't hang the stream
+    std::stringstream ss(args);
+    std::string axis, position, direction;
+    std::getline(ss, axis, ',');
+    std::getline(ss, position, ',');
+    std::getline(ss, direction, ',');
+    if (axis.empty() || position.empty() || direction.empty()) return;
+
+    const int target = std::stoi(position);
+    const int sign = std::stoi(direction) < 0 ? -1 : 1;
+    const std::string positionCmd = "TP" + axis;
+    const std::string movingCmd = "MG _BG" + axis;
+
+    constexpr int sleepTime_ms = 5;
+    while (running)
+    {
+        int current{};
+        int moving{};
+        if (GCmdI(mPrinter->g, positionCmd.c_str(), &current) != G_NO_ERROR) return;
+        if (sign * (current - target) >= 0) return;
+        if (GCmdI(mPrinter->g, movingCmd.c_str(), &moving) != G_NO_ERROR || moving == 0) return;
+        GSleep(sleepTime_ms);
+    }
+}
+
+void PrintThread::send_linear_segment(const std::string &segment)
+{
+    // Keep a local count of the free space so the controller only needs to be
+    // asked every few segments (or when the buffer is full), which keeps the
+    // round trips down while still catching the buffer running empty
+    constexpr int sleepTime_ms = 5;
+    constexpr int checkInterval = 16;
+    bool checkLevel = (mLinearBufferSpace <= 0) || (mLinearSegmentsSent % checkInterval == 0);
+    while (checkLevel && running)
+    {
+        GCmdI(mPrinter->g, "_LM", &mLinearBufferSpace);
+
+        // an empty buffer after segments were sent means the motion
+        // ran out of segments before more could be sent
+        if (mLinearBufferSpace >= LM_BUFFER_SIZE && mLinearSegmentsSent > 0)
+            emit response("Warning: linear interpolation buffer ran empty during motion");
+
+        checkLevel = (mLinearBufferSpace <= 0);
+        if (checkLevel) GSleep(sleepTime_ms);
+    }
+    if (!running) return;
+
+    e(GCmd(mPrinter->g, segment.c_str()));
+    mLinearBufferSpace--;
+    mLinearSegmentsSent++;
+}
+
+void PrintThread::send_raster_row(const std::string &row)
+{
+    // row is "<slot offset>,<state>,<slot values...>"
+    const size_t offsetEnd = row.find(',');
+    if (offsetEnd == std::string::npos) return;
+    const int offset = std::stoi(row.substr(0, offsetEnd));
+    const size_t stateEnd = row.find(',', offsetEnd + 1);
+    const std::string state = row.substr(offsetEnd + 1, stateEnd - offsetEnd - 1);
+
+    // wait for the controller to free the slot (state 0)
+    const std::string query = std::string(RASTER_ROW_ARRAY) + "[" + std::to_string(offset) + "]";
+    constexpr int sleepTime_ms = 5;
+    int val {1};
+    while (running)
+    {
+        if (e(GCmdI(mPrinter->g, (query + "=?").c_str(), &val)) != G_NO_ERROR)
+        {
+            // Raster_Print.dmc would wait in #RWAIT for the row forever
+            emit error("Could not read raster row slot " + std::to_string(offset) + ", stopping print");
+            stop();
+            return;
+        }
+        if (val == 0) break;
+        GSleep(sleepTime_ms);
+    }
+    if (!running) return;
+
+    // download the row first and only then mark it as ready so the program
+    // never reads a partially downloaded row
+    if (stateEnd != std::string::npos)
+    {
+        const std::string values = row.substr(stateEnd + 1);
+        const int count = (int)std::count(values.begin(), values.end(), ',') + 1;
+        if (e(GArrayDownload(mPrinter->g, RASTER_ROW_ARRAY, offset + 1, offset + count, values.c_str())) != G_NO_ERROR)
+        {
+            emit error("Could not download raster row to slot " + std::to_string(offset) + ", stopping print");
+            stop();
+            return;
+        }
+    }
+    if (e(GCmd(mPrinter->g, (query + "=" + state).c_str())) != G_NO_ERROR)
+    {
+        emit error("Could not mark raster row slot " + std::to_string(offset) + " as ready, stopping print");
+        stop();
+    }
+}
+
 GReturn PrintThread::e(GReturn rc)
 {
     char buf[G_SMALL_BUFFER];
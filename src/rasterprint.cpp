@@ -0,0 +1,149 @@
+#include "rasterprint.h"
+#include "layermap.h"
+#include "settlemodel.h"
+
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+std::vector<RasterRun> runs_in_row(const Bitmap &bitmap, int row)
+{
+    std::vector<RasterRun> runs;
+    int x {0};
+    while (x < bitmap.width)
+    {
+        if (!bitmap.at(x, row)) { ++x; continue; }
+        RasterRun run {x, x};
+        while (run.last + 1 < bitmap.width && bitmap.at(run.last + 1, row)) ++run.last;
+        runs.push_back(run);
+        x = run.last + 1;
+    }
+    return runs;
+}
+
+std::vector<RasterPass> RasterPrintCommandGenerator::plan_passes(const Bitmap &bitmap) const
+{
+    return plan_passes(bitmap.height, [&bitmap](int row) { return runs_in_row(bitmap, row); });
+}
+
+std::vector<RasterPass> RasterPrintCommandGenerator::plan_passes(const LayerMap &layer) const
+{
+    return plan_passes(layer.height(), [&layer](int row)
+    {
+        std::vector<RasterRun> runs;
+        runs.reserve(layer.row(row).size());
+        for (const auto &span : layer.row(row)) runs.push_back({span.begin, span.end - 1});
+        return runs;
+    });
+}
+
+std::vector<RasterPass> RasterPrintCommandGenerator::plan_passes(int height, const std::function<std::vector<RasterRun>(int)> &rowRuns) const
+{
+    std::vector<RasterPass> passes;
+    int direction {1};
+
+    // start at the bottom of the image (lowest y) and step up
+    for (int row{height - 1}; row >= 0; --row)
+    {
+        const auto runs = rowRuns(row);
+        for (size_t start{0}; start < runs.size(); start += RASTER_MAX_RUNS_PER_ROW)
+        {
+            const size_t end = std::min(runs.size(), start + RASTER_MAX_RUNS_PER_ROW);
+            RasterPass pass;
+            pass.row = row;
+            pass.direction = direction;
+            pass.runs.assign(runs.begin() + start, runs.begin() + end);
+            if (direction < 0)
+            {
+                // runs are printed right to left, first droplet is the right end
+                std::reverse(pass.runs.begin(), pass.runs.end());
+                for (auto &run : pass.runs) std::swap(run.first, run.last);
+            }
+            passes.push_back(pass);
+            direction = -direction;
+        }
+    }
+
+    return passes;
+}
+
+double RasterPrintCommandGenerator::run_up_mm() const
+{
+    // measured settle distance if calibrated, a fixed margin if not
+    return Settle::run_up_distance_mm(Axis::X, print_speed_mm_per_s(), acceleration_mm_per_s2, 0.5);
+}
+
+double RasterPrintCommandGenerator::pass_start_x_mm(const RasterPass &pass) const
+{
+    if (pass.runs.empty()) return originX_mm;
+    return pixel_x_mm(pass.runs.front().first) - pass.direction * run_up_mm();
+}
+
+std::string RasterPrintCommandGenerator::row_slot_command(int height, const RasterPass &pass, int slot) const
+{
+    auto x_counts = [this](int column) { return std::lround(pixel_x_mm(column) * X_CNTS_PER_MM); };
+
+    std::stringstream s;
+    s << "RasterRow," << slot * RASTER_ROW_SLOT_SIZE << ",1,"
+      << std::lround(pixel_y_mm(height, pass.row) * Y_CNTS_PER_MM) << ","
+      << pass.direction << ","
+      << pass.runs.size();
+    for (const auto &run : pass.runs)
+    {
+        s << "," << x_counts(run.first) << "," << x_counts(run.last);
+    }
+    s << "\n";
+    return s.str();
+}
+
+std::string RasterPrintCommandGenerator::generate_commands_for_printing(const Bitmap &bitmap) const
+{
+    return generate_commands_for_printing(bitmap.height, plan_passes(bitmap));
+}
+
+std::string RasterPrintCommandGenerator::generate_commands_for_printing(const LayerMap &layer) const
+{
+    return generate_commands_for_printing(layer.height(), plan_passes(layer));
+}
+
+std::string RasterPrintCommandGenerator::generate_commands_for_printing(int height, const std::vector<RasterPass> &passes) const
+{
+    std::stringstream s;
+
+    const double printSpeed_cnts = print_speed_mm_per_s() * X_CNTS_PER_MM;
+    const double accel_cnts = (double)acceleration_mm_per_s2 * X_CNTS_PER_MM;
+    const double runUp_cnts = run_up_mm() * X_CNTS_PER_MM;
+    const double dropletSpacing_cnts = dropletSpacing_um / 1000.0 * X_CNTS_PER_MM;
+
+    s << CMD::display_message("Printing " + std::to_string(passes.size()) + " raster rows");
+    s << CMD::stop_motion(Axis::Jet); // stop jetting if it is currently jetting
+    s << CMD::detail::GCmd() << "XQ #BEGIN" << "\n";
+
+    // job settings go in the Data[] array (same handshake as line printing)
+    s << "PrintLineSet,1,"
+      << std::lround(printSpeed_cnts) << ","
+      << std::lround(accel_cnts) << ","
+      << std::lround(runUp_cnts) << ","
+      << std::lround(dropletSpacing_cnts) << ","
+      << (1.0 / dropletSpacing_cnts) << ","
+      << std::lround(travelSpeed_mm_per_s * X_CNTS_PER_MM) << ","
+      << std::lround(travelSpeed_mm_per_s * Y_CNTS_PER_MM) << ","
+      << 0 << "\n";
+
+    // each row waits for its slot to be freed by the controller before it
+    // downloads, so at most one row is queued ahead of the one printing
+    int slot {0};
+    for (const auto &pass : passes)
+    {
+        s << row_slot_command(height, pass, slot);
+        slot = 1 - slot;
+    }
+    s << "RasterRow," << slot * RASTER_ROW_SLOT_SIZE << ",2\n"; // end of job
+
+    // tell the program to exit once the raster subroutine returns
+    s << "PrintLineSet,2,0,0,0,0,0,0,0,0\n";
+    s << "GProgramComplete," << "\n";
+    s << CMD::display_message("Raster Print Complete");
+
+    return s.str();
+}
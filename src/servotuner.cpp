@@ -0,0 +1,372 @@
+#include "servotuner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+// volts out of the motor command DAC per count of the digital filter output
+constexpr double DAC_V_PER_COUNT {20.0 / 65536.0};
+// largest gains the controller takes
+constexpr double MAX_KP {1023.875};
+constexpr double MAX_KD {4095.875};
+constexpr double MAX_KI {255.999};
+// how long a simulated step runs for
+constexpr double SIMULATION_TIME_S {1.0};
+constexpr double PI {3.14159265358979323846};
+
+// RC records every 2^n samples, n from 1 to 8
+int record_period_exponent(double duration_s)
+{
+    const double samples = duration_s / Tuning::SERVO_PERIOD_S;
+    int n {1};
+    while ((samples / std::pow(2, n)) > Tuning::MAX_RECORD_LENGTH && n < 8) n++;
+    return n;
+}
+
+std::string record_setup(Axis axis)
+{
+    using CMD::detail::GCmd;
+    const std::string size = std::to_string(Tuning::MAX_RECORD_LENGTH);
+    const std::string posArray = Tuning::POSITION_ARRAY;
+    const std::string cmdArray = Tuning::COMMAND_ARRAY;
+    const std::string name = CMD::detail::axis_string(axis);
+
+    std::stringstream s;
+    s << GCmd("DA *[0]");
+    s << GCmd("DM " + posArray + "[" + size + "]," + cmdArray + "[" + size + "]");
+    s << GCmd("RA " + posArray + "[]," + cmdArray + "[]");
+    s << GCmd("RD _TP" + name + ",_TT" + name);
+    return s.str();
+}
+
+std::string fixed(double value, int precision)
+{
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(precision) << value;
+    return s.str();
+}
+}
+
+namespace Tuning
+{
+
+std::string StepMetrics::summary() const
+{
+    return fixed(overshoot_percent, 1) + " % overshoot, "
+            + (settlingTime_s < 0 ? std::string("does not settle")
+                                  : "settles in " + fixed(settlingTime_s * 1000.0, 1) + " ms");
+}
+
+std::string Proposal::summary(Axis axis) const
+{
+    if (!found) return "No gains meet the overshoot limit";
+    const std::string name = CMD::detail::axis_string(axis);
+    return "KP" + name + "=" + fixed(gains.KP, 3) + ", KD" + name + "=" + fixed(gains.KD, 3)
+            + ", KI" + name + "=" + fixed(gains.KI, 3) + " (" + predicted.summary() + ")";
+}
+
+double sample_period_s(double duration_s)
+{
+    return SERVO_PERIOD_S * std::pow(2, record_period_exponent(duration_s));
+}
+
+std::string step_test_commands(const StepTest &test)
+{
+    using CMD::detail::GCmd;
+    const std::string name = CMD::detail::axis_string(test.axis);
+
+    std::stringstream s;
+    s << record_setup(test.axis);
+    // the step runs at the controller maximums, later moves expect the
+    // axis's own acceleration and speed back
+    s << GCmd("tnAc=_AC" + name);
+    s << GCmd("tnDc=_DC" + name);
+    s << GCmd("tnSp=_SP" + name);
+    s << GCmd("AC" + name + "=1073740800");
+    s << GCmd("DC" + name + "=1073740800");
+    s << GCmd("SP" + name + "=22000000");
+    s << GCmd("RC " + std::to_string(record_period_exponent(test.duration_s)));
+    s << CMD::position_relative(test.axis, test.step_mm);
+    s << CMD::begin_motion(test.axis);
+    s << CMD::sleep((int)std::lround(test.duration_s * 1000.0));
+    s << GCmd("RC 0");
+    s << CMD::after_motion(test.axis);
+    s << GCmd("AC" + name + "=tnAc");
+    s << GCmd("DC" + name + "=tnDc");
+    s << GCmd("SP" + name + "=tnSp");
+    return s.str();
+}
+
+std::string sine_sweep_program(const SineSweep &sweep)
+{
+    const std::string name = CMD::detail::axis_string(sweep.axis);
+    // the loop waits 1 ms each time round
+    const int loops = (int)std::lround(sweep.duration_s * 1000.0);
+    const double step_Hz = loops > 1 ? (sweep.endFrequency_Hz - sweep.startFrequency_Hz) / (loops - 1) : 0;
+
+    std::stringstream s;
+    s << "#TUNESW\n";
+    s << "tnI = 0\n";
+    s << "tnPh = 0\n";
+    s << "RC " << record_period_exponent(sweep.duration_s) << "\n";
+    s << "#TNSWL\n";
+    s << "tnF = " << sweep.startFrequency_Hz << " + (" << step_Hz << " * tnI)\n";
+    s << "tnPh = tnPh + (0.36 * tnF)\n"; // degrees in 1 ms
+    s << "IF (tnPh >= 360)\n";
+    s << "tnPh = tnPh - 360\n";
+    s << "ENDIF\n";
+    s << "OF" << name << " = " << sweep.amplitude_V << " * @SIN[tnPh]\n";
+    s << "WT 1\n";
+    s << "tnI = tnI + 1\n";
+    s << "JP #TNSWL, tnI < " << loops << "\n";
+    s << "OF" << name << " = 0\n";
+    s << "RC 0\n";
+    s << "EN\n";
+    return s.str();
+}
+
+std::string sine_sweep_commands(const SineSweep &sweep)
+{
+    std::stringstream s;
+    s << record_setup(sweep.axis);
+    s << CMD::detail::GCmd("XQ #TUNESW");
+    s << "GProgramComplete," << "\n";
+    return s.str();
+}
+
+std::vector<double> upload_array(GCon g, const char *name, int count)
+{
+    std::vector<double> values;
+    std::vector<char> buf(MAX_RECORD_LENGTH * 16, '\0');
+    if (GArrayUpload(g, name, 0, count - 1, G_COMMA, buf.data(), buf.size()) != G_NO_ERROR)
+        return values;
+
+    std::stringstream ss(std::string(buf.data()));
+    std::string value;
+    while (std::getline(ss, value, ','))
+    {
+        try { values.push_back(std::stod(value)); }
+        catch (const std::exception &) { break; }
+    }
+    return values;
+}
+
+bool upload_record(GCon g, double duration_s, Record &record)
+{
+    if (!g) return false;
+
+    // _RD is where the next sample would have gone
+    int count {};
+    if (GCmdI(g, "MG _RD", &count) != G_NO_ERROR || count <= 0) count = MAX_RECORD_LENGTH;
+    count = std::min(count, MAX_RECORD_LENGTH);
+
+    record.position_cnts = upload_array(g, POSITION_ARRAY, count);
+    record.command_V = upload_array(g, COMMAND_ARRAY, count);
+    record.samplePeriod_s = sample_period_s(duration_s);
+
+    const size_t size = std::min(record.position_cnts.size(), record.command_V.size());
+    record.position_cnts.resize(size);
+    record.command_V.resize(size);
+    return size > 0;
+}
+
+bool read_gains(GCon g, Axis axis, Gains &gains)
+{
+    if (!g) return false;
+    const std::string name = CMD::detail::axis_string(axis);
+    const std::string kp = "MG _KP" + name;
+    const std::string kd = "MG _KD" + name;
+    const std::string ki = "MG _KI" + name;
+    return GCmdD(g, kp.c_str(), &gains.KP) == G_NO_ERROR
+            && GCmdD(g, kd.c_str(), &gains.KD) == G_NO_ERROR
+            && GCmdD(g, ki.c_str(), &gains.KI) == G_NO_ERROR;
+}
+
+PlantModel fit_plant(const Record &record)
+{
+    PlantModel plant;
+    const std::vector<double> &x = record.position_cnts;
+    const std::vector<double> &u = record.command_V;
+    const double T = record.samplePeriod_s;
+    // differences over a few samples so encoder counts don't swamp the acceleration
+    constexpr int h {2};
+    if (T <= 0 || (int)x.size() < 4 * h) return plant;
+
+    // least squares fit of a = gain * u + c * v (c = -damping)
+    double Suu{}, Suv{}, Svv{}, Sua{}, Sva{};
+    std::vector<double> a, uAvg, v;
+    for (int n{h}; n < (int)x.size() - h; ++n)
+    {
+        const double vel = (x[n + h] - x[n - h]) / (2 * h * T);
+        const double acc = (x[n + h] - 2 * x[n] + x[n - h]) / std::pow(h * T, 2);
+        double cmd {};
+        for (int k{n - h}; k <= n + h; ++k) cmd += u[k];
+        cmd /= (2 * h + 1);
+
+        Suu += cmd * cmd;
+        Suv += cmd * vel;
+        Svv += vel * vel;
+        Sua += cmd * acc;
+        Sva += vel * acc;
+        a.push_back(acc);
+        uAvg.push_back(cmd);
+        v.push_back(vel);
+    }
+
+    const double det = Suu * Svv - Suv * Suv;
+    if (std::abs(det) < 1e-12) return plant;
+    const double gain = (Sua * Svv - Suv * Sva) / det;
+    const double c = (Suu * Sva - Suv * Sua) / det;
+
+    double mean {};
+    for (const double acc : a) mean += acc;
+    mean /= a.size();
+    double ssRes{}, ssTot{};
+    for (size_t i{0}; i < a.size(); ++i)
+    {
+        ssRes += std::pow(a[i] - (gain * uAvg[i] + c * v[i]), 2);
+        ssTot += std::pow(a[i] - mean, 2);
+    }
+
+    plant.gain_cnts_per_s2_per_V = gain;
+    plant.damping_per_s = -c;
+    plant.fit_R2 = ssTot > 0 ? 1.0 - ssRes / ssTot : 0;
+    return plant;
+}
+
+StepMetrics measure_step(const Record &record, double tolerance_cnts)
+{
+    StepMetrics metrics;
+    const std::vector<double> &x = record.position_cnts;
+    if (x.size() < 2) return metrics;
+
+    const double start = x.front();
+    const double target = x.back(); // where it ended up
+    const double step = target - start;
+    if (std::abs(step) <= tolerance_cnts) return metrics;
+
+    // the move starts when the axis first leaves the tolerance
+    size_t moveStart {0};
+    while (moveStart < x.size() && std::abs(x[moveStart] - start) <= tolerance_cnts) moveStart++;
+
+    double peak {0};
+    size_t lastOutside {moveStart};
+    for (size_t i{moveStart}; i < x.size(); ++i)
+    {
+        peak = std::max(peak, (x[i] - start) / step);
+        if (std::abs(x[i] - target) > tolerance_cnts) lastOutside = i;
+    }
+    metrics.overshoot_percent = std::max(0.0, (peak - 1.0) * 100.0);
+    metrics.settlingTime_s = (lastOutside + 1 - moveStart) * record.samplePeriod_s;
+    return metrics;
+}
+
+StepMetrics simulate_step(const PlantModel &plant, const Gains &gains,
+                          double step_cnts, double tolerance_cnts, double torqueLimit_V)
+{
+    StepMetrics metrics;
+    if (!plant.valid() || step_cnts == 0) return metrics;
+
+    constexpr int substeps {10};
+    const double dt = SERVO_PERIOD_S / substeps;
+    const int samples = (int)(SIMULATION_TIME_S / SERVO_PERIOD_S);
+
+    double x{}, v{}, integral{}, lastError{step_cnts};
+    double peak {};
+    int lastOutside {-1};
+    for (int n{0}; n < samples; ++n)
+    {
+        // the digital filter of the controller
+        const double error = step_cnts - x;
+        integral += error;
+        double u = DAC_V_PER_COUNT * (4 * gains.KP * error
+                                      + 4 * gains.KD * (error - lastError)
+                                      + gains.KI / 2 * integral);
+        u = std::clamp(u, -torqueLimit_V, torqueLimit_V);
+        lastError = error;
+
+        for (int k{0}; k < substeps; ++k)
+        {
+            const double a = plant.gain_cnts_per_s2_per_V * u - plant.damping_per_s * v;
+            v += a * dt;
+            x += v * dt;
+        }
+
+        peak = std::max(peak, x / step_cnts);
+        if (std::abs(x - step_cnts) > tolerance_cnts) lastOutside = n;
+        if (!std::isfinite(x)) return {100, -1};
+    }
+
+    metrics.overshoot_percent = std::max(0.0, (peak - 1.0) * 100.0);
+    metrics.settlingTime_s = (lastOutside == samples - 1) ? -1 : (lastOutside + 1) * SERVO_PERIOD_S;
+    return metrics;
+}
+
+Proposal propose_gains(const PlantModel &plant, double maxOvershoot_percent,
+                       double step_cnts, double tolerance_cnts, double torqueLimit_V)
+{
+    Proposal best;
+    if (!plant.valid()) return best;
+
+    // damping ratio of a second order system with this overshoot, the
+    // integrator adds to it so more damped loops and slower integrators are
+    // tried as well
+    const double logOvershoot = std::log(std::max(maxOvershoot_percent, 0.01) / 100.0);
+    const double minDamping = std::min(1.0, -logOvershoot / std::sqrt(PI * PI + logOvershoot * logOvershoot));
+
+    // Closed loop natural frequencies from 2 Hz to a twentieth of the servo
+    // rate (past that the sample delay isn't small compared to the loop).
+    // Each one is turned into gains that place the poles there, then checked
+    // on the simulated plant, with the motor command limit and integrator
+    constexpr int steps {80};
+    const double minFrequency = 2 * PI * 2;
+    const double maxFrequency = 2 * PI / (20 * SERVO_PERIOD_S);
+    const double K = plant.gain_cnts_per_s2_per_V;
+    for (double damping{minDamping}; damping < 2.0; damping += 0.1)
+    {
+        for (const double integratorRatio : {5.0, 10.0, 20.0, 50.0, 100.0})
+        {
+            for (int i{0}; i < steps; ++i)
+            {
+                const double wn = minFrequency * std::pow(maxFrequency / minFrequency, (double)i / (steps - 1));
+
+                // PD in volts per count (and per count/s) with the
+                // integrator zero under the loop
+                const double kp = wn * wn / K;
+                const double kd = std::max(0.0, (2 * damping * wn - plant.damping_per_s) / K);
+                const double ki = kp * wn / integratorRatio;
+
+                Gains gains;
+                gains.KP = std::min(MAX_KP, kp / (4 * DAC_V_PER_COUNT));
+                gains.KD = std::min(MAX_KD, kd / (4 * DAC_V_PER_COUNT * SERVO_PERIOD_S));
+                gains.KI = std::min(MAX_KI, 2 * ki * SERVO_PERIOD_S / DAC_V_PER_COUNT);
+
+                const StepMetrics metrics = simulate_step(plant, gains, step_cnts, tolerance_cnts, torqueLimit_V);
+                if (metrics.settlingTime_s < 0 || metrics.overshoot_percent > maxOvershoot_percent) continue;
+                if (!best.found || metrics.settlingTime_s < best.predicted.settlingTime_s)
+                {
+                    best.gains = gains;
+                    best.predicted = metrics;
+                    best.found = true;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+std::string set_gains(Axis axis, const Gains &gains)
+{
+    using CMD::detail::GCmd;
+    const std::string name = CMD::detail::axis_string(axis);
+    std::stringstream s;
+    s << GCmd("KP" + name + "=" + fixed(gains.KP, 3));
+    s << GCmd("KD" + name + "=" + fixed(gains.KD, 3));
+    s << GCmd("KI" + name + "=" + fixed(gains.KI, 3));
+    return s.str();
+}
+
+}
@@ -0,0 +1,268 @@
+#include "settlemodel.h"
+#include "servotuner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr int MAX_RECORD_LENGTH {Tuning::MAX_RECORD_LENGTH};
+// time at speed between the acceleration and the deceleration
+constexpr double CRUISE_TIME_S {0.3};
+// recorded after the deceleration, longer than any stop should take to settle
+constexpr double TAIL_TIME_S {0.5};
+
+double acceleration_time_s(const Settle::CalibrationMove &move)
+{
+    return move.speed_mm_s / move.acceleration_mm_s2;
+}
+
+// RC records every 2^n samples
+int record_period_exponent(double duration_s)
+{
+    return (int)std::lround(std::log2(Tuning::sample_period_s(duration_s) / Tuning::SERVO_PERIOD_S));
+}
+
+bool axis_from_string(const std::string &name, Axis &axis)
+{
+    for (Axis a : {Axis::X, Axis::Y, Axis::Z})
+    {
+        if (CMD::detail::axis_string(a) == name)
+        {
+            axis = a;
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+namespace Settle
+{
+
+double duration_s(const CalibrationMove &move)
+{
+    return 2 * acceleration_time_s(move) + CRUISE_TIME_S + TAIL_TIME_S;
+}
+
+double distance_mm(const CalibrationMove &move)
+{
+    return 2 * calculate_acceleration_distance(move.speed_mm_s, move.acceleration_mm_s2)
+            + move.speed_mm_s * CRUISE_TIME_S;
+}
+
+std::string calibration_move_commands(const CalibrationMove &move)
+{
+    using CMD::detail::GCmd;
+    const std::string size = std::to_string(MAX_RECORD_LENGTH);
+    const std::string errArray = ERROR_ARRAY;
+    const std::string refArray = REFERENCE_ARRAY;
+    const std::string name = CMD::detail::axis_string(move.axis);
+    const double duration = duration_s(move);
+
+    std::stringstream s;
+    s << GCmd("DA *[0]");
+    s << GCmd("DM " + errArray + "[" + size + "]," + refArray + "[" + size + "]");
+    s << GCmd("RA " + errArray + "[]," + refArray + "[]");
+    s << GCmd("RD _TE" + name + ",_RP" + name);
+    s << CMD::set_accleration(move.axis, move.acceleration_mm_s2);
+    s << CMD::set_deceleration(move.axis, move.acceleration_mm_s2);
+    s << CMD::set_speed(move.axis, move.speed_mm_s);
+    s << GCmd("RC " + std::to_string(record_period_exponent(duration)));
+    s << CMD::position_relative(move.axis, move.direction * distance_mm(move));
+    s << CMD::begin_motion(move.axis);
+    s << CMD::sleep((int)std::ceil(duration * 1000.0));
+    s << GCmd("RC 0");
+    return s.str();
+}
+
+bool measure(GCon g, const CalibrationMove &move, double tolerance_cnts, Measurement &measurement)
+{
+    if (!g) return false;
+
+    int count {};
+    if (GCmdI(g, "MG _RD", &count) != G_NO_ERROR || count <= 0) count = MAX_RECORD_LENGTH;
+    count = std::min(count, MAX_RECORD_LENGTH);
+
+    const std::vector<double> error = Tuning::upload_array(g, ERROR_ARRAY, count);
+    const std::vector<double> reference = Tuning::upload_array(g, REFERENCE_ARRAY, count);
+    const int size = (int)std::min(error.size(), reference.size());
+    if (size < 2) return false;
+
+    // where the reference starts and stops moving
+    int start {0};
+    while (start < size && reference[start] == reference[0]) start++;
+    int end {size - 1};
+    while (end > 0 && reference[end - 1] == reference[size - 1]) end--;
+    if (start >= end) return false;
+
+    const double T = Tuning::sample_period_s(duration_s(move));
+    const int accelerationSamples = (int)std::ceil(acceleration_time_s(move) / T);
+    const int cruiseStart = start + accelerationSamples;
+    const int decelerationStart = end - accelerationSamples;
+    if (cruiseStart >= decelerationStart) return false;
+
+    // the first sample from which the error stays within tolerance at speed
+    int settled {decelerationStart};
+    while (settled > cruiseStart && std::abs(error[settled - 1]) <= tolerance_cnts) settled--;
+    if (settled == decelerationStart) return false;
+
+    // the last sample out of tolerance after the stop
+    int lastOut {size - 1};
+    while (lastOut >= end && std::abs(error[lastOut]) <= tolerance_cnts) lastOut--;
+    if (lastOut == size - 1) return false;
+
+    // a sample late at worst, so round up to the next one
+    measurement.axis = move.axis;
+    measurement.speed_mm_s = move.speed_mm_s;
+    measurement.acceleration_mm_s2 = move.acceleration_mm_s2;
+    measurement.runUpSettle_ms = settled > cruiseStart ? (settled - cruiseStart + 1) * T * 1000.0 : 0;
+    measurement.stopSettle_ms = lastOut >= end ? (lastOut - end + 2) * T * 1000.0 : 0;
+    return true;
+}
+
+void Model::add(const Measurement &measurement)
+{
+    // a new measurement of the same move replaces the old one
+    auto same = std::find_if(measurements_.begin(), measurements_.end(), [&](const Measurement &m) {
+        return m.axis == measurement.axis
+                && m.speed_mm_s == measurement.speed_mm_s
+                && m.acceleration_mm_s2 == measurement.acceleration_mm_s2;
+    });
+    if (same != measurements_.end()) *same = measurement;
+    else measurements_.push_back(measurement);
+}
+
+void Model::clear()
+{
+    measurements_.clear();
+}
+
+const Measurement *Model::covering(Axis axis, double speed_mm_s, double acceleration_mm_s2) const
+{
+    const Measurement *closest {nullptr};
+    double closestDistance {};
+    for (const auto &m : measurements_)
+    {
+        if (m.axis != axis || m.speed_mm_s < speed_mm_s || m.acceleration_mm_s2 < acceleration_mm_s2)
+            continue;
+        // relative, speeds and accelerations are orders of magnitude apart
+        const double distance = (m.speed_mm_s - speed_mm_s) / m.speed_mm_s
+                + (m.acceleration_mm_s2 - acceleration_mm_s2) / m.acceleration_mm_s2;
+        if (!closest || distance < closestDistance)
+        {
+            closest = &m;
+            closestDistance = distance;
+        }
+    }
+    return closest;
+}
+
+double Model::run_up_settle_ms(Axis axis, double speed_mm_s, double acceleration_mm_s2) const
+{
+    const Measurement *m = covering(axis, speed_mm_s, acceleration_mm_s2);
+    return m ? m->runUpSettle_ms : -1;
+}
+
+double Model::stop_settle_ms(Axis axis, double speed_mm_s, double acceleration_mm_s2) const
+{
+    const Measurement *m = covering(axis, speed_mm_s, acceleration_mm_s2);
+    return m ? m->stopSettle_ms : -1;
+}
+
+bool Model::save(const std::string &fileName) const
+{
+    json j = json::array();
+    for (const auto &m : measurements_)
+    {
+        j.push_back({{"axis", CMD::detail::axis_string(m.axis)},
+                     {"speed_mm_s", m.speed_mm_s},
+                     {"acceleration_mm_s2", m.acceleration_mm_s2},
+                     {"runUpSettle_ms", m.runUpSettle_ms},
+                     {"stopSettle_ms", m.stopSettle_ms}});
+    }
+
+    const std::string text = json{{"measurements", j}}.dump(2);
+    QSaveFile file(QString::fromStdString(fileName));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    if (file.write(text.data(), (qint64)text.size()) != (qint64)text.size())
+    {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool Model::load(const std::string &fileName)
+{
+    QFile file(QString::fromStdString(fileName));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QByteArray text = file.readAll();
+
+    std::vector<Measurement> measurements;
+    try
+    {
+        const json j = json::parse(text.constData(), text.constData() + text.size());
+        for (const auto &entry : j.at("measurements"))
+        {
+            Measurement m;
+            if (!axis_from_string(entry.at("axis").get<std::string>(), m.axis)) return false;
+            m.speed_mm_s = entry.at("speed_mm_s").get<double>();
+            m.acceleration_mm_s2 = entry.at("acceleration_mm_s2").get<double>();
+            m.runUpSettle_ms = entry.at("runUpSettle_ms").get<double>();
+            m.stopSettle_ms = entry.at("stopSettle_ms").get<double>();
+            measurements.push_back(m);
+        }
+    }
+    catch (const json::exception &)
+    {
+        return false;
+    }
+
+    measurements_ = measurements;
+    return true;
+}
+
+std::string default_file()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/BJ_Settings";
+    if (!QDir(dir).exists()) QDir().mkdir(dir);
+    return (dir + "/settle_model.json").toStdString();
+}
+
+Model &model()
+{
+    static Model model = [] {
+        Model m;
+        m.load(default_file()); // stays empty until calibrated
+        return m;
+    }();
+    return model;
+}
+
+double run_up_distance_mm(Axis axis, double speed_mm_s, double acceleration_mm_s2, double fallbackMargin_mm)
+{
+    const double accelerationDistance_mm = calculate_acceleration_distance(speed_mm_s, acceleration_mm_s2);
+    const double settle_ms = model().run_up_settle_ms(axis, speed_mm_s, acceleration_mm_s2);
+    if (settle_ms < 0) return accelerationDistance_mm + fallbackMargin_mm;
+    return accelerationDistance_mm + speed_mm_s * settle_ms / 1000.0;
+}
+
+int stop_wait_ms(Axis axis, double speed_mm_s, double acceleration_mm_s2, int fallback_ms)
+{
+    const double settle_ms = model().stop_settle_ms(axis, speed_mm_s, acceleration_mm_s2);
+    if (settle_ms < 0) return fallback_ms;
+    return (int)std::ceil(settle_ms);
+}
+
+}
@@ -0,0 +1,294 @@
+#include "slicer.h"
+
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+Mesh load_binary_stl(const std::string &fileName)
+{
+    Mesh mesh;
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file) return mesh;
+
+    // 80 byte header, triangle count, then 50 bytes per triangle
+    constexpr std::streamoff headerSize {80 + sizeof(uint32_t)};
+    constexpr std::streamoff triangleSize {50};
+    const std::streamoff fileSize = file.tellg();
+    if (fileSize < headerSize) return mesh;
+
+    uint32_t count {};
+    file.seekg(80);
+    file.read(reinterpret_cast<char *>(&count), sizeof(count));
+
+    // ASCII files (or truncated binary ones) won't match the expected size
+    if (!file || fileSize != headerSize + (std::streamoff)count * triangleSize) return mesh;
+
+    std::vector<char> buf((size_t)count * triangleSize);
+    file.read(buf.data(), (std::streamsize)buf.size());
+    if (!file) return mesh;
+
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    mesh.min = {inf, inf, inf};
+    mesh.max = {-inf, -inf, -inf};
+    mesh.triangles.resize(count);
+    for (uint32_t i{0}; i < count; ++i)
+    {
+        // skip the normal (12 bytes), the attribute count is after the vertices
+        const char *t = buf.data() + (size_t)i * triangleSize + 12;
+        Triangle &triangle = mesh.triangles[i];
+        std::memcpy(triangle.v, t, sizeof(triangle.v));
+        for (const Vertex &v : triangle.v)
+        {
+            mesh.min = {std::min(mesh.min.x, v.x), std::min(mesh.min.y, v.y), std::min(mesh.min.z, v.z)};
+            mesh.max = {std::max(mesh.max.x, v.x), std::max(mesh.max.y, v.y), std::max(mesh.max.z, v.z)};
+        }
+    }
+
+    return mesh;
+}
+
+Slicer::Slicer(const Mesh &mesh, const SliceSettings &settings) :
+    mesh_(mesh),
+    settings_(settings),
+    dropletSpacing_mm_(settings.dropletSpacing_um / 1000.0),
+    lineSpacing_mm_(settings.lineSpacing_um / 1000.0),
+    layerHeight_mm_(settings.layerHeight_um / 1000.0)
+{
+    if (mesh.empty() || dropletSpacing_mm_ <= 0 || lineSpacing_mm_ <= 0 || layerHeight_mm_ <= 0) return;
+
+    width_ = std::max(1, (int)std::ceil((mesh.max.x - mesh.min.x) / dropletSpacing_mm_));
+    height_ = std::max(1, (int)std::ceil((mesh.max.y - mesh.min.y) / lineSpacing_mm_));
+    numLayers_ = std::max(1, (int)std::ceil((mesh.max.z - mesh.min.z) / layerHeight_mm_));
+
+    build_layer_index();
+}
+
+LayerFileHeader Slicer::file_header() const
+{
+    LayerFileHeader header;
+    header.width = width_;
+    header.height = height_;
+    header.layerCount = numLayers_;
+    header.dropletSpacing_um = settings_.dropletSpacing_um;
+    header.lineSpacing_um = settings_.lineSpacing_um;
+    header.layerHeight_um = settings_.layerHeight_um;
+    // droplets are in the middle of their cells
+    header.originX_mm = mesh_.min.x + 0.5 * dropletSpacing_mm_;
+    header.originY_mm = mesh_.min.y + 0.5 * lineSpacing_mm_;
+    return header;
+}
+
+double Slicer::layer_z(int layer) const
+{
+    return mesh_.min.z + (layer + 0.5) * layerHeight_mm_;
+}
+
+void Slicer::build_layer_index()
+{
+    // layers a triangle can cross: layer_z(i) in [zmin, zmax)
+    auto layer_range = [this](const Triangle &t, int &first, int &last)
+    {
+        const double zmin = std::min({t.v[0].z, t.v[1].z, t.v[2].z});
+        const double zmax = std::max({t.v[0].z, t.v[1].z, t.v[2].z});
+        first = std::max(0, (int)std::ceil((zmin - mesh_.min.z) / layerHeight_mm_ - 0.5));
+        last = std::min(numLayers_ - 1, (int)std::ceil((zmax - mesh_.min.z) / layerHeight_mm_ - 0.5) - 1);
+    };
+
+    // count the triangles in each layer, then fill them in
+    std::vector<uint32_t> counts(numLayers_ + 1, 0);
+    for (const Triangle &t : mesh_.triangles)
+    {
+        int first, last;
+        layer_range(t, first, last);
+        for (int i{first}; i <= last; ++i) counts[i]++;
+    }
+
+    layerStart_.assign(numLayers_ + 1, 0);
+    for (int i{0}; i < numLayers_; ++i) layerStart_[i + 1] = layerStart_[i] + counts[i];
+
+    layerTriangles_.resize(layerStart_.back());
+    std::vector<uint32_t> fill(layerStart_.begin(), layerStart_.end() - 1);
+    for (uint32_t index{0}; index < mesh_.triangles.size(); ++index)
+    {
+        int first, last;
+        layer_range(mesh_.triangles[index], first, last);
+        for (int i{first}; i <= last; ++i) layerTriangles_[fill[i]++] = index;
+    }
+}
+
+std::vector<Slicer::Segment> Slicer::layer_segments(int layer) const
+{
+    std::vector<Segment> segments;
+    const double z = layer_z(layer);
+
+    for (uint32_t i{layerStart_[layer]}; i < layerStart_[layer + 1]; ++i)
+    {
+        const Triangle &t = mesh_.triangles[layerTriangles_[i]];
+
+        // a vertex exactly on the plane counts as below it, so the plane
+        // never cuts through a vertex
+        bool above[3];
+        int numAbove {0};
+        for (int k{0}; k < 3; ++k)
+        {
+            above[k] = t.v[k].z > z;
+            numAbove += above[k];
+        }
+        if (numAbove == 0 || numAbove == 3) continue;
+
+        // the two edges with one vertex on each side of the plane
+        float points[2][2];
+        int n {0};
+        for (int k{0}; k < 3; ++k)
+        {
+            const Vertex &a = t.v[k];
+            const Vertex &b = t.v[(k + 1) % 3];
+            if (above[k] == above[(k + 1) % 3]) continue;
+            const double f = (z - a.z) / (b.z - a.z);
+            points[n][0] = (float)(a.x + f * (b.x - a.x));
+            points[n][1] = (float)(a.y + f * (b.y - a.y));
+            n++;
+        }
+        segments.push_back({points[0][0], points[0][1], points[1][0], points[1][1]});
+    }
+
+    return segments;
+}
+
+DropletLayer Slicer::slice_layer(int layer) const
+{
+    DropletLayer result(width_, height_);
+    if (layer < 0 || layer >= numLayers_) return result;
+
+    // x positions where each row of droplet centers crosses the outline
+    std::vector<std::vector<float>> crossings(height_);
+    const double topY = mesh_.min.y + height_ * lineSpacing_mm_;
+    for (const Segment &seg : layer_segments(layer))
+    {
+        if (seg.y0 == seg.y1) continue;
+
+        // row r is at y = topY - (r + 0.5) * lineSpacing
+        const double ymin = std::min(seg.y0, seg.y1);
+        const double ymax = std::max(seg.y0, seg.y1);
+        const int firstRow = std::max(0, (int)std::floor((topY - ymax) / lineSpacing_mm_ - 0.5));
+        const int lastRow = std::min(height_ - 1, (int)std::ceil((topY - ymin) / lineSpacing_mm_ - 0.5));
+        for (int r{firstRow}; r <= lastRow; ++r)
+        {
+            const double y = topY - (r + 0.5) * lineSpacing_mm_;
+            // half open so a row through a shared end point only counts once
+            if ((seg.y0 <= y) == (seg.y1 <= y)) continue;
+            const double f = (y - seg.y0) / (seg.y1 - seg.y0);
+            crossings[r].push_back((float)(seg.x0 + f * (seg.x1 - seg.x0)));
+        }
+    }
+
+    for (int r{0}; r < height_; ++r)
+    {
+        auto &xs = crossings[r];
+        if (xs.size() < 2) continue;
+        std::sort(xs.begin(), xs.end());
+
+        // even-odd fill, droplet c is at x = min.x + (c + 0.5) * dropletSpacing
+        for (size_t i{0}; i + 1 < xs.size(); i += 2)
+        {
+            const int first = std::max(0, (int)std::ceil((xs[i] - mesh_.min.x) / dropletSpacing_mm_ - 0.5));
+            const int last = std::min(width_ - 1, (int)std::ceil((xs[i + 1] - mesh_.min.x) / dropletSpacing_mm_ - 0.5) - 1);
+            if (first <= last) result.set_span(r, first, last);
+        }
+    }
+
+    return result;
+}
+
+bool Slicer::slice_to_file(const std::string &fileName,
+                           const std::function<void(int, int)> &progress,
+                           const std::atomic<bool> *cancel) const
+{
+    if (numLayers_ == 0) return false;
+
+    LayerFileWriter writer;
+    if (!writer.open(fileName, file_header())) return false;
+
+    int numThreads = settings_.numThreads;
+    if (numThreads <= 0) numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, numLayers_);
+    // how far the slicing threads can get ahead of the writer
+    const int maxLayersInMemory = 2 * numThreads;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<int, DropletLayer> sliced; // waiting to be written
+    int nextLayer {0};
+    int layersWritten {0};
+    bool stopped {false};
+
+    auto slice_layers = [&]()
+    {
+        while (true)
+        {
+            int layer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() {
+                    return stopped || nextLayer >= numLayers_ || nextLayer < layersWritten + maxLayersInMemory;
+                });
+                if (stopped || nextLayer >= numLayers_) return;
+                layer = nextLayer++;
+            }
+
+            DropletLayer result = slice_layer(layer);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                sliced.emplace(layer, std::move(result));
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (int i{0}; i < numThreads; ++i) threads.emplace_back(slice_layers);
+
+    // write the layers in order as they are finished
+    bool ok {true};
+    while (layersWritten < numLayers_)
+    {
+        DropletLayer layer;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return sliced.count(layersWritten) > 0; });
+            auto it = sliced.find(layersWritten);
+            layer = std::move(it->second);
+            sliced.erase(it);
+        }
+
+        if ((cancel && *cancel) || !writer.write_layer(layer))
+        {
+            ok = false;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            layersWritten++;
+        }
+        changed.notify_all();
+        if (progress) progress(layersWritten, numLayers_);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    changed.notify_all();
+    for (auto &thread : threads) thread.join();
+
+    return writer.close() && ok;
+}
@@ -54,6 +54,7 @@
 #include <QWheelEvent>
 #include <QMouseEvent>
 #include <QGraphicsRectItem>
+#include <QGraphicsPathItem>
 #include <QGraphicsSvgItem>
 #include <QPaintEvent>
 #include <qmath.h>
@@ -116,6 +117,7 @@ void SvgView::setup(double xSize, double ySize)
     mXSize = xSize;
     mYSize = ySize;
     scene()->clear();
+    m_lineGroups.clear();
     resetTransform();
 
     scene()->setSceneRect(0, 0, mXSize, mYSize);
@@ -139,9 +141,39 @@ void SvgView::add_print_bed_outline()
 void SvgView::clear_lines()
 {
     scene()->clear();
+    m_lineGroups.clear();
     add_print_bed_outline();
 }
 
+void SvgView::set_line_group(int group, const std::vector<QLineF> &lines, const QPen &pen)
+{
+    QPainterPath path;
+    for (const auto &line : lines)
+    {
+        path.moveTo(line.p1());
+        path.lineTo(line.p2());
+    }
+
+    auto it = m_lineGroups.find(group);
+    if (it == m_lineGroups.end())
+    {
+        m_lineGroups[group] = scene()->addPath(path, pen);
+    }
+    else
+    {
+        it->second->setPath(path);
+        it->second->setPen(pen);
+    }
+}
+
+void SvgView::remove_line_groups_from(int group)
+{
+    for (auto it = m_lineGroups.lower_bound(group); it != m_lineGroups.end(); it = m_lineGroups.erase(it))
+    {
+        delete it->second; // removes it from the scene
+    }
+}
+
 bool SvgView::openFile(const QString &fileName)
 {
     QGraphicsScene *s = scene();
@@ -153,6 +185,7 @@ bool SvgView::openFile(const QString &fileName)
     if (!svgItem->renderer()->isValid()) return false;
 
     s->clear();
+    m_lineGroups.clear();
     resetTransform();
 
     m_svgItem = svgItem.take();
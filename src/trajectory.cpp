@@ -0,0 +1,324 @@
+#include "trajectory.h"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace Trajectory
+{
+
+namespace
+{
+constexpr double PI {3.14159265358979323846};
+
+// rounds a duration up to a whole number of servo samples
+int samples_ceil(double time_s)
+{
+    // small tolerance so exact multiples don't get bumped up a sample
+    return (int)std::ceil(time_s * SAMPLES_PER_SECOND - 1e-9);
+}
+
+double phase_position(const Phase &phase, double dt)
+{
+    return phase.startPosition_mm
+            + phase.startVelocity_mm_s * dt
+            + 0.5 * phase.startAcceleration_mm_s2 * dt * dt
+            + phase.jerk_mm_s3 * dt * dt * dt / 6.0;
+}
+
+double phase_velocity(const Phase &phase, double dt)
+{
+    return phase.startVelocity_mm_s
+            + phase.startAcceleration_mm_s2 * dt
+            + 0.5 * phase.jerk_mm_s3 * dt * dt;
+}
+
+double phase_acceleration(const Phase &phase, double dt)
+{
+    return phase.startAcceleration_mm_s2 + phase.jerk_mm_s3 * dt;
+}
+
+int to_samples(double time_s)
+{
+    return (int)std::lround(time_s * SAMPLES_PER_SECOND);
+}
+}
+
+std::vector<ShaperImpulse> shaper_impulses(const InputShaper &shaper)
+{
+    if (shaper.type == InputShaper::Type::None || shaper.frequency_Hz <= 0
+        || shaper.dampingRatio < 0 || shaper.dampingRatio >= 1)
+        return {{1, 0}};
+
+    // the impulses are half a damped period apart, each one cancelling the
+    // vibration the one before it leaves behind
+    const double root = std::sqrt(1 - shaper.dampingRatio * shaper.dampingRatio);
+    const double K = std::exp(-shaper.dampingRatio * PI / root);
+    const double halfPeriod_s = 0.5 / (shaper.frequency_Hz * root);
+    const int delay = to_samples(halfPeriod_s);
+
+    if (shaper.type == InputShaper::Type::ZV)
+        return {{1 / (1 + K), 0}, {K / (1 + K), delay}};
+
+    // ZVD: the ZV shaper twice, less sensitive to an error in the frequency
+    const double sum = (1 + K) * (1 + K);
+    return {{1 / sum, 0}, {2 * K / sum, delay}, {K * K / sum, 2 * delay}};
+}
+
+void Profile::add_phase(double duration_s, double startAcceleration_mm_s2, double jerk_mm_s3)
+{
+    if (duration_s <= 0) return;
+
+    Phase phase;
+    phase.duration_s = duration_s;
+    phase.startAcceleration_mm_s2 = startAcceleration_mm_s2;
+    phase.jerk_mm_s3 = jerk_mm_s3;
+
+    if (!phases_.empty())
+    {
+        const Phase &prev = phases_.back();
+        phase.startTime_s = prev.startTime_s + prev.duration_s;
+        phase.startPosition_mm = phase_position(prev, prev.duration_s);
+        phase.startVelocity_mm_s = phase_velocity(prev, prev.duration_s);
+    }
+
+    phases_.push_back(phase);
+}
+
+double Profile::total_time_s() const
+{
+    if (phases_.empty()) return 0;
+    return phases_.back().startTime_s + phases_.back().duration_s;
+}
+
+double Profile::position_at(double time_s) const
+{
+    if (phases_.empty() || time_s <= 0) return 0;
+
+    for (const auto &phase : phases_)
+    {
+        if (time_s <= phase.startTime_s + phase.duration_s)
+            return phase_position(phase, time_s - phase.startTime_s);
+    }
+    // past the end of the move
+    return phase_position(phases_.back(), phases_.back().duration_s);
+}
+
+double Profile::velocity_at(double time_s) const
+{
+    if (phases_.empty() || time_s <= 0) return 0;
+
+    for (const auto &phase : phases_)
+    {
+        if (time_s <= phase.startTime_s + phase.duration_s)
+            return phase_velocity(phase, time_s - phase.startTime_s);
+    }
+    return 0;
+}
+
+std::string Profile::commands(Axis axis) const
+{
+    std::stringstream s;
+    const double cntsPerMM = CMD::detail::counts_per_mm(axis);
+
+    double position_mm {0};
+    long long position_cnts {0};
+    for (const auto &point : points_)
+    {
+        position_mm += point.relativePosition_mm;
+        const long long target_cnts = std::llround(position_mm * cntsPerMM);
+        s << CMD::add_pvt_counts_to_buffer(axis,
+                                           (int)(target_cnts - position_cnts),
+                                           (int)std::lround(point.velocity_mm_s * cntsPerMM),
+                                           point.time_samples);
+        position_cnts = target_cnts;
+    }
+    s << CMD::exit_pvt_mode(axis);
+
+    return s.str();
+}
+
+void Profile::make_points()
+{
+    // convert phases to PVT segments, splitting any that are too long
+    points_.clear();
+    double prevPosition_mm {0};
+    for (const auto &phase : phases_)
+    {
+        const int phaseSamples = to_samples(phase.duration_s);
+        const int numSegments = (phaseSamples + MAX_PVT_SEGMENT_SAMPLES - 1) / MAX_PVT_SEGMENT_SAMPLES;
+
+        int prevSample {0};
+        for (int i{1}; i <= numSegments; ++i)
+        {
+            // spread the samples evenly over the segments
+            const int sample = (int)(((long long)phaseSamples * i) / numSegments);
+            const double dt = sample / (double)SAMPLES_PER_SECOND;
+            const double position_mm = phase_position(phase, dt);
+
+            PVTPoint point;
+            point.relativePosition_mm = position_mm - prevPosition_mm;
+            point.velocity_mm_s = phase_velocity(phase, dt);
+            point.time_samples = sample - prevSample;
+            points_.push_back(point);
+
+            prevPosition_mm = position_mm;
+            prevSample = sample;
+        }
+    }
+
+    // the last point must bring the axis exactly to rest
+    if (!points_.empty()) points_.back().velocity_mm_s = 0;
+}
+
+Profile plan_constant_velocity_move(
+        double constantVelocityDistance_mm,
+        double velocity_mm_s,
+        const AxisLimits &limits)
+{
+    if (limits.acceleration_mm_s2 <= 0)
+        throw std::invalid_argument("acceleration limit must be greater than 0");
+    if (velocity_mm_s == 0)
+        throw std::invalid_argument("velocity must not be 0");
+    if (constantVelocityDistance_mm < 0)
+        throw std::invalid_argument("constant velocity distance must not be negative");
+
+    const double speed = std::abs(velocity_mm_s);
+    const double direction = velocity_mm_s < 0 ? -1.0 : 1.0;
+
+    // minimum time ramp within the limits
+    double jerkTime_s {0};
+    double accelTime_s {speed / limits.acceleration_mm_s2};
+    if (limits.jerk_mm_s3 > 0)
+    {
+        jerkTime_s = limits.acceleration_mm_s2 / limits.jerk_mm_s3;
+        if (speed < limits.acceleration_mm_s2 * jerkTime_s)
+        {
+            // never reaches the acceleration limit
+            jerkTime_s = std::sqrt(speed / limits.jerk_mm_s3);
+            accelTime_s = 0;
+        }
+        else
+        {
+            accelTime_s = speed / limits.acceleration_mm_s2 - jerkTime_s;
+        }
+    }
+
+    // Round each phase up to whole samples. Stretching a phase only lowers
+    // the acceleration and jerk that are needed, so the limits still hold.
+    const int jerkSamples = samples_ceil(jerkTime_s);
+    int accelSamples = samples_ceil(accelTime_s);
+    if (jerkSamples + accelSamples == 0) accelSamples = 1;
+    jerkTime_s = jerkSamples / (double)SAMPLES_PER_SECOND;
+    accelTime_s = accelSamples / (double)SAMPLES_PER_SECOND;
+
+    const double peakAccel = speed / (jerkTime_s + accelTime_s);
+    const double jerk = (jerkSamples > 0) ? peakAccel / jerkTime_s : 0;
+
+    // keep the velocity exact (it sets the droplet spacing) and let the
+    // constant velocity distance land on a whole sample. Shaping eats into
+    // the start of the constant velocity, so it is made that much longer
+    const int shaperSamples = shaper_impulses(limits.shaper).back().delay_samples;
+    const int constantVelocitySamples =
+            (int)std::lround(constantVelocityDistance_mm / speed * SAMPLES_PER_SECOND) + shaperSamples;
+    const double constantVelocityTime_s = constantVelocitySamples / (double)SAMPLES_PER_SECOND;
+
+    Profile profile;
+    profile.velocity_mm_s_ = velocity_mm_s;
+
+    // ramp up
+    if (jerkSamples > 0)
+    {
+        profile.add_phase(jerkTime_s, 0, direction * jerk);
+        profile.add_phase(accelTime_s, direction * peakAccel, 0);
+        profile.add_phase(jerkTime_s, direction * peakAccel, -direction * jerk);
+    }
+    else profile.add_phase(accelTime_s, direction * peakAccel, 0);
+
+    profile.constantVelocityStart_s_ = profile.total_time_s();
+    profile.accelerationDistance_mm_ = std::abs(profile.position_at(profile.total_time_s()));
+
+    // constant velocity
+    profile.add_phase(constantVelocityTime_s, 0, 0);
+    profile.constantVelocityEnd_s_ = profile.total_time_s();
+    profile.constantVelocityDistance_mm_ = speed * constantVelocityTime_s;
+
+    // ramp down (mirror of the ramp up)
+    if (jerkSamples > 0)
+    {
+        profile.add_phase(jerkTime_s, 0, -direction * jerk);
+        profile.add_phase(accelTime_s, -direction * peakAccel, 0);
+        profile.add_phase(jerkTime_s, -direction * peakAccel, direction * jerk);
+    }
+    else profile.add_phase(accelTime_s, -direction * peakAccel, 0);
+
+    if (shaperSamples > 0) return shape(profile, limits.shaper);
+
+    profile.make_points();
+    return profile;
+}
+
+Profile shape(const Profile &profile, const InputShaper &shaper)
+{
+    const std::vector<ShaperImpulse> impulses = shaper_impulses(shaper);
+
+    // The shaped profile is a sum of delayed copies of the profile, so it is
+    // still a cubic between the delayed ends of its phases
+    std::vector<int> breaks;
+    for (const auto &phase : profile.phases_)
+    {
+        for (const auto &impulse : impulses)
+        {
+            breaks.push_back(to_samples(phase.startTime_s) + impulse.delay_samples);
+            breaks.push_back(to_samples(phase.startTime_s + phase.duration_s) + impulse.delay_samples);
+        }
+    }
+    std::sort(breaks.begin(), breaks.end());
+    breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+
+    // acceleration and jerk of the profile just after the sample
+    auto acceleration_and_jerk = [&profile](int sample, double &acceleration, double &jerk)
+    {
+        for (const auto &phase : profile.phases_)
+        {
+            const int start = to_samples(phase.startTime_s);
+            if (sample >= start && sample < start + to_samples(phase.duration_s))
+            {
+                const double dt = (sample - start) / (double)SAMPLES_PER_SECOND;
+                acceleration = phase_acceleration(phase, dt);
+                jerk = phase.jerk_mm_s3;
+                return;
+            }
+        }
+    };
+
+    Profile shaped;
+    shaped.velocity_mm_s_ = profile.velocity_mm_s_;
+    for (size_t i{1}; i < breaks.size(); ++i)
+    {
+        double acceleration {}, jerk {};
+        for (const auto &impulse : impulses)
+        {
+            double a {}, j {};
+            acceleration_and_jerk(breaks[i - 1] - impulse.delay_samples, a, j);
+            acceleration += impulse.amplitude * a;
+            jerk += impulse.amplitude * j;
+        }
+        shaped.add_phase((breaks[i] - breaks[i - 1]) / (double)SAMPLES_PER_SECOND, acceleration, jerk);
+    }
+
+    // the velocity is only constant once every copy has finished ramping up
+    // and until the first starts ramping down
+    const double shaperTime_s = impulses.back().delay_samples / (double)SAMPLES_PER_SECOND;
+    shaped.constantVelocityStart_s_ = profile.constantVelocityStart_s_ + shaperTime_s;
+    shaped.constantVelocityEnd_s_ = std::max(shaped.constantVelocityStart_s_, profile.constantVelocityEnd_s_);
+    shaped.constantVelocityDistance_mm_ = std::abs(shaped.velocity_mm_s_)
+            * (shaped.constantVelocityEnd_s_ - shaped.constantVelocityStart_s_);
+    shaped.accelerationDistance_mm_ = std::abs(shaped.position_at(shaped.constantVelocityStart_s_));
+
+    shaped.make_points();
+    return shaped;
+}
+
+}
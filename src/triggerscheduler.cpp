@@ -0,0 +1,76 @@
+#include "triggerscheduler.h"
+
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+TriggerScheduler::TriggerScheduler(const Trajectory::Profile &profile, Axis axis, double moveStart_mm) :
+    profile_(profile),
+    axis_(axis),
+    moveStart_mm_(moveStart_mm)
+{
+
+}
+
+void TriggerScheduler::add_event(double time_s, const std::string &commands)
+{
+    events_.push_back({time_s, commands});
+}
+
+bool TriggerScheduler::moving_at(double time_s) const
+{
+    if (time_s <= 0 || time_s >= profile_.total_time_s()) return false;
+
+    // need to move at least a count per sample for the trippoint to resolve
+    // better than the time based one
+    const double countsPerSample = std::abs(profile_.velocity_at(time_s))
+            * CMD::detail::counts_per_mm(axis_) / Trajectory::SAMPLES_PER_SECOND;
+    return countsPerSample >= 1.0;
+}
+
+std::string TriggerScheduler::commands() const
+{
+    std::stringstream s;
+
+    std::vector<Event> events = events_;
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event &a, const Event &b) { return a.time_s < b.time_s; });
+
+    // time reference is the earliest of the move start and the first event
+    const double referenceTime_s = events.empty() ? 0 : std::min(0.0, events.front().time_s);
+    auto samples_from_reference = [referenceTime_s](double time_s)
+    { return (int)std::lround((time_s - referenceTime_s) * Trajectory::SAMPLES_PER_SECOND); };
+
+    s << CMD::set_reference_time();
+
+    bool moveStarted {false};
+    auto start_move = [&]()
+    {
+        // AT 0 would reset the reference, so only wait if there is a wait
+        const int samples = samples_from_reference(0);
+        if (samples > 0) s << CMD::at_time_samples(samples);
+        s << CMD::begin_pvt_motion(axis_);
+        moveStarted = true;
+    };
+
+    for (const auto &event : events)
+    {
+        if (!moveStarted && event.time_s >= 0) start_move();
+
+        if (moveStarted && moving_at(event.time_s))
+        {
+            const double position_mm = moveStart_mm_ + profile_.position_at(event.time_s);
+            s << CMD::after_absolute_position(axis_, position_mm);
+        }
+        else
+        {
+            const int samples = samples_from_reference(event.time_s);
+            if (samples > 0) s << CMD::at_time_samples(samples);
+        }
+        s << event.commands;
+    }
+
+    if (!moveStarted) start_move();
+
+    return s.str();
+}
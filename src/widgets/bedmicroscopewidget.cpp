@@ -4,6 +4,7 @@
 #include "display.h"
 #include "bedmicroscope.h"
 #include "dmc4080.h"
+#include "jobfile.h"
 
 #include <QImage>
 #include <QPainter>
@@ -101,6 +102,57 @@ void BedMicroscopeWidget::allow_widget_input(bool allowed)
     ui->frame->setEnabled(allowed);
 }
 
+bool BedMicroscopeWidget::save_job(JobFile &job)
+{
+    job.type = "bed scan";
+    job.settings["numX"] = ui->numXSpinBox->value();
+    job.settings["numY"] = ui->numYSpinBox->value();
+    job.settings["xStart_mm"] = ui->xStartPositionSpinBox->value();
+    job.settings["yStart_mm"] = ui->yStartPositionSpinBox->value();
+    job.settings["xSpacing_mm"] = ui->xSpacingSpinBox->value();
+    job.settings["ySpacing_mm"] = ui->ySpacingSpinBox->value();
+    job.settings["bedID"] = ui->bedIDSpinBox->value();
+    job.settings["saveFolder"] = saveFolderPath.toStdString();
+    return true;
+}
+
+bool BedMicroscopeWidget::load_job(const JobFile &job)
+{
+    if (job.type != "bed scan") return false;
+
+    const auto &s = job.settings;
+    ui->numXSpinBox->setValue(s.value("numX", ui->numXSpinBox->value()));
+    ui->numYSpinBox->setValue(s.value("numY", ui->numYSpinBox->value()));
+    ui->xStartPositionSpinBox->setValue(s.value("xStart_mm", ui->xStartPositionSpinBox->value()));
+    ui->yStartPositionSpinBox->setValue(s.value("yStart_mm", ui->yStartPositionSpinBox->value()));
+    ui->xSpacingSpinBox->setValue(s.value("xSpacing_mm", ui->xSpacingSpinBox->value()));
+    ui->ySpacingSpinBox->setValue(s.value("ySpacing_mm", ui->ySpacingSpinBox->value()));
+    ui->bedIDSpinBox->setValue(s.value("bedID", ui->bedIDSpinBox->value()));
+    const QString folder = QString::fromStdString(s.value("saveFolder", std::string{}));
+    if (!folder.isEmpty())
+    {
+        saveFolderPath = folder;
+        ui->saveFolderLabel->setText(saveFolderPath);
+    }
+    return true;
+}
+
+bool BedMicroscopeWidget::run_job(const JobFile &job)
+{
+    if (!load_job(job)) return false;
+
+    if (!mPrinter->bedMicroscope->is_connected())
+        emit job_finished(false, "The microscope camera is not connected");
+    else if (saveFolderPath.isEmpty())
+        emit job_finished(false, "The job does not have a folder to save the images in");
+    else
+    {
+        capture_images();
+        finish_job_when_stream_ends();
+    }
+    return true;
+}
+
 void BedMicroscopeWidget::connect_to_camera()
 {
     if (!mPrinter->bedMicroscope->is_connected())
@@ -176,80 +228,20 @@ void BedMicroscopeWidget::capture_images()
 {
     if (!mPrinter->bedMicroscope->is_connected() || saveFolderPath.isEmpty()) { return; }
 
-    // generate dmc file to move printer to positions
-    std::stringstream s;
-    s << "## Bed imaging DMC program on the BJ system\n";
-    s << "Jacob Lawrence\n";
-    s << "##option \"--min 4\"\n\n";
-
-    s << "#BEGIN;\n";
-    s << "JS #store;\n"; // initialize arrays
-    s << "SP " << CMD::detail::mm2cnts(50, Axis::X) << ", " << CMD::detail::mm2cnts(30, Axis::Y) << "\n"; // set speed
-    s << "AC " << CMD::detail::mm2cnts(5000, Axis::X) << ", " << CMD::detail::mm2cnts(1000, Axis::Y) << "\n"; // set acceleration
-    s << "DC " << CMD::detail::mm2cnts(5000, Axis::X) << ", " << CMD::detail::mm2cnts(1000, Axis::Y) << "\n"; // set deceleration
-    s << "\n";
-    s << "nx = 0;\n";
-    s << "ny = 0;\n";
-
-    s << "#loopY;\n";
-    s << "PAY = yPos[ny];\n"; // move to y position
-    s << "#loopX;\n";
-    s << "PAX = xPos[nx];\n"; // move to x position
-    s << "BG XY;\n"; // start motion
-    s << "AM XY;\n"; // after motion complete
-    s << "WT 500;\n"; // wait for 0.5 seconds
-    s << "nxStr = (97+nx)*$1000000;\n";
-    s << "MG \"CMD MICRO_CAP \", nxStr{S1}, (ny+1){Z2.0}\n"; // request image
-//    s << "MG \"CMD MICRO_CAP \" {^(97+nx)}, (ny+1){Z1.0}\n"; // request image
-    s << "WT 1000;\n"; // wait for 1 second
-    s << "nx = nx + 1\n";
-    s << "JP #loopX, (nx < " << ui->numXSpinBox->value() << ");\n";
-    s << "nx = 0;\n"; // reset x variable
-    s << "ny = ny + 1\n";
-    s << "JP #loopY, (ny < " << ui->numYSpinBox->value() << ");\n";
-    s << "EN;\n";
-    s << "\n\n";
-
-    s << "#store\n";
-    s << "DA *,*[0];\n"; //Deallocate all variables and all arrays
-    s << "DM xPos[" << ui->numXSpinBox->value() << "];\n"; // define x array
-    s << "DM yPos[" << ui->numYSpinBox->value() << "];\n"; // define x array
-    s << "\n";
-    // populate x-values
+    // the scan is #LIMAGE of the resident library, only the positions change
+    std::vector<double> xPositions_mm;
     for (int i = 0; i < ui->numXSpinBox->value(); ++i)
-    {
-        int xPos = CMD::detail::mm2cnts(ui->xStartPositionSpinBox->value() + (i * ui->xSpacingSpinBox->value()), Axis::X);
-        s << "xPos[" << i << "] = " << xPos << ";\n";
-    }
-    s << "\n";
-    // populate y-values
+        xPositions_mm.push_back(ui->xStartPositionSpinBox->value() + (i * ui->xSpacingSpinBox->value()));
+    std::vector<double> yPositions_mm;
     for (int i = 0; i < ui->numYSpinBox->value(); ++i)
-    {
-        int yPos = CMD::detail::mm2cnts(ui->yStartPositionSpinBox->value() + (i * ui->ySpacingSpinBox->value()), Axis::Y);
-        s << "yPos[" << i << "] = " << yPos << ";\n";
-    }
-    s << "EN;\n"; // end subroutine
-
-
+        yPositions_mm.push_back(ui->yStartPositionSpinBox->value() + (i * ui->ySpacingSpinBox->value()));
 
-
-
-    std::string temp = s.str();
-    const char *program = temp.c_str();
-
-//    qDebug().noquote() << QString::fromStdString(temp); // debugging
-
-    if (mPrinter->mcu->g)
-    {
-        GProgramDownload(mPrinter->mcu->g, program, "--max 4");
-    }
-    std::stringstream s2;
-    s2 << "GCmd," << "XQ #BEGIN" << "\n";
-    s2 << "GProgramComplete," << "\n";
+    std::stringstream s;
+    s << CMD::library::image_bed(xPositions_mm, yPositions_mm);
 
     emit print_to_output_window(QString("Imaging Bed"));
 
-    emit execute_command(s2);
+    emit execute_command(s);
     emit disable_user_input();
 }
 
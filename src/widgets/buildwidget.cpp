@@ -0,0 +1,140 @@
+#include "buildwidget.h"
+#include "ui_buildwidget.h"
+
+#include <QFileDialog>
+#include <QFileInfo>
+
+#include "printer.h"
+#include "dmc4080.h"
+
+BuildWidget::BuildWidget(Printer *printer, QWidget *parent) :
+    PrinterWidget(printer, parent),
+    ui(new Ui::BuildWidget),
+    build(new BuildOrchestrator(printer, this))
+{
+    ui->setupUi(this);
+    setAccessibleName("Build Widget");
+
+    connect(ui->openLayerFileButton, &QAbstractButton::clicked, this, &BuildWidget::open_layer_file);
+    connect(ui->startBuildButton, &QAbstractButton::clicked, this, &BuildWidget::start_build);
+    connect(ui->stopBuildButton, &QAbstractButton::clicked, this, &BuildWidget::stop_build);
+    connect(ui->mistCheckBox, &QCheckBox::toggled, ui->mistSpeedSpinBox, &QWidget::setEnabled);
+    connect(ui->mistCheckBox, &QCheckBox::toggled, ui->mistDwellSpinBox, &QWidget::setEnabled);
+    connect(ui->cureCheckBox, &QCheckBox::toggled, ui->cureSpeedSpinBox, &QWidget::setEnabled);
+
+    connect(build, &BuildOrchestrator::progress, ui->progressLabel, &QLabel::setText);
+    connect(build, &BuildOrchestrator::progress, this, &BuildWidget::print_to_output_window);
+    connect(build, &BuildOrchestrator::finished, this, &BuildWidget::when_build_finished);
+}
+
+BuildWidget::~BuildWidget()
+{
+    delete ui;
+}
+
+void BuildWidget::allow_widget_input(bool allowed)
+{
+    // input is allowed again whenever the stream runs out, which also happens
+    // while a build waits for its next layer
+    const bool idle = allowed && !build->is_running();
+    ui->layerFileGroupBox->setEnabled(idle);
+    ui->printGroupBox->setEnabled(idle);
+    ui->recoatGroupBox->setEnabled(idle);
+    ui->mistCureGroupBox->setEnabled(idle);
+    ui->startBuildButton->setEnabled(idle && build->number_of_layers() > 0 && mPrinter->mcu->g);
+}
+
+void BuildWidget::open_layer_file()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Open Layer File", QDir::homePath(),
+                                                    "Layer Files (*.bjl);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    if (!build->open_layer_file(fileName.toStdString()))
+    {
+        emit print_to_output_window(QString::fromStdString(build->error()));
+        ui->layerFileLabel->setText("No layer file open");
+        ui->layerInfoLabel->clear();
+        ui->startBuildButton->setEnabled(false);
+        return;
+    }
+
+    const LayerFileHeader &header = build->layer_file_header();
+    ui->layerFileLabel->setText(QFileInfo(fileName).fileName());
+    ui->layerInfoLabel->setText(QString("%1 layers of %2 x %3 droplets\n"
+                                        "%4 µm droplet spacing, %5 µm line spacing, %6 µm layers\n"
+                                        "origin at (%7, %8) mm")
+                                .arg(build->number_of_layers())
+                                .arg(header.width).arg(header.height)
+                                .arg(header.dropletSpacing_um).arg(header.lineSpacing_um).arg(header.layerHeight_um)
+                                .arg(header.originX_mm).arg(header.originY_mm));
+    ui->firstLayerSpinBox->setMaximum(std::max(1, build->number_of_layers()));
+    ui->firstLayerSpinBox->setValue(1);
+    ui->startBuildButton->setEnabled(build->number_of_layers() > 0 && mPrinter->mcu->g);
+}
+
+BuildSettings BuildWidget::build_settings() const
+{
+    BuildSettings settings;
+    settings.recoat.isLevelRecoat = false;
+    settings.recoat.recoatSpeed_mm_s = ui->recoatSpeedSpinBox->value();
+    settings.recoat.rollerTraverseSpeed_mm_s = ui->rollerTraverseSpeedSpinBox->value();
+    // Note: Index from the combo box must match up with the data to be sent over RS-232 to the generator (see documentation of generator)
+    settings.recoat.ultrasonicIntensityLevel = ui->ultrasonicIntensityComboBox->currentIndex();
+    settings.recoat.ultrasonicMode = ui->ultrasonicModeComboBox->currentIndex();
+    settings.recoat.waitAfterHopperOn_millisecs = ui->hopperDwellTimeSpinBox->value();
+
+    settings.jettingFrequency_Hz = ui->jettingFrequencySpinBox->value();
+    settings.acceleration_mm_per_s2 = ui->accelerationSpinBox->value();
+    settings.travelSpeed_mm_per_s = ui->travelSpeedSpinBox->value();
+
+    settings.mist = ui->mistCheckBox->isChecked();
+    settings.mistSpeed_mm_s = ui->mistSpeedSpinBox->value();
+    settings.mistDwell_ms = int(1000.0 * ui->mistDwellSpinBox->value());
+    settings.cure = ui->cureCheckBox->isChecked();
+    settings.cureSpeed_mm_s = ui->cureSpeedSpinBox->value();
+
+    settings.firstLayer = ui->firstLayerSpinBox->value() - 1;
+    return settings;
+}
+
+void BuildWidget::start_build()
+{
+    emit stop_continuous_jetting();
+
+    if (!build->start(build_settings()))
+    {
+        emit print_to_output_window(QString::fromStdString(build->error()));
+        return;
+    }
+
+    emit disable_user_input();
+    ui->stopBuildButton->setEnabled(true);
+}
+
+void BuildWidget::stop_build()
+{
+    if (build->is_running())
+    {
+        build->stop();
+        emit stop_print_and_thread();
+    }
+}
+
+void BuildWidget::when_build_finished(bool completed)
+{
+    ui->stopBuildButton->setEnabled(false);
+    if (completed)
+    {
+        ui->firstLayerSpinBox->setValue(1);
+    }
+    else
+    {
+        // carry on from the layer that was stopped
+        const int stoppedAt = build_settings().firstLayer + build->report().layersDone;
+        ui->firstLayerSpinBox->setValue(stoppedAt + 1);
+    }
+    emit start_continuous_jetting();
+}
+
+#include "moc_buildwidget.cpp"
@@ -0,0 +1,142 @@
+#include "contourprintwidget.h"
+#include "ui_contourprintwidget.h"
+
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDebug>
+
+#include "printer.h"
+#include "printhread.h"
+#include "dmc4080.h"
+
+ContourPrintWidget::ContourPrintWidget(Printer *printer, QWidget *parent) :
+    PrinterWidget(printer, parent),
+    ui(new Ui::ContourPrintWidget)
+{
+    ui->setupUi(this);
+    setAccessibleName("Contour Print Widget");
+
+    ui->SVGViewer->setup(PRINT_X_SIZE_MM, PRINT_Y_SIZE_MM);
+
+    // Connect all Spin Boxes to update print settings when finished editing
+    QList<QAbstractSpinBox *> printSettingWidgets = this->findChildren<QAbstractSpinBox *> ();
+    for(int i{0}; i < printSettingWidgets.count(); ++i)
+    {
+       connect(printSettingWidgets[i], &QAbstractSpinBox::editingFinished, this, &ContourPrintWidget::update_print_settings);
+    }
+
+    connect(ui->loadFileButton, &QAbstractButton::clicked, this, &ContourPrintWidget::load_file);
+    connect(ui->printButton, &QAbstractButton::clicked, this, &ContourPrintWidget::print_contours);
+    connect(ui->stopPrintButton, &QAbstractButton::clicked, this, &ContourPrintWidget::stop_printing);
+
+    update_print_settings();
+}
+
+ContourPrintWidget::~ContourPrintWidget()
+{
+    delete ui;
+}
+
+void ContourPrintWidget::allow_widget_input(bool allowed)
+{
+    ui->printButton->setEnabled(allowed && !polylines.empty());
+    ui->printParametersFrame->setEnabled(allowed);
+}
+
+void ContourPrintWidget::load_file()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Open Contour File", QDir::homePath(),
+                                                    "Contours (*.svg *.txt *.csv);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    polylines = load_polylines(fileName);
+    if (polylines.empty())
+    {
+        emit print_to_output_window("No printable contours found in " + fileName);
+    }
+    else
+    {
+        emit print_to_output_window(QString("Loaded %1 contours").arg(polylines.size()));
+    }
+
+    ui->fileNameLabel->setText(QFileInfo(fileName).fileName());
+    ui->printButton->setEnabled(!polylines.empty() && mPrinter->mcu->g);
+    update_preview();
+}
+
+void ContourPrintWidget::update_print_settings()
+{
+    print.dropletSpacing_um = ui->dropletSpacingSpinBox->value();
+    print.jettingFrequency_Hz = ui->jettingFrequencySpinBox->value();
+    print.acceleration_mm_per_s2 = ui->accelerationSpinBox->value();
+    print.travelSpeed_mm_per_s = ui->travelSpeedSpinBox->value();
+    print.originX_mm = ui->originXSpinBox->value();
+    print.originY_mm = ui->originYSpinBox->value();
+
+    ui->printSpeedLabel->setText(QString::number((print.dropletSpacing_um * print.jettingFrequency_Hz) / 1000.0) + " mm/s");
+
+    update_preview();
+}
+
+void ContourPrintWidget::update_preview()
+{
+    ui->SVGViewer->clear_lines();
+
+    // the scene has y pointing down
+    auto to_scene = [](double x, double y) { return QPointF(x, PRINT_Y_SIZE_MM - y); };
+
+    QPointF prev;
+    bool havePrev {false};
+    for (const auto &polyline : polylines)
+    {
+        for (size_t i{0}; i < polyline.size(); ++i)
+        {
+            QPointF point = to_scene(print.originX_mm + polyline[i].x_mm, print.originY_mm + polyline[i].y_mm);
+            if (havePrev)
+            {
+                ui->SVGViewer->scene()->addLine(QLineF(prev, point), i == 0 ? lineTravelPen : linePen);
+            }
+            prev = point;
+            havePrev = true;
+        }
+    }
+}
+
+void ContourPrintWidget::print_contours()
+{
+    if (polylines.empty()) return;
+
+    emit stop_continuous_jetting();
+
+    std::stringstream s;
+    s << print.generate_commands_for_printing(polylines);
+
+    emit print_to_output_window("Printing contours");
+    emit execute_command(s);
+    emit disable_user_input();
+
+    printIsRunning_ = true;
+    ui->stopPrintButton->setEnabled(true);
+    connect(mPrintThread, &PrintThread::ended, this, &ContourPrintWidget::when_print_completed);
+}
+
+void ContourPrintWidget::stop_printing()
+{
+    if (printIsRunning_)
+    {
+        disconnect(mPrintThread, &PrintThread::ended, this, &ContourPrintWidget::when_print_completed);
+        emit stop_print_and_thread();
+        emit print_to_output_window("Print Stopped");
+        printIsRunning_ = false;
+        ui->stopPrintButton->setEnabled(false);
+    }
+}
+
+void ContourPrintWidget::when_print_completed()
+{
+    disconnect(mPrintThread, &PrintThread::ended, this, &ContourPrintWidget::when_print_completed); // run once
+    printIsRunning_ = false;
+    ui->stopPrintButton->setEnabled(false);
+}
+
+#include "moc_contourprintwidget.cpp"
@@ -0,0 +1,124 @@
+#include "doedialog.h"
+
+#include <algorithm>
+
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QLabel>
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+
+namespace
+{
+enum Column {Vary, Low, High, Step};
+}
+
+DOEDialog::DOEDialog(const LineSet &base, QWidget *parent) :
+    QDialog(parent),
+    base_(base)
+{
+    setWindowTitle("Design Experiment");
+    initWidgets();
+    setMinimumSize(500, 350);
+}
+
+void DOEDialog::initWidgets()
+{
+    const int velocityColumn = LinePrintData().get_column_index_for(base_.printVelocity);
+
+    table = new QTableWidget(base_.size, 4);
+    table->setHorizontalHeaderLabels({"Vary", "Low", "High", "Step"});
+    QStringList names;
+    for (int c{0}; c < base_.size; ++c)
+    {
+        names.append(QString::fromStdString(base_[c].typeName).replace('\n', ' '));
+
+        auto vary = new QTableWidgetItem();
+        vary->setCheckState(Qt::Unchecked);
+        table->setItem(c, Vary, vary);
+        table->setItem(c, Low, new QTableWidgetItem(base_[c].toQString()));
+        table->setItem(c, High, new QTableWidgetItem(base_[c].toQString()));
+        table->setItem(c, Step, new QTableWidgetItem(base_[c].dataType == type::int_type ? "1" : "0.1"));
+
+        if (c == velocityColumn) // comes from droplet spacing and jetting frequency
+        {
+            for (int i{Vary}; i <= Step; ++i) table->item(c, i)->setFlags(Qt::NoItemFlags);
+        }
+    }
+    table->setVerticalHeaderLabels(names);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    methodComboBox = new QComboBox();
+    methodComboBox->addItems({"Full Factorial", "Latin Hypercube"});
+
+    runsSpinBox = new QSpinBox();
+    runsSpinBox->setRange(1, DOE::MAX_RUNS);
+    runsSpinBox->setValue(10);
+    runsSpinBox->setEnabled(false);
+
+    seedSpinBox = new QSpinBox();
+    seedSpinBox->setRange(0, 1000000);
+    seedSpinBox->setValue(1);
+    seedSpinBox->setEnabled(false);
+
+    auto form = new QFormLayout();
+    form->addRow("Method", methodComboBox);
+    form->addRow("Number of Sets", runsSpinBox);
+    form->addRow("Random Seed", seedSpinBox);
+
+    buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+
+    auto layout = new QVBoxLayout();
+    layout->addWidget(table);
+    layout->addLayout(form);
+    layout->addWidget(buttonBox);
+    setLayout(layout);
+
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(table, &QTableWidget::itemChanged, this, &DOEDialog::update_run_count);
+    connect(methodComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int index)
+    {
+        // the number of sets of a full factorial design comes from the steps
+        runsSpinBox->setEnabled(index == 1);
+        seedSpinBox->setEnabled(index == 1);
+        update_run_count();
+    });
+}
+
+void DOEDialog::update_run_count()
+{
+    if (methodComboBox->currentIndex() != 0) return;
+
+    size_t runs {1};
+    for (const auto &factor : design().factors) runs *= factor.levels().size();
+    runsSpinBox->setValue((int)std::min(runs, (size_t)DOE::MAX_RUNS));
+}
+
+DOE::Design DOEDialog::design() const
+{
+    DOE::Design design;
+    design.base = base_;
+    design.method = methodComboBox->currentIndex() == 0 ? DOE::Method::FullFactorial : DOE::Method::LatinHypercube;
+    design.runs = runsSpinBox->value();
+    design.seed = (unsigned)seedSpinBox->value();
+
+    for (int c{0}; c < table->rowCount(); ++c)
+    {
+        if (table->item(c, Vary)->checkState() != Qt::Checked) continue;
+
+        DOE::Factor factor;
+        factor.column = c;
+        factor.low = table->item(c, Low)->text().toFloat();
+        factor.high = table->item(c, High)->text().toFloat();
+        factor.step = table->item(c, Step)->text().toFloat();
+        design.factors.push_back(factor);
+    }
+    return design;
+}
+
+#include "moc_doedialog.cpp"
@@ -2,6 +2,8 @@
 #include "ui_dropletobservationwidget.h"
 
 #include <QTimer>
+#include <QDateTime>
+#include <QDir>
 #include <QStandardPaths>
 #include <QFileDialog>
 #include <QMessageBox>
@@ -16,6 +18,7 @@
 #include "dropletanalyzer.h"
 #include "dropletanalyzerwidget.h"
 #include "pressurecontrollerwidget.h"
+#include "jobfile.h"
 #include <QSpacerItem>
 
 #include <QDebug>
@@ -70,6 +73,7 @@ DropletObservationWidget::DropletObservationWidget(Printer *printer, QWidget *pa
     m_tempFileName = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/jetdroplet.avi";
     qDebug() << "temp video files are stored at " << m_tempFileName;
     connect(ui->SaveVideoButton, &QPushButton::clicked, this, &DropletObservationWidget::save_video_clicked);
+    connect(this, &DropletObservationWidget::video_capture_complete, this, &DropletObservationWidget::when_job_video_captured);
 
     m_JetVolumeTimer = new QTimer(this);
     connect(m_JetVolumeTimer, &QTimer::timeout, this, &DropletObservationWidget::end_jet_timer);
@@ -119,6 +123,65 @@ void DropletObservationWidget::allow_widget_input(bool allowed)
     ui->frame->setEnabled(allowed);
 }
 
+bool DropletObservationWidget::save_job(JobFile &job)
+{
+    job.type = "droplet characterization";
+    job.settings["jettingFrequency_Hz"] = ui->jettingFreqSpinBox->value();
+    job.settings["strobeStart_us"] = ui->startTimeSpinBox->value();
+    job.settings["strobeEnd_us"] = ui->endTimeSpinBox->value();
+    job.settings["strobeStep_us"] = ui->stepTimeSpinBox->value();
+    job.settings["videoFolder"] = (QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)
+                                   + "/BJ_Droplets").toStdString();
+    return true;
+}
+
+bool DropletObservationWidget::load_job(const JobFile &job)
+{
+    if (job.type != "droplet characterization") return false;
+
+    const auto &s = job.settings;
+    ui->jettingFreqSpinBox->setValue(s.value("jettingFrequency_Hz", ui->jettingFreqSpinBox->value()));
+    ui->startTimeSpinBox->setValue(s.value("strobeStart_us", ui->startTimeSpinBox->value()));
+    ui->endTimeSpinBox->setValue(s.value("strobeEnd_us", ui->endTimeSpinBox->value()));
+    ui->stepTimeSpinBox->setValue(s.value("strobeStep_us", ui->stepTimeSpinBox->value()));
+    m_jobVideoFolder = QString::fromStdString(s.value("videoFolder", std::string{}));
+    return true;
+}
+
+bool DropletObservationWidget::run_job(const JobFile &job)
+{
+    if (!load_job(job)) return false;
+
+    if (!m_cameraIsConnected)
+    {
+        emit job_finished(false, "The droplet camera is not connected");
+        return true;
+    }
+    if (m_jobVideoFolder.isEmpty())
+        m_jobVideoFolder = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/BJ_Droplets";
+
+    m_runningJob = true;
+    if (!m_isJetting) start_jetting();
+    capture_video();
+    return true;
+}
+
+void DropletObservationWidget::when_job_video_captured()
+{
+    if (!m_runningJob) return;
+    m_runningJob = false;
+    stop_jetting();
+
+    // the video is analyzed later, from the droplet analyzer
+    QDir().mkpath(m_jobVideoFolder);
+    const QString fileName = m_jobVideoFolder + "/droplets_"
+            + QDateTime::currentDateTime().toString("yyyy_MM_dd_hh_mm_ss") + ".avi";
+    if (QFile::copy(m_tempFileName, fileName))
+        emit job_finished(true, "Saved the video to " + fileName);
+    else
+        emit job_finished(false, "Could not save the video to " + fileName);
+}
+
 void DropletObservationWidget::show_droplet_analyzer_widget(bool loadTempVideo)
 {
     if (loadTempVideo)
@@ -350,14 +413,8 @@ void DropletObservationWidget::capture_video()
 void DropletObservationWidget::move_to_jetting_window()
 {
     std::stringstream s;
-    s << CMD::set_speed(Axis::X, 50);
-    s << CMD::position_absolute(Axis::X, X_STAGE_LEN_MM);
-    //s << CMD::set_jog(Axis::X, 50);
-    s << CMD::set_accleration(Axis::X, 800);
-    s << CMD::set_deceleration(Axis::X, 800);
-    s << CMD::begin_motion(Axis::X);
     s << CMD::display_message("Moving to jetting window");
-    s << CMD::motion_complete(Axis::X);
+    s << CMD::library::move_to_jetting_window();
 
     emit execute_command(s);
     emit disable_user_input();
@@ -7,6 +7,8 @@
 #include <sstream>
 #include <cmath>
 #include "dmc4080.h"
+#include "triggerscheduler.h"
+#include "jobfile.h"
 
 HighSpeedLineWidget::HighSpeedLineWidget(Printer *printer, QWidget *parent) :
     PrinterWidget(printer, parent),
@@ -37,6 +39,70 @@ void HighSpeedLineWidget::allow_widget_input(bool allowed)
     //ui->decrementLineNumButton->setEnabled(allowed);
 }
 
+bool HighSpeedLineWidget::save_job(JobFile &job)
+{
+    update_print_settings();
+    job.type = "high speed line";
+    job.settings["numLines"] = print->numLines;
+    job.settings["lineSpacing_um"] = print->lineSpacing_um;
+    job.settings["lineLength_mm"] = print->lineLength_mm;
+    job.settings["dropletSpacing_um"] = print->dropletSpacing_um;
+    job.settings["jettingFrequency_Hz"] = print->jettingFrequency_Hz;
+    job.settings["acceleration_mm_per_s2"] = print->acceleration_mm_per_s2;
+    job.settings["jerk_mm_per_s3"] = print->jerk_mm_per_s3;
+    job.settings["yShaper"] = ui->yShaperComboBox->currentIndex();
+    job.settings["yResonance_Hz"] = print->yShaper.frequency_Hz;
+    job.settings["firingMode"] = ui->firingModeComboBox->currentIndex();
+    job.settings["buildBox"] = {{"centerX", print->buildBox.centerX}, {"centerY", print->buildBox.centerY},
+                                {"thickness", print->buildBox.thickness}, {"length", print->buildBox.length}};
+    job.settings["printAxis"] = ui->printAxisComboBox->currentIndex();
+    job.settings["viewAxis"] = ui->viewAxisComboBox->currentIndex();
+    job.settings["triggerOffset_ms"] = print->triggerOffset_ms;
+    return true;
+}
+
+bool HighSpeedLineWidget::load_job(const JobFile &job)
+{
+    if (job.type != "high speed line") return false;
+
+    // settings missing from the job keep their current values
+    const auto &s = job.settings;
+    ui->numLinesSpinBox->setValue(s.value("numLines", print->numLines));
+    ui->lineSpacingSpinBox->setValue(s.value("lineSpacing_um", print->lineSpacing_um));
+    ui->lineLengthSpinBox->setValue(s.value("lineLength_mm", print->lineLength_mm));
+    ui->dropletSpacingSpinBox->setValue(s.value("dropletSpacing_um", print->dropletSpacing_um));
+    ui->jettingFrequencySpinBox->setValue(s.value("jettingFrequency_Hz", print->jettingFrequency_Hz));
+    ui->printAccelerationSpinBox->setValue(s.value("acceleration_mm_per_s2", print->acceleration_mm_per_s2));
+    ui->printJerkSpinBox->setValue(s.value("jerk_mm_per_s3", print->jerk_mm_per_s3));
+    ui->yShaperComboBox->setCurrentIndex(s.value("yShaper", ui->yShaperComboBox->currentIndex()));
+    ui->yResonanceSpinBox->setValue(s.value("yResonance_Hz", print->yShaper.frequency_Hz));
+    ui->firingModeComboBox->setCurrentIndex(s.value("firingMode", ui->firingModeComboBox->currentIndex()));
+    if (s.contains("buildBox"))
+    {
+        const auto &box = s["buildBox"];
+        ui->buildBoxCenterXSpinBox->setValue(box.value("centerX", print->buildBox.centerX));
+        ui->buildBoxCenterYSpinBox->setValue(box.value("centerY", print->buildBox.centerY));
+        ui->buildBoxThicknessSpinBox->setValue(box.value("thickness", print->buildBox.thickness));
+        ui->buildBoxLengthSpinBox->setValue(box.value("length", print->buildBox.length));
+    }
+    ui->printAxisComboBox->setCurrentIndex(s.value("printAxis", ui->printAxisComboBox->currentIndex()));
+    ui->viewAxisComboBox->setCurrentIndex(s.value("viewAxis", ui->viewAxisComboBox->currentIndex()));
+    ui->triggerOffsetSpinBox->setValue(s.value("triggerOffset_ms", print->triggerOffset_ms));
+
+    update_print_settings(); // spin boxes only update the settings when editing finishes
+    return true;
+}
+
+bool HighSpeedLineWidget::run_job(const JobFile &job)
+{
+    if (!load_job(job)) return false;
+
+    reset_print();
+    runningJob_ = true;
+    print_line();
+    return true;
+}
+
 void HighSpeedLineWidget::allow_user_to_change_parameters(bool allowed)
 {
     ui->printParametersFrame->setEnabled(allowed);
@@ -97,6 +163,17 @@ void HighSpeedLineWidget::update_print_settings()
     print->dropletSpacing_um = ui->dropletSpacingSpinBox->value();
     print->jettingFrequency_Hz = ui->jettingFrequencySpinBox->value();
     print->acceleration_mm_per_s2 = ui->printAccelerationSpinBox->value();
+    print->jerk_mm_per_s3 = ui->printJerkSpinBox->value();
+
+    // items are in the order of InputShaper::Type
+    print->yShaper.type = static_cast<Trajectory::InputShaper::Type>(ui->yShaperComboBox->currentIndex());
+    print->yShaper.frequency_Hz = ui->yResonanceSpinBox->value();
+    ui->yResonanceSpinBox->setEnabled(ui->yShaperComboBox->currentIndex() != 0);
+
+    // first item is time based jetting, the others fire by position
+    print->positionSynchronizedFiring = ui->firingModeComboBox->currentIndex() != 0;
+    print->firingEngine.mode = ui->firingModeComboBox->currentIndex() == 2 ?
+                Firing::Mode::OutputCompare : Firing::Mode::EncoderGearing;
 
     // update build box parameters
     print->buildBox.centerX = ui->buildBoxCenterXSpinBox->value();
@@ -180,7 +257,7 @@ void HighSpeedLineWidget::print_line()
 
     if (mPrinter->mcu->g)
     {
-        GProgramDownload(mPrinter->mcu->g, commands, "");
+        mPrinter->mcu->download_program(commands, "");
     }
     s << "GCmd," << "XQ" << "\n";
     s << "GProgramComplete," << "\n";
@@ -210,7 +287,7 @@ void HighSpeedLineWidget::view_flat()
 
     if (mPrinter->mcu->g)
     {
-        GProgramDownload(mPrinter->mcu->g, commands, "");
+        mPrinter->mcu->download_program(commands, "");
     }
     s << "GCmd," << "XQ" << "\n";
     s << "GProgramComplete," << "\n";
@@ -228,9 +305,36 @@ void HighSpeedLineWidget::view_flat()
 void HighSpeedLineWidget::when_line_print_completed()
 {
     disconnect(mPrintThread, &PrintThread::ended, this, &HighSpeedLineWidget::when_line_print_completed); // run once
+
+    // check where the droplets actually landed
+    if (print->positionSynchronizedFiring)
+    {
+        Firing::Telemetry telemetry;
+        if (Firing::upload_telemetry(mPrinter->mcu->g, telemetry))
+        {
+            auto result = Firing::verify(print->firingEngine, print->firing_window(), telemetry);
+            emit print_to_output_window(QString::fromStdString(result.summary()));
+        }
+    }
+
     currentLineToPrintIndex++;
 
     printIsRunning_ = false;
+
+    if (runningJob_)
+    {
+        // nobody is there to press print for the next line
+        if (currentLineToPrintIndex < print->numLines)
+        {
+            print_line();
+            return;
+        }
+        runningJob_ = false;
+        reset_print();
+        emit job_finished(true, QString("%1 lines printed").arg(print->numLines));
+        return;
+    }
+
     ui->stopPrintButton->setText("\nReset Print\n");
 
     if (currentLineToPrintIndex < print->numLines)
@@ -249,6 +353,7 @@ void HighSpeedLineWidget::stop_printing()
     if (printIsRunning_)
     {
         disconnect(mPrintThread, &PrintThread::ended, this, &HighSpeedLineWidget::when_line_print_completed);
+        runningJob_ = false;
         emit stop_print_and_thread();
         emit print_to_output_window("Print Stopped");
 
@@ -306,13 +411,9 @@ std::string HighSpeedLineCommandGenerator::generate_commands_for_printing_line(i
     else nonPrintAxis = Axis::X;
 
     // line print move, jetting, and TTL trigger
-    double print_speed_mm_per_s = (dropletSpacing_um * jettingFrequency_Hz) / 1000.0;
-
-    double accelTime = print_speed_mm_per_s/acceleration_mm_per_s2;
-    int accelTimeCnts{int((accelTime) * (double)cntsPerSec)};
-    double linePrintTime_s = (lineLength_mm / print_speed_mm_per_s);
-    int halfLinePrintTimeCnts{int((linePrintTime_s * (double)cntsPerSec) / 2.0)};
-    double accelDistance_mm{0.5 * acceleration_mm_per_s2 * std::pow(accelTime, 2)};
+    const Trajectory::Profile profile = line_print_profile();
+    double accelDistance_mm = profile.acceleration_distance_mm();
+    double halfLineTravel_mm = profile.constant_velocity_distance_mm() / 2.0;
 
     std::string linePrintMessage = "Printing Line " + std::to_string(lineNum + 1);
     s << CMD::display_message(linePrintMessage);
@@ -331,7 +432,7 @@ std::string HighSpeedLineCommandGenerator::generate_commands_for_printing_line(i
     {
         // move y axis so that bed is behind the nozzle so there is enough space to get up to speed to print
         s << CMD::set_speed(printAxis, 60);
-        s << CMD::position_absolute(printAxis, buildBox.centerY + (lineLength_mm/2.0) + accelDistance_mm);
+        s << CMD::position_absolute(printAxis, buildBox.centerY + halfLineTravel_mm + accelDistance_mm);
         s << CMD::begin_motion(printAxis);
         s << CMD::motion_complete(printAxis);
     }
@@ -370,7 +471,7 @@ std::string HighSpeedLineCommandGenerator::generate_commands_for_printing_line(i
     if (printAxis == Axis::X)
     {
         s << CMD::set_speed(printAxis, xTravelSpeed);
-        s << CMD::position_absolute(printAxis, buildBox.centerX + (lineLength_mm/2.0) + accelDistance_mm);
+        s << CMD::position_absolute(printAxis, buildBox.centerX + halfLineTravel_mm + accelDistance_mm);
         s << CMD::begin_motion(printAxis);
         s << CMD::motion_complete(printAxis);
     }
@@ -379,15 +480,11 @@ std::string HighSpeedLineCommandGenerator::generate_commands_for_printing_line(i
     // Line Print PVT Commands
     // PVT commands are in relative position coordinates
     s << CMD::enable_gearing_for(Axis::Jet, printAxis);
-    s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,    -print_speed_mm_per_s, accelTimeCnts);         // accelerate
-    s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/2.0), -print_speed_mm_per_s, halfLinePrintTimeCnts); // constant velocity to trigger point
-    s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/2.0), -print_speed_mm_per_s, halfLinePrintTimeCnts); // constant velocity
-    s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,     0,                    accelTimeCnts);         // decelerate
-    s << CMD::exit_pvt_mode(printAxis);
+    s << profile.commands(printAxis);
 
-    double linePrintTime_ms = linePrintTime_s * 1000.0;
+    double linePrintTime_ms = (profile.constant_velocity_end_s() - profile.constant_velocity_start_s()) * 1000.0;
     double halfLinePrintTime_ms = linePrintTime_ms / 2.0;
-    double accelTime_ms = accelTime * 1000.0;
+    double accelTime_ms = profile.constant_velocity_start_s() * 1000.0;
     if (triggerOffset_ms < halfLinePrintTime_ms) // trigger occurs during line print
     {
         s << CMD::display_message("Trigger occured during line print");
@@ -437,6 +534,32 @@ std::string HighSpeedLineCommandGenerator::generate_commands_for_printing_line(i
     return s.str();
 }
 
+Trajectory::Profile HighSpeedLineCommandGenerator::line_print_profile() const
+{
+    double print_speed_mm_per_s = (dropletSpacing_um * jettingFrequency_Hz) / 1000.0;
+
+    Trajectory::AxisLimits limits;
+    limits.acceleration_mm_s2 = acceleration_mm_per_s2;
+    limits.jerk_mm_s3 = jerk_mm_per_s3;
+    if (printAxis == Axis::Y) limits.shaper = yShaper;
+
+    return Trajectory::plan_constant_velocity_move(lineLength_mm, -print_speed_mm_per_s, limits);
+}
+
+Firing::Window HighSpeedLineCommandGenerator::firing_window() const
+{
+    // lines are printed moving in the negative direction across the center
+    const double center = (printAxis == Axis::X) ? buildBox.centerX : buildBox.centerY;
+    const double halfLineTravel_mm = line_print_profile().constant_velocity_distance_mm() / 2.0;
+
+    Firing::Window window;
+    window.printAxis = printAxis;
+    window.start_mm = center + halfLineTravel_mm;
+    window.end_mm = center - halfLineTravel_mm;
+    window.dropletSpacing_um = dropletSpacing_um;
+    return window;
+}
+
 void HighSpeedLineWidget::move_to_build_box_center()
 {
     std::stringstream s;
@@ -463,20 +586,19 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_printing_li
     else nonPrintAxis = Axis::X;
 
     // line print move, jetting, and TTL trigger
-    double print_speed_mm_per_s = (dropletSpacing_um * jettingFrequency_Hz) / 1000.0;
-
-    double accelTime = print_speed_mm_per_s/acceleration_mm_per_s2;
-    int accelTimeCnts = int(std::round((accelTime) * (double)cntsPerSec));
-    double linePrintTime_s = (lineLength_mm / print_speed_mm_per_s);
-    int halfLinePrintTimeCnts = int(std::round((linePrintTime_s * (double)cntsPerSec) / 2.0));
-    double accelDistance_mm{0.5 * acceleration_mm_per_s2 * std::pow(accelTime, 2)};
+    const Trajectory::Profile profile = line_print_profile();
+    double accelDistance_mm = profile.acceleration_distance_mm();
+    double halfLineTravel_mm = profile.constant_velocity_distance_mm() / 2.0;
 
     // move to the jetting position if we are not already there
 
     //start jetting right away
-    s << CMD::set_accleration(Axis::Jet, 20000000); // set super high acceleration for jetting axis
-    s << CMD::set_jog(Axis::Jet, jettingFrequency_Hz); // jet at 1024z while waiting
-    s << CMD::begin_motion(Axis::Jet);
+    if (!positionSynchronizedFiring)
+    {
+        s << CMD::set_accleration(Axis::Jet, 20000000); // set super high acceleration for jetting axis
+        s << CMD::set_jog(Axis::Jet, jettingFrequency_Hz); // jet at 1024z while waiting
+        s << CMD::begin_motion(Axis::Jet);
+    }
 
     s << CMD::set_accleration(Axis::X, 300); // moved down from 800 4/6/22 for slower accelerations
     s << CMD::set_deceleration(Axis::X, 300);
@@ -491,7 +613,7 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_printing_li
     {
         // move y axis so that bed is behind the nozzle so there is enough space to get up to speed to print
         s << CMD::set_speed(printAxis, 60);
-        s << CMD::position_absolute(printAxis, buildBox.centerY + (lineLength_mm/2.0) + accelDistance_mm);
+        s << CMD::position_absolute(printAxis, buildBox.centerY + halfLineTravel_mm + accelDistance_mm);
         s << CMD::begin_motion(printAxis);
         s << CMD::after_motion(printAxis);
     }
@@ -534,7 +656,7 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_printing_li
     if (printAxis == Axis::X)
     {
         s << CMD::set_speed(printAxis, xTravelSpeed);
-        s << CMD::position_absolute(printAxis, buildBox.centerX + (lineLength_mm/2.0) + accelDistance_mm);
+        s << CMD::position_absolute(printAxis, buildBox.centerX + halfLineTravel_mm + accelDistance_mm);
         s << CMD::begin_motion(printAxis);
         s << CMD::after_motion(printAxis);
     }
@@ -543,97 +665,25 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_printing_li
     // Line Print PVT Commands
     // PVT commands are in relative position coordinates
 
-    // need to add more pvt points if any sample times are greater than 2048
-    if (halfLinePrintTimeCnts < 2048) // data points are close together enough
-    {
-        s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,    -print_speed_mm_per_s, accelTimeCnts);         // accelerate
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/2.0), -print_speed_mm_per_s, halfLinePrintTimeCnts); // constant velocity to trigger point
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/2.0), -print_speed_mm_per_s, halfLinePrintTimeCnts); // constant velocity
-        s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,     0,                    accelTimeCnts);         // decelerate
-    }
-    else
-    {
-        s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,    -print_speed_mm_per_s, accelTimeCnts);           // accelerate
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/4.0), -print_speed_mm_per_s, halfLinePrintTimeCnts/2); // constant velocity
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/4.0), -print_speed_mm_per_s, halfLinePrintTimeCnts/2); // constant velocity to trigger point
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/4.0), -print_speed_mm_per_s, halfLinePrintTimeCnts/2); // constant velocity
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/4.0), -print_speed_mm_per_s, halfLinePrintTimeCnts/2); // constant velocity
-        s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,     0,                    accelTimeCnts);           // decelerate
-    }
-
-    s << CMD::exit_pvt_mode(printAxis);
-    s << CMD::set_reference_time();
+    // segments longer than the controller limit are split by the profile
+    s << profile.commands(printAxis);
 
-    double linePrintTime_ms = linePrintTime_s * 1000.0;
-    double halfLinePrintTime_ms = linePrintTime_ms / 2.0;
-    double accelTime_ms = accelTime * 1000.0;
-    if (triggerOffset_ms < halfLinePrintTime_ms) // trigger occurs during line print
+    // droplets are fired by position on thread 1 (#FIRE below) so the
+    // trigger timing on this thread isn't held up by position trippoints
+    if (positionSynchronizedFiring)
     {
-        qDebug() << "trigger occured during line print";
-
-        //int time1 = std::round(accelTime_ms);
-        //int time2 = std::round(halfLinePrintTime_ms - triggerOffset_ms);
-        //int time3 = std::round(triggerOffset_ms + halfLinePrintTime_ms);
-        //if (time1 != 0) s << CMD::wait(time1);
-        //if (time2 != 0) s << CMD::wait(time2);
-        //if (time3 != 0) s << CMD::wait(time3);
-
-        int time1 = std::round(accelTime_ms);
-        int time2 = std::round(accelTime_ms + halfLinePrintTime_ms - triggerOffset_ms);
-        int time3 = std::round(accelTime_ms + linePrintTime_ms);
-
-        s << CMD::begin_pvt_motion(printAxis);
-        s << CMD::at_time_milliseconds(time1);
-        //s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um);
-        if (time2 != time1) s << CMD::at_time_milliseconds(time2);
-        s << CMD::set_bit(HS_TTL_BIT);
-        s << CMD::at_time_milliseconds(time3);
+        s << firingEngine.arm(firing_window());
+        s << firingEngine.start_recording(firing_window(), profile.total_time_s());
+        s << CMD::detail::GCmd("XQ #FIRE,1");
     }
-    else if (triggerOffset_ms < (halfLinePrintTime_ms + accelTime_ms)) // trigger occurs during acceleration
-    {
-        qDebug() << "trigger occured during acceleration";
-
-        //int time1 = std::round(accelTime_ms + halfLinePrintTime_ms - triggerOffset_ms);
-        //int time2 = std::round(triggerOffset_ms - halfLinePrintTime_ms);
-        //int time3 = std::round(linePrintTime_ms);
-        //if (time1 != 0) s << CMD::wait(time1);
-        //if (time2 != 0) s << CMD::wait(time2);
-        //if (time3 != 0) s << CMD::wait(time3);
 
-        int time1 = std::round(accelTime_ms + halfLinePrintTime_ms - triggerOffset_ms);
-        int time2 = std::round(accelTime_ms);
-        int time3 = std::round(accelTime_ms + linePrintTime_ms);
-
-        s << CMD::begin_pvt_motion(printAxis);
-        if (time1 != 0) s << CMD::at_time_milliseconds(time1);
-        s << CMD::set_bit(HS_TTL_BIT);
-        if (time2 != time1) s << CMD::at_time_milliseconds(time2);
-        //s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um);
-        s << CMD::at_time_milliseconds(time3);
-    }
-    else // trigger occurs before acceleration
-    {
-        qDebug() << "trigger occured before acceleration";
-
-        //int time1 = std::round(triggerOffset_ms - accelTime_ms - halfLinePrintTime_ms);
-        //int time2 = std::round(accelTime_ms);
-        //int time3 = std::round(linePrintTime_ms);
-        //if (time1 != 0) s << CMD::wait(time1);
-        //if (time2 != 0) s << CMD::wait(time2);
-        //if (time3 != 0) s << CMD::wait(time3);
-
-        int timeWaitBeforePrint = triggerOffset_ms - accelTime_ms - halfLinePrintTime_ms;
-        int time1 = std::round(timeWaitBeforePrint);
-        int time2 = std::round(timeWaitBeforePrint + accelTime_ms);
-        int time3 = std::round(timeWaitBeforePrint + accelTime_ms + linePrintTime_ms);
-
-        s << CMD::set_bit(HS_TTL_BIT);
-        if (time1 != 0) s << CMD::at_time_milliseconds(time1);
-        s << CMD::begin_pvt_motion(printAxis);
-        if (time2 != time1) s << CMD::at_time_milliseconds(time2);
-        //s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um);
-        s << CMD::at_time_milliseconds(time3);
-    }
+    // the move starts at the pre-positioned point on the print axis
+    const double moveStart_mm = (printAxis == Axis::X ? buildBox.centerX : buildBox.centerY)
+            + halfLineTravel_mm + accelDistance_mm;
+    TriggerScheduler trigger(profile, printAxis, moveStart_mm);
+    trigger.add_event(profile.constant_velocity_mid_s() - (triggerOffset_ms / 1000.0),
+                      CMD::set_bit(HS_TTL_BIT));
+    s << trigger.commands();
 
     //s << CMD::disable_gearing_for(Axis::Jet);
     s << CMD::after_motion(printAxis);
@@ -653,6 +703,12 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_printing_li
 
     std::string returnString = CMD::cmd_buf_to_dmc(s);
 
+    if (positionSynchronizedFiring)
+    {
+        returnString += "EN\n";
+        returnString += firingEngine.firing_thread(firing_window(), "FIRE");
+    }
+
     return returnString;
 }
 
@@ -665,13 +721,9 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_viewing_fla
     else nonPrintAxis = Axis::X;
 
     // line print move, jetting, and TTL trigger
-    double print_speed_mm_per_s = (dropletSpacing_um * jettingFrequency_Hz) / 1000.0;
-
-    double accelTime = print_speed_mm_per_s/acceleration_mm_per_s2;
-    int accelTimeCnts = int(std::round((accelTime) * (double)cntsPerSec));
-    double linePrintTime_s = (lineLength_mm / print_speed_mm_per_s);
-    int halfLinePrintTimeCnts = int(std::round((linePrintTime_s * (double)cntsPerSec) / 2.0));
-    double accelDistance_mm{0.5 * acceleration_mm_per_s2 * std::pow(accelTime, 2)};
+    const Trajectory::Profile profile = line_print_profile();
+    double accelDistance_mm = profile.acceleration_distance_mm();
+    double halfLineTravel_mm = profile.constant_velocity_distance_mm() / 2.0;
 
     // start PVT motion
     // position axes where they need to be for printing
@@ -679,7 +731,7 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_viewing_fla
     {
         // move y axis so that bed is behind the nozzle so there is enough space to get up to speed to print
         s << CMD::set_speed(printAxis, 60);
-        s << CMD::position_absolute(printAxis, buildBox.centerY + (lineLength_mm/2.0) + accelDistance_mm);
+        s << CMD::position_absolute(printAxis, buildBox.centerY + halfLineTravel_mm + accelDistance_mm);
         s << CMD::begin_motion(printAxis);
         s << CMD::after_motion(printAxis);
     }
@@ -713,64 +765,17 @@ std::string HighSpeedLineCommandGenerator::generate_dmc_commands_for_viewing_fla
         // Line Print PVT Commands
         // PVT commands are in relative position coordinates
         s << CMD::enable_gearing_for(Axis::Jet, printAxis);
-        s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,    -print_speed_mm_per_s, accelTimeCnts);         // accelerate
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/2.0), -print_speed_mm_per_s, halfLinePrintTimeCnts); // constant velocity to trigger point
-        s << CMD::add_pvt_data_to_buffer(printAxis, -(lineLength_mm/2.0), -print_speed_mm_per_s, halfLinePrintTimeCnts); // constant velocity
-        s << CMD::add_pvt_data_to_buffer(printAxis, -accelDistance_mm,     0,                    accelTimeCnts);         // decelerate
-        s << CMD::exit_pvt_mode(printAxis);
-        s << CMD::set_reference_time();
-
-        double linePrintTime_ms = linePrintTime_s * 1000.0;
-        double halfLinePrintTime_ms = linePrintTime_ms / 2.0;
-        double accelTime_ms = accelTime * 1000.0;
-        if (triggerOffset_ms < halfLinePrintTime_ms) // trigger occurs during line print
-        {
-            qDebug() << "trigger occured during line print";
-
-            int time1 = std::round(accelTime_ms);
-            int time2 = std::round(accelTime_ms + halfLinePrintTime_ms - triggerOffset_ms);
-            int time3 = std::round(accelTime_ms + linePrintTime_ms);
-
-            s << CMD::begin_pvt_motion(printAxis);
-            s << CMD::at_time_milliseconds(time1);
-            s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um);
-            if (time2 != time1) s << CMD::at_time_milliseconds(time2);
-            s << CMD::set_bit(HS_TTL_BIT);
-            s << CMD::at_time_milliseconds(time3);
-        }
-        else if (triggerOffset_ms < (halfLinePrintTime_ms + accelTime_ms)) // trigger occurs during acceleration
-        {
-            qDebug() << "trigger occured during acceleration";
-
-            int time1 = std::round(accelTime_ms + halfLinePrintTime_ms - triggerOffset_ms);
-            int time2 = std::round(accelTime_ms);
-            int time3 = std::round(accelTime_ms + linePrintTime_ms);
-
-            s << CMD::begin_pvt_motion(printAxis);
-            if (time1 != 0) s << CMD::at_time_milliseconds(time1);
-            s << CMD::set_bit(HS_TTL_BIT);
-            if (time2 != time1) s << CMD::at_time_milliseconds(time2);
-            s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um);
-            s << CMD::at_time_milliseconds(time3);
-        }
-        else // trigger occurs before acceleration
-        {
-            qDebug() << "trigger occured before acceleration";
-
-            int timeWaitBeforePrint = triggerOffset_ms - accelTime_ms - halfLinePrintTime_ms;
-            int time1 = std::round(timeWaitBeforePrint);
-            int time2 = std::round(timeWaitBeforePrint + accelTime_ms);
-            int time3 = std::round(timeWaitBeforePrint + accelTime_ms + linePrintTime_ms);
-
-            s << CMD::set_bit(HS_TTL_BIT);
-            if (time1 != 0) s << CMD::at_time_milliseconds(time1);
-            s << CMD::begin_pvt_motion(printAxis);
-            if (time2 != time1) s << CMD::at_time_milliseconds(time2);
-            s << CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um);
-            s << CMD::at_time_milliseconds(time3);
-        }
+        s << profile.commands(printAxis);
+        // the move starts at the pre-positioned point on the print axis
+        TriggerScheduler trigger(profile, printAxis, buildBox.centerY + halfLineTravel_mm + accelDistance_mm);
+        trigger.add_event(profile.constant_velocity_start_s(),
+                          CMD::set_jetting_gearing_ratio_from_droplet_spacing(printAxis, dropletSpacing_um));
+        trigger.add_event(profile.constant_velocity_mid_s() - (triggerOffset_ms / 1000.0),
+                          CMD::set_bit(HS_TTL_BIT));
+        // jet the whole line, not just up to the trigger
+        trigger.add_event(profile.constant_velocity_end_s(), CMD::disable_gearing_for(Axis::Jet));
+        s << trigger.commands();
 
-        s << CMD::disable_gearing_for(Axis::Jet);
         s << CMD::after_motion(printAxis);
         s << CMD::clear_bit(HS_TTL_BIT);
     }
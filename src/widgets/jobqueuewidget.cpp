@@ -0,0 +1,183 @@
+#include "jobqueuewidget.h"
+#include "ui_jobqueuewidget.h"
+
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QSignalBlocker>
+
+#include "printer.h"
+#include "dmc4080.h"
+
+namespace
+{
+enum Column { ID, Name, Type, Priority, DependsOn, State, Started, Time, Result };
+
+QString id_list(const std::vector<int> &ids)
+{
+    QStringList list;
+    for (const int id : ids) list << QString::number(id);
+    return list.join(", ");
+}
+
+bool parse_id_list(const QString &text, std::vector<int> &ids)
+{
+    ids.clear();
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts))
+    {
+        bool ok {false};
+        const int id = item.trimmed().toInt(&ok);
+        if (!ok) return false;
+        ids.push_back(id);
+    }
+    return true;
+}
+}
+
+JobQueueWidget::JobQueueWidget(Printer *printer, QWidget *parent) :
+    PrinterWidget(printer, parent),
+    ui(new Ui::JobQueueWidget),
+    queue(new JobQueue(printer->mcu->printerThread, this))
+{
+    ui->setupUi(this);
+    setAccessibleName("Job Queue Widget");
+
+    connect(ui->addJobFilesButton, &QAbstractButton::clicked, this, &JobQueueWidget::add_job_files);
+    connect(ui->removeJobButton, &QAbstractButton::clicked, this, &JobQueueWidget::remove_job);
+    connect(ui->clearFinishedButton, &QAbstractButton::clicked, this, &JobQueueWidget::clear_finished);
+    connect(ui->startQueueButton, &QAbstractButton::clicked, queue, &JobQueue::start);
+    connect(ui->pauseQueueButton, &QAbstractButton::clicked, queue, &JobQueue::pause);
+    connect(ui->jobTable, &QTableWidget::cellChanged, this, &JobQueueWidget::job_cell_changed);
+
+    // queued, the table can't be rebuilt from inside its own cellChanged
+    connect(queue, &JobQueue::changed, this, &JobQueueWidget::update_table, Qt::QueuedConnection);
+    connect(queue, &JobQueue::print_to_output_window, this, &JobQueueWidget::print_to_output_window);
+    connect(queue, &JobQueue::started, this, &JobQueueWidget::update_buttons);
+    connect(queue, &JobQueue::paused, this, &JobQueueWidget::update_buttons);
+    connect(queue, &JobQueue::finished, this, &JobQueueWidget::update_buttons);
+    connect(queue, &JobQueue::finished, this, &JobQueueWidget::queue_finished);
+}
+
+JobQueueWidget::~JobQueueWidget()
+{
+    delete ui;
+}
+
+void JobQueueWidget::allow_widget_input(bool allowed)
+{
+    // jobs can be added and removed while the queue runs
+    inputAllowed = allowed;
+    update_buttons();
+}
+
+void JobQueueWidget::update_buttons()
+{
+    ui->startQueueButton->setEnabled(inputAllowed && !queue->is_running() && mPrinter->mcu->g);
+    ui->pauseQueueButton->setEnabled(queue->is_running());
+    ui->summaryLabel->setText(queue->summary());
+}
+
+void JobQueueWidget::add_runner(PrinterWidget *widget)
+{
+    queue->add_runner(widget);
+}
+
+void JobQueueWidget::add_job(const QString &name, JobFile &&job)
+{
+    const int id = queue->add(name, std::move(job));
+    emit print_to_output_window(QString("Queued job %1 (%2)").arg(id).arg(name));
+}
+
+void JobQueueWidget::add_job_files()
+{
+    const QStringList fileNames = QFileDialog::getOpenFileNames(this, "Add Jobs", QDir::homePath(), "Print Jobs (*.bjob)");
+    for (const QString &fileName : fileNames)
+    {
+        JobFile job;
+        if (!job.load(fileName))
+        {
+            emit print_to_output_window(QString::fromStdString(job.error()));
+            continue;
+        }
+        add_job(QFileInfo(fileName).completeBaseName(), std::move(job));
+    }
+}
+
+int JobQueueWidget::selected_job() const
+{
+    const int row = ui->jobTable->currentRow();
+    if (row < 0 || !ui->jobTable->item(row, ID)) return -1;
+    return ui->jobTable->item(row, ID)->text().toInt();
+}
+
+void JobQueueWidget::remove_job()
+{
+    const int id = selected_job();
+    if (id < 0) return;
+    if (!queue->remove(id)) emit print_to_output_window("The running job can't be removed");
+}
+
+void JobQueueWidget::clear_finished()
+{
+    queue->clear_finished();
+}
+
+void JobQueueWidget::update_table()
+{
+    const QSignalBlocker blocker(ui->jobTable);
+    const int selected = selected_job();
+    const std::vector<QueuedJob> &jobs = queue->jobs();
+
+    ui->jobTable->setRowCount((int)jobs.size());
+    for (int row{0}; row < (int)jobs.size(); ++row)
+    {
+        const QueuedJob &job = jobs[row];
+        const bool editable = job.state == QueuedJob::State::Waiting;
+        const bool finished = job.state != QueuedJob::State::Waiting && job.state != QueuedJob::State::Running;
+
+        const QString values[] {
+            QString::number(job.id),
+            job.name,
+            QString::fromStdString(job.job->type),
+            QString::number(job.priority),
+            id_list(job.dependsOn),
+            state_name(job.state),
+            job.started.isValid() ? job.started.toString("MM/dd hh:mm:ss") : QString(),
+            finished ? QString("%1 s").arg(job.elapsed_s, 0, 'f', 1) : QString(),
+            job.result
+        };
+        for (int column{0}; column <= Result; ++column)
+        {
+            auto item = new QTableWidgetItem(values[column]);
+            if (!editable || (column != Priority && column != DependsOn))
+                item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+            ui->jobTable->setItem(row, column, item);
+        }
+        if (job.id == selected) ui->jobTable->selectRow(row);
+    }
+    ui->jobTable->resizeColumnsToContents();
+    ui->summaryLabel->setText(queue->summary());
+}
+
+void JobQueueWidget::job_cell_changed(int row, int column)
+{
+    const int id = ui->jobTable->item(row, ID)->text().toInt();
+    const QString text = ui->jobTable->item(row, column)->text();
+
+    bool ok {false};
+    if (column == Priority)
+    {
+        const int priority = text.trimmed().toInt(&ok);
+        ok = ok && queue->set_priority(id, priority);
+    }
+    else if (column == DependsOn)
+    {
+        std::vector<int> dependsOn;
+        ok = parse_id_list(text, dependsOn) && queue->set_dependencies(id, dependsOn);
+        if (!ok) emit print_to_output_window(QString("Job %1 can only depend on jobs queued before it").arg(id));
+    }
+
+    // put the old value back
+    if (!ok) QMetaObject::invokeMethod(this, &JobQueueWidget::update_table, Qt::QueuedConnection);
+}
+
+#include "moc_jobqueuewidget.cpp"
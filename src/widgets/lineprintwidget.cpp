@@ -10,6 +10,10 @@
 #include "printhread.h"
 #include "dmc4080.h"
 #include "jetdrive.h"
+#include "jobfile.h"
+#include "jetschedule.h"
+#include "settlemodel.h"
+#include "doedialog.h"
 
 using namespace std;
 
@@ -45,10 +49,11 @@ LinePrintWidget::LinePrintWidget(Printer *printer, QWidget *parent) :
 
     connect(ui->stopPrintButton, &QAbstractButton::clicked, this, &LinePrintWidget::stop_print_button_pressed);
     connect(ui->startPrint, &QAbstractButton::clicked, this, &LinePrintWidget::print_lines_dmc);
+    connect(ui->designExperimentButton, &QAbstractButton::clicked, this, &LinePrintWidget::design_experiment);
 
     // get dmc code from QRC
     dmcLinePrintCode = read_dmc_code(":/src/dmc/Line_Print.dmc");
-    dmcLinePrintCode_JetFreq = read_dmc_code(":/src/dmc/Line_Print_Jet_Freq.dmc");
+    dmcLinePrintCode_Schedule = read_dmc_code(":/src/dmc/Line_Print_Schedule.dmc");
 }
 
 LinePrintWidget::~LinePrintWidget()
@@ -67,18 +72,14 @@ void LinePrintWidget::log(QString message, enum logType messageType = logType::S
 
 void LinePrintWidget::updatePreviewWindow()
 {
-    std::vector<QLineF> lines = table.qLines(); // vector of lines to add to window
-    std::vector<QLineF> accelerationLines = table.qAccelerationLines();
-    //ui->SVGViewer->scene()->clear(); // clear the window
-    ui->SVGViewer->clear_lines();
-    for (size_t i{0}; i < lines.size(); ++i) // for each line
-    {
-        ui->SVGViewer->scene()->addLine(lines[i], linePen); // add the line to the scene
-    }
-    for (size_t i{0}; i < accelerationLines.size(); ++i) // for each line
+    // each set has a group for its lines and one for its acceleration lines,
+    // only the sets that changed are redrawn
+    for (int set : table.changed_sets())
     {
-        ui->SVGViewer->scene()->addLine(accelerationLines[i], lineTravelPen); // add the line to the scene
+        ui->SVGViewer->set_line_group(2 * set, table.set_lines(set), linePen);
+        ui->SVGViewer->set_line_group(2 * set + 1, table.set_acceleration_lines(set), lineTravelPen);
     }
+    ui->SVGViewer->remove_line_groups_from(2 * table.numRows()); // removed sets
 }
 
 void LinePrintWidget::CheckCell(int row, int column)
@@ -219,6 +220,7 @@ void LinePrintWidget::on_numSets_valueChanged(int rowCount)
 void LinePrintWidget::on_tableWidget_cellChanged(int row, int column)
 {
     CheckCell(row, column); // Check the cell that was changed
+    table.invalidate_set(row);
     updatePreviewWindow();
     ui->consoleOutput->ensureCursorVisible(); // Scroll to new content on console
 }
@@ -248,6 +250,7 @@ void LinePrintWidget::on_printPercentSlider_sliderMoved(int position)
 
     std::vector<QLineF> lines = table.qLines(); // vector of lines to add to window
     ui->SVGViewer->clear_lines(); // clear the window
+    table.invalidate_geometry(); // the next preview update has to redraw every set
 
     int numLinestoShow = lines.size() * percent;
 
@@ -309,10 +312,24 @@ void LinePrintWidget::print_lines_dmc()
 
     std::stringstream s;
 
+    // with the JetDrive setting the frequency every line is a segment of a
+    // jetting schedule, which is worked out before anything is sent
+    const bool useJetSchedule = ui->useJDriveFreqCheckBox->isChecked();
+    JetSchedule schedule;
+    if (useJetSchedule)
+    {
+        schedule = JetSchedule::from_line_print_data(table, Printer2NozzleOffsetX, Printer2NozzleOffsetY);
+        if (!schedule.error().empty())
+        {
+            log(QString::fromStdString(schedule.error()), logType::Error);
+            return;
+        }
+    }
+
     QByteArray ba;
-    if (ui->useJDriveFreqCheckBox->isChecked())
+    if (useJetSchedule)
     {
-        ba = dmcLinePrintCode_JetFreq.toLocal8Bit();
+        ba = dmcLinePrintCode_Schedule.toLocal8Bit();
     }
     else
     {
@@ -323,7 +340,7 @@ void LinePrintWidget::print_lines_dmc()
     if (mPrinter->mcu->g)
     {
         // upload program with up to full compression enabled on the preprocessor
-        if (GProgramDownload(mPrinter->mcu->g, dmcCodeC_Str, "--max 4") == G_NO_ERROR)
+        if (mPrinter->mcu->download_program(dmcCodeC_Str, "--max 4"))
             qDebug() << "Program Downloaded with compression level 4";
         else
         {
@@ -335,15 +352,22 @@ void LinePrintWidget::print_lines_dmc()
     s << CMD::stop_motion(Axis::Jet); // stop jetting if it is currently jetting
     s << CMD::set_accleration(Axis::Y, 300);
     s << CMD::set_deceleration(Axis::Y, 300);
-    //executing/verifying code
-    s << "GCmd," << "XQ #BEGIN" << "\n";
+    if (useJetSchedule)
+    {
+        s << schedule.generate_commands_for_printing();
+    }
+    else
+    {
+        //executing/verifying code
+        s << "GCmd," << "XQ #BEGIN" << "\n";
 
-    // pass line_sets here to program here
-    s << line_set_arrays_dmc();
+        // pass line_sets here to program here
+        s << line_set_arrays_dmc();
 
-    s << "GProgramComplete," << "\n";
+        s << "GProgramComplete," << "\n";
 
-    s << CMD::display_message("Print Complete");
+        s << CMD::display_message("Print Complete");
+    }
 
     emit disable_user_input();
     emit execute_command(s);
@@ -362,6 +386,12 @@ void LinePrintWidget::when_line_print_completed()
 
     // tell droplet observation widget to start jetting
     emit start_continuous_jetting();
+
+    if (runningJob_)
+    {
+        runningJob_ = false;
+        emit job_finished(true, QString("%1 line sets printed").arg(table.numRows()));
+    }
 }
 
 void LinePrintWidget::stop_print_button_pressed()
@@ -371,17 +401,15 @@ void LinePrintWidget::stop_print_button_pressed()
         emit stop_print_and_thread();
         ui->stopPrintButton->setEnabled(false);
         printIsRunning_ = false;
+        runningJob_ = false;
     }
 }
 
 void LinePrintWidget::generate_line_set_commands(int setNum, std::stringstream &s)
 {
     //Find starting position for line set
-    float lineStartX = table.startX;
-    for (int i{0}; i < setNum; ++i) // set proper x_start for current set to be printed
-    {
-        lineStartX += table.data[i].lineLength.value + table.setSpacing;
-    }
+    const QPointF origin = table.set_origins()[setNum];
+    float lineStartX = origin.x();
     LineSet *currentLineSet = &table.data[setNum];
 
     s << CMD::set_accleration(Axis::Y, 400);
@@ -394,13 +422,16 @@ void LinePrintWidget::generate_line_set_commands(int setNum, std::stringstream &
     // move to the left of the first line to be printed
     //     offset by the distance it will take to accelerate
 
-    double accelerationDistance = calculate_acceleration_distance(currentLineSet->printVelocity.value, currentLineSet->printAcceleration.value);
-    int accelerationTime_ms = (int)((currentLineSet->printVelocity.value/currentLineSet->printAcceleration.value) * 1000.0);
+    //     and settle at the print speed (see settlemodel.h)
+    double accelerationDistance = Settle::run_up_distance_mm(Axis::X, currentLineSet->printVelocity.value, currentLineSet->printAcceleration.value);
+    double settleDistance = accelerationDistance - calculate_acceleration_distance(currentLineSet->printVelocity.value, currentLineSet->printAcceleration.value);
+    int accelerationTime_ms = (int)((currentLineSet->printVelocity.value/currentLineSet->printAcceleration.value
+                                     + settleDistance/currentLineSet->printVelocity.value) * 1000.0);
     int printTime_ms = (int)((currentLineSet->lineLength.value/currentLineSet->printVelocity.value) * 1000.0);
 
     lineStartX += (Printer2NozzleOffsetX - accelerationDistance);
     double lineEndX = lineStartX + currentLineSet->lineLength.value + (2.0*accelerationDistance);
-    double lineYPos = table.startY + Printer2NozzleOffsetY;
+    double lineYPos = origin.y() + Printer2NozzleOffsetY;
 
     // configure jetting
     s << CMD::servo_here(Axis::Jet);
@@ -443,6 +474,116 @@ void LinePrintWidget::generate_line_set_commands(int setNum, std::stringstream &
     }
 }
 
+bool LinePrintWidget::save_job(JobFile &job)
+{
+    job.type = "line print";
+    Job::write_line_print_data(job, table);
+    return true;
+}
+
+bool LinePrintWidget::load_job(const JobFile &job)
+{
+    if (job.type != "line print") return false;
+
+    if (!Job::read_line_print_data(job, table) || table.numRows() == 0)
+    {
+        log("The job does not have a valid line table", logType::Error);
+        if (table.numRows() == 0) table.addRows(1);
+        return true;
+    }
+
+    update_inputs_from_table();
+    return true;
+}
+
+bool LinePrintWidget::run_job(const JobFile &job)
+{
+    if (job.type != "line print") return false;
+
+    LinePrintData jobTable;
+    if (!Job::read_line_print_data(job, jobTable) || jobTable.numRows() == 0)
+    {
+        emit job_finished(false, "The job does not have a valid line table");
+        return true;
+    }
+    load_job(job);
+
+    runningJob_ = true;
+    print_lines_dmc();
+    if (!printIsRunning_)
+    {
+        runningJob_ = false;
+        emit job_finished(false, "The print could not be started");
+    }
+    return true;
+}
+
+void LinePrintWidget::update_inputs_from_table()
+{
+    {
+        // the table is already up to date, so don't let the inputs change it
+        const QSignalBlocker numSetsBlocker(ui->numSets);
+        const QSignalBlocker startXBlocker(ui->startX);
+        const QSignalBlocker startYBlocker(ui->startY);
+        const QSignalBlocker setSpacingBlocker(ui->setSpacing);
+        const QSignalBlocker tableBlocker(ui->tableWidget);
+        ui->numSets->setValue(table.numRows());
+        ui->startX->setValue(table.startX);
+        ui->startY->setValue(table.startY);
+        ui->setSpacing->setValue(table.setSpacing);
+        updateTable(true, false);
+    }
+    updatePreviewWindow();
+}
+
+void LinePrintWidget::design_experiment()
+{
+    DOEDialog dialog(table.data[0], this);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    const DOE::Design design = dialog.design();
+    const auto errors = DOE::validate(design);
+    if (!errors.empty())
+    {
+        for (const auto &error : errors) log(QString::fromStdString(error), logType::Error);
+        return;
+    }
+
+    int skipped {0};
+    const auto sets = DOE::generate(design, &skipped);
+    if (skipped > 0)
+    {
+        log(QString::number(skipped) + " sets were left out because their print velocity is out of range", logType::Error);
+    }
+    if (sets.empty()) return;
+
+    // the x-axis can't go left of where the nozzle is over the bed edge, so
+    // the acceleration overrun has to stay right of that
+    DOE::Area area;
+    area.x_mm = std::max(0.0, -Printer2NozzleOffsetX);
+    area.width_mm = PRINT_X_SIZE_MM - area.x_mm;
+    const auto packing = DOE::pack(sets, area, table.setSpacing);
+    if (packing.placed.empty())
+    {
+        log("None of the sets fit on the bed", logType::Error);
+        return;
+    }
+    if (!packing.unplaced.empty())
+    {
+        log(QString::number(packing.unplaced.size()) + " sets did not fit on the bed and were left out", logType::Error);
+    }
+
+    table.data = packing.placed;
+    table.invalidate_geometry();
+    update_inputs_from_table();
+
+    log(QString("Packed %1 sets into %2 x %3 mm, about %4 minutes to print")
+        .arg(packing.placed.size())
+        .arg(packing.usedWidth_mm, 0, 'f', 1)
+        .arg(packing.usedHeight_mm, 0, 'f', 1)
+        .arg(packing.printTime_s / 60.0, 0, 'f', 1));
+}
+
 void LinePrintWidget::allow_widget_input(bool allowed)
 {
     ui->startPrint->setEnabled(allowed);
@@ -466,7 +607,7 @@ void LinePrintWidget::disable_velocity_input()
 void LinePrintWidget::check_x_start()
 {
     int row = 0;
-    double accelerationDistance = calculate_acceleration_distance(table.data[row].printVelocity.value, table.data[row].printAcceleration.value);
+    double accelerationDistance = Settle::run_up_distance_mm(Axis::X, table.data[row].printVelocity.value, table.data[row].printAcceleration.value);
     double xStartPos = table.startX + (Printer2NozzleOffsetX - accelerationDistance);
     if (xStartPos < 0)
     {
@@ -477,16 +618,17 @@ void LinePrintWidget::check_x_start()
     }
 }
 
-std::vector<std::array<int, 11>> LinePrintWidget::generate_line_set_arrays_dmc()
+std::vector<std::array<int, 12>> LinePrintWidget::generate_line_set_arrays_dmc()
 {
-    int startX = (table.startX + Printer2NozzleOffsetX) * X_CNTS_PER_MM;
+    const std::vector<QPointF> origins = table.set_origins();
 
-    std::vector<std::array<int, 11>> arrays;
+    std::vector<std::array<int, 12>> arrays;
     arrays.reserve(table.numRows()); // reserve the number of line sets we will be printing
     for (int i=0; i < table.numRows(); ++i) // for each line set
     {
         const int stateVal = 1; // set as 1 to start printing
-        const int startY = (table.startY + Printer2NozzleOffsetY) * Y_CNTS_PER_MM;
+        const int startX = (origins[i].x() + Printer2NozzleOffsetX) * X_CNTS_PER_MM;
+        const int startY = (origins[i].y() + Printer2NozzleOffsetY) * Y_CNTS_PER_MM;
         const int numLines = table.data[i].numLines.value;
         const int lineSpacing = table.data[i].lineSpacing.value * Y_CNTS_PER_MM;
         const int lineLength = table.data[i].lineLength.value * X_CNTS_PER_MM;
@@ -495,12 +637,13 @@ std::vector<std::array<int, 11>> LinePrintWidget::generate_line_set_arrays_dmc()
         const int printSpeed = table.data[i].printVelocity.value * X_CNTS_PER_MM;
         const int printAcceleration = table.data[i].printAcceleration.value * X_CNTS_PER_MM;
         const int index = 0;
+        const int runUp = Settle::run_up_distance_mm(Axis::X, table.data[i].printVelocity.value,
+                                                     table.data[i].printAcceleration.value) * X_CNTS_PER_MM;
 
         arrays.push_back({stateVal, startX, startY, numLines, lineSpacing, lineLength,
-                     dropletSpacing, jettingFreq, printSpeed, printAcceleration, index});
-        startX += ((table.data[i].lineLength.value + table.setSpacing) * X_CNTS_PER_MM);
+                     dropletSpacing, jettingFreq, printSpeed, printAcceleration, index, runUp});
     }
-    arrays.push_back({2,0,0,0,0,0,0,0,0,0,0}); // one more to tell the printer to stop printing
+    arrays.push_back({2,0,0,0,0,0,0,0,0,0,0,0}); // one more to tell the printer to stop printing
     // the 2 tell the printer to stop
     return arrays;
 }
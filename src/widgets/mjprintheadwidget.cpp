@@ -90,7 +90,9 @@ void MJPrintheadWidget::read_in_file(const QString &filename)
         return;
     }
 
-    mPrinter->mjController->send_image_data(1, image, 0);
+    // gray levels are binder saturation, halftoned to droplets like a raster print
+    const auto halftone = static_cast<Halftone::Method>(ui->halftoneComboBox->currentIndex());
+    mPrinter->mjController->send_image_data(1, image, 0, halftone);
 
 }
 
@@ -220,7 +222,7 @@ void MJPrintheadWidget::testPrintPressed()
 
     if (mPrinter->mcu->g)
     {
-        GProgramDownload(mPrinter->mcu->g, commands, "");
+        mPrinter->mcu->download_program(commands, "");
     }
 
 //    int errorCode = 0;
@@ -450,7 +452,7 @@ void MJPrintheadWidget::printBMPatLocation(double xLocation, double yLocation, d
 
     if (mPrinter->mcu->g)
     {
-        GProgramDownload(mPrinter->mcu->g, commands, "");
+        mPrinter->mcu->download_program(commands, "");
     }
 
     std::stringstream c;
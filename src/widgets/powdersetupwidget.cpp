@@ -6,6 +6,8 @@
 #include "printer.h"
 #include "dmc4080.h"
 #include "mister.h"
+#include "printhread.h"
+#include "jobfile.h"
 
 #include <QMessageBox>
 #include <QDebug>
@@ -22,6 +24,7 @@ PowderSetupWidget::PowderSetupWidget(Printer *printer, QWidget *parent) :
     connect(ui->toggleMisterButton, &QAbstractButton::clicked, this, &PowderSetupWidget::toggle_mister_clicked);
 
     connect(ui->cureLayerButton, &QPushButton::clicked, this, &PowderSetupWidget::cure_layer_pressed);
+    connect(printer->mcu->printerThread, &PrintThread::phase_started, this, &PowderSetupWidget::time_recoat);
 
     setAccessibleName("Powder Setup Widget");
 
@@ -35,21 +38,24 @@ PowderSetupWidget::~PowderSetupWidget()
     delete ui;
 }
 
-void PowderSetupWidget::level_recoat_clicked()
+RecoatSettings PowderSetupWidget::recoat_settings(bool levelRecoat) const
 {
-    std::stringstream s;
-    int numLayers{ui->recoatCyclesSpinBox->value()};
-    RecoatSettings levelRecoat{};
-    levelRecoat.isLevelRecoat = true;
-    levelRecoat.rollerTraverseSpeed_mm_s = ui->rollerTraverseSpeedSpinBox->value();
-    levelRecoat.recoatSpeed_mm_s = ui->recoatSpeedSpinBox->value();
+    RecoatSettings settings {};
+    settings.isLevelRecoat = levelRecoat;
+    settings.rollerTraverseSpeed_mm_s = ui->rollerTraverseSpeedSpinBox->value();
+    settings.recoatSpeed_mm_s = ui->recoatSpeedSpinBox->value();
     // Index from the combo box must match up with the data to be sent over RS-232 to the generator (see documentation for generator)
-    levelRecoat.ultrasonicIntensityLevel = ui->ultrasonicIntensityComboBox->currentIndex();
-    levelRecoat.ultrasonicMode = ui->ultrasonicModeComboBox->currentIndex();
-    levelRecoat.layerHeight_microns = ui->layerHeightSpinBox->value();
-    levelRecoat.waitAfterHopperOn_millisecs = ui->hopperDwellTimeMsSpinBox->value();
+    settings.ultrasonicIntensityLevel = ui->ultrasonicIntensityComboBox->currentIndex();
+    settings.ultrasonicMode = ui->ultrasonicModeComboBox->currentIndex();
+    settings.layerHeight_microns = ui->layerHeightSpinBox->value();
+    settings.waitAfterHopperOn_millisecs = ui->hopperDwellTimeMsSpinBox->value();
+    return settings;
+}
 
-    s << CMD::display_message("starting level recoat...");
+std::string PowderSetupWidget::recoat_commands(const RecoatSettings &settings, int numLayers) const
+{
+    std::stringstream s;
+    s << CMD::display_message(settings.isLevelRecoat ? "starting level recoat..." : "starting normal recoat...");
     for(int i{0}; i < numLayers; ++i)
     {
         std::string message{"spreading layer "};
@@ -58,12 +64,21 @@ void PowderSetupWidget::level_recoat_clicked()
         message += std::to_string(numLayers);
         message += "...";
         s << CMD::display_message(message);
-        s << CMD::spread_layer(levelRecoat);
+        s << CMD::phase_mark("spread", i);
+        s << CMD::library::spread_layer(settings);
+        s << CMD::phase_mark("spread done", i);
     }
     s << CMD::display_message("powder spreading complete");
     s << CMD::display_message("");
 
     s << CMD::move_xy_axes_to_default_position();
+    return s.str();
+}
+
+void PowderSetupWidget::level_recoat_clicked()
+{
+    std::stringstream s;
+    s << recoat_commands(recoat_settings(true), ui->recoatCyclesSpinBox->value());
 
     emit execute_command(s);
     emit generate_printing_message_box("Level recoat is in progress.");
@@ -72,37 +87,66 @@ void PowderSetupWidget::level_recoat_clicked()
 void PowderSetupWidget::normal_recoat_clicked()
 {
     std::stringstream s;
-    int numLayers{ui->recoatCyclesSpinBox->value()};
-    RecoatSettings layerRecoatSettings {};
-    layerRecoatSettings.isLevelRecoat = false;
-    layerRecoatSettings.rollerTraverseSpeed_mm_s = ui->rollerTraverseSpeedSpinBox->value();
-    layerRecoatSettings.recoatSpeed_mm_s = ui->recoatSpeedSpinBox->value();
-    // Note: Index from the combo box must match up with the data to be sent over RS-232 to the generator (see documentation of generator)
-    layerRecoatSettings.ultrasonicIntensityLevel = ui->ultrasonicIntensityComboBox->currentIndex();
-    layerRecoatSettings.ultrasonicMode = ui->ultrasonicModeComboBox->currentIndex();
-    layerRecoatSettings.layerHeight_microns = ui->layerHeightSpinBox->value();
-    layerRecoatSettings.waitAfterHopperOn_millisecs = ui->hopperDwellTimeMsSpinBox->value();
-
-    s << CMD::display_message("starting normal recoat...");
-    for(int i{0}; i < numLayers; ++i)
-    {
-        std::string message{"spreading layer "};
-        message += std::to_string(i+1);
-        message += " of ";
-        message += std::to_string(numLayers);
-        message += "...";
-        s << CMD::display_message(message);
-        s << CMD::spread_layer(layerRecoatSettings);
-    }
-    s << CMD::display_message("powder spreading complete");
-    s << CMD::display_message("");
-
-    s << CMD::move_xy_axes_to_default_position();
+    s << recoat_commands(recoat_settings(false), ui->recoatCyclesSpinBox->value());
 
     emit execute_command(s);
     emit generate_printing_message_box("Normal recoat is in progress.");
 }
 
+bool PowderSetupWidget::save_job(JobFile &job)
+{
+    // a normal recoat, the cycles between prints. Set isLevelRecoat in the
+    // job for a level recoat
+    job.type = "recoat";
+    job.settings["recoat"] = recoat_settings(false);
+    job.settings["cycles"] = ui->recoatCyclesSpinBox->value();
+    return true;
+}
+
+bool PowderSetupWidget::load_job(const JobFile &job)
+{
+    if (job.type != "recoat") return false;
+
+    const RecoatSettings settings = job.settings.value("recoat", recoat_settings(false));
+    ui->rollerTraverseSpeedSpinBox->setValue(settings.rollerTraverseSpeed_mm_s);
+    ui->recoatSpeedSpinBox->setValue(settings.recoatSpeed_mm_s);
+    ui->ultrasonicIntensityComboBox->setCurrentIndex(settings.ultrasonicIntensityLevel);
+    ui->ultrasonicModeComboBox->setCurrentIndex(settings.ultrasonicMode);
+    ui->layerHeightSpinBox->setValue(settings.layerHeight_microns);
+    ui->hopperDwellTimeMsSpinBox->setValue(settings.waitAfterHopperOn_millisecs);
+    ui->recoatCyclesSpinBox->setValue(job.settings.value("cycles", ui->recoatCyclesSpinBox->value()));
+    return true;
+}
+
+bool PowderSetupWidget::run_job(const JobFile &job)
+{
+    if (!load_job(job)) return false;
+
+    const RecoatSettings settings = job.settings.value("recoat", recoat_settings(false));
+    const int numLayers = ui->recoatCyclesSpinBox->value();
+
+    std::stringstream s;
+    s << recoat_commands(settings, numLayers);
+    emit execute_command(s);
+    emit disable_user_input();
+    finish_job_when_stream_ends();
+    return true;
+}
+
+void PowderSetupWidget::time_recoat(const QString &phase, int layer)
+{
+    if (phase == "spread")
+    {
+        recoatTimer.start();
+    }
+    else if (phase == "spread done" && recoatTimer.isValid())
+    {
+        emit print_to_output_window(QString("Spreading layer %1 took %2 s")
+                                    .arg(layer + 1).arg(recoatTimer.elapsed() / 1000.0, 0, 'f', 1));
+        recoatTimer.invalidate();
+    }
+}
+
 void PowderSetupWidget::allow_widget_input(bool allowed)
 {
     ui->recoaterSettingsFrame->setEnabled(allowed);
@@ -113,31 +157,9 @@ void PowderSetupWidget::allow_widget_input(bool allowed)
 void PowderSetupWidget::mist_layer()
 {
     std::stringstream s;
-    s << "GCmd,#BEGIN\n";
     const double mistSpeed = ui->mistTraverseSpeedSpinBox->value();
-    const double mistDwellTime = int(1000.0 * ui->misterDwellTimeSpinBox->value());
-    s << CMD::mist_layer(mistSpeed, mistDwellTime);
-
-    auto programString = CMD::cmd_buf_to_dmc(s);
-    programString += "EN;"; // Controller doesn't like an empty line at the end
-    const char* program = programString.c_str();
-
-    if (mPrinter->mcu->g)
-    {
-        // upload program with up to full compression enabled on the preprocessor
-        if (GProgramDownload(mPrinter->mcu->g, program, "--max 4") == G_NO_ERROR)
-            qDebug() << "Program Downloaded with compression level 4";
-        else
-        {
-            qDebug() << "Unexpected GProgramDownload() behaviour";
-            return;
-        }
-    }
-
-    s.clear();
-
-    s << "GCmd," << "XQ #BEGIN" << "\n";
-    s << "GProgramComplete," << "\n";
+    const int mistDwellTime = int(1000.0 * ui->misterDwellTimeSpinBox->value());
+    s << CMD::library::mist_layer(mistSpeed, mistDwellTime);
     s << CMD::display_message("Print Complete");
 
     emit disable_user_input();
@@ -165,62 +187,15 @@ void PowderSetupWidget::toggle_mister_clicked()
 void PowderSetupWidget::cure_layer_pressed()
 {
     std::stringstream s;
-    Axis y {Axis::Y};
-    double zAxisOffsetUnderRoller {0.5};
-    const double defaultTraverseSpeed = 60.0;
-    using namespace CMD;
-    const double heatLampStart_mm = -310;
-    const double heatLampEnd_mm = -460;
-
     const double heatingTraverseSpeed = ui->heatLampSpeedSpinBox->value();
 
-    s << display_message("curing layer...");
-
-    // move z-axis down when going back to get more powder
-    s << set_accleration(Axis::Z, 10)
-      << set_deceleration(Axis::Z, 10)
-      << set_speed(Axis::Z, 2)
-      << position_relative(Axis::Z, -zAxisOffsetUnderRoller)
-      << begin_motion(Axis::Z)
-      << motion_complete(Axis::Z);
-
-    // move to just before the heat lamp
-    s << set_accleration(y, 400);
-    s << set_deceleration(y, 400);
-    s << set_speed(y, defaultTraverseSpeed);
-    s << position_absolute(y, heatLampStart_mm)
-      << begin_motion(y)
-      << motion_complete(y);
-
-    // turn on heat lamp
-    s << set_bit(HEAT_LAMP_BIT);
-
-    // traverse under heat lamp
-    s << set_speed(y, heatingTraverseSpeed);
-    s << position_absolute(y, heatLampEnd_mm);
-    s << begin_motion(y);
-    s << motion_complete(y);
-
-    // turn off heat lamp
-    s << clear_bit(HEAT_LAMP_BIT);
-
-    // move z-axis back up
-    s << position_relative(Axis::Z, zAxisOffsetUnderRoller);
-    // move to back of y-axis
-    s << position_absolute(y, -Y_STAGE_LEN_MM);
-    s << set_speed(y, defaultTraverseSpeed);
-    s << begin_motion(Axis::Z);
-    s << begin_motion(y);
-    s << motion_complete(y);
-    s << motion_complete(Axis::Z);
-
-    s << display_message("layer cured");
-    s << display_message("");
-
+    s << CMD::display_message("curing layer...");
+    s << CMD::library::cure_layer(heatingTraverseSpeed);
+    s << CMD::display_message("layer cured");
+    s << CMD::display_message("");
 
     emit execute_command(s);
     emit generate_printing_message_box("Layer cure is in progress.");
-
 }
 
 #include "moc_powdersetupwidget.cpp"
@@ -13,4 +13,15 @@ PrinterWidget::~PrinterWidget()
 
 }
 
+void PrinterWidget::finish_job_when_stream_ends()
+{
+    connect(mPrintThread, &PrintThread::ended, this, &PrinterWidget::when_job_stream_ended);
+}
+
+void PrinterWidget::when_job_stream_ended()
+{
+    disconnect(mPrintThread, &PrintThread::ended, this, &PrinterWidget::when_job_stream_ended); // run once
+    emit job_finished(true, {});
+}
+
 #include "moc_printerwidget.cpp"
@@ -0,0 +1,275 @@
+#include "rasterprintwidget.h"
+#include "ui_rasterprintwidget.h"
+
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+
+#include "printer.h"
+#include "printhread.h"
+#include "dmc4080.h"
+#include "halftone.h"
+#include "jobfile.h"
+
+RasterPrintWidget::RasterPrintWidget(Printer *printer, QWidget *parent) :
+    PrinterWidget(printer, parent),
+    ui(new Ui::RasterPrintWidget)
+{
+    ui->setupUi(this);
+    setAccessibleName("Raster Print Widget");
+
+    ui->SVGViewer->setup(PRINT_X_SIZE_MM, PRINT_Y_SIZE_MM);
+
+    // Connect all Spin Boxes to update print settings when finished editing
+    QList<QAbstractSpinBox *> printSettingWidgets = this->findChildren<QAbstractSpinBox *> ();
+    for(int i{0}; i < printSettingWidgets.count(); ++i)
+    {
+       connect(printSettingWidgets[i], &QAbstractSpinBox::editingFinished, this, &RasterPrintWidget::update_print_settings);
+    }
+
+    connect(ui->halftoneComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, &RasterPrintWidget::update_bitmap);
+    connect(ui->loadFileButton, &QAbstractButton::clicked, this, &RasterPrintWidget::load_file);
+    connect(ui->printButton, &QAbstractButton::clicked, this, &RasterPrintWidget::print_bitmap);
+    connect(ui->stopPrintButton, &QAbstractButton::clicked, this, &RasterPrintWidget::stop_printing);
+
+    // get dmc code from QRC
+    QFile file(":/src/dmc/Raster_Print.dmc");
+    if (file.open(QFile::ReadOnly | QFile::Text))
+    {
+        QTextStream in(&file);
+        dmcRasterPrintCode = in.readAll();
+    }
+    else
+    {
+        qDebug() << " Could not open the raster print program for reading";
+    }
+
+    update_print_settings();
+}
+
+RasterPrintWidget::~RasterPrintWidget()
+{
+    delete ui;
+}
+
+void RasterPrintWidget::allow_widget_input(bool allowed)
+{
+    ui->printButton->setEnabled(allowed && !bitmap.empty());
+    ui->printParametersFrame->setEnabled(allowed);
+}
+
+bool RasterPrintWidget::save_job(JobFile &job)
+{
+    job.type = "raster print";
+    job.settings["dropletSpacing_um"] = print.dropletSpacing_um;
+    job.settings["lineSpacing_um"] = print.lineSpacing_um;
+    job.settings["jettingFrequency_Hz"] = print.jettingFrequency_Hz;
+    job.settings["acceleration_mm_per_s2"] = print.acceleration_mm_per_s2;
+    job.settings["travelSpeed_mm_per_s"] = print.travelSpeed_mm_per_s;
+    job.settings["originX_mm"] = print.originX_mm;
+    job.settings["originY_mm"] = print.originY_mm;
+    job.settings["halftone"] = ui->halftoneComboBox->currentIndex();
+    job.settings["fileName"] = ui->fileNameLabel->text().toStdString();
+
+    // the halftoned droplets are what gets printed, the gray levels are kept
+    // so the halftone method can still be changed after opening the job
+    Job::write_bitmap(job, "bitmap", bitmap);
+    if (!sourceImage.isNull())
+    {
+        const QImage gray = sourceImage.convertToFormat(QImage::Format_Grayscale8);
+        Bitmap levels {gray.width(), gray.height(), {}};
+        levels.pixels.resize((size_t)gray.width() * gray.height());
+        for (int y{0}; y < gray.height(); ++y)
+        {
+            std::copy_n(gray.constScanLine(y), gray.width(), levels.pixels.data() + (size_t)y * gray.width());
+        }
+        Job::write_bitmap(job, "sourceImage", levels);
+    }
+    return true;
+}
+
+bool RasterPrintWidget::load_job(const JobFile &job)
+{
+    if (job.type != "raster print") return false;
+
+    const auto &s = job.settings;
+    ui->dropletSpacingSpinBox->setValue(s.value("dropletSpacing_um", print.dropletSpacing_um));
+    ui->lineSpacingSpinBox->setValue(s.value("lineSpacing_um", print.lineSpacing_um));
+    ui->jettingFrequencySpinBox->setValue(s.value("jettingFrequency_Hz", print.jettingFrequency_Hz));
+    ui->accelerationSpinBox->setValue(s.value("acceleration_mm_per_s2", print.acceleration_mm_per_s2));
+    ui->travelSpeedSpinBox->setValue(s.value("travelSpeed_mm_per_s", print.travelSpeed_mm_per_s));
+    ui->originXSpinBox->setValue(s.value("originX_mm", print.originX_mm));
+    ui->originYSpinBox->setValue(s.value("originY_mm", print.originY_mm));
+    ui->fileNameLabel->setText(QString::fromStdString(s.value("fileName", std::string{})));
+
+    // both bitmaps stay in the job file, nothing is read until it's used
+    Bitmap levels;
+    if (Job::read_bitmap(job, "sourceImage", levels))
+    {
+        sourceImage = QImage(levels.data(), levels.width, levels.height, levels.width, QImage::Format_Grayscale8);
+        sourceOwner = levels.owner;
+    }
+    else
+    {
+        sourceImage = QImage();
+        sourceOwner.reset();
+    }
+
+    {
+        // don't halftone again from the source image, use the saved droplets
+        const QSignalBlocker blocker(ui->halftoneComboBox);
+        ui->halftoneComboBox->setCurrentIndex(s.value("halftone", ui->halftoneComboBox->currentIndex()));
+    }
+    if (!Job::read_bitmap(job, "bitmap", bitmap)) bitmap = Bitmap{};
+
+    ui->printButton->setEnabled(!bitmap.empty() && mPrinter->mcu->g);
+    update_print_settings();
+    return true;
+}
+
+bool RasterPrintWidget::run_job(const JobFile &job)
+{
+    if (!load_job(job)) return false;
+
+    if (bitmap.empty())
+    {
+        emit job_finished(false, "The job does not have a bitmap to print");
+        return true;
+    }
+
+    runningJob_ = true;
+    print_bitmap();
+    if (!printIsRunning_)
+    {
+        runningJob_ = false;
+        emit job_finished(false, "Could not download the raster print program");
+    }
+    return true;
+}
+
+void RasterPrintWidget::load_file()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Open Bitmap", QDir::homePath(),
+                                                    "Images (*.png *.bmp *.pbm *.tif *.tiff);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    sourceImage = QImage(fileName);
+    sourceOwner.reset();
+    if (sourceImage.isNull())
+    {
+        emit print_to_output_window("Could not load " + fileName);
+    }
+    else
+    {
+        emit print_to_output_window(QString("Loaded %1 x %2 droplet image").arg(sourceImage.width()).arg(sourceImage.height()));
+    }
+
+    ui->fileNameLabel->setText(QFileInfo(fileName).fileName());
+    update_bitmap();
+}
+
+void RasterPrintWidget::update_bitmap()
+{
+    // gray levels in the image are the binder saturation (darker is more)
+    const auto method = static_cast<Halftone::Method>(ui->halftoneComboBox->currentIndex());
+    bitmap = sourceImage.isNull() ? Bitmap{} : Halftone::dither(sourceImage, method);
+
+    ui->printButton->setEnabled(!bitmap.empty() && mPrinter->mcu->g);
+    update_preview();
+}
+
+void RasterPrintWidget::update_print_settings()
+{
+    print.dropletSpacing_um = ui->dropletSpacingSpinBox->value();
+    print.lineSpacing_um = ui->lineSpacingSpinBox->value();
+    print.jettingFrequency_Hz = ui->jettingFrequencySpinBox->value();
+    print.acceleration_mm_per_s2 = ui->accelerationSpinBox->value();
+    print.travelSpeed_mm_per_s = ui->travelSpeedSpinBox->value();
+    print.originX_mm = ui->originXSpinBox->value();
+    print.originY_mm = ui->originYSpinBox->value();
+
+    ui->printSpeedLabel->setText(QString::number(print.print_speed_mm_per_s()) + " mm/s");
+
+    update_preview();
+}
+
+void RasterPrintWidget::update_preview()
+{
+    ui->SVGViewer->clear_lines();
+    if (bitmap.empty()) return;
+
+    // the scene has y pointing down
+    auto to_scene = [](double x, double y) { return QPointF(x, PRINT_Y_SIZE_MM - y); };
+
+    for (int row{0}; row < bitmap.height; ++row)
+    {
+        const double y = print.pixel_y_mm(bitmap, row);
+        for (const auto &run : runs_in_row(bitmap, row))
+        {
+            ui->SVGViewer->scene()->addLine(QLineF(to_scene(print.pixel_x_mm(run.first), y),
+                                                   to_scene(print.pixel_x_mm(run.last), y)), linePen);
+        }
+    }
+}
+
+void RasterPrintWidget::print_bitmap()
+{
+    if (bitmap.empty()) return;
+
+    emit stop_continuous_jetting();
+
+    if (mPrinter->mcu->g)
+    {
+        QByteArray ba = dmcRasterPrintCode.toLocal8Bit();
+        // upload program with up to full compression enabled on the preprocessor
+        if (!mPrinter->mcu->download_program(ba.data(), "--max 4"))
+        {
+            emit print_to_output_window("Could not download the raster print program");
+            return;
+        }
+    }
+
+    std::stringstream s;
+    s << print.generate_commands_for_printing(bitmap);
+
+    emit print_to_output_window("Printing bitmap");
+    emit execute_command(s);
+    emit disable_user_input();
+
+    printIsRunning_ = true;
+    ui->stopPrintButton->setEnabled(true);
+    connect(mPrintThread, &PrintThread::ended, this, &RasterPrintWidget::when_print_completed);
+}
+
+void RasterPrintWidget::stop_printing()
+{
+    if (printIsRunning_)
+    {
+        disconnect(mPrintThread, &PrintThread::ended, this, &RasterPrintWidget::when_print_completed);
+        emit stop_print_and_thread();
+        emit print_to_output_window("Print Stopped");
+        printIsRunning_ = false;
+        runningJob_ = false;
+        ui->stopPrintButton->setEnabled(false);
+    }
+}
+
+void RasterPrintWidget::when_print_completed()
+{
+    disconnect(mPrintThread, &PrintThread::ended, this, &RasterPrintWidget::when_print_completed); // run once
+    printIsRunning_ = false;
+    ui->stopPrintButton->setEnabled(false);
+
+    emit start_continuous_jetting();
+
+    if (runningJob_)
+    {
+        runningJob_ = false;
+        emit job_finished(true, QString("%1 x %2 droplet bitmap printed").arg(bitmap.width).arg(bitmap.height));
+    }
+}
+
+#include "moc_rasterprintwidget.cpp"
@@ -0,0 +1,276 @@
+#include "servotuningwidget.h"
+#include "ui_servotuningwidget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "printer.h"
+#include "dmc4080.h"
+
+ServoTuningWidget::ServoTuningWidget(Printer *printer, QWidget *parent) :
+    PrinterWidget(printer, parent),
+    ui(new Ui::ServoTuningWidget)
+{
+    ui->setupUi(this);
+    setAccessibleName("Servo Tuning Widget");
+
+    connect(ui->runStepTestButton, &QAbstractButton::clicked, this, &ServoTuningWidget::run_step_test);
+    connect(ui->runSineSweepButton, &QAbstractButton::clicked, this, &ServoTuningWidget::run_sine_sweep);
+    connect(ui->applyGainsButton, &QAbstractButton::clicked, this, &ServoTuningWidget::apply_gains);
+    connect(ui->calibrateSettleButton, &QAbstractButton::clicked, this, &ServoTuningWidget::calibrate_settle_times);
+
+    const int calibrated = (int)Settle::model().measurements().size();
+    ui->settleReportLabel->setText(calibrated > 0 ? QString("%1 settle times measured").arg(calibrated)
+                                                  : "Not calibrated, the fixed margins are used");
+}
+
+ServoTuningWidget::~ServoTuningWidget()
+{
+    delete ui;
+}
+
+void ServoTuningWidget::allow_widget_input(bool allowed)
+{
+    ui->runStepTestButton->setEnabled(allowed);
+    ui->runSineSweepButton->setEnabled(allowed);
+    ui->applyGainsButton->setEnabled(allowed && proposal.found);
+    ui->calibrateSettleButton->setEnabled(allowed);
+}
+
+Axis ServoTuningWidget::selected_axis() const
+{
+    // the z-axis can't take a full speed step, it isn't offered
+    return ui->axisComboBox->currentIndex() == 1 ? Axis::Y : Axis::X;
+}
+
+void ServoTuningWidget::run_step_test()
+{
+    Tuning::StepTest test;
+    test.axis = selected_axis();
+    test.step_mm = ui->stepSizeSpinBox->value();
+    test.duration_s = ui->stepDurationSpinBox->value();
+
+    experimentAxis = test.axis;
+    experimentDuration_s = test.duration_s;
+    experimentIsStep = true;
+
+    std::stringstream s;
+    s << Tuning::step_test_commands(test);
+    emit print_to_output_window("Running step test");
+    emit execute_command(s);
+    emit disable_user_input();
+    connect(mPrintThread, &PrintThread::ended, this, &ServoTuningWidget::when_experiment_finished);
+}
+
+void ServoTuningWidget::run_sine_sweep()
+{
+    if (!mPrinter->mcu->g) return;
+
+    Tuning::SineSweep sweep;
+    sweep.axis = selected_axis();
+    sweep.amplitude_V = ui->sweepAmplitudeSpinBox->value();
+    sweep.startFrequency_Hz = ui->sweepStartSpinBox->value();
+    sweep.endFrequency_Hz = ui->sweepEndSpinBox->value();
+    sweep.duration_s = ui->sweepDurationSpinBox->value();
+
+    experimentAxis = sweep.axis;
+    experimentDuration_s = sweep.duration_s;
+    experimentIsStep = false;
+
+    if (!mPrinter->mcu->download_program(Tuning::sine_sweep_program(sweep).c_str()))
+    {
+        emit print_to_output_window("Could not download the sine sweep program");
+        return;
+    }
+
+    std::stringstream s;
+    s << Tuning::sine_sweep_commands(sweep);
+    emit print_to_output_window("Running sine sweep");
+    emit execute_command(s);
+    emit disable_user_input();
+    connect(mPrintThread, &PrintThread::ended, this, &ServoTuningWidget::when_experiment_finished);
+}
+
+void ServoTuningWidget::when_experiment_finished()
+{
+    disconnect(mPrintThread, &PrintThread::ended, this, &ServoTuningWidget::when_experiment_finished); // run once
+
+    GCon g = mPrinter->mcu->g;
+    Tuning::Record record;
+    if (!Tuning::upload_record(g, experimentDuration_s, record))
+    {
+        emit print_to_output_window("Could not upload the recording");
+        return;
+    }
+
+    const std::string axis = CMD::detail::axis_string(experimentAxis);
+    QStringList report;
+
+    const double tolerance_cnts = ui->toleranceSpinBox->value();
+    if (experimentIsStep)
+    {
+        const Tuning::StepMetrics measured = Tuning::measure_step(record, tolerance_cnts);
+        report << QString::fromStdString("Measured step: " + measured.summary());
+    }
+
+    const Tuning::PlantModel plant = Tuning::fit_plant(record);
+    if (!plant.valid())
+    {
+        report << "The recording could not be fit, try a larger step or sweep";
+        proposal = {};
+        ui->reportLabel->setText(report.join("\n"));
+        ui->applyGainsButton->setEnabled(false);
+        return;
+    }
+    report << QString("Plant: %1 counts/s² per V, damping %2 /s (R² %3)")
+              .arg(plant.gain_cnts_per_s2_per_V, 0, 'g', 4)
+              .arg(plant.damping_per_s, 0, 'f', 2)
+              .arg(plant.fit_R2, 0, 'f', 3);
+
+    double torqueLimit_V {9.998};
+    GCmdD(g, ("MG _TL" + axis).c_str(), &torqueLimit_V);
+
+    // the step size the gains are judged on
+    const double countsPerMM = experimentAxis == Axis::Y ? Y_CNTS_PER_MM : X_CNTS_PER_MM;
+    const double step_cnts = ui->stepSizeSpinBox->value() * countsPerMM;
+    const double maxOvershoot = ui->maxOvershootSpinBox->value();
+
+    Tuning::Gains current;
+    if (Tuning::read_gains(g, experimentAxis, current))
+    {
+        const Tuning::StepMetrics predicted = Tuning::simulate_step(plant, current, step_cnts, tolerance_cnts, torqueLimit_V);
+        report << QString("Current: KP%1=%2, KD%1=%3, KI%1=%4 (%5)")
+                  .arg(QString::fromStdString(axis))
+                  .arg(current.KP, 0, 'f', 3).arg(current.KD, 0, 'f', 3).arg(current.KI, 0, 'f', 3)
+                  .arg(QString::fromStdString(predicted.summary()));
+    }
+
+    proposal = Tuning::propose_gains(plant, maxOvershoot, step_cnts, tolerance_cnts, torqueLimit_V);
+    report << QString::fromStdString("Proposed: " + proposal.summary(experimentAxis));
+
+    ui->reportLabel->setText(report.join("\n"));
+    ui->applyGainsButton->setEnabled(proposal.found);
+    emit print_to_output_window(report.join("\n"));
+}
+
+void ServoTuningWidget::apply_gains()
+{
+    if (!proposal.found) return;
+
+    std::stringstream s;
+    s << Tuning::set_gains(experimentAxis, proposal.gains);
+    emit print_to_output_window("Applied " + QString::fromStdString(proposal.summary(experimentAxis)));
+    emit print_to_output_window("These only last until the controller is reset, put them in "
+                                "set_default_controller_settings to keep them");
+    emit execute_command(s);
+}
+
+namespace
+{
+std::vector<double> positive_numbers(const QString &text)
+{
+    std::vector<double> numbers;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts))
+    {
+        bool ok {false};
+        const double number = item.trimmed().toDouble(&ok);
+        if (ok && number > 0) numbers.push_back(number);
+    }
+    return numbers;
+}
+}
+
+void ServoTuningWidget::calibrate_settle_times()
+{
+    if (!mPrinter->mcu->g || !settleMoves.empty()) return;
+
+    const Axis axis = selected_axis();
+    const double stageLength_mm = axis == Axis::Y ? Y_STAGE_LEN_MM : X_STAGE_LEN_MM;
+    const std::vector<double> speeds = positive_numbers(ui->settleSpeedsLineEdit->text());
+    const std::vector<double> accelerations = positive_numbers(ui->settleAccelerationsLineEdit->text());
+
+    settleReport.clear();
+    double longest_mm {};
+    int direction {1};
+    for (const double speed : speeds)
+    {
+        for (const double acceleration : accelerations)
+        {
+            Settle::CalibrationMove move;
+            move.axis = axis;
+            move.speed_mm_s = speed;
+            move.acceleration_mm_s2 = acceleration;
+            move.direction = direction;
+
+            const double distance = Settle::distance_mm(move);
+            if (distance > stageLength_mm / 2)
+            {
+                settleReport << QString("%1 mm/s at %2 mm/s² needs too long a move (%3 mm), skipped")
+                                .arg(speed).arg(acceleration).arg(distance, 0, 'f', 1);
+                continue;
+            }
+            longest_mm = std::max(longest_mm, distance);
+            settleMoves.push_back(move);
+            direction = -direction; // back and forth about where it started
+        }
+    }
+
+    if (settleMoves.empty())
+    {
+        ui->settleReportLabel->setText("Nothing to calibrate, enter speeds and accelerations");
+        return;
+    }
+
+    emit print_to_output_window(QString("Calibrating settle times of the %1-axis, it moves up to %2 mm forward")
+                                .arg(QString::fromStdString(CMD::detail::axis_string(axis)))
+                                .arg(longest_mm, 0, 'f', 1));
+    run_next_settle_move();
+}
+
+void ServoTuningWidget::run_next_settle_move()
+{
+    const Settle::CalibrationMove &move = settleMoves.front();
+
+    std::stringstream s;
+    s << Settle::calibration_move_commands(move);
+    emit execute_command(s);
+    emit disable_user_input();
+    connect(mPrintThread, &PrintThread::ended, this, &ServoTuningWidget::when_settle_move_finished);
+}
+
+void ServoTuningWidget::when_settle_move_finished()
+{
+    disconnect(mPrintThread, &PrintThread::ended, this, &ServoTuningWidget::when_settle_move_finished); // run once
+
+    const Settle::CalibrationMove move = settleMoves.front();
+    settleMoves.pop_front();
+
+    Settle::Measurement measurement;
+    const QString name = QString("%1 mm/s at %2 mm/s²").arg(move.speed_mm_s).arg(move.acceleration_mm_s2);
+    if (Settle::measure(mPrinter->mcu->g, move, ui->settleToleranceSpinBox->value(), measurement))
+    {
+        Settle::model().add(measurement);
+        settleReport << QString("%1: settles %2 ms into the run, %3 ms after stopping")
+                        .arg(name)
+                        .arg(measurement.runUpSettle_ms, 0, 'f', 1)
+                        .arg(measurement.stopSettle_ms, 0, 'f', 1);
+    }
+    else
+    {
+        settleReport << name + ": did not settle within the tolerance";
+    }
+
+    if (!settleMoves.empty())
+    {
+        run_next_settle_move();
+        return;
+    }
+
+    if (!Settle::model().save(Settle::default_file()))
+        settleReport << "Could not save the settle times";
+    ui->settleReportLabel->setText(settleReport.join("\n"));
+    emit print_to_output_window(settleReport.join("\n"));
+}
+
+#include "moc_servotuningwidget.cpp"
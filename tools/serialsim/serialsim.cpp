@@ -0,0 +1,552 @@
+// Virtual serial devices for running the printer software without the
+// JetDrive, pressure controller, mister or MJ board connected.
+//
+// Each device is a Linux pseudo-terminal linked from the directory given with
+// --dir (/tmp/bjsim by default), e.g. /tmp/bjsim/jetdrive. Point the printer at
+// them with the BJ_*_PORT environment variables, e.g.
+//
+//   serialsim --latency 2 --baud jetdrive=115200 &
+//   export BJ_JETDRIVE_PORT=/tmp/bjsim/jetdrive BJ_PCD_PORT=/tmp/bjsim/pcd
+//   export BJ_MISTER_PORT=/tmp/bjsim/mister BJ_MJ_PORT=/tmp/bjsim/mj
+//   ./BJPrinter
+//
+// The protocols follow what the Controller classes send and expect:
+//   - JetDrive: "Q" is answered with "MFJET32>", the X2000 bytes are echoed
+//     back and after that MFJDRV frames (see mfjdrv.h) are answered with
+//     response_size() bytes, ACK or NAK (bad checksum), the command and the
+//     checksum of the reply
+//   - pressure controller: "Q\r" is answered with "PCD\r", every other
+//     command with "OK\r"
+//   - mister: answers like arduino/mister.ino
+//   - MJ board: every line is answered with a line, "b" and "B" with a JSON
+//     object. An image ("W", the head and the columns) has no length, so it
+//     ends when the line is quiet for a while.
+//
+// Timing and faults are set for every device, or for one with device=value:
+//   --latency MS   between the end of a command and the start of its reply
+//   --baud RATE    commands and replies take 10 bits a byte at this rate
+//   --drop P       probability a reply is never sent
+//   --garble P     probability a reply has a byte flipped
+//   --seed N       for repeatable faults
+//   --verbose      print every command and reply
+// Ctrl+C prints how many commands each device answered.
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using Bytes = std::string;
+
+constexpr unsigned char ACK {0x06};
+constexpr unsigned char NAK {0x15};
+// how long the MJ board's line has to be quiet for an image to have ended
+constexpr auto IMAGE_GAP {std::chrono::milliseconds(20)};
+
+volatile std::sig_atomic_t stopRequested {0};
+
+struct Settings
+{
+    double latency_ms {1.0};
+    long baudRate {0}; // 0 for no limit
+    double dropProbability {0.0};
+    double garbleProbability {0.0};
+};
+
+std::mt19937 random_engine;
+
+bool chance(double probability)
+{
+    return probability > 0 && std::uniform_real_distribution<double>(0, 1)(random_engine) < probability;
+}
+
+// e.g. an image is cut short after the first 32 bytes
+std::string printable(const Bytes &bytes)
+{
+    constexpr size_t MAX_SHOWN {32};
+    std::string s;
+    for (const unsigned char c : bytes.substr(0, MAX_SHOWN))
+    {
+        if (c >= 0x20 && c < 0x7F) s += (char)c;
+        else
+        {
+            char hex[8];
+            std::snprintf(hex, sizeof(hex), "\\x%02X", c);
+            s += hex;
+        }
+    }
+    if (bytes.size() > MAX_SHOWN) s += "... (" + std::to_string(bytes.size()) + " bytes)";
+    return s;
+}
+
+class Device
+{
+public:
+    Device(std::string name, Settings settings) :
+        name_(std::move(name)), settings_(settings) {}
+    virtual ~Device()
+    {
+        if (master_ >= 0) close(master_);
+        if (slave_ >= 0) close(slave_);
+    }
+
+    const std::string &name() const { return name_; }
+    int fd() const { return master_; }
+    int answered() const { return answered_; }
+    int dropped() const { return dropped_; }
+
+    bool open_pty(const std::string &dir)
+    {
+        master_ = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0) return false;
+        fcntl(master_, F_SETFL, fcntl(master_, F_GETFL) | O_NONBLOCK);
+
+        const char *slaveName = ptsname(master_);
+        if (!slaveName) return false;
+        // held open so the master doesn't hang up while nothing is connected
+        slave_ = open(slaveName, O_RDWR | O_NOCTTY);
+        if (slave_ < 0) return false;
+        termios tio {};
+        tcgetattr(slave_, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave_, TCSANOW, &tio);
+
+        link_ = dir + "/" + name_;
+        unlink(link_.c_str());
+        if (symlink(slaveName, link_.c_str()) != 0) return false;
+        std::printf("%-9s %s -> %s\n", name_.c_str(), link_.c_str(), slaveName);
+        return true;
+    }
+
+    void remove_link() const
+    {
+        if (!link_.empty()) unlink(link_.c_str());
+    }
+
+    void read_input(bool verbose)
+    {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(master_, buf, sizeof(buf))) > 0)
+        {
+            const auto now = Clock::now();
+            // the bytes can't have arrived faster than the baud rate allows
+            lineFreeAt_ = std::max(lineFreeAt_, now) + byte_time(n);
+            lastInput_ = now;
+            input_.append(buf, (size_t)n);
+        }
+        parse(verbose);
+    }
+
+    // sends the replies that are due, the time the next one is due
+    std::optional<Clock::time_point> send_replies(bool verbose)
+    {
+        parse(verbose);
+        const auto now = Clock::now();
+        while (!replies_.empty() && replies_.front().due <= now)
+        {
+            const Bytes &reply = replies_.front().bytes;
+            if (verbose) std::printf("%-9s <- %s\n", name_.c_str(), printable(reply).c_str());
+            if (write(master_, reply.data(), reply.size()) < 0) {} // nothing is connected
+            replies_.erase(replies_.begin());
+        }
+
+        std::optional<Clock::time_point> next;
+        if (!replies_.empty()) next = replies_.front().due;
+        if (const auto wait = pending_input_deadline()) next = next ? std::min(*next, *wait) : *wait;
+        return next;
+    }
+
+protected:
+    // a command at the front of the input, its length or 0 if it isn't complete
+    virtual size_t command_length(const Bytes &input, Clock::time_point now) const = 0;
+    // the reply to a complete command, nothing for no reply
+    virtual std::optional<Bytes> reply(const Bytes &command) = 0;
+    // when command_length() could change without more input
+    virtual std::optional<Clock::time_point> pending_input_deadline() const { return std::nullopt; }
+
+    Clock::time_point last_input() const { return lastInput_; }
+    const Bytes &input() const { return input_; }
+
+private:
+    struct Reply
+    {
+        Bytes bytes;
+        Clock::time_point due;
+    };
+
+    Clock::duration byte_time(size_t count) const
+    {
+        if (settings_.baudRate <= 0) return Clock::duration::zero();
+        return std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(count * 10.0 / settings_.baudRate));
+    }
+
+    void parse(bool verbose)
+    {
+        const auto now = Clock::now();
+        size_t length;
+        while (!input_.empty() && (length = command_length(input_, now)) > 0)
+        {
+            const Bytes command = input_.substr(0, length);
+            input_.erase(0, length);
+            if (verbose) std::printf("%-9s -> %s\n", name_.c_str(), printable(command).c_str());
+
+            std::optional<Bytes> r = reply(command);
+            if (!r) continue;
+            if (chance(settings_.dropProbability))
+            {
+                dropped_++;
+                if (verbose) std::printf("%-9s    (reply dropped)\n", name_.c_str());
+                continue;
+            }
+            if (!r->empty() && chance(settings_.garbleProbability))
+            {
+                const size_t i = std::uniform_int_distribution<size_t>(0, r->size() - 1)(random_engine);
+                (*r)[i] = (char)((*r)[i] ^ 0x5A);
+            }
+
+            // replies go out in order, one after another on the line
+            const auto start = std::max(lineFreeAt_, now)
+                    + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double, std::milli>(settings_.latency_ms));
+            const auto due = std::max(start, replies_.empty() ? start : replies_.back().due) + byte_time(r->size());
+            replies_.push_back({*r, due});
+            answered_++;
+        }
+    }
+
+    std::string name_;
+    Settings settings_;
+    std::string link_;
+    int master_ {-1};
+    int slave_ {-1};
+
+    Bytes input_;
+    Clock::time_point lineFreeAt_ {};
+    Clock::time_point lastInput_ {};
+    std::vector<Reply> replies_;
+    int answered_ {0};
+    int dropped_ {0};
+};
+
+class JetDrive final : public Device
+{
+public:
+    using Device::Device;
+
+protected:
+    size_t command_length(const Bytes &input, Clock::time_point) const override
+    {
+        if (!initialized_) return 1;
+        // 'S', the length, the length's bytes and the checksum
+        if ((unsigned char)input[0] != 'S') return 1;
+        if (input.size() < 2) return 0;
+        const size_t length = 2 + (unsigned char)input[1];
+        return input.size() >= length ? length : 0;
+    }
+
+    std::optional<Bytes> reply(const Bytes &command) override
+    {
+        if (!initialized_)
+        {
+            if (command == "Q")
+            {
+                x2000_ = 0;
+                return Bytes("MFJET32>");
+            }
+            // X2000 byte by byte, each one echoed
+            x2000_ = command[0] == "X2000"[x2000_] ? x2000_ + 1 : 0;
+            if (x2000_ == 5) initialized_ = true;
+            return command;
+        }
+
+        if (command.size() < 4) return std::nullopt; // stray byte
+        unsigned char check {0};
+        for (size_t i = 1; i + 1 < command.size(); ++i) check += (unsigned char)command[i];
+        const unsigned char cmd = (unsigned char)command[2];
+
+        Bytes r(response_size(cmd), '\0');
+        r[0] = (char)(check == (unsigned char)command.back() ? ACK : NAK);
+        r[1] = (char)cmd;
+        unsigned char replyCheck {0};
+        for (size_t i = 1; i + 1 < r.size(); ++i) replyCheck += (unsigned char)r[i];
+        r.back() = (char)replyCheck;
+        return r;
+    }
+
+private:
+    // as in mfjdrv.h
+    static size_t response_size(unsigned char cmd)
+    {
+        switch (cmd)
+        {
+        default:   return 4;
+        case 0xF0: return 5; // GETVERSION
+        case 0x0D: return 5; // MULTITRIGGER
+        case 0x60: return 27; // DUMPINPUT
+        }
+    }
+
+    bool initialized_ {false};
+    int x2000_ {0};
+};
+
+// commands and replies that are lines ending with a carriage return
+class LineDevice : public Device
+{
+public:
+    LineDevice(std::string name, Settings settings, Bytes initReply, Bytes okReply, Bytes errorReply) :
+        Device(std::move(name), settings),
+        initReply_(std::move(initReply)), okReply_(std::move(okReply)), errorReply_(std::move(errorReply)) {}
+
+protected:
+    size_t command_length(const Bytes &input, Clock::time_point) const override
+    {
+        const size_t end = input.find('\r');
+        return end == Bytes::npos ? 0 : end + 1;
+    }
+
+    std::optional<Bytes> reply(const Bytes &command) override
+    {
+        Bytes line = command;
+        line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
+        line.pop_back(); // '\r'
+        if (line.empty()) return std::nullopt;
+        if (line == "Q") return initReply_;
+        return known(line) ? okReply_ : errorReply_;
+    }
+
+    virtual bool known(const Bytes &line) const = 0;
+
+private:
+    Bytes initReply_;
+    Bytes okReply_;
+    Bytes errorReply_;
+};
+
+class PressureController final : public LineDevice
+{
+public:
+    explicit PressureController(Settings settings) :
+        LineDevice("pcd", settings, "PCD\r", "OK\r", "?\r") {}
+
+protected:
+    bool known(const Bytes &line) const override
+    {
+        // "as<psi>", purge on and purge off
+        return line.rfind("as", 0) == 0 || line == "P" || line == "O";
+    }
+};
+
+class Mister final : public LineDevice
+{
+public:
+    explicit Mister(Settings settings) :
+        LineDevice("mister", settings, "MISTER\n\r", "Placeholder\n\r", "Error\n\r") {}
+
+protected:
+    bool known(const Bytes &line) const override
+    {
+        return line.size() == 1 && std::strchr("OCLR", line[0]);
+    }
+};
+
+class MJBoard final : public Device
+{
+public:
+    using Device::Device;
+
+protected:
+    size_t command_length(const Bytes &input, Clock::time_point now) const override
+    {
+        if (input[0] == 'W')
+            return now - last_input() >= IMAGE_GAP ? input.size() : 0;
+        const size_t end = input.find('\n');
+        return end == Bytes::npos ? 0 : end + 1;
+    }
+
+    std::optional<Clock::time_point> pending_input_deadline() const override
+    {
+        if (!input().empty() && input()[0] == 'W') return last_input() + IMAGE_GAP;
+        return std::nullopt;
+    }
+
+    std::optional<Bytes> reply(const Bytes &command) override
+    {
+        if (command[0] == 'W')
+        {
+            const size_t columns = command.size() >= 2 ? (command.size() - 2) / 16 : 0;
+            return "Image received for head " + std::to_string((unsigned char)command[1] - 100)
+                    + ", " + std::to_string(columns) + " columns\n";
+        }
+
+        Bytes line = command.substr(0, command.size() - 1);
+        if (line == "b" || line == "B")
+        {
+            return "{\"power\": " + Bytes(powered_ ? "true" : "false")
+                    + ", \"mode\": " + std::to_string(mode_) + "}\n";
+        }
+        if (line == "O") powered_ = true;
+        else if (line == "F") powered_ = false;
+        else if (line.rfind("M ", 0) == 0) mode_ = std::atoi(line.c_str() + 2);
+        else if (line == "t") return Bytes("Head temps: 25.0 25.0 25.0 25.0\n");
+        else if (line == ">") return Bytes("Position: 0\n");
+        return "OK " + line + "\n";
+    }
+
+private:
+    bool powered_ {false};
+    int mode_ {0};
+};
+
+void handle_signal(int)
+{
+    stopRequested = 1;
+}
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: serialsim [--dir DIR] [--latency [DEVICE=]MS] [--baud [DEVICE=]RATE]\n"
+                 "                 [--drop [DEVICE=]P] [--garble [DEVICE=]P] [--seed N] [--verbose]\n"
+                 "devices: jetdrive, pcd, mister, mj\n");
+}
+
+const char *const DEVICE_NAMES[] {"jetdrive", "pcd", "mister", "mj"};
+
+// "value" for every device or "device=value" for one
+bool apply_option(std::map<std::string, Settings> &settings, const std::string &option, const std::string &argument)
+{
+    std::string device;
+    std::string value = argument;
+    const size_t equals = argument.find('=');
+    if (equals != std::string::npos)
+    {
+        device = argument.substr(0, equals);
+        value = argument.substr(equals + 1);
+        if (!settings.count(device)) return false;
+    }
+
+    char *end {nullptr};
+    const double number = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || number < 0) return false;
+
+    for (auto &[name, s] : settings)
+    {
+        if (!device.empty() && name != device) continue;
+        if (option == "--latency") s.latency_ms = number;
+        else if (option == "--baud") s.baudRate = (long)number;
+        else if (option == "--drop") s.dropProbability = number;
+        else if (option == "--garble") s.garbleProbability = number;
+        else return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir {"/tmp/bjsim"};
+    bool verbose {false};
+    unsigned seed {std::random_device{}()};
+
+    std::map<std::string, Settings> settings;
+    for (const char *name : DEVICE_NAMES) settings[name] = Settings{};
+    // what the Controller classes open the ports at
+    settings["jetdrive"].baudRate = 9600;
+    settings["pcd"].baudRate = 19200;
+    settings["mister"].baudRate = 19200;
+    settings["mj"].baudRate = 1'000'000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        if (option == "--verbose") { verbose = true; continue; }
+        if (option == "--help" || i + 1 >= argc) { usage(); return option == "--help" ? 0 : 1; }
+
+        const std::string argument = argv[++i];
+        if (option == "--dir") dir = argument;
+        else if (option == "--seed") seed = (unsigned)std::strtoul(argument.c_str(), nullptr, 10);
+        else if (!apply_option(settings, option, argument))
+        {
+            std::fprintf(stderr, "invalid %s %s\n", option.c_str(), argument.c_str());
+            usage();
+            return 1;
+        }
+    }
+    random_engine.seed(seed);
+
+    mkdir(dir.c_str(), 0755);
+    std::vector<std::unique_ptr<Device>> devices;
+    devices.push_back(std::make_unique<JetDrive>("jetdrive", settings["jetdrive"]));
+    devices.push_back(std::make_unique<PressureController>(settings["pcd"]));
+    devices.push_back(std::make_unique<Mister>(settings["mister"]));
+    devices.push_back(std::make_unique<MJBoard>("mj", settings["mj"]));
+    for (auto &device : devices)
+    {
+        if (!device->open_pty(dir))
+        {
+            std::fprintf(stderr, "can't create the pseudo-terminal for %s: %s\n",
+                         device->name().c_str(), std::strerror(errno));
+            return 1;
+        }
+    }
+    std::printf("seed %u\n", seed);
+    std::fflush(stdout);
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    std::vector<pollfd> fds;
+    for (const auto &device : devices) fds.push_back({device->fd(), POLLIN, 0});
+
+    while (!stopRequested)
+    {
+        // wake up for input or for the next reply that's due
+        int timeout_ms {1000};
+        const auto now = Clock::now();
+        for (auto &device : devices)
+        {
+            if (const auto due = device->send_replies(verbose))
+            {
+                const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(*due - now).count() + 1;
+                timeout_ms = std::min<int>(timeout_ms, (int)std::max<long long>(wait, 0));
+            }
+        }
+        if (verbose) std::fflush(stdout);
+
+        if (poll(fds.data(), fds.size(), timeout_ms) < 0) continue; // interrupted
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (fds[i].revents & POLLIN) devices[i]->read_input(verbose);
+        }
+    }
+
+    std::printf("\n");
+    for (const auto &device : devices)
+    {
+        std::printf("%-9s %d replies, %d dropped\n", device->name().c_str(), device->answered(), device->dropped());
+        device->remove_link();
+    }
+    return 0;
+}